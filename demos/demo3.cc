@@ -15,8 +15,10 @@
 #include "../vulkan/vulkan_buffer.h"
 #include "../vulkan/vulkan_command_pool.h"
 #include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_buffer_cache.h"
 #include "../vulkan/vulkan_device_queue.h"
 #include "../vulkan/vulkan_implementation.h"
+#include "../vulkan/vulkan_render_graph.h"
 #include "../vulkan/vulkan_render_pass.h"
 #include "../vulkan/vulkan_surface.h"
 #include "../vulkan/vulkan_swap_chain.h"
@@ -44,8 +46,9 @@ int main(int argc, char** argv) {
   std::unique_ptr<VulkanSurface> surface =
       VulkanSurface::CreateViewSurface(window_);
   surface->CreateSurface();
+  // Frames are submitted from |command_buffer_cache| below, so the swap
+  // chain's own command buffers are never reset individually.
   surface->Initialize(&device_queue, VulkanSurface::DEFAULT_SURFACE_FORMAT,
-      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
       VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 
   // Create a render pass.
@@ -74,6 +77,8 @@ int main(int argc, char** argv) {
 
   VulkanRenderPass render_pass(&device_queue);
   render_pass.Initialize(surface->GetSwapChain(), subpass_dependencies);
+  render_pass.frame_buffers_.resize(surface->GetSwapChain()->num_images(),
+                                    VK_NULL_HANDLE);
 
   const std::string kVertexShaderSource =
       "#version 450\n"
@@ -125,6 +130,13 @@ int main(int argc, char** argv) {
   VulkanBuffer vertexBuffer;
   vertexBuffer.Initialize(&device_queue, vertex_data, 4);
 
+  // Derives the barriers around the draw from what it declares.
+  VulkanRenderGraph render_graph(device_queue.GetGraphicsQueueFamilyIndex());
+
+  // The quad never changes, so every frame resubmits the command buffer
+  // recorded for its slot and image the first time.
+  VulkanCommandBufferCache command_buffer_cache(&device_queue);
+  command_buffer_cache.Initialize();
 
   // Run loop
   // Prepare notification for window destruction
@@ -179,160 +191,119 @@ int main(int argc, char** argv) {
       uint32_t image_index = 0;
       surface->GetSwapChain()->WaitFences(&resource_index, &image_index);
       // Tutorial04::PrepareFrame() is called in Draw();
+      // The framebuffer wraps the acquired image, so there is one per image,
+      // looked up in the framebuffer cache.
       if (!render_pass.CreateFrameBuffer(surface->GetSwapChain(),
-                                         resource_index)) {
+                                         image_index)) {
          std::cout << "fail to create a frame buffer\n"  << std::endl;
         return 0;
       }
-      // for single use
-
-     /* ScopedSingleUseCommandBufferRecorder
-          ScopedSingleUseCommandBufferRecorder;*/
-      VkCommandBufferBeginInfo command_buffer_begin_info = {
-          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // VkStructureType sType
-          nullptr,  // const void                            *pNext
-          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // VkCommandBufferUsageFlags
-          nullptr  // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-      };
-
-      vkBeginCommandBuffer(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(),
-          &command_buffer_begin_info);
-
-      VkImageSubresourceRange image_subresource_range = {
-          VK_IMAGE_ASPECT_COLOR_BIT,  // VkImageAspectFlags aspectMask
-          0,  // uint32_t                               baseMipLevel
-          1,  // uint32_t                               levelCount
-          0,  // uint32_t                               baseArrayLayer
-          1   // uint32_t                               layerCount
-      };
-
-      if (device_queue.GetPresentQueue() != device_queue.GetGraphicsQueue()) {
-        VkImageMemoryBarrier barrier_from_present_to_draw = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // VkStructureType sType
-            nullptr,  // const void                            *pNext
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags dstAccessMask
-            VK_IMAGE_LAYOUT_UNDEFINED,        // VkImageLayout oldLayout
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout newLayout
-            device_queue
-                .GetPresentQueueFamilyIndex(),  // uint32_t srcQueueFamilyIndex
-            device_queue
-                .GetGraphicsQueueFamilyIndex(),  // uint32_t dstQueueFamilyIndex
-            surface->GetSwapChain()->GetImage(image_index),  // VkImage image
-            image_subresource_range  // VkImageSubresourceRange subresourceRange
-        };
-
-        vkCmdPipelineBarrier(
-            surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(),
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
-            nullptr, 1, &barrier_from_present_to_draw);
+      if (resize) {
+        command_buffer_cache.Invalidate();
+        resize = false;
       }
-
-      VkClearValue clear_value = {
-          {{1.0f, 0.8f, 0.4f, 0.0f}},  // VkClearColorValue color
-      };
-
-      VkRenderPassBeginInfo render_pass_begin_info = {
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // VkStructureType sType
-          nullptr,               // const void                            *pNext
-          render_pass.handle(),  // VkRenderPass renderPass
-          render_pass
-              .frame_buffers_[resource_index],  // VkFramebuffer framebuffer
-          {
-              // VkRect2D                               renderArea
+      VulkanCommandBufferCache::Key key;
+      key.frame_slot = resource_index;
+      key.image_index = image_index;
+      key.framebuffer = render_pass.frame_buffers_[image_index];
+      key.pipeline = render_pass.GetGraphicsPipeline();
+      VkCommandBuffer command_buffer = command_buffer_cache.GetOrRecord(
+          key, [&](VkCommandBuffer command_buffer) {
+        // The acquire semaphore is waited on at the color attachment output
+        // stage and the render pass moves the image to the present layout, so
+        // the graph only adds what is missing. Swap chain images are shared
+        // with a separate present queue, so there is no ownership transfer.
+        render_graph.Reset();
+        VulkanRenderGraph::ResourceId swap_image = render_graph.ImportImage(
+            surface->GetSwapChain()->GetImage(image_index),
+            VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        render_graph.SetOutput(swap_image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        VulkanRenderGraph::PassId draw_pass = render_graph.AddPass(
+            "draw", [&](VkCommandBuffer command_buffer) {
+          VkClearValue clear_value = {
+              {{1.0f, 0.8f, 0.4f, 0.0f}},  // VkClearColorValue color
+          };
+
+          VkRenderPassBeginInfo render_pass_begin_info = {
+              VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // VkStructureType sType
+              nullptr,               // const void                            *pNext
+              render_pass.handle(),  // VkRenderPass renderPass
+              render_pass
+                  .frame_buffers_[image_index],  // VkFramebuffer framebuffer
               {
-                  // VkOffset2D                             offset
-                  0,  // x
-                  0   // y
+                  // VkRect2D                               renderArea
+                  {
+                      // VkOffset2D                             offset
+                      0,  // x
+                      0   // y
+                  },
+                  surface->GetSwapChain()->GetExtent(),  // VkExtent2D extent;
               },
-              surface->GetSwapChain()->GetExtent(),  // VkExtent2D extent;
-          },
-          1,  // uint32_t                               clearValueCount
-          &clear_value  // const VkClearValue                    *pClearValues
-      };
-
-      vkCmdBeginRenderPass(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(),
-          &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdBindPipeline(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(),
-          VK_PIPELINE_BIND_POINT_GRAPHICS, render_pass.GetGraphicsPipeline());
-
-      VkViewport viewport = {
-          0.0f,  // float            x
-          0.0f,  // float            y
-          static_cast<float>(
-              surface->GetSwapChain()->GetExtent().width),
-          static_cast<float>(
-              surface->GetSwapChain()->GetExtent().height),
-          0.0f,  // float            minDepth
-          1.0f   // float            maxDepth
-      };
-
-      VkRect2D scissor = {
-          {
-              // VkOffset2D        offset
-              0,  // int32_t           x
-              0   // int32_t           y
-          },
-          {
-              // VkExtent2D        extent
-              surface->GetSwapChain()->GetExtent().width,
-              surface->GetSwapChain()->GetExtent().height
-          }};
-
-      vkCmdSetViewport(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(), 0, 1,
-          &viewport);
-      vkCmdSetScissor(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(), 0, 1,
-          &scissor);
-
-      VkDeviceSize offset = 0;
-      vkCmdBindVertexBuffers(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(), 0, 1,
-          vertexBuffer.handle(), &offset);
-      vkCmdDraw(surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(), 4,
-                1, 0, 0);
-      vkCmdEndRenderPass(
-          surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle());
-
-      if (device_queue.GetGraphicsQueue() != device_queue.GetPresentQueue()) {
-        VkImageMemoryBarrier barrier_from_draw_to_present = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // VkStructureType sType
-            nullptr,  // const void                            *pNext
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags dstAccessMask
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout oldLayout
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout newLayout
-            device_queue
-                .GetPresentQueueFamilyIndex(),  // uint32_t srcQueueFamilyIndex
-            device_queue
-                .GetGraphicsQueueFamilyIndex(),  // uint32_t dstQueueFamilyIndex
-            surface->GetSwapChain()->GetImage(resource_index),  // VkImage image
-            image_subresource_range  // VkImageSubresourceRange subresourceRange
-        };
-        vkCmdPipelineBarrier(
-            surface->GetSwapChain()->GetCurrentCommandBuffer(resource_index)->handle(),
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
-            &barrier_from_draw_to_present);
-      }
-
-      if (vkEndCommandBuffer(surface->GetSwapChain()->GetCurrentCommandBuffer(
-              resource_index)->handle()) != VK_SUCCESS) {
+              1,  // uint32_t                               clearValueCount
+              &clear_value  // const VkClearValue                    *pClearValues
+          };
+
+          vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info,
+                               VK_SUBPASS_CONTENTS_INLINE);
+          vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            render_pass.GetGraphicsPipeline());
+
+          VkViewport viewport = {
+              0.0f,  // float            x
+              0.0f,  // float            y
+              static_cast<float>(
+                  surface->GetSwapChain()->GetExtent().width),
+              static_cast<float>(
+                  surface->GetSwapChain()->GetExtent().height),
+              0.0f,  // float            minDepth
+              1.0f   // float            maxDepth
+          };
+
+          VkRect2D scissor = {
+              {
+                  // VkOffset2D        offset
+                  0,  // int32_t           x
+                  0   // int32_t           y
+              },
+              {
+                  // VkExtent2D        extent
+                  surface->GetSwapChain()->GetExtent().width,
+                  surface->GetSwapChain()->GetExtent().height
+              }};
+
+          vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+          vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+          VkDeviceSize offset = 0;
+          vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffer.handle(),
+                                 &offset);
+          vkCmdDraw(command_buffer, 4, 1, 0, 0);
+          vkCmdEndRenderPass(command_buffer);
+        });
+        render_graph.Write(
+            draw_pass, swap_image,
+            VulkanRenderGraph::ColorAttachment(VK_IMAGE_LAYOUT_UNDEFINED,
+                                               VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+        render_graph.Compile();
+        render_graph.Execute(command_buffer);
+      });
+      if (VK_NULL_HANDLE == command_buffer) {
         std::cout << "Could not record command buffer!" << std::endl;
         return 0;
       }
       // end of Tutorial04::PrepareFrame
-      surface->GetSwapChain()->SwapBuffer2(resource_index, &image_index);
+      surface->GetSwapChain()->SwapBuffer2(resource_index, &image_index,
+                                           command_buffer);
     }
   }  // end of while
 
+  vkDeviceWaitIdle(device_queue.GetVulkanDevice());
+  command_buffer_cache.Destroy();
   render_pass.Destroy();
   surface->Destroy();
+  vertexBuffer.Destroy();
 
   gpu::DestroyNativeWindow(window_);
   window_ = gfx::kNullAcceleratedWidget;
@@ -1,27 +1,88 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
 #include "base/command_line.h"
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
 #include "ui/gfx/geometry/rect.h"
 #include "ui/gfx/native_widget_types.h"
 #include "ui/gfx/x/x11_types.h"
 
 #include "../tests/native_window.h"
 #include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_buffer_cache.h"
 #include "../vulkan/vulkan_command_pool.h"
 #include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_frame_command_allocator.h"
 #include "../vulkan/vulkan_implementation.h"
+#include "../vulkan/vulkan_mesh.h"
+#include "../vulkan/vulkan_mesh_optimizer.h"
+#include "../vulkan/vulkan_pipeline_cache.h"
+#include "../vulkan/vulkan_pipeline_compiler.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_graph.h"
 #include "../vulkan/vulkan_render_pass.h"
 #include "../vulkan/vulkan_surface.h"
 #include "../vulkan/vulkan_swap_chain.h"
+#include "../vulkan/vulkan_sync_pool.h"
+#include "../vulkan/vulkan_upload_batch.h"
+#include "../vulkan/vulkan_vertex_format.h"
 
 using namespace gpu;
 
+namespace {
+
+// 12 bytes per vertex instead of the 32 of VulkanBuffer::VertexData. Half
+// floats are exact for the cube's corners and 8 bits per color channel are
+// all the swap chain keeps anyway.
+struct CubeVertex {
+  Half4 position;
+  UNorm8x4 color;
+};
+
+using CubeVertexLayout =
+    VulkanVertexLayout<CubeVertex,
+                       GPU_VERTEX_ATTRIBUTE(CubeVertex, position),
+                       GPU_VERTEX_ATTRIBUTE(CubeVertex, color)>;
+static_assert(CubeVertexLayout::kStride == 12, "CubeVertex isn't packed");
+
+// Returns $XDG_CACHE_HOME/vulkan_demos/demo4_pipeline_cache.bin, falling back
+// to ~/.cache, and creates the directory. Returns an empty path, which keeps
+// the cache in memory, if there is no cache directory.
+std::string GetDefaultPipelineCachePath() {
+  std::string cache_home;
+  const char* xdg_cache_home = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  if (xdg_cache_home && *xdg_cache_home)
+    cache_home = xdg_cache_home;
+  else if (home && *home)
+    cache_home = std::string(home) + "/.cache";
+  else
+    return std::string();
+
+  const std::string directory = cache_home + "/vulkan_demos";
+  mkdir(cache_home.c_str(), 0700);
+  if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+    return std::string();
+  return directory + "/demo4_pipeline_cache.bin";
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
   base::CommandLine::Init(argc, argv);
 
@@ -34,8 +95,16 @@ int main(int argc, char** argv) {
   const bool success = gpu::InitializeVulkan();
   CHECK(success);
 
-  // Create a device and queue.
+  // Create a device and queue. Pipelines compiled by an earlier run are
+  // loaded from --pipeline-cache, by default a file in the user's cache
+  // directory.
   gpu::VulkanDeviceQueue device_queue;
+  std::string pipeline_cache_path =
+      base::CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          "pipeline-cache");
+  if (pipeline_cache_path.empty())
+    pipeline_cache_path = GetDefaultPipelineCachePath();
+  device_queue.SetPipelineCachePath(pipeline_cache_path);
   device_queue.Initialize(VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
                           VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG);
 
@@ -43,8 +112,9 @@ int main(int argc, char** argv) {
   std::unique_ptr<VulkanSurface> surface =
       VulkanSurface::CreateViewSurface(window_);
   surface->CreateSurface();
+  // Frames are recorded into command buffers of |frame_allocator| below, so
+  // the swap chain's own command buffers are never reset individually.
   surface->Initialize(&device_queue, VulkanSurface::DEFAULT_SURFACE_FORMAT,
-      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
       VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 
   // Create a render pass.
@@ -71,8 +141,35 @@ int main(int argc, char** argv) {
           VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
       }};
 
+  // --depth adds a depth buffer, and --depth-prepass also lays depth down
+  // before shading so every pixel is shaded once.
+  VulkanRenderPass::DepthMode depth_mode =
+      VulkanRenderPass::DepthMode::DEPTH_MODE_NONE;
+  if (base::CommandLine::ForCurrentProcess()->HasSwitch("depth-prepass"))
+    depth_mode = VulkanRenderPass::DepthMode::DEPTH_MODE_PREPASS;
+  else if (base::CommandLine::ForCurrentProcess()->HasSwitch("depth"))
+    depth_mode = VulkanRenderPass::DepthMode::DEPTH_MODE_TEST;
+  // --msaa=N renders into transient N sample attachments that are resolved
+  // into the swap chain image.
+  unsigned msaa = 1;
+  if (base::CommandLine::ForCurrentProcess()->HasSwitch("msaa") &&
+      !base::StringToUint(
+          base::CommandLine::ForCurrentProcess()->GetSwitchValueASCII("msaa"),
+          &msaa)) {
+    msaa = 1;
+  }
+  msaa = std::max(msaa, 1u);
   VulkanRenderPass render_pass(&device_queue);
-  render_pass.Initialize(surface->GetSwapChain(), subpass_dependencies);
+  render_pass.Initialize(surface->GetSwapChain(), subpass_dependencies,
+                         depth_mode, static_cast<VkSampleCountFlagBits>(msaa));
+  if (depth_mode != VulkanRenderPass::DepthMode::DEPTH_MODE_NONE)
+    printf("Depth format: %d\n", render_pass.depth_format());
+  if (render_pass.samples() != VK_SAMPLE_COUNT_1_BIT)
+    printf("MSAA: %dx\n", render_pass.samples());
+  VkClearValue clear_value = {
+      {{1.0f, 0.8f, 0.4f, 0.0f}},  // VkClearColorValue color
+  };
+  render_pass.SetClearValue(0, clear_value);
 
   const std::string kVertexShaderSource =
       "#version 450\n"
@@ -82,6 +179,7 @@ int main(int argc, char** argv) {
       "{"
       "  vec4 gl_Position;"
       "};"
+      "invariant gl_Position;"
       "layout(location = 0) out vec4 v_Color;"
       "void main() {"
       "  gl_Position = i_Position;"
@@ -97,9 +195,22 @@ int main(int argc, char** argv) {
       "}";
 
   // Create a pipeline using vkCreatePipelineLayout and
-  // vkCreateGraphicsPipelines.
-  render_pass.CreatePipeline(kVertexShaderSource, kFragShaderSource,
-      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, true);
+  // vkCreateGraphicsPipelines. It is built on |pipeline_compiler|'s threads
+  // while the loop below clears the window, and the cube shows up once it is
+  // ready.
+  VulkanPipelineCompiler pipeline_compiler(&device_queue, 0);
+  pipeline_compiler.Initialize();
+  base::TimeTicks pipeline_start = base::TimeTicks::Now();
+  render_pass.CreatePipelineAsync(kVertexShaderSource, kFragShaderSource,
+                                  VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                  CubeVertexLayout::Describe(),
+                                  &pipeline_compiler);
+  if (depth_mode == VulkanRenderPass::DepthMode::DEPTH_MODE_PREPASS) {
+    render_pass.CreateDepthPrepassPipeline(kVertexShaderSource,
+                                           VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                           CubeVertexLayout::Describe());
+  }
+  bool pipeline_reported = false;
 
 
 #define XYZ1(_x_, _y_, _z_) (_x_), (_y_), (_z_), 1.f
@@ -125,10 +236,193 @@ VulkanBuffer::VertexData vertex_data[] = {
     {XYZ1(-1, -1, 1), XYZ1(0.f, 0.f, 1.f)},  {XYZ1(1, -1, -1), XYZ1(1.f, 0.f, 0.f)}, {XYZ1(-1, -1, -1), XYZ1(0.f, 0.f, 0.f)},
 };
 
-
+  // Every corner of the cube is shared by six of the 36 expanded vertices, so
+  // welding leaves 8 vertices the vertex shader runs on and an index list.
+  const uint32_t kExpandedVertexCount = arraysize(vertex_data);
+  VulkanMesh<VulkanBuffer::VertexData> mesh =
+      WeldVertices(vertex_data, kExpandedVertexCount);
+  const uint32_t kIndexCount = static_cast<uint32_t>(mesh.indices.size());
+
+  const uint32_t welded_vertex_count =
+      static_cast<uint32_t>(mesh.vertices.size());
+  VertexCacheStatistics cache_before = AnalyzeVertexCache(
+      mesh.indices.data(), kIndexCount, welded_vertex_count);
+  OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), kIndexCount,
+                      welded_vertex_count);
+  OptimizeVertexFetch(&mesh.vertices, &mesh.indices);
+  VertexCacheStatistics cache_after = AnalyzeVertexCache(
+      mesh.indices.data(), kIndexCount, welded_vertex_count);
+  printf("Vertex cache: ACMR %.2f -> %.2f, ATVR %.2f -> %.2f\n",
+         cache_before.acmr, cache_after.acmr, cache_before.atvr,
+         cache_after.atvr);
+
+  std::vector<CubeVertex> cube_vertices(mesh.vertices.size());
+  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+    const VulkanBuffer::VertexData& vertex = mesh.vertices[i];
+    cube_vertices[i].position =
+        PackHalf4(vertex.x, vertex.y, vertex.z, vertex.w);
+    cube_vertices[i].color =
+        PackUNorm8x4(vertex.r, vertex.g, vertex.b, vertex.a);
+  }
+  printf("Vertex shader invocations: %u indexed vs %u expanded "
+         "(%.0f%% fewer)\n",
+         static_cast<uint32_t>(cube_vertices.size()), kExpandedVertexCount,
+         100.0 * (kExpandedVertexCount - cube_vertices.size()) /
+             kExpandedVertexCount);
+  printf("Vertex data: %zu bytes packed + %zu bytes of indices, %zu bytes as "
+         "floats\n",
+         cube_vertices.size() * sizeof(CubeVertex),
+         kIndexCount * sizeof(uint16_t), sizeof(vertex_data));
+
+  // --host-visible-vertices keeps the vertices in host visible memory so it
+  // can be compared against the default device local + staging path.
+  const VulkanBuffer::MemoryMode memory_mode =
+      base::CommandLine::ForCurrentProcess()->HasSwitch(
+          "host-visible-vertices")
+          ? VulkanBuffer::MEMORY_MODE_HOST_VISIBLE
+          : VulkanBuffer::MEMORY_MODE_DEVICE_LOCAL;
+
+  base::TimeTicks upload_start = base::TimeTicks::Now();
+  VulkanUploadBatch upload_batch(&device_queue);
+  upload_batch.Initialize();
   VulkanBuffer vertexBuffer;
-  vertexBuffer.Initialize(&device_queue, vertex_data, 36);
+  vertexBuffer.InitializeVertices(
+      &device_queue, cube_vertices.data(),
+      static_cast<uint32_t>(cube_vertices.size()), memory_mode, &upload_batch);
+  VulkanBuffer indexBuffer;
+  indexBuffer.InitializeIndices(&device_queue, mesh.indices.data(),
+                                kIndexCount, memory_mode, &upload_batch);
+  upload_batch.Submit();
+  upload_batch.Wait();
+  printf("Vertex upload (%s) took %.3f ms\n",
+         memory_mode == VulkanBuffer::MEMORY_MODE_HOST_VISIBLE
+             ? "host visible"
+             : "device local",
+         (base::TimeTicks::Now() - upload_start).InMillisecondsF());
+
+
+  // One transient command pool per swap chain slot, reset as a whole once
+  // the slot's fence has signaled.
+  VulkanFrameCommandAllocator frame_allocator(
+      &device_queue, surface->GetSwapChain()->num_images());
+  frame_allocator.Initialize();
+
+  // The cube never changes, so by default every frame resubmits command
+  // buffers recorded once per slot and image. --disable-command-buffer-cache
+  // records every frame again for comparison.
+  const bool cache_command_buffers =
+      !base::CommandLine::ForCurrentProcess()->HasSwitch(
+          "disable-command-buffer-cache");
+  VulkanCommandBufferCache command_buffer_cache(&device_queue);
+  command_buffer_cache.Initialize();
+  // Bumped whenever the scene is edited.
+  uint64_t scene_version = 0;
+
+  // Derives the barriers around the draw from what it declares.
+  VulkanRenderGraph render_graph(device_queue.GetGraphicsQueueFamilyIndex());
+
+  auto record_frame = [&](VkCommandBuffer command_buffer,
+                          uint32_t resource_index, uint32_t image_index) {
+    // The acquire semaphore is waited on at the color attachment output
+    // stage and the render pass moves the image to the present layout, so
+    // the graph only adds what is missing. Swap chain images are shared
+    // with a separate present queue, so there is no ownership transfer.
+    render_graph.Reset();
+    VulkanRenderGraph::ResourceId swap_image = render_graph.ImportImage(
+        surface->GetSwapChain()->GetImage(image_index),
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    render_graph.SetOutput(swap_image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    VulkanRenderGraph::PassId draw_pass = render_graph.AddPass(
+        "draw", [&](VkCommandBuffer command_buffer) {
+      VkRenderPassBeginInfo render_pass_begin_info = {
+          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // VkStructureType sType
+          nullptr,               // const void                            *pNext
+          render_pass.handle(),  // VkRenderPass renderPass
+          render_pass
+              .frame_buffers_[image_index],  // VkFramebuffer framebuffer
+          {
+              // VkRect2D                               renderArea
+              {
+                  // VkOffset2D                             offset
+                  0,  // x
+                  0   // y
+              },
+              surface->GetSwapChain()->GetExtent(),  // VkExtent2D extent;
+          },
+          static_cast<uint32_t>(
+              render_pass.clear_values().size()),  // uint32_t clearValueCount
+          render_pass.clear_values()
+              .data()  // const VkClearValue                    *pClearValues
+      };
+
+      vkCmdBeginRenderPass(
+          command_buffer,
+          &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+      // Only clear until the pipeline is ready.
+      VkPipeline pipeline = render_pass.GetGraphicsPipeline();
+      VkPipeline depth_prepass_pipeline = render_pass.GetDepthPrepassPipeline();
+      if (VK_NULL_HANDLE != pipeline) {
+        // The viewport and scissor are dynamic in both pipelines, so they
+        // carry over from the pre-pass pipeline.
+        vkCmdBindPipeline(
+            command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            VK_NULL_HANDLE != depth_prepass_pipeline ? depth_prepass_pipeline
+                                                     : pipeline);
+
+        VkViewport viewport = {
+            0.0f,  // float            x
+            0.0f,  // float            y
+            static_cast<float>(
+                surface->GetSwapChain()->GetExtent().width),
+            static_cast<float>(
+                surface->GetSwapChain()->GetExtent().height),
+            0.0f,  // float            minDepth
+            1.0f   // float            maxDepth
+        };
 
+        VkRect2D scissor = {
+            {
+                // VkOffset2D        offset
+                0,  // int32_t           x
+                0   // int32_t           y
+            },
+            {
+                // VkExtent2D        extent
+                surface->GetSwapChain()->GetExtent().width,
+                surface->GetSwapChain()->GetExtent().height
+            }};
+
+        vkCmdSetViewport(
+            command_buffer, 0, 1,
+            &viewport);
+        vkCmdSetScissor(
+            command_buffer, 0, 1,
+            &scissor);
+
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(
+            command_buffer, 0, 1,
+            vertexBuffer.handle(), &offset);
+        indexBuffer.BindIndexBuffer(command_buffer);
+        indexBuffer.DrawIndexed(command_buffer);
+        if (VK_NULL_HANDLE != depth_prepass_pipeline) {
+          vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline);
+          indexBuffer.DrawIndexed(command_buffer);
+        }
+      }
+      vkCmdEndRenderPass(
+          command_buffer);
+    });
+    render_graph.Write(
+        draw_pass, swap_image,
+        VulkanRenderGraph::ColorAttachment(VK_IMAGE_LAYOUT_UNDEFINED,
+                                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+    render_graph.Compile();
+    render_graph.Execute(command_buffer);
+  };
 
   // Run loop
   // Prepare notification for window destruction
@@ -182,158 +476,109 @@ VulkanBuffer::VertexData vertex_data[] = {
       static uint32_t resource_index = 0;
       uint32_t image_index = 0;
       surface->GetSwapChain()->WaitFences(&resource_index, &image_index);
-      // Tutorial04::PrepareFrame() is called in Draw();
+      // The framebuffer cache returns the same framebuffer for the image
+      // until the swap chain is recreated, so cached command buffers that
+      // reference it stay valid.
       if (!render_pass.CreateFrameBuffer(surface->GetSwapChain(),
-                                         resource_index)) {
+                                         image_index)) {
          std::cout << "fail to create a frame buffer\n"  << std::endl;
         return 0;
       }
 
-      VkCommandBufferBeginInfo command_buffer_begin_info = {
-          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // VkStructureType sType
-          nullptr,  // const void                            *pNext
-          VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // VkCommandBufferUsageFlags
-          nullptr  // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
-      };
-
-      vkBeginCommandBuffer(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index),
-          &command_buffer_begin_info);
-
-      VkImageSubresourceRange image_subresource_range = {
-          VK_IMAGE_ASPECT_COLOR_BIT,  // VkImageAspectFlags aspectMask
-          0,  // uint32_t                               baseMipLevel
-          1,  // uint32_t                               levelCount
-          0,  // uint32_t                               baseArrayLayer
-          1   // uint32_t                               layerCount
-      };
-
-      if (device_queue.GetPresentQueue() != device_queue.GetGraphicsQueue()) {
-        VkImageMemoryBarrier barrier_from_present_to_draw = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // VkStructureType sType
-            nullptr,  // const void                            *pNext
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags dstAccessMask
-            VK_IMAGE_LAYOUT_UNDEFINED,        // VkImageLayout oldLayout
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout newLayout
-            device_queue
-                .GetPresentQueueFamilyIndex(),  // uint32_t srcQueueFamilyIndex
-            device_queue
-                .GetGraphicsQueueFamilyIndex(),  // uint32_t dstQueueFamilyIndex
-            surface->GetSwapChain()->GetImage(image_index),  // VkImage image
-            image_subresource_range  // VkImageSubresourceRange subresourceRange
-        };
-
-        vkCmdPipelineBarrier(
-            *surface->GetSwapChain()->GetCommandBuffer(resource_index),
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
-            nullptr, 1, &barrier_from_present_to_draw);
+      if (!pipeline_reported &&
+          VK_NULL_HANDLE != render_pass.GetGraphicsPipeline()) {
+        printf("Pipeline was ready after %.2f ms with a %s pipeline cache\n",
+               (base::TimeTicks::Now() - pipeline_start).InMillisecondsF(),
+               device_queue.GetPipelineCache()->loaded_size() ? "warm"
+                                                              : "cold");
+        pipeline_reported = true;
       }
 
-      VkClearValue clear_value = {
-          {{1.0f, 0.8f, 0.4f, 0.0f}},  // VkClearColorValue color
-      };
-
-      VkRenderPassBeginInfo render_pass_begin_info = {
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // VkStructureType sType
-          nullptr,               // const void                            *pNext
-          render_pass.handle(),  // VkRenderPass renderPass
-          render_pass
-              .frame_buffers_[resource_index],  // VkFramebuffer framebuffer
-          {
-              // VkRect2D                               renderArea
-              {
-                  // VkOffset2D                             offset
-                  0,  // x
-                  0   // y
-              },
-              surface->GetSwapChain()->GetExtent(),  // VkExtent2D extent;
-          },
-          1,  // uint32_t                               clearValueCount
-          &clear_value  // const VkClearValue                    *pClearValues
-      };
-
-      vkCmdBeginRenderPass(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index),
-          &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdBindPipeline(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index),
-          VK_PIPELINE_BIND_POINT_GRAPHICS, render_pass.GetGraphicsPipeline());
-
-      VkViewport viewport = {
-          0.0f,  // float            x
-          0.0f,  // float            y
-          static_cast<float>(
-              surface->GetSwapChain()->GetExtent().width),
-          static_cast<float>(
-              surface->GetSwapChain()->GetExtent().height),
-          0.0f,  // float            minDepth
-          1.0f   // float            maxDepth
-      };
-
-      VkRect2D scissor = {
-          {
-              // VkOffset2D        offset
-              0,  // int32_t           x
-              0   // int32_t           y
-          },
-          {
-              // VkExtent2D        extent
-              surface->GetSwapChain()->GetExtent().width,
-              surface->GetSwapChain()->GetExtent().height
-          }};
-
-      vkCmdSetViewport(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index), 0, 1,
-          &viewport);
-      vkCmdSetScissor(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index), 0, 1,
-          &scissor);
-
-      VkDeviceSize offset = 0;
-      vkCmdBindVertexBuffers(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index), 0, 1,
-          vertexBuffer.handle(), &offset);
-      vkCmdDraw(*surface->GetSwapChain()->GetCommandBuffer(resource_index), 36,
-                1, 0, 0);
-      vkCmdEndRenderPass(
-          *surface->GetSwapChain()->GetCommandBuffer(resource_index));
-
-      if (device_queue.GetGraphicsQueue() != device_queue.GetPresentQueue()) {
-        VkImageMemoryBarrier barrier_from_draw_to_present = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // VkStructureType sType
+      VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+      if (cache_command_buffers) {
+        if (resize) {
+          command_buffer_cache.Invalidate();
+          resize = false;
+        }
+        VulkanCommandBufferCache::Key key;
+        key.frame_slot = resource_index;
+        key.image_index = image_index;
+        key.framebuffer = render_pass.frame_buffers_[image_index];
+        key.pipeline = render_pass.GetGraphicsPipeline();
+        key.scene_version = scene_version;
+        command_buffer = command_buffer_cache.GetOrRecord(
+            key, [&](VkCommandBuffer command_buffer) {
+              record_frame(command_buffer, resource_index, image_index);
+            });
+      } else {
+        frame_allocator.BeginFrame(resource_index);
+        command_buffer = frame_allocator.AllocatePrimary();
+
+        VkCommandBufferBeginInfo command_buffer_begin_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,  // VkStructureType sType
             nullptr,  // const void                            *pNext
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags srcAccessMask
-            VK_ACCESS_MEMORY_READ_BIT,        // VkAccessFlags dstAccessMask
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout oldLayout
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,  // VkImageLayout newLayout
-            device_queue
-                .GetPresentQueueFamilyIndex(),  // uint32_t srcQueueFamilyIndex
-            device_queue
-                .GetGraphicsQueueFamilyIndex(),  // uint32_t dstQueueFamilyIndex
-            surface->GetSwapChain()->GetImage(resource_index),  // VkImage image
-            image_subresource_range  // VkImageSubresourceRange subresourceRange
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // VkCommandBufferUsageFlags
+            nullptr  // const VkCommandBufferInheritanceInfo  *pInheritanceInfo
         };
-        vkCmdPipelineBarrier(
-            *surface->GetSwapChain()->GetCommandBuffer(resource_index),
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
-            &barrier_from_draw_to_present);
+        vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+        record_frame(command_buffer, resource_index, image_index);
+        if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+          std::cout << "Could not record command buffer!" << std::endl;
+          return 0;
+        }
       }
-
-      if (vkEndCommandBuffer(*surface->GetSwapChain()->GetCommandBuffer(
-              resource_index)) != VK_SUCCESS) {
+      if (command_buffer == VK_NULL_HANDLE) {
         std::cout << "Could not record command buffer!" << std::endl;
         return 0;
       }
-      // end of Tutorial04::PrepareFrame
-      surface->GetSwapChain()->SwapBuffer2(resource_index, &image_index);
+
+      surface->GetSwapChain()->SwapBuffer2(resource_index, &image_index,
+                                           command_buffer);
     }
   }  // end of while
 
+  const VulkanDeviceQueue::SubmitCounters& submits =
+      device_queue.GetLastFrameSubmitCounters();
+  printf("Last frame: %u vkQueueSubmit(), %u VkSubmitInfo, %u command "
+         "buffers\n",
+         submits.queue_submits, submits.submit_infos,
+         submits.command_buffers);
+  if (cache_command_buffers) {
+    printf("Command buffer cache: %llu hits, %llu misses\n",
+           static_cast<unsigned long long>(command_buffer_cache.hits()),
+           static_cast<unsigned long long>(command_buffer_cache.misses()));
+  }
+  VulkanPipelineRegistry* pipeline_registry =
+      device_queue.GetPipelineRegistry();
+  printf("Pipeline registry: %zu pipelines, %llu hits, %llu misses\n",
+         pipeline_registry->size(),
+         static_cast<unsigned long long>(pipeline_registry->hits()),
+         static_cast<unsigned long long>(pipeline_registry->misses()));
+  VulkanFencePool* fence_pool = device_queue.GetFencePool();
+  VulkanSemaphorePool* semaphore_pool = device_queue.GetSemaphorePool();
+  printf("Fence pool: %llu hits, %llu misses\n",
+         static_cast<unsigned long long>(fence_pool->hits()),
+         static_cast<unsigned long long>(fence_pool->misses()));
+  printf("Semaphore pool: %llu hits, %llu misses\n",
+         static_cast<unsigned long long>(semaphore_pool->hits()),
+         static_cast<unsigned long long>(semaphore_pool->misses()));
+
+  // --dump-memory-stats prints what the demo allocated, including the heap
+  // budgets when VK_EXT_memory_budget is available.
+  if (base::CommandLine::ForCurrentProcess()->HasSwitch("dump-memory-stats")) {
+    printf("%s\n",
+           device_queue.GetMemoryAllocator()->GetStatistics().ToJSON().c_str());
+  }
+
+  vkDeviceWaitIdle(device_queue.GetVulkanDevice());
+  command_buffer_cache.Destroy();
+  frame_allocator.Destroy();
+  pipeline_compiler.Destroy();
   render_pass.Destroy();
   surface->Destroy();
+  vertexBuffer.Destroy();
+  indexBuffer.Destroy();
+  upload_batch.Destroy();
 
   gpu::DestroyNativeWindow(window_);
   window_ = gfx::kNullAcceleratedWidget;
@@ -0,0 +1,464 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "base/command_line.h"
+#include "base/macros.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/time/time.h"
+#include "ui/gfx/geometry/rect.h"
+#include "ui/gfx/native_widget_types.h"
+#include "ui/gfx/x/x11_types.h"
+
+#include "../tests/native_window.h"
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_frame_command_allocator.h"
+#include "../vulkan/vulkan_implementation.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+#include "../vulkan/vulkan_surface.h"
+#include "../vulkan/vulkan_swap_chain.h"
+#include "../vulkan/vulkan_vertex_format.h"
+
+// Deferred shading in a single render pass. Subpass 0 writes a G-buffer of
+// albedo and normals, and subpass 1 reads it back as input attachments while
+// it adds up the lights, drawn as one instanced quad each. Each pixel only
+// reads its own G-buffer texels, so tile-based GPUs keep the G-buffer in tile
+// memory and never write it out.
+//
+// --lights=N sets the number of lights, 512 by default. --store-gbuffer
+// stores the G-buffer instead, like separate render passes would have to, to
+// compare the frame times.
+
+using namespace gpu;
+
+namespace {
+
+const uint32_t kDefaultLightCount = 512;
+// Frames averaged per frame time report.
+const uint32_t kReportInterval = 200;
+
+// Attachments of the render pass.
+enum Attachment : uint32_t {
+  ATTACHMENT_ALBEDO,
+  ATTACHMENT_NORMAL,
+  ATTACHMENT_SWAP_IMAGE,
+};
+
+// A point light above the screen, as per instance vertex data.
+struct Light {
+  // xy is the center in normalized device coordinates, z the height above
+  // the surface and w the radius of influence.
+  Float4 position;
+  Float4 color;
+};
+
+using LightLayout = VulkanVertexLayout<Light,
+                                       GPU_VERTEX_ATTRIBUTE(Light, position),
+                                       GPU_VERTEX_ATTRIBUTE(Light, color)>;
+
+// A full screen triangle.
+const char kGBufferVertexShaderSource[] =
+    "#version 450\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "layout(location = 0) out vec2 v_Position;\n"
+    "void main() {\n"
+    "  vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);\n"
+    "  v_Position = position * 2.0 - 1.0;\n"
+    "  gl_Position = vec4(v_Position, 0.0, 1.0);\n"
+    "}\n";
+
+// A grid of colored domes on a grey floor. The normal's alpha is the height.
+const char kGBufferFragmentShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) in vec2 v_Position;\n"
+    "layout(location = 0) out vec4 o_Albedo;\n"
+    "layout(location = 1) out vec4 o_Normal;\n"
+    "void main() {\n"
+    "  vec2 grid = v_Position * 6.0;\n"
+    "  vec2 cell = fract(grid) - 0.5;\n"
+    "  vec2 id = floor(grid);\n"
+    "  float dome = 0.16 - dot(cell, cell);\n"
+    "  float height = sqrt(max(dome, 0.0));\n"
+    "  vec3 normal = dome > 0.0 ? normalize(vec3(cell, height))\n"
+    "                           : vec3(0.0, 0.0, 1.0);\n"
+    "  vec3 color = 0.5 + 0.5 * cos(id.x * vec3(1.0, 2.0, 3.0) + id.y);\n"
+    "  o_Albedo = vec4(dome > 0.0 ? color : vec3(0.5), 1.0);\n"
+    "  o_Normal = vec4(normal * 0.5 + 0.5, height);\n"
+    "}\n";
+
+// A quad covering the light's radius, as a 4 vertex triangle strip.
+const char kLightVertexShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) in vec4 i_Light;\n"
+    "layout(location = 1) in vec4 i_Color;\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "layout(location = 0) out vec4 v_Light;\n"
+    "layout(location = 1) out vec3 v_Color;\n"
+    "layout(location = 2) out vec2 v_Position;\n"
+    "void main() {\n"
+    "  vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);\n"
+    "  v_Position = i_Light.xy + (corner * 2.0 - 1.0) * i_Light.w;\n"
+    "  v_Light = i_Light;\n"
+    "  v_Color = i_Color.rgb;\n"
+    "  gl_Position = vec4(v_Position, 0.0, 1.0);\n"
+    "}\n";
+
+const char kLightFragmentShaderSource[] =
+    "#version 450\n"
+    "layout(input_attachment_index = 0, set = 0, binding = 0)\n"
+    "    uniform subpassInput i_Albedo;\n"
+    "layout(input_attachment_index = 1, set = 0, binding = 1)\n"
+    "    uniform subpassInput i_Normal;\n"
+    "layout(location = 0) in vec4 v_Light;\n"
+    "layout(location = 1) in vec3 v_Color;\n"
+    "layout(location = 2) in vec2 v_Position;\n"
+    "layout(location = 0) out vec4 o_Color;\n"
+    "void main() {\n"
+    "  vec4 albedo = subpassLoad(i_Albedo);\n"
+    "  vec4 normal = subpassLoad(i_Normal);\n"
+    "  vec3 to_light = vec3(v_Light.xy - v_Position,\n"
+    "                       v_Light.z - normal.a * 0.1);\n"
+    "  float light_distance = length(to_light);\n"
+    "  float attenuation = max(1.0 - light_distance / v_Light.w, 0.0);\n"
+    "  float diffuse =\n"
+    "      max(dot(normal.xyz * 2.0 - 1.0, to_light / light_distance), 0.0);\n"
+    "  o_Color = vec4(albedo.rgb * v_Color * diffuse * attenuation *\n"
+    "                     attenuation, 0.0);\n"
+    "}\n";
+
+// Light 0 is a dim one over the whole screen, the rest are small colored
+// ones scattered by a fixed seed so runs are comparable.
+std::vector<Light> CreateLights(uint32_t count) {
+  std::vector<Light> lights(count);
+  uint32_t seed = 12345;
+  auto random = [&seed]() {
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / static_cast<float>(1 << 24);
+  };
+  for (uint32_t i = 0; i < count; ++i) {
+    if (i == 0) {
+      lights[i].position = {0.0f, 0.0f, 1.0f, 4.0f};
+      lights[i].color = {0.3f, 0.3f, 0.3f, 1.0f};
+      continue;
+    }
+    lights[i].position = {random() * 2.0f - 1.0f, random() * 2.0f - 1.0f,
+                          0.05f + 0.1f * random(), 0.1f + 0.2f * random()};
+    lights[i].color = {random(), random(), random(), 1.0f};
+  }
+  return lights;
+}
+
+// The G-buffer is cleared, written in subpass 0 and read in subpass 1. Unless
+// |store_g_buffer|, it is discarded afterwards and thus transient.
+VulkanRenderPassDescription DeferredDescription(VkFormat swap_chain_format,
+                                                bool store_g_buffer) {
+  VkAttachmentDescription g_buffer_attachment = {
+      0,                                 // VkAttachmentDescriptionFlags
+      VK_FORMAT_R8G8B8A8_UNORM,          // VkFormat format
+      VK_SAMPLE_COUNT_1_BIT,             // VkSampleCountFlagBits samples
+      VK_ATTACHMENT_LOAD_OP_CLEAR,       // VkAttachmentLoadOp loadOp
+      store_g_buffer ? VK_ATTACHMENT_STORE_OP_STORE
+                     : VK_ATTACHMENT_STORE_OP_DONT_CARE,  // storeOp
+      VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // VkAttachmentLoadOp stencilLoadOp
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,  // VkAttachmentStoreOp
+                                         // stencilStoreOp
+      VK_IMAGE_LAYOUT_UNDEFINED,         // VkImageLayout initialLayout
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL  // VkImageLayout finalLayout
+  };
+  VkAttachmentDescription swap_image_attachment = {
+      0,                                 // VkAttachmentDescriptionFlags
+      swap_chain_format,                 // VkFormat format
+      VK_SAMPLE_COUNT_1_BIT,             // VkSampleCountFlagBits samples
+      VK_ATTACHMENT_LOAD_OP_CLEAR,       // VkAttachmentLoadOp loadOp
+      VK_ATTACHMENT_STORE_OP_STORE,      // VkAttachmentStoreOp storeOp
+      VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // VkAttachmentLoadOp stencilLoadOp
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,  // VkAttachmentStoreOp
+                                         // stencilStoreOp
+      VK_IMAGE_LAYOUT_UNDEFINED,         // VkImageLayout initialLayout
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR    // VkImageLayout finalLayout
+  };
+
+  VulkanRenderPassDescription::Subpass g_buffer_subpass;
+  g_buffer_subpass.color_attachments = {
+      {ATTACHMENT_ALBEDO, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      {ATTACHMENT_NORMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+  VulkanRenderPassDescription::Subpass lighting_subpass;
+  lighting_subpass.input_attachments = {
+      {ATTACHMENT_ALBEDO, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {ATTACHMENT_NORMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+  lighting_subpass.color_attachments = {
+      {ATTACHMENT_SWAP_IMAGE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}};
+
+  VulkanRenderPassDescription description;
+  description.attachments = {g_buffer_attachment, g_buffer_attachment,
+                             swap_image_attachment};
+  description.subpasses = {g_buffer_subpass, lighting_subpass};
+  description.dependencies = {
+      // The G-buffer of a framebuffer is cleared while the previous frame
+      // drawn to it may still be writing it, and the swap image is only
+      // available once the acquire semaphore waited at this stage.
+      {
+          VK_SUBPASS_EXTERNAL,  // uint32_t srcSubpass
+          0,                    // uint32_t dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // VkAccessFlags srcAccessMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // VkAccessFlags dstAccessMask
+          VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
+      },
+      {
+          VK_SUBPASS_EXTERNAL,  // uint32_t srcSubpass
+          1,                    // uint32_t dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
+          VK_ACCESS_MEMORY_READ_BIT,             // VkAccessFlags srcAccessMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // VkAccessFlags dstAccessMask
+          VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
+      },
+      // Lighting reads the G-buffer texel of its own pixel, which is what
+      // lets the dependency be by region and the G-buffer stay on tile.
+      {
+          0,  // uint32_t srcSubpass
+          1,  // uint32_t dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,          // dstStageMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // VkAccessFlags srcAccessMask
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,   // VkAccessFlags dstAccessMask
+          VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
+      },
+      {
+          1,                    // uint32_t srcSubpass
+          VK_SUBPASS_EXTERNAL,  // uint32_t dstSubpass
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,           // dstStageMask
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,  // VkAccessFlags srcAccessMask
+          VK_ACCESS_MEMORY_READ_BIT,             // VkAccessFlags dstAccessMask
+          VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
+      }};
+  return description;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine* command_line =
+      base::CommandLine::ForCurrentProcess();
+  unsigned light_count = kDefaultLightCount;
+  if (command_line->HasSwitch("lights") &&
+      !base::StringToUint(command_line->GetSwitchValueASCII("lights"),
+                          &light_count)) {
+    light_count = kDefaultLightCount;
+  }
+  light_count = std::max(light_count, 1u);
+  const bool store_g_buffer = command_line->HasSwitch("store-gbuffer");
+
+  // Create a window.
+  gfx::AcceleratedWidget window_ = gfx::kNullAcceleratedWidget;
+  const gfx::Rect kDefaultBounds(10, 10, 800, 600);
+  window_ = gpu::CreateNativeWindow(kDefaultBounds);
+
+  const bool success = gpu::InitializeVulkan();
+  CHECK(success);
+
+  gpu::VulkanDeviceQueue device_queue;
+  device_queue.Initialize(VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+                          VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG);
+
+  std::unique_ptr<VulkanSurface> surface =
+      VulkanSurface::CreateViewSurface(window_);
+  surface->CreateSurface();
+  surface->Initialize(&device_queue, VulkanSurface::DEFAULT_SURFACE_FORMAT,
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+  VulkanSwapChain* swap_chain = surface->GetSwapChain();
+
+  VulkanRenderPass render_pass(&device_queue);
+  if (!render_pass.Initialize(
+          swap_chain, DeferredDescription(swap_chain->format(),
+                                          store_g_buffer))) {
+    std::cout << "Could not create the deferred render pass!" << std::endl;
+    return 0;
+  }
+  printf("Deferred shading: %u lights, G-buffer %s\n", light_count,
+         store_g_buffer ? "stored" : "transient");
+
+  VulkanPipelineRegistry* pipeline_registry =
+      device_queue.GetPipelineRegistry();
+  VulkanPipelineDescription g_buffer_description;
+  render_pass.DescribeSubpassPipeline(
+      0, kGBufferVertexShaderSource, kGBufferFragmentShaderSource,
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VulkanVertexInput(),
+      &g_buffer_description);
+  g_buffer_description.cull_mode = VK_CULL_MODE_NONE;
+  VkPipeline g_buffer_pipeline = pipeline_registry->Get(g_buffer_description);
+
+  VulkanVertexInput light_input;
+  light_input.bindings.push_back(
+      LightLayout::Binding(0, VK_VERTEX_INPUT_RATE_INSTANCE));
+  LightLayout::AttributeArray light_attributes = LightLayout::Attributes();
+  light_input.attributes.assign(light_attributes.begin(),
+                                light_attributes.end());
+  VulkanPipelineDescription lighting_description;
+  render_pass.DescribeSubpassPipeline(
+      1, kLightVertexShaderSource, kLightFragmentShaderSource,
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, light_input,
+      &lighting_description);
+  lighting_description.cull_mode = VK_CULL_MODE_NONE;
+  lighting_description.blend_enable = true;
+  lighting_description.additive_blend = true;
+  VkPipeline lighting_pipeline = pipeline_registry->Get(lighting_description);
+  if (VK_NULL_HANDLE == g_buffer_pipeline ||
+      VK_NULL_HANDLE == lighting_pipeline) {
+    std::cout << "Could not create the deferred pipelines!" << std::endl;
+    return 0;
+  }
+
+  std::vector<Light> lights = CreateLights(light_count);
+  VulkanBuffer light_buffer;
+  light_buffer.InitializeVertices(&device_queue, lights.data(), light_count);
+
+  VulkanFrameCommandAllocator frame_allocator(&device_queue,
+                                              swap_chain->num_images());
+  frame_allocator.Initialize();
+
+  auto record_frame = [&](VkCommandBuffer command_buffer,
+                          uint32_t image_index) {
+    const VkExtent2D extent = swap_chain->GetExtent();
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // VkStructureType sType
+        nullptr,               // const void                            *pNext
+        render_pass.handle(),  // VkRenderPass renderPass
+        render_pass.frame_buffers_[image_index],  // VkFramebuffer framebuffer
+        {{0, 0}, extent},      // VkRect2D renderArea
+        static_cast<uint32_t>(
+            render_pass.clear_values().size()),  // uint32_t clearValueCount
+        render_pass.clear_values()
+            .data()  // const VkClearValue                    *pClearValues
+    };
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info,
+                         VK_SUBPASS_CONTENTS_INLINE);
+
+    // Both pipelines set the viewport and scissor dynamically.
+    VkViewport viewport = {0.0f,
+                           0.0f,
+                           static_cast<float>(extent.width),
+                           static_cast<float>(extent.height),
+                           0.0f,
+                           1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    // Subpass 0: fill the G-buffer.
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      g_buffer_pipeline);
+    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+
+    // Subpass 1: add up every light on top of the G-buffer.
+    vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      lighting_pipeline);
+    VkDescriptorSet input_set =
+        render_pass.GetInputAttachmentSet(1, image_index);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            lighting_description.layout, 0, 1, &input_set, 0,
+                            nullptr);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, light_buffer.handle(),
+                           &offset);
+    vkCmdDraw(command_buffer, 4, light_count, 0, 0);
+    vkCmdEndRenderPass(command_buffer);
+  };
+
+  Atom delete_window_atom =
+      XInternAtom(gfx::GetXDisplay(), "WM_DELETE_WINDOW", false);
+  XSetWMProtocols(gfx::GetXDisplay(), window_, &delete_window_atom, 1);
+  XClearWindow(gfx::GetXDisplay(), window_);
+  XMapWindow(gfx::GetXDisplay(), window_);
+
+  XEvent event;
+  bool loop = true;
+  uint32_t resource_index = 0;
+  uint32_t frame_count = 0;
+  base::TimeTicks report_start = base::TimeTicks::Now();
+  while (loop) {
+    if (XPending(gfx::GetXDisplay())) {
+      XNextEvent(gfx::GetXDisplay(), &event);
+      switch (event.type) {
+        case KeyPress:
+        case DestroyNotify:
+          loop = false;
+          break;
+        case ClientMessage:
+          if (static_cast<unsigned int>(event.xclient.data.l[0]) ==
+              delete_window_atom) {
+            loop = false;
+          }
+          break;
+      }
+      continue;
+    }
+
+    uint32_t image_index = 0;
+    swap_chain->WaitFences(&resource_index, &image_index);
+    if (!render_pass.CreateFrameBuffer(swap_chain, image_index)) {
+      std::cout << "fail to create a frame buffer" << std::endl;
+      return 0;
+    }
+
+    frame_allocator.BeginFrame(resource_index);
+    VkCommandBuffer command_buffer = frame_allocator.AllocatePrimary();
+    VkCommandBufferBeginInfo command_buffer_begin_info = {};
+    command_buffer_begin_info.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags =
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    record_frame(command_buffer, image_index);
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+      std::cout << "Could not record command buffer!" << std::endl;
+      return 0;
+    }
+    swap_chain->SwapBuffer2(resource_index, &image_index, command_buffer);
+
+    // Frame times include waiting for the GPU, so they track its cost of
+    // the G-buffer and the lights once the GPU is the bottleneck.
+    if (++frame_count == kReportInterval) {
+      const base::TimeDelta elapsed = base::TimeTicks::Now() - report_start;
+      printf("%u lights, G-buffer %s: %.3f ms per frame\n", light_count,
+             store_g_buffer ? "stored" : "transient",
+             elapsed.InMillisecondsF() / frame_count);
+      frame_count = 0;
+      report_start = base::TimeTicks::Now();
+    }
+  }
+
+  if (command_line->HasSwitch("dump-memory-stats")) {
+    printf("%s\n",
+           device_queue.GetMemoryAllocator()->GetStatistics().ToJSON().c_str());
+  }
+
+  vkDeviceWaitIdle(device_queue.GetVulkanDevice());
+  frame_allocator.Destroy();
+  render_pass.Destroy();
+  surface->Destroy();
+  light_buffer.Destroy();
+
+  gpu::DestroyNativeWindow(window_);
+  window_ = gfx::kNullAcceleratedWidget;
+  device_queue.Destroy();
+
+  return 0;
+}
@@ -4,11 +4,53 @@
 
 #include "basic_vulkan_test.h"
 
+#include "../vulkan/vulkan_implementation.h"
 #include "native_window.h"
 #include "ui/gfx/geometry/rect.h"
 
 namespace gpu {
 
+const char kPositionVertexShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) in vec4 i_Position;\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "void main() { gl_Position = i_Position; }\n";
+
+const char kWhiteFragmentShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) out vec4 o_Color;\n"
+    "void main() { o_Color = vec4(1.0); }\n";
+
+VkRenderPass CreateColorRenderPass(VkDevice device, VkFormat format) {
+  VkAttachmentDescription attachment = {};
+  attachment.format = format;
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference color_reference = {
+      0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &color_reference;
+
+  VkRenderPassCreateInfo render_pass_create_info = {};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.attachmentCount = 1;
+  render_pass_create_info.pAttachments = &attachment;
+  render_pass_create_info.subpassCount = 1;
+  render_pass_create_info.pSubpasses = &subpass;
+
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  vkCreateRenderPass(device, &render_pass_create_info, nullptr, &render_pass);
+  return render_pass;
+}
+
 void BasicVulkanTest::SetUp() {
   const gfx::Rect kDefaultBounds(10, 10, 500, 500);
   window_ = CreateNativeWindow(kDefaultBounds);
@@ -20,4 +62,21 @@ void BasicVulkanTest::TearDown() {
   device_queue_.Destroy();
 }
 
+bool VulkanPerfTest::vulkan_initialized_ = false;
+
+void VulkanPerfTest::SetUpTestCase() {
+  vulkan_initialized_ = InitializeVulkan();
+}
+
+void VulkanPerfTest::SetUp() {
+  ASSERT_TRUE(vulkan_initialized_);
+  ASSERT_TRUE(device_queue_.Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+}
+
+void VulkanPerfTest::TearDown() {
+  device_queue_.Destroy();
+}
+
 }  // namespace gpu
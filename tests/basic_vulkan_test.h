@@ -13,6 +13,15 @@ namespace gpu {
 
 class VulkanSurface;
 
+// A vertex shader passing the vec4 position at location 0 through and a
+// fragment shader writing white, for tests that need some pipeline.
+extern const char kPositionVertexShaderSource[];
+extern const char kWhiteFragmentShaderSource[];
+
+// Creates a render pass with one |format| color attachment, cleared and
+// stored, or returns VK_NULL_HANDLE.
+VkRenderPass CreateColorRenderPass(VkDevice device, VkFormat format);
+
 class BasicVulkanTest : public testing::Test {
  public:
   void SetUp() override;
@@ -28,6 +37,24 @@ class BasicVulkanTest : public testing::Test {
   VulkanSurface* surface_;
 };
 
+// Fixture of the perf tests. Vulkan is initialized once per test case and
+// every test gets a device with a graphics and presentation capable queue.
+// Subclasses call SetUp() first and TearDown() last.
+class VulkanPerfTest : public testing::Test {
+ public:
+  static void SetUpTestCase();
+
+  void SetUp() override;
+  void TearDown() override;
+
+  VulkanDeviceQueue* GetDeviceQueue() { return &device_queue_; }
+
+ private:
+  static bool vulkan_initialized_;
+
+  VulkanDeviceQueue device_queue_;
+};
+
 }  // namespace gpu
 
 #endif  // GPU_VULKAN_TESTS_BASIC_VULKAN_TEST_H_
@@ -0,0 +1,58 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_command_buffer_cache.h"
+#include "../vulkan/vulkan_device_queue.h"
+
+// This file tests the cache of pre-recorded frame command buffers.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, CommandBufferCacheRecordsOnlyWhenStale) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  VulkanCommandBufferCache cache(GetDeviceQueue());
+  ASSERT_TRUE(cache.Initialize());
+
+  int recordings = 0;
+  VulkanCommandBufferCache::RecordCallback record =
+      [&recordings](VkCommandBuffer command_buffer) { ++recordings; };
+
+  VulkanCommandBufferCache::Key key;
+  VkCommandBuffer first = cache.GetOrRecord(key, record);
+  ASSERT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE), first);
+  EXPECT_EQ(1, recordings);
+
+  // A static frame reuses the recording.
+  EXPECT_EQ(first, cache.GetOrRecord(key, record));
+  EXPECT_EQ(1, recordings);
+  EXPECT_EQ(1u, cache.hits());
+
+  // Another swap chain image gets its own command buffer.
+  VulkanCommandBufferCache::Key other_image = key;
+  other_image.image_index = 1;
+  VkCommandBuffer second = cache.GetOrRecord(other_image, record);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2, recordings);
+  EXPECT_EQ(2u, cache.size());
+
+  // Editing the scene re-records into the same command buffer.
+  key.scene_version = 1;
+  EXPECT_EQ(first, cache.GetOrRecord(key, record));
+  EXPECT_EQ(3, recordings);
+  EXPECT_EQ(3u, cache.misses());
+
+  cache.Invalidate();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE),
+            cache.GetOrRecord(key, record));
+  EXPECT_EQ(4, recordings);
+
+  cache.Destroy();
+}
+
+}  // namespace gpu
@@ -0,0 +1,147 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <vector>
+
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_deletion_queue.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_memory_allocator.h"
+#include "../vulkan/vulkan_timeline.h"
+
+// This file tests that the deletion queue holds on to objects until the
+// work submitted before they were enqueued has retired.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, DeletionQueueWaitsForSubmittedWork) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VulkanDeletionQueue* deletion_queue = device_queue->GetDeletionQueue();
+  VulkanTimeline* graphics_timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+  ASSERT_TRUE(graphics_timeline);
+
+  VkPipelineLayoutCreateInfo layout_create_info = {};
+  layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS,
+            vkCreatePipelineLayout(device_queue->GetVulkanDevice(),
+                                   &layout_create_info, nullptr,
+                                   &pipeline_layout));
+
+  int tasks_run = 0;
+  deletion_queue->Enqueue(pipeline_layout);
+  deletion_queue->EnqueueTask([&tasks_run](VkDevice) { ++tasks_run; });
+  EXPECT_EQ(2u, deletion_queue->num_pending());
+
+  // Nothing was submitted after the objects were enqueued.
+  deletion_queue->Collect();
+  EXPECT_EQ(2u, deletion_queue->num_pending());
+  EXPECT_EQ(0, tasks_run);
+
+  ASSERT_TRUE(graphics_timeline->Wait(graphics_timeline->Signal()));
+  deletion_queue->Collect();
+  EXPECT_EQ(0u, deletion_queue->num_pending());
+  EXPECT_EQ(2u, deletion_queue->num_collected());
+  EXPECT_EQ(1, tasks_run);
+}
+
+TEST_F(BasicVulkanTest, DeletionQueueCollectsTimelinesIndependently) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VulkanDeletionQueue* deletion_queue = device_queue->GetDeletionQueue();
+  VulkanTimeline* graphics_timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+
+  // A separate fence-based timeline stands in for a second queue.
+  VulkanTimeline other_timeline(device_queue,
+                                device_queue->GetGraphicsQueue(), false);
+  ASSERT_TRUE(other_timeline.Initialize());
+
+  std::vector<int> order;
+  deletion_queue->EnqueueTask([&order](VkDevice) { order.push_back(1); },
+                              &other_timeline,
+                              other_timeline.last_submitted_value() + 1);
+  deletion_queue->EnqueueTask([&order](VkDevice) { order.push_back(2); });
+  deletion_queue->EnqueueTask([&order](VkDevice) { order.push_back(3); });
+
+  ASSERT_TRUE(graphics_timeline->Wait(graphics_timeline->Signal()));
+  deletion_queue->Collect();
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ(2, order[0]);
+  EXPECT_EQ(3, order[1]);
+
+  ASSERT_TRUE(other_timeline.Wait(other_timeline.Signal()));
+  deletion_queue->Collect();
+  ASSERT_EQ(3u, order.size());
+  EXPECT_EQ(1, order[2]);
+
+  other_timeline.Destroy();
+}
+
+
+TEST_F(BasicVulkanTest, DeletionQueueDefersBufferDestruction) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VulkanDeletionQueue* deletion_queue = device_queue->GetDeletionQueue();
+  VulkanMemoryAllocator* allocator = device_queue->GetMemoryAllocator();
+  VulkanTimeline* graphics_timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+
+  const uint8_t data[256] = {};
+  VulkanBuffer buffer;
+  ASSERT_TRUE(buffer.Initialize(device_queue,
+                                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, data,
+                                sizeof(data)));
+  const uint64_t live_allocations =
+      allocator->GetStatistics().live_allocations;
+
+  // The buffer and its memory stay alive until the work submitted before
+  // Destroy() has retired.
+  const size_t num_pending = deletion_queue->num_pending();
+  buffer.Destroy();
+  EXPECT_EQ(num_pending + 2, deletion_queue->num_pending());
+  EXPECT_EQ(live_allocations, allocator->GetStatistics().live_allocations);
+
+  ASSERT_TRUE(graphics_timeline->Wait(graphics_timeline->Signal()));
+  deletion_queue->Collect();
+  EXPECT_EQ(0u, deletion_queue->num_pending());
+  EXPECT_EQ(live_allocations - 1,
+            allocator->GetStatistics().live_allocations);
+}
+
+TEST_F(BasicVulkanTest, DeletionQueueDefersImageDestruction) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VulkanDeletionQueue* deletion_queue = device_queue->GetDeletionQueue();
+  VulkanTimeline* graphics_timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+
+  VulkanImage image(device_queue);
+  ASSERT_TRUE(image.Initialize(VK_FORMAT_R8G8B8A8_UNORM, {16, 16},
+                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                               VulkanImageView::IMAGE_TYPE_COLOR));
+
+  // The view, the image and its memory.
+  const size_t num_pending = deletion_queue->num_pending();
+  image.Destroy();
+  EXPECT_EQ(num_pending + 3, deletion_queue->num_pending());
+
+  ASSERT_TRUE(graphics_timeline->Wait(graphics_timeline->Signal()));
+  deletion_queue->Collect();
+  EXPECT_EQ(0u, deletion_queue->num_pending());
+}
+
+}  // namespace gpu
@@ -0,0 +1,161 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+
+// This file tests depth format selection, depth images and framebuffers of
+// render passes with a depth attachment, and depth tested and depth only
+// pipelines.
+namespace gpu {
+
+namespace {
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {64, 64};
+
+const char kVertexShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) in vec4 i_Position;\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "invariant gl_Position;\n"
+    "void main() { gl_Position = i_Position; }\n";
+
+VulkanRenderPassDescription ColorDepthDescription(VkFormat depth_format) {
+  VkAttachmentDescription color_attachment = {};
+  color_attachment.format = kColorFormat;
+  color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription depth_attachment = color_attachment;
+  depth_attachment.format = depth_format;
+  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+  subpass.depth_stencil_attachment = {
+      1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(color_attachment);
+  description.attachments.push_back(depth_attachment);
+  description.subpasses.push_back(subpass);
+  return description;
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, DepthFormatSelection) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  // Every implementation supports D16_UNORM or D32_SFLOAT as a depth
+  // attachment.
+  VkFormat depth_format = VulkanImage::FindDepthFormat(GetDeviceQueue(), false);
+  EXPECT_NE(VK_FORMAT_UNDEFINED, depth_format);
+
+  // Stencil formats are optional, but must have a stencil aspect.
+  VkFormat depth_stencil_format =
+      VulkanImage::FindDepthFormat(GetDeviceQueue(), true);
+  if (VK_FORMAT_UNDEFINED != depth_stencil_format)
+    EXPECT_TRUE(VulkanImage::HasStencil(depth_stencil_format));
+  EXPECT_FALSE(VulkanImage::HasStencil(VK_FORMAT_D32_SFLOAT));
+  EXPECT_FALSE(VulkanImage::HasStencil(VK_FORMAT_D16_UNORM));
+}
+
+TEST_F(BasicVulkanTest, DepthAttachment) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  const VkFormat depth_format = VulkanImage::FindDepthFormat(device_queue,
+                                                             false);
+  ASSERT_NE(VK_FORMAT_UNDEFINED, depth_format);
+
+  VulkanImage color_image(device_queue);
+  ASSERT_TRUE(color_image.Initialize(kColorFormat, kExtent,
+                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                     VulkanImageView::IMAGE_TYPE_COLOR));
+  VulkanImage depth_image(device_queue);
+  ASSERT_TRUE(depth_image.Initialize(
+      depth_format, kExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+      VulkanImageView::IMAGE_TYPE_DEPTH));
+  EXPECT_NE(static_cast<VkImage>(VK_NULL_HANDLE), depth_image.handle());
+  EXPECT_EQ(depth_format, depth_image.format());
+  EXPECT_EQ(kExtent.width, depth_image.extent().width);
+
+  VulkanRenderPassCache* render_pass_cache =
+      device_queue->GetRenderPassCache();
+  VkRenderPass render_pass =
+      render_pass_cache->Acquire(ColorDepthDescription(depth_format));
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+
+  VulkanFramebufferCache* framebuffer_cache =
+      device_queue->GetFramebufferCache();
+  std::vector<VkImageView> attachments = {
+      color_image.image_view()->handle(),
+      depth_image.image_view()->handle()};
+  EXPECT_NE(static_cast<VkFramebuffer>(VK_NULL_HANDLE),
+            framebuffer_cache->Get(render_pass, attachments, kExtent));
+
+  VulkanPipelineRegistry* registry = device_queue->GetPipelineRegistry();
+  VulkanPipelineDescription description;
+  description.vertex_shader_source = kVertexShaderSource;
+  description.fragment_shader_source = kWhiteFragmentShaderSource;
+  description.vertex_input.bindings.push_back(
+      {0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX});
+  description.vertex_input.attributes.push_back(
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0});
+  description.layout = registry->GetPipelineLayout({}, {});
+  description.render_pass = render_pass;
+  description.depth_test_enable = true;
+  description.depth_write_enable = true;
+  VkPipeline pipeline = registry->Get(description);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline);
+
+  // The depth only pre-pass pipeline has no fragment shader.
+  VulkanPipelineDescription prepass = description;
+  prepass.fragment_shader_source = VulkanShaderSource();
+  prepass.color_write_enable = false;
+  prepass.depth_compare_op = VK_COMPARE_OP_LESS;
+  EXPECT_FALSE(prepass == description);
+  VkPipeline prepass_pipeline = registry->Get(prepass);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), prepass_pipeline);
+  EXPECT_NE(pipeline, prepass_pipeline);
+
+  // Shading after the pre-pass only tests for equal depth.
+  VulkanPipelineDescription shading = description;
+  shading.depth_write_enable = false;
+  shading.depth_compare_op = VK_COMPARE_OP_EQUAL;
+  EXPECT_NE(HashPipelineDescription(description),
+            HashPipelineDescription(shading));
+  EXPECT_NE(pipeline, registry->Get(shading));
+  EXPECT_EQ(3u, registry->size());
+
+  // Destroying the depth image evicts its framebuffer.
+  depth_image.Destroy();
+  EXPECT_EQ(0u, framebuffer_cache->size());
+  color_image.Destroy();
+  render_pass_cache->Release(render_pass);
+  EXPECT_EQ(0u, registry->size());
+}
+
+}  // namespace gpu
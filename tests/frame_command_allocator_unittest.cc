@@ -0,0 +1,59 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_frame_command_allocator.h"
+
+// This file tests the per-frame command buffer allocator.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, FrameCommandAllocatorReusesCommandBuffers) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  VulkanFrameCommandAllocator allocator(GetDeviceQueue(), 2);
+  ASSERT_TRUE(allocator.Initialize());
+
+  ASSERT_TRUE(allocator.BeginFrame(0));
+  VkCommandBuffer first = allocator.AllocatePrimary();
+  VkCommandBuffer second = allocator.AllocatePrimary();
+  VkCommandBuffer secondary = allocator.AllocateSecondary();
+  ASSERT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE), first);
+  ASSERT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE), secondary);
+  EXPECT_NE(first, second);
+
+  // Recorded but never submitted, which a pool reset also covers.
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  ASSERT_EQ(VK_SUCCESS, vkBeginCommandBuffer(first, &begin_info));
+  ASSERT_EQ(VK_SUCCESS, vkEndCommandBuffer(first));
+
+  // The other slot has its own command buffers.
+  ASSERT_TRUE(allocator.BeginFrame(1));
+  VkCommandBuffer other = allocator.AllocatePrimary();
+  EXPECT_NE(first, other);
+  EXPECT_NE(second, other);
+  EXPECT_EQ(4u, allocator.allocated_command_buffer_count());
+
+  // Coming back to slot 0 hands out the same command buffers in the same
+  // order without allocating.
+  ASSERT_TRUE(allocator.BeginFrame(0));
+  EXPECT_EQ(first, allocator.AllocatePrimary());
+  EXPECT_EQ(second, allocator.AllocatePrimary());
+  EXPECT_EQ(secondary, allocator.AllocateSecondary());
+  EXPECT_EQ(4u, allocator.allocated_command_buffer_count());
+
+  // Running past them allocates more.
+  EXPECT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE),
+            allocator.AllocatePrimary());
+  EXPECT_EQ(5u, allocator.allocated_command_buffer_count());
+
+  allocator.Destroy();
+}
+
+}  // namespace gpu
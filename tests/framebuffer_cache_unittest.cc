@@ -0,0 +1,85 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image_view.h"
+#include "../vulkan/vulkan_memory_allocator.h"
+
+// This file tests that framebuffers are created once per render pass,
+// attachments and extent, and evicted with their image view or render pass.
+namespace gpu {
+
+namespace {
+
+const VkFormat kFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {64, 64};
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, FramebufferCache) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VkDevice device = device_queue->GetVulkanDevice();
+
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = kFormat;
+  image_create_info.extent = {kExtent.width, kExtent.height, 1};
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkImage image = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS,
+            vkCreateImage(device, &image_create_info, nullptr, &image));
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(device, image, &requirements);
+  VulkanMemoryAllocation allocation;
+  ASSERT_TRUE(device_queue->GetMemoryAllocator()->Allocate(
+      requirements, VulkanMemoryUsage::GPU_ONLY, false, &allocation));
+  ASSERT_EQ(VK_SUCCESS, vkBindImageMemory(device, image, allocation.memory,
+                                          allocation.offset));
+
+  VulkanImageView image_view(device_queue);
+  ASSERT_TRUE(image_view.Initialize(
+      image, VK_IMAGE_VIEW_TYPE_2D, VulkanImageView::IMAGE_TYPE_COLOR,
+      kFormat, kExtent.width, kExtent.height, 0, 1, 0, 1));
+  VkRenderPass render_pass = CreateColorRenderPass(device, kFormat);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+
+  VulkanFramebufferCache* cache = device_queue->GetFramebufferCache();
+  std::vector<VkImageView> attachments = {image_view.handle()};
+  VkFramebuffer framebuffer = cache->Get(render_pass, attachments, kExtent);
+  ASSERT_NE(static_cast<VkFramebuffer>(VK_NULL_HANDLE), framebuffer);
+  EXPECT_EQ(framebuffer, cache->Get(render_pass, attachments, kExtent));
+  EXPECT_EQ(1u, cache->hits());
+  EXPECT_EQ(1u, cache->misses());
+
+  // A smaller render area is a different framebuffer.
+  const VkExtent2D kHalfExtent = {kExtent.width / 2, kExtent.height / 2};
+  EXPECT_NE(framebuffer, cache->Get(render_pass, attachments, kHalfExtent));
+  EXPECT_EQ(2u, cache->size());
+
+  // Destroying the view evicts both.
+  image_view.Destroy();
+  EXPECT_EQ(0u, cache->size());
+
+  // The deletion queue destroys the evicted framebuffers on teardown.
+  vkDestroyRenderPass(device, render_pass, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  device_queue->GetMemoryAllocator()->Free(&allocation);
+}
+
+}  // namespace gpu
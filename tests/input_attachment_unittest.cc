@@ -0,0 +1,217 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <memory>
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+
+// This file tests render passes with a G-buffer subpass and a lighting
+// subpass that reads the G-buffer as input attachments, and the descriptor
+// set layouts and pipelines of those subpasses.
+namespace gpu {
+
+namespace {
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {64, 64};
+const uint32_t kGBufferCount = 2;
+
+const char kVertexShaderSource[] =
+    "#version 450\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "void main() {\n"
+    "  vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);\n"
+    "  gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+const char kGBufferShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) out vec4 o_Albedo;\n"
+    "layout(location = 1) out vec4 o_Normal;\n"
+    "void main() {\n"
+    "  o_Albedo = vec4(1.0);\n"
+    "  o_Normal = vec4(0.5, 0.5, 1.0, 0.0);\n"
+    "}\n";
+
+const char kLightingShaderSource[] =
+    "#version 450\n"
+    "layout(input_attachment_index = 0, set = 0, binding = 0)\n"
+    "    uniform subpassInput i_Albedo;\n"
+    "layout(input_attachment_index = 1, set = 0, binding = 1)\n"
+    "    uniform subpassInput i_Normal;\n"
+    "layout(location = 0) out vec4 o_Color;\n"
+    "void main() {\n"
+    "  vec3 normal = subpassLoad(i_Normal).xyz * 2.0 - 1.0;\n"
+    "  o_Color = subpassLoad(i_Albedo) * max(normal.z, 0.0);\n"
+    "}\n";
+
+// Attachments 0 and 1 are the G-buffer, which is only needed during the
+// render pass, and 2 is the lit result.
+VulkanRenderPassDescription DeferredDescription() {
+  VkAttachmentDescription g_buffer_attachment = {};
+  g_buffer_attachment.format = kColorFormat;
+  g_buffer_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  g_buffer_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  g_buffer_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  g_buffer_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  g_buffer_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  g_buffer_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  g_buffer_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentDescription color_attachment = g_buffer_attachment;
+  color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VulkanRenderPassDescription::Subpass g_buffer_subpass;
+  VulkanRenderPassDescription::Subpass lighting_subpass;
+  for (uint32_t i = 0; i < kGBufferCount; ++i) {
+    g_buffer_subpass.color_attachments.push_back(
+        {i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    lighting_subpass.input_attachments.push_back(
+        {i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+  }
+  lighting_subpass.color_attachments.push_back(
+      {kGBufferCount, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  VkSubpassDependency dependency = {};
+  dependency.srcSubpass = 0;
+  dependency.dstSubpass = 1;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+  dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  VulkanRenderPassDescription description;
+  for (uint32_t i = 0; i < kGBufferCount; ++i)
+    description.attachments.push_back(g_buffer_attachment);
+  description.attachments.push_back(color_attachment);
+  description.subpasses.push_back(g_buffer_subpass);
+  description.subpasses.push_back(lighting_subpass);
+  description.dependencies.push_back(dependency);
+  return description;
+}
+
+VkDescriptorSetLayoutBinding InputAttachmentBinding(uint32_t binding) {
+  return {binding, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1,
+          VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, DescriptorSetLayoutRegistry) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanPipelineRegistry* registry = GetDeviceQueue()->GetPipelineRegistry();
+
+  const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+      InputAttachmentBinding(0), InputAttachmentBinding(1)};
+  VkDescriptorSetLayout set_layout = registry->GetDescriptorSetLayout(bindings);
+  ASSERT_NE(static_cast<VkDescriptorSetLayout>(VK_NULL_HANDLE), set_layout);
+  EXPECT_EQ(set_layout, registry->GetDescriptorSetLayout(bindings));
+
+  // Another stage is another layout.
+  std::vector<VkDescriptorSetLayoutBinding> vertex_bindings = bindings;
+  vertex_bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  EXPECT_NE(set_layout, registry->GetDescriptorSetLayout(vertex_bindings));
+
+  // Pipeline layouts are shared by their set layouts too.
+  VkPipelineLayout layout = registry->GetPipelineLayout({set_layout}, {});
+  EXPECT_NE(static_cast<VkPipelineLayout>(VK_NULL_HANDLE), layout);
+  EXPECT_EQ(layout, registry->GetPipelineLayout({set_layout}, {}));
+  EXPECT_NE(layout, registry->GetPipelineLayout({}, {}));
+}
+
+TEST_F(BasicVulkanTest, InputAttachmentSubpasses) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+  // The G-buffer is written and read within the render pass, so it is
+  // transient.
+  std::vector<std::unique_ptr<VulkanImage>> images;
+  std::vector<VkImageView> attachments;
+  for (uint32_t i = 0; i <= kGBufferCount; ++i) {
+    const bool g_buffer = i < kGBufferCount;
+    images.emplace_back(new VulkanImage(device_queue));
+    ASSERT_TRUE(images.back()->Initialize(
+        kColorFormat, kExtent,
+        g_buffer ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                       VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+                 : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        VulkanImageView::IMAGE_TYPE_COLOR, VK_SAMPLE_COUNT_1_BIT,
+        g_buffer ? VulkanMemoryUsage::TRANSIENT
+                 : VulkanMemoryUsage::GPU_ONLY));
+    attachments.push_back(images.back()->image_view()->handle());
+  }
+
+  VulkanRenderPassCache* render_pass_cache =
+      device_queue->GetRenderPassCache();
+  const VulkanRenderPassDescription description = DeferredDescription();
+  VkRenderPass render_pass = render_pass_cache->Acquire(description);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+  // Subpasses are part of compatibility.
+  VulkanRenderPassDescription single_subpass = description;
+  single_subpass.subpasses.pop_back();
+  single_subpass.dependencies.clear();
+  EXPECT_FALSE(description.IsCompatibleWith(single_subpass));
+
+  VulkanFramebufferCache* framebuffer_cache =
+      device_queue->GetFramebufferCache();
+  EXPECT_NE(static_cast<VkFramebuffer>(VK_NULL_HANDLE),
+            framebuffer_cache->Get(render_pass, attachments, kExtent));
+
+  // The G-buffer pipeline writes both attachments.
+  VulkanPipelineRegistry* registry = device_queue->GetPipelineRegistry();
+  VulkanPipelineDescription g_buffer;
+  g_buffer.vertex_shader_source = kVertexShaderSource;
+  g_buffer.fragment_shader_source = kGBufferShaderSource;
+  g_buffer.cull_mode = VK_CULL_MODE_NONE;
+  g_buffer.color_attachment_count = kGBufferCount;
+  g_buffer.layout = registry->GetPipelineLayout({}, {});
+  g_buffer.render_pass = render_pass;
+  g_buffer.subpass = 0;
+  VkPipeline g_buffer_pipeline = registry->Get(g_buffer);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), g_buffer_pipeline);
+
+  // The lighting pipeline reads them through set 0 and adds up lights.
+  VkDescriptorSetLayout set_layout = registry->GetDescriptorSetLayout(
+      {InputAttachmentBinding(0), InputAttachmentBinding(1)});
+  VulkanPipelineDescription lighting;
+  lighting.vertex_shader_source = kVertexShaderSource;
+  lighting.fragment_shader_source = kLightingShaderSource;
+  lighting.cull_mode = VK_CULL_MODE_NONE;
+  lighting.blend_enable = true;
+  lighting.additive_blend = true;
+  lighting.layout = registry->GetPipelineLayout({set_layout}, {});
+  lighting.render_pass = render_pass;
+  lighting.subpass = 1;
+  VulkanPipelineDescription alpha_blended = lighting;
+  alpha_blended.additive_blend = false;
+  EXPECT_FALSE(alpha_blended == lighting);
+  EXPECT_NE(HashPipelineDescription(alpha_blended),
+            HashPipelineDescription(lighting));
+  VkPipeline lighting_pipeline = registry->Get(lighting);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), lighting_pipeline);
+  EXPECT_NE(g_buffer_pipeline, lighting_pipeline);
+
+  for (std::unique_ptr<VulkanImage>& image : images)
+    image->Destroy();
+  EXPECT_EQ(0u, framebuffer_cache->size());
+  render_pass_cache->Release(render_pass);
+  EXPECT_EQ(0u, registry->size());
+}
+
+}  // namespace gpu
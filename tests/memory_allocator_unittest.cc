@@ -0,0 +1,258 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <algorithm>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_memory_allocator.h"
+
+// This file tests sub-allocation out of shared blocks, dedicated blocks for
+// large requests, flush ranges, memory type scoring and the fragmentation
+// statistics of VulkanMemoryAllocator.
+namespace gpu {
+
+namespace {
+
+const VkDeviceSize kAlignment = 256;
+
+// Shared blocks are at most an eighth of their heap, see
+// VulkanMemoryAllocator::AllocateFromMemoryType().
+VkDeviceSize GetBlockSize(VulkanDeviceQueue* device_queue) {
+  const VkPhysicalDeviceMemoryProperties& properties =
+      device_queue->GetMemoryProperties();
+  const uint32_t memory_type_index = device_queue->FindMemoryTypeIndex(
+      UINT32_MAX, VulkanMemoryUsage::GPU_ONLY);
+  const uint32_t heap_index =
+      properties.memoryTypes[memory_type_index].heapIndex;
+  return std::min(VulkanMemoryAllocator::kDefaultBlockSize,
+                  properties.memoryHeaps[heap_index].size / 8);
+}
+
+bool Allocate(VulkanMemoryAllocator* allocator,
+              VkDeviceSize size,
+              VkDeviceSize alignment,
+              VulkanMemoryAllocation* allocation) {
+  VkMemoryRequirements requirements = {size, alignment, UINT32_MAX};
+  return allocator->Allocate(requirements, VulkanMemoryUsage::GPU_ONLY, true,
+                             allocation);
+}
+
+}  // namespace
+
+TEST(MemoryAllocatorTest, FlushRange) {
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+
+  // Both ends are rounded out to the atom size.
+  VulkanMemoryAllocator::GetFlushRange(100, 50, 4096, 64, &offset, &size);
+  EXPECT_EQ(64u, offset);
+  EXPECT_EQ(128u, size);
+
+  // Aligned ranges stay as they are.
+  VulkanMemoryAllocator::GetFlushRange(256, 512, 4096, 256, &offset, &size);
+  EXPECT_EQ(256u, offset);
+  EXPECT_EQ(512u, size);
+
+  // A range whose rounded end reaches past the end of the block can only be
+  // flushed to the end of the memory.
+  VulkanMemoryAllocator::GetFlushRange(900, 90, 1000, 256, &offset, &size);
+  EXPECT_EQ(768u, offset);
+  EXPECT_EQ(VK_WHOLE_SIZE, size);
+  VulkanMemoryAllocator::GetFlushRange(0, 1024, 1024, 64, &offset, &size);
+  EXPECT_EQ(0u, offset);
+  EXPECT_EQ(VK_WHOLE_SIZE, size);
+
+  // Coherent-like atom sizes of 1 leave the range alone.
+  VulkanMemoryAllocator::GetFlushRange(3, 5, 1024, 1, &offset, &size);
+  EXPECT_EQ(3u, offset);
+  EXPECT_EQ(5u, size);
+}
+
+TEST(MemoryAllocatorTest, MemoryTypeScoring) {
+  VkPhysicalDeviceMemoryProperties properties = {};
+  properties.memoryHeapCount = 1;
+  properties.memoryHeaps[0] = {1024u * 1024u * 1024u,
+                               VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+  properties.memoryTypeCount = 4;
+  properties.memoryTypes[0].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  properties.memoryTypes[1].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  properties.memoryTypes[2].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  properties.memoryTypes[3].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  // The primary flag outweighs the secondary ones: cached but incoherent
+  // memory beats coherent memory for readback.
+  EXPECT_EQ(0u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, UINT32_MAX, VulkanMemoryUsage::READBACK));
+  // Avoided flags cost points: uploads stay out of device local memory
+  // and cached memory even though both are host visible.
+  EXPECT_EQ(1u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, UINT32_MAX, VulkanMemoryUsage::UPLOAD));
+  EXPECT_EQ(2u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, UINT32_MAX, VulkanMemoryUsage::DIRECT_WRITE));
+  // Of two types with equal scores the lower index wins.
+  EXPECT_EQ(1u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, 0xa, VulkanMemoryUsage::UPLOAD));
+  EXPECT_EQ(3u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, 0x9, VulkanMemoryUsage::UPLOAD));
+  // With only host visible types around, GPU_ONLY takes the device local one.
+  EXPECT_EQ(2u, VulkanMemoryAllocator::FindMemoryTypeIndex(
+                    properties, UINT32_MAX, VulkanMemoryUsage::GPU_ONLY));
+}
+
+TEST_F(BasicVulkanTest, SubAllocationCoalescing) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+  const VkDeviceSize block_size = GetBlockSize(GetDeviceQueue());
+  const VkDeviceSize kSize = 4096;
+
+  VulkanMemoryAllocation allocations[3];
+  for (VulkanMemoryAllocation& allocation : allocations)
+    ASSERT_TRUE(Allocate(allocator, kSize, kAlignment, &allocation));
+  // All three come out of one block, back to back.
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(allocations[0].memory, allocations[i].memory);
+    EXPECT_EQ(i * kSize, allocations[i].offset);
+  }
+  VulkanMemoryAllocator::Statistics stats = allocator->GetStatistics();
+  EXPECT_EQ(1u, stats.block_count);
+  EXPECT_EQ(1u, stats.free_range_count);
+  EXPECT_EQ(block_size - 3 * kSize, stats.free_bytes);
+  EXPECT_FLOAT_EQ(0.0f, stats.fragmentation);
+
+  // A hole in the middle splits the free space.
+  allocator->Free(&allocations[1]);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(2u, stats.free_range_count);
+  EXPECT_EQ(block_size - 2 * kSize, stats.free_bytes);
+  EXPECT_EQ(block_size - 3 * kSize, stats.largest_free_range);
+  EXPECT_FLOAT_EQ(1.0f - static_cast<float>(stats.largest_free_range) /
+                             static_cast<float>(stats.free_bytes),
+                  stats.fragmentation);
+  EXPECT_GT(stats.fragmentation, 0.0f);
+
+  // Freeing a neighbour merges it into the hole, and the last one merges
+  // the hole with the tail.
+  allocator->Free(&allocations[0]);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(2u, stats.free_range_count);
+  EXPECT_EQ(block_size - 3 * kSize, stats.largest_free_range);
+  allocator->Free(&allocations[2]);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(1u, stats.free_range_count);
+  EXPECT_EQ(block_size, stats.free_bytes);
+  EXPECT_EQ(block_size, stats.largest_free_range);
+  EXPECT_FLOAT_EQ(0.0f, stats.fragmentation);
+}
+
+TEST_F(BasicVulkanTest, SubAllocationAlignment) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+
+  VulkanMemoryAllocation small;
+  ASSERT_TRUE(Allocate(allocator, 100, 1, &small));
+  EXPECT_EQ(0u, small.offset);
+
+  // The aligned allocation skips to the next 4096 boundary and the padding
+  // before it goes back to the free list.
+  VulkanMemoryAllocation aligned;
+  ASSERT_TRUE(Allocate(allocator, 4096, 4096, &aligned));
+  EXPECT_EQ(small.memory, aligned.memory);
+  EXPECT_EQ(4096u, aligned.offset);
+  VulkanMemoryAllocator::Statistics stats = allocator->GetStatistics();
+  EXPECT_EQ(2u, stats.free_range_count);
+  EXPECT_EQ(100u + 4096u, stats.used_bytes);
+
+  // Smaller requests are served from the padding, first fit.
+  VulkanMemoryAllocation padding;
+  ASSERT_TRUE(Allocate(allocator, kAlignment, kAlignment, &padding));
+  EXPECT_EQ(small.memory, padding.memory);
+  EXPECT_EQ(kAlignment, padding.offset);
+
+  allocator->Free(&small);
+  allocator->Free(&aligned);
+  allocator->Free(&padding);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(0u, stats.live_allocations);
+  EXPECT_EQ(1u, stats.free_range_count);
+}
+
+TEST_F(BasicVulkanTest, DedicatedBlocks) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+  const VkDeviceSize block_size = GetBlockSize(GetDeviceQueue());
+
+  // More than half a block gets its own VkDeviceMemory of exactly its size.
+  const VkDeviceSize large_size = block_size / 2 + kAlignment;
+  VulkanMemoryAllocation large;
+  ASSERT_TRUE(Allocate(allocator, large_size, kAlignment, &large));
+  EXPECT_EQ(0u, large.offset);
+  VulkanMemoryAllocator::Statistics stats = allocator->GetStatistics();
+  EXPECT_EQ(1u, stats.block_count);
+  EXPECT_EQ(large_size, stats.block_bytes);
+  EXPECT_EQ(0u, stats.free_bytes);
+
+  // Small allocations never share it.
+  VulkanMemoryAllocation small;
+  ASSERT_TRUE(Allocate(allocator, kAlignment, kAlignment, &small));
+  EXPECT_NE(large.memory, small.memory);
+  EXPECT_EQ(2u, allocator->GetStatistics().block_count);
+
+  // Dedicated blocks are released as soon as they are empty.
+  allocator->Free(&large);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(1u, stats.block_count);
+  EXPECT_EQ(block_size, stats.block_bytes);
+  allocator->Free(&small);
+}
+
+TEST_F(BasicVulkanTest, KeepsOneEmptyBlock) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+  const VkDeviceSize half_block = GetBlockSize(GetDeviceQueue()) / 2;
+
+  // Two halves fill the first block, the third one needs a second block.
+  VulkanMemoryAllocation allocations[3];
+  for (VulkanMemoryAllocation& allocation : allocations)
+    ASSERT_TRUE(Allocate(allocator, half_block, kAlignment, &allocation));
+  EXPECT_EQ(allocations[0].memory, allocations[1].memory);
+  EXPECT_NE(allocations[0].memory, allocations[2].memory);
+  VulkanMemoryAllocator::Statistics stats = allocator->GetStatistics();
+  EXPECT_EQ(2u, stats.block_count);
+  EXPECT_EQ(2u, stats.allocate_memory_calls);
+
+  // The first block to become empty is kept, the second one is released.
+  allocator->Free(&allocations[2]);
+  EXPECT_EQ(2u, allocator->GetStatistics().block_count);
+  allocator->Free(&allocations[0]);
+  allocator->Free(&allocations[1]);
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(1u, stats.block_count);
+  EXPECT_EQ(0u, stats.used_bytes);
+
+  // Allocating again reuses the kept block without vkAllocateMemory().
+  ASSERT_TRUE(Allocate(allocator, half_block, kAlignment, &allocations[0]));
+  EXPECT_EQ(2u, allocator->GetStatistics().allocate_memory_calls);
+  allocator->Free(&allocations[0]);
+  EXPECT_EQ(1u, allocator->GetStatistics().block_count);
+}
+
+}  // namespace gpu
@@ -0,0 +1,193 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_memory_allocator.h"
+
+// This file tests memory type selection by usage and memory statistics.
+namespace gpu {
+
+namespace {
+
+const VkMemoryPropertyFlags kDeviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+const VkMemoryPropertyFlags kHostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+const VkMemoryPropertyFlags kHostCoherent =
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+const VkMemoryPropertyFlags kHostCached = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+const VkMemoryPropertyFlags kLazilyAllocated =
+    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+VkPhysicalDeviceMemoryProperties CreateMemoryProperties(
+    const std::vector<VkMemoryPropertyFlags>& type_flags) {
+  VkPhysicalDeviceMemoryProperties properties = {};
+  properties.memoryHeapCount = 2;
+  properties.memoryHeaps[0] = {1024u * 1024u * 1024u,
+                               VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+  properties.memoryHeaps[1] = {1024u * 1024u * 1024u, 0};
+  properties.memoryTypeCount = static_cast<uint32_t>(type_flags.size());
+  for (size_t i = 0; i < type_flags.size(); ++i) {
+    properties.memoryTypes[i].propertyFlags = type_flags[i];
+    properties.memoryTypes[i].heapIndex =
+        (type_flags[i] & kDeviceLocal) ? 0 : 1;
+  }
+  return properties;
+}
+
+uint32_t Find(const VkPhysicalDeviceMemoryProperties& properties,
+              VulkanMemoryUsage usage,
+              uint32_t memory_type_bits = UINT32_MAX) {
+  return VulkanMemoryAllocator::FindMemoryTypeIndex(properties,
+                                                    memory_type_bits, usage);
+}
+
+}  // namespace
+
+TEST(MemoryTypeTest, DiscreteGPU) {
+  VkPhysicalDeviceMemoryProperties properties = CreateMemoryProperties({
+      kDeviceLocal,                                // 0
+      kHostVisible | kHostCoherent,                // 1
+      kHostVisible | kHostCoherent | kHostCached,  // 2
+  });
+
+  EXPECT_EQ(0u, Find(properties, VulkanMemoryUsage::GPU_ONLY));
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::UPLOAD));
+  EXPECT_EQ(2u, Find(properties, VulkanMemoryUsage::READBACK));
+  // Without ReBAR, direct writes go to plain write-combined memory.
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::DIRECT_WRITE));
+  // Without lazily allocated memory transient attachments are GPU_ONLY.
+  EXPECT_EQ(0u, Find(properties, VulkanMemoryUsage::TRANSIENT));
+}
+
+TEST(MemoryTypeTest, DiscreteGPUWithResizableBAR) {
+  VkPhysicalDeviceMemoryProperties properties = CreateMemoryProperties({
+      kDeviceLocal,                                 // 0
+      kHostVisible | kHostCoherent,                 // 1
+      kHostVisible | kHostCoherent | kHostCached,   // 2
+      kDeviceLocal | kHostVisible | kHostCoherent,  // 3
+  });
+
+  EXPECT_EQ(0u, Find(properties, VulkanMemoryUsage::GPU_ONLY));
+  // Staging buffers must not eat into the BAR heap.
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::UPLOAD));
+  EXPECT_EQ(2u, Find(properties, VulkanMemoryUsage::READBACK));
+  EXPECT_EQ(3u, Find(properties, VulkanMemoryUsage::DIRECT_WRITE));
+}
+
+TEST(MemoryTypeTest, UnifiedMemory) {
+  VkPhysicalDeviceMemoryProperties properties = CreateMemoryProperties({
+      kDeviceLocal,                                               // 0
+      kDeviceLocal | kHostVisible | kHostCoherent,                // 1
+      kDeviceLocal | kHostVisible | kHostCoherent | kHostCached,  // 2
+      kDeviceLocal | kLazilyAllocated,                            // 3
+  });
+
+  EXPECT_EQ(0u, Find(properties, VulkanMemoryUsage::GPU_ONLY));
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::UPLOAD));
+  EXPECT_EQ(2u, Find(properties, VulkanMemoryUsage::READBACK));
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::DIRECT_WRITE));
+
+  // Lazily allocated memory is only picked when nothing else is allowed,
+  // or for transient attachments.
+  EXPECT_EQ(3u, Find(properties, VulkanMemoryUsage::GPU_ONLY, 1u << 3));
+  EXPECT_EQ(3u, Find(properties, VulkanMemoryUsage::TRANSIENT));
+}
+
+TEST(MemoryTypeTest, RespectsMemoryTypeBits) {
+  VkPhysicalDeviceMemoryProperties properties = CreateMemoryProperties({
+      kDeviceLocal,                  // 0
+      kHostVisible | kHostCoherent,  // 1
+      kHostVisible,                  // 2
+  });
+
+  // GPU_ONLY falls back to host visible memory if it's all that's allowed.
+  EXPECT_EQ(1u, Find(properties, VulkanMemoryUsage::GPU_ONLY, 0x6));
+  EXPECT_EQ(2u, Find(properties, VulkanMemoryUsage::UPLOAD, 0x5));
+  // Host access can't be satisfied by device local memory.
+  EXPECT_EQ(UINT32_MAX, Find(properties, VulkanMemoryUsage::UPLOAD, 0x1));
+  EXPECT_EQ(UINT32_MAX, Find(properties, VulkanMemoryUsage::READBACK, 0x1));
+}
+
+// Runs against whichever ICD is installed, e.g. lavapipe or SwiftShader on
+// the bots, and checks the choices against the real memory properties.
+TEST_F(BasicVulkanTest, MemoryTypeSelectionOnDevice) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  const VkPhysicalDeviceMemoryProperties& properties =
+      GetDeviceQueue()->GetMemoryProperties();
+  ASSERT_GT(properties.memoryTypeCount, 0u);
+
+  const VulkanMemoryUsage kHostUsages[] = {VulkanMemoryUsage::UPLOAD,
+                                           VulkanMemoryUsage::READBACK,
+                                           VulkanMemoryUsage::DIRECT_WRITE};
+  for (VulkanMemoryUsage usage : kHostUsages) {
+    uint32_t index = GetDeviceQueue()->FindMemoryTypeIndex(UINT32_MAX, usage);
+    ASSERT_LT(index, properties.memoryTypeCount);
+    EXPECT_TRUE(properties.memoryTypes[index].propertyFlags & kHostVisible);
+  }
+
+  uint32_t gpu_only = GetDeviceQueue()->FindMemoryTypeIndex(
+      UINT32_MAX, VulkanMemoryUsage::GPU_ONLY);
+  ASSERT_LT(gpu_only, properties.memoryTypeCount);
+  EXPECT_TRUE(properties.memoryTypes[gpu_only].propertyFlags & kDeviceLocal);
+
+  // Allocations through the allocator land on the selected type and host
+  // visible ones come back mapped.
+  VkMemoryRequirements requirements = {4096, 256, UINT32_MAX};
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+  VulkanMemoryAllocation allocation;
+  ASSERT_TRUE(allocator->Allocate(requirements, VulkanMemoryUsage::UPLOAD, true,
+                                  &allocation));
+  EXPECT_EQ(GetDeviceQueue()->FindMemoryTypeIndex(UINT32_MAX,
+                                                  VulkanMemoryUsage::UPLOAD),
+            allocation.memory_type_index);
+  EXPECT_NE(nullptr, allocation.mapped_data);
+  EXPECT_EQ(0u, allocation.offset % requirements.alignment);
+  EXPECT_TRUE(allocator->Flush(allocation));
+  allocator->Free(&allocation);
+  EXPECT_FALSE(allocation.IsValid());
+}
+
+TEST_F(BasicVulkanTest, MemoryStatistics) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanMemoryAllocator* allocator = GetDeviceQueue()->GetMemoryAllocator();
+  const size_t kUpload = static_cast<size_t>(VulkanMemoryUsage::UPLOAD);
+
+  VkMemoryRequirements requirements = {64 * 1024, 256, UINT32_MAX};
+  VulkanMemoryAllocation allocations[2];
+  for (VulkanMemoryAllocation& allocation : allocations) {
+    ASSERT_TRUE(allocator->Allocate(requirements, VulkanMemoryUsage::UPLOAD,
+                                    true, &allocation));
+  }
+
+  VulkanMemoryAllocator::Statistics stats = allocator->GetStatistics();
+  EXPECT_EQ(2u, stats.usages[kUpload].allocation_count);
+  EXPECT_EQ(2 * requirements.size, stats.usages[kUpload].used_bytes);
+  ASSERT_EQ(GetDeviceQueue()->GetMemoryProperties().memoryHeapCount,
+            stats.heaps.size());
+  const uint32_t heap_index = GetDeviceQueue()
+                                  ->GetMemoryProperties()
+                                  .memoryTypes[allocations[0].memory_type_index]
+                                  .heapIndex;
+  EXPECT_GE(stats.heaps[heap_index].block_bytes, 2 * requirements.size);
+  EXPECT_EQ(2 * requirements.size, stats.heaps[heap_index].used_bytes);
+  EXPECT_GT(stats.heaps[heap_index].budget, 0u);
+  EXPECT_FALSE(stats.ToJSON().empty());
+
+  for (VulkanMemoryAllocation& allocation : allocations)
+    allocator->Free(&allocation);
+
+  // Usage drops back while the peaks are kept.
+  stats = allocator->GetStatistics();
+  EXPECT_EQ(0u, stats.usages[kUpload].allocation_count);
+  EXPECT_EQ(0u, stats.usages[kUpload].used_bytes);
+  EXPECT_EQ(2 * requirements.size, stats.usages[kUpload].peak_used_bytes);
+  EXPECT_GE(stats.peak_block_bytes, 2 * requirements.size);
+}
+
+}  // namespace gpu
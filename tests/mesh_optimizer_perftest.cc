@@ -0,0 +1,131 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#include "../vulkan/vulkan_mesh_optimizer.h"
+
+// Throughput of the mesh optimizers on large generated meshes.
+namespace gpu {
+
+namespace {
+
+struct GeneratedMesh {
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  uint32_t vertex_count() const {
+    return static_cast<uint32_t>(positions.size() / 3);
+  }
+};
+
+// A UV sphere with |rings| x |segments| quads and its triangles shuffled,
+// like the output of a tool that doesn't care about triangle order.
+GeneratedMesh CreateShuffledSphere(uint32_t rings, uint32_t segments) {
+  GeneratedMesh mesh;
+  for (uint32_t ring = 0; ring <= rings; ++ring) {
+    const float theta = static_cast<float>(M_PI) * ring / rings;
+    for (uint32_t segment = 0; segment <= segments; ++segment) {
+      const float phi = 2.0f * static_cast<float>(M_PI) * segment / segments;
+      mesh.positions.push_back(sinf(theta) * cosf(phi));
+      mesh.positions.push_back(cosf(theta));
+      mesh.positions.push_back(sinf(theta) * sinf(phi));
+    }
+  }
+
+  for (uint32_t ring = 0; ring < rings; ++ring) {
+    for (uint32_t segment = 0; segment < segments; ++segment) {
+      const uint32_t corner = ring * (segments + 1) + segment;
+      const uint32_t quad[] = {corner, corner + segments + 1, corner + 1,
+                               corner + 1, corner + segments + 1,
+                               corner + segments + 2};
+      mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+    }
+  }
+
+  const size_t triangle_count = mesh.indices.size() / 3;
+  std::mt19937 random(1234);
+  for (size_t i = triangle_count - 1; i > 0; --i) {
+    std::uniform_int_distribution<size_t> distribution(0, i);
+    const size_t j = distribution(random);
+    std::swap_ranges(&mesh.indices[i * 3], &mesh.indices[i * 3 + 3],
+                     &mesh.indices[j * 3]);
+  }
+  return mesh;
+}
+
+void PrintThroughput(const std::string& story,
+                     const std::string& optimizer,
+                     size_t triangle_count,
+                     base::TimeDelta elapsed) {
+  perf_test::PrintResult("mesh_optimizer", "_" + optimizer, story,
+                         triangle_count / elapsed.InSecondsF() / 1e6,
+                         "Mtriangles/s", true);
+}
+
+void RunMeshOptimizerPerfTest(uint32_t rings, uint32_t segments) {
+  GeneratedMesh mesh = CreateShuffledSphere(rings, segments);
+  const std::string story = base::StringPrintf("sphere_%ux%u", rings, segments);
+  const size_t triangle_count = mesh.indices.size() / 3;
+
+  VertexCacheStatistics before = AnalyzeVertexCache(
+      mesh.indices.data(), mesh.indices.size(), mesh.vertex_count());
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  OptimizeVertexCache(mesh.indices.data(), mesh.indices.data(),
+                      mesh.indices.size(), mesh.vertex_count());
+  PrintThroughput(story, "vertex_cache", triangle_count,
+                  base::TimeTicks::Now() - start);
+
+  VertexCacheStatistics after = AnalyzeVertexCache(
+      mesh.indices.data(), mesh.indices.size(), mesh.vertex_count());
+
+  start = base::TimeTicks::Now();
+  OptimizeOverdraw(mesh.indices.data(), mesh.indices.data(),
+                   mesh.indices.size(), mesh.positions.data(),
+                   mesh.vertex_count(), 3 * sizeof(float));
+  PrintThroughput(story, "overdraw", triangle_count,
+                  base::TimeTicks::Now() - start);
+
+  VertexCacheStatistics after_overdraw = AnalyzeVertexCache(
+      mesh.indices.data(), mesh.indices.size(), mesh.vertex_count());
+
+  std::vector<uint32_t> remap;
+  start = base::TimeTicks::Now();
+  OptimizeVertexFetchRemap(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertex_count(), &remap);
+  PrintThroughput(story, "vertex_fetch", triangle_count,
+                  base::TimeTicks::Now() - start);
+
+  perf_test::PrintResult("acmr", "_before", story, before.acmr, "ratio",
+                         false);
+  perf_test::PrintResult("acmr", "_after", story, after.acmr, "ratio", true);
+  perf_test::PrintResult("acmr", "_after_overdraw", story, after_overdraw.acmr,
+                         "ratio", false);
+  perf_test::PrintResult("atvr", "_before", story, before.atvr, "ratio",
+                         false);
+  perf_test::PrintResult("atvr", "_after", story, after.atvr, "ratio", true);
+
+  EXPECT_LT(after.acmr, before.acmr);
+}
+
+}  // namespace
+
+TEST(MeshOptimizerPerfTest, MediumMesh) {
+  RunMeshOptimizerPerfTest(128, 256);
+}
+
+TEST(MeshOptimizerPerfTest, LargeMesh) {
+  RunMeshOptimizerPerfTest(1024, 1024);
+}
+
+}  // namespace gpu
@@ -0,0 +1,110 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "../vulkan/vulkan_mesh_optimizer.h"
+
+// This file tests the vertex cache, overdraw and vertex fetch optimizers.
+namespace gpu {
+
+namespace {
+
+// A |size| x |size| quad grid with its triangles in random order.
+std::vector<uint32_t> CreateShuffledGrid(uint32_t size,
+                                         std::vector<float>* positions) {
+  for (uint32_t y = 0; y <= size; ++y) {
+    for (uint32_t x = 0; x <= size; ++x) {
+      positions->push_back(static_cast<float>(x));
+      positions->push_back(static_cast<float>(y));
+      positions->push_back(0.0f);
+    }
+  }
+
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      uint32_t corner = y * (size + 1) + x;
+      triangles.push_back({{corner, corner + 1, corner + size + 1}});
+      triangles.push_back({{corner + size + 1, corner + 1, corner + size + 2}});
+    }
+  }
+  std::mt19937 random(42);
+  std::shuffle(triangles.begin(), triangles.end(), random);
+
+  std::vector<uint32_t> indices;
+  for (const auto& triangle : triangles)
+    indices.insert(indices.end(), triangle.begin(), triangle.end());
+  return indices;
+}
+
+std::vector<std::array<uint32_t, 3>> SortedTriangles(
+    const std::vector<uint32_t>& indices) {
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t i = 0; i < indices.size(); i += 3)
+    triangles.push_back({{indices[i], indices[i + 1], indices[i + 2]}});
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+}  // namespace
+
+TEST(MeshOptimizerTest, AnalyzeVertexCache) {
+  // Two triangles sharing an edge transform 4 vertices.
+  const uint32_t kQuad[] = {0, 1, 2, 2, 1, 3};
+  VertexCacheStatistics statistics = AnalyzeVertexCache(kQuad, 6, 4);
+  EXPECT_EQ(4u, statistics.vertices_transformed);
+  EXPECT_FLOAT_EQ(2.0f, statistics.acmr);
+  EXPECT_FLOAT_EQ(1.0f, statistics.atvr);
+
+  // With a single entry cache only consecutive repeats hit.
+  statistics = AnalyzeVertexCache(kQuad, 6, 4, 1);
+  EXPECT_EQ(5u, statistics.vertices_transformed);
+}
+
+TEST(MeshOptimizerTest, OptimizeVertexCache) {
+  std::vector<float> positions;
+  std::vector<uint32_t> indices = CreateShuffledGrid(64, &positions);
+  const uint32_t vertex_count = static_cast<uint32_t>(positions.size() / 3);
+  VertexCacheStatistics before =
+      AnalyzeVertexCache(indices.data(), indices.size(), vertex_count);
+
+  std::vector<uint32_t> optimized(indices.size());
+  OptimizeVertexCache(optimized.data(), indices.data(), indices.size(),
+                      vertex_count);
+  VertexCacheStatistics after =
+      AnalyzeVertexCache(optimized.data(), optimized.size(), vertex_count);
+
+  // The same triangles, in an order shading each vertex about once.
+  EXPECT_EQ(SortedTriangles(indices), SortedTriangles(optimized));
+  EXPECT_GT(before.acmr, 2.5f);
+  EXPECT_LT(after.acmr, 0.8f);
+  EXPECT_LT(after.atvr, 1.5f);
+
+  // Overdraw sorting keeps the triangles and most of the cache locality.
+  std::vector<uint32_t> sorted(optimized.size());
+  OptimizeOverdraw(sorted.data(), optimized.data(), optimized.size(),
+                   positions.data(), vertex_count, 3 * sizeof(float));
+  EXPECT_EQ(SortedTriangles(indices), SortedTriangles(sorted));
+  EXPECT_LT(AnalyzeVertexCache(sorted.data(), sorted.size(), vertex_count).acmr,
+            0.8f);
+}
+
+TEST(MeshOptimizerTest, OptimizeVertexFetch) {
+  std::vector<char> vertices = {'a', 'b', 'c', 'd', 'e'};
+  std::vector<uint32_t> indices = {3, 1, 4, 4, 1, 0};
+  OptimizeVertexFetch(&vertices, &indices);
+
+  // 'c' isn't referenced and is dropped.
+  const std::vector<char> kExpectedVertices = {'d', 'b', 'e', 'a'};
+  const std::vector<uint32_t> kExpectedIndices = {0, 1, 2, 2, 1, 3};
+  EXPECT_EQ(kExpectedVertices, vertices);
+  EXPECT_EQ(kExpectedIndices, indices);
+}
+
+}  // namespace gpu
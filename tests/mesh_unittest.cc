@@ -0,0 +1,46 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_mesh.h"
+
+// This file tests welding expanded triangle lists into indexed meshes.
+namespace gpu {
+
+TEST(MeshTest, WeldVertices) {
+  const VulkanBuffer::VertexData kA = {0, 0, 0, 1, 1, 0, 0, 1};
+  const VulkanBuffer::VertexData kB = {1, 0, 0, 1, 0, 1, 0, 1};
+  const VulkanBuffer::VertexData kC = {0, 1, 0, 1, 0, 0, 1, 1};
+  const VulkanBuffer::VertexData kD = {1, 1, 0, 1, 1, 1, 1, 1};
+  // A quad as two triangles sharing an edge.
+  const VulkanBuffer::VertexData kQuad[] = {kA, kB, kC, kC, kB, kD};
+
+  VulkanMesh<VulkanBuffer::VertexData> mesh = WeldVertices(kQuad, 6);
+  ASSERT_EQ(4u, mesh.vertices.size());
+  const std::vector<uint32_t> kExpectedIndices = {0, 1, 2, 2, 1, 3};
+  EXPECT_EQ(kExpectedIndices, mesh.indices);
+
+  // Indexing the welded vertices reproduces the input.
+  for (size_t i = 0; i < mesh.indices.size(); ++i) {
+    EXPECT_EQ(0, memcmp(&kQuad[i], &mesh.vertices[mesh.indices[i]],
+                        sizeof(VulkanBuffer::VertexData)));
+  }
+}
+
+TEST(MeshTest, GenerateVertexRemapKeepsDistinctVertices) {
+  const uint16_t kVertices[] = {5, 7, 5, 9, 7, 5};
+  std::vector<uint32_t> remap;
+  EXPECT_EQ(3u, GenerateVertexRemap(kVertices, 6, sizeof(uint16_t), &remap));
+  const std::vector<uint32_t> kExpectedRemap = {0, 1, 0, 2, 1, 0};
+  EXPECT_EQ(kExpectedRemap, remap);
+
+  EXPECT_EQ(0u, GenerateVertexRemap(nullptr, 0, sizeof(uint16_t), &remap));
+  EXPECT_TRUE(remap.empty());
+}
+
+}  // namespace gpu
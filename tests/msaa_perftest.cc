@@ -0,0 +1,319 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#include "basic_vulkan_test.h"
+#include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_pool.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+
+// Frame time and attachment memory traffic of rendering at 1x, and at 4x
+// into multisampled attachments that are resolved at the end of the subpass,
+// either transient or stored like a naive implementation would.
+namespace gpu {
+
+namespace {
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {1920, 1080};
+// Overlapping full screen triangles, front to back.
+const uint32_t kLayerCount = 8;
+const uint32_t kFrameCount = 50;
+
+const char kVertexShaderSource[] =
+    "#version 450\n"
+    "out gl_PerVertex { vec4 gl_Position; };\n"
+    "layout(location = 0) out vec4 v_Color;\n"
+    "void main() {\n"
+    "  vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);\n"
+    "  float depth = float(gl_InstanceIndex + 1) / 16.0;\n"
+    "  gl_Position = vec4(position * 2.0 - 1.0, depth, 1.0);\n"
+    "  v_Color = vec4(position, depth, 1.0);\n"
+    "}\n";
+
+const char kFragmentShaderSource[] =
+    "#version 450\n"
+    "layout(location = 0) in vec4 v_Color;\n"
+    "layout(location = 0) out vec4 o_Color;\n"
+    "void main() { o_Color = v_Color; }\n";
+
+uint32_t BytesPerTexel(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+      return 2;
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+// Bytes moved between tile memory and DRAM per frame on a tile-based GPU:
+// loaded attachments are read and stored or resolved ones written, while
+// transient ones never leave the tile.
+VkDeviceSize AttachmentTraffic(const VulkanRenderPassDescription& description,
+                               const VkExtent2D& extent) {
+  VkDeviceSize traffic = 0;
+  for (const VkAttachmentDescription& attachment : description.attachments) {
+    const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) *
+                              extent.height * attachment.samples *
+                              BytesPerTexel(attachment.format);
+    if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+      traffic += size;
+    if (attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE)
+      traffic += size;
+  }
+  return traffic;
+}
+
+// Color and depth at |samples|. Multisampled, the color is resolved into a
+// single sampled attachment. With |transient| the multisampled attachments
+// are neither loaded nor stored.
+VulkanRenderPassDescription MultisampledDescription(
+    VkFormat depth_format,
+    VkSampleCountFlagBits samples,
+    bool transient) {
+  const bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+  VkAttachmentDescription color = {};
+  color.format = kColorFormat;
+  color.samples = samples;
+  color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color.storeOp = multisampled && transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                            : VK_ATTACHMENT_STORE_OP_STORE;
+  color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription depth = color;
+  depth.format = depth_format;
+  depth.storeOp = transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                            : VK_ATTACHMENT_STORE_OP_STORE;
+  depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+  subpass.depth_stencil_attachment = {
+      1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(color);
+  description.attachments.push_back(depth);
+  if (multisampled) {
+    VkAttachmentDescription resolve = color;
+    resolve.samples = VK_SAMPLE_COUNT_1_BIT;
+    resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    subpass.resolve_attachments.push_back(
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    description.attachments.push_back(resolve);
+  }
+  description.subpasses.push_back(subpass);
+  return description;
+}
+
+class MsaaPerfTest : public VulkanPerfTest {
+ public:
+  struct Result {
+    base::TimeDelta frame_time;
+    VkDeviceSize attachment_traffic = 0;
+    // Memory the driver committed to lazily allocated attachments, if any
+    // were.
+    bool lazily_allocated = false;
+    VkDeviceSize committed_bytes = 0;
+  };
+
+  void SetUp() override {
+    VulkanPerfTest::SetUp();
+    if (HasFatalFailure())
+      return;
+    depth_format_ = VulkanImage::FindDepthFormat(GetDeviceQueue(), false);
+    ASSERT_NE(VK_FORMAT_UNDEFINED, depth_format_);
+  }
+
+  bool SupportsSamples(VkSampleCountFlagBits samples) {
+    const VkPhysicalDeviceLimits& limits =
+        GetDeviceQueue()->GetPhysicalDeviceProperties().limits;
+    return (limits.framebufferColorSampleCounts &
+            limits.framebufferDepthSampleCounts & samples) != 0;
+  }
+
+  // Renders |kFrameCount| frames, waiting for each, and returns the average
+  // time per frame.
+  Result RenderFrames(VkSampleCountFlagBits samples, bool transient) {
+    Result result;
+    const VulkanRenderPassDescription description =
+        MultisampledDescription(depth_format_, samples, transient);
+    result.attachment_traffic = AttachmentTraffic(description, kExtent);
+
+    VulkanRenderPassCache* render_pass_cache =
+        GetDeviceQueue()->GetRenderPassCache();
+    VkRenderPass render_pass = render_pass_cache->Acquire(description);
+    EXPECT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+
+    std::vector<std::unique_ptr<VulkanImage>> images;
+    std::vector<VkImageView> views;
+    for (uint32_t i = 0; i < description.attachments.size(); ++i) {
+      const VkAttachmentDescription& attachment = description.attachments[i];
+      const bool depth = i == 1;
+      VkImageUsageFlags usage =
+          depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      VulkanMemoryUsage memory_usage = VulkanMemoryUsage::GPU_ONLY;
+      if (attachment.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE) {
+        usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        memory_usage = VulkanMemoryUsage::TRANSIENT;
+      }
+      images.emplace_back(new VulkanImage(GetDeviceQueue()));
+      EXPECT_TRUE(images.back()->Initialize(
+          attachment.format, kExtent, usage,
+          depth ? (VulkanImage::HasStencil(attachment.format)
+                       ? VulkanImageView::IMAGE_TYPE_DEPTH_STENCIL
+                       : VulkanImageView::IMAGE_TYPE_DEPTH)
+                : VulkanImageView::IMAGE_TYPE_COLOR,
+          attachment.samples, memory_usage));
+      views.push_back(images.back()->image_view()->handle());
+    }
+    VkFramebuffer framebuffer = GetDeviceQueue()->GetFramebufferCache()->Get(
+        render_pass, views, kExtent);
+
+    VulkanPipelineRegistry* registry = GetDeviceQueue()->GetPipelineRegistry();
+    VulkanPipelineDescription pipeline_description;
+    pipeline_description.vertex_shader_source = kVertexShaderSource;
+    pipeline_description.fragment_shader_source = kFragmentShaderSource;
+    pipeline_description.cull_mode = VK_CULL_MODE_NONE;
+    pipeline_description.samples = samples;
+    pipeline_description.depth_test_enable = true;
+    pipeline_description.depth_write_enable = true;
+    pipeline_description.layout = registry->GetPipelineLayout({}, {});
+    pipeline_description.render_pass = render_pass;
+    VkPipeline pipeline = registry->Get(pipeline_description);
+    EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline);
+
+    std::unique_ptr<VulkanCommandPool> command_pool =
+        GetDeviceQueue()->CreateCommandPool(
+            nullptr, 0, GetDeviceQueue()->GetGraphicsQueueFamilyIndex());
+    std::unique_ptr<VulkanCommandBuffer> command_buffer =
+        command_pool->CreatePrimaryCommandBuffer();
+    {
+      ScopedMultiUseCommandBufferRecorder recorder(*command_buffer);
+      std::vector<VkClearValue> clear_values(description.attachments.size());
+      clear_values[1].depthStencil = {1.0f, 0};
+      VkRenderPassBeginInfo begin_info = {};
+      begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      begin_info.renderPass = render_pass;
+      begin_info.framebuffer = framebuffer;
+      begin_info.renderArea = {{0, 0}, kExtent};
+      begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+      begin_info.pClearValues = clear_values.data();
+      vkCmdBeginRenderPass(recorder.handle(), &begin_info,
+                           VK_SUBPASS_CONTENTS_INLINE);
+      vkCmdBindPipeline(recorder.handle(), VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      VkViewport viewport = {0.0f,
+                             0.0f,
+                             static_cast<float>(kExtent.width),
+                             static_cast<float>(kExtent.height),
+                             0.0f,
+                             1.0f};
+      vkCmdSetViewport(recorder.handle(), 0, 1, &viewport);
+      VkRect2D scissor = {{0, 0}, kExtent};
+      vkCmdSetScissor(recorder.handle(), 0, 1, &scissor);
+      vkCmdDraw(recorder.handle(), 3, kLayerCount, 0, 0);
+      vkCmdEndRenderPass(recorder.handle());
+    }
+
+    // The first frame pays for lazily committing memory, if the driver ever
+    // has to.
+    command_buffer->Submit(0, nullptr, 0, nullptr);
+    command_buffer->Wait(UINT64_MAX);
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+      command_buffer->Submit(0, nullptr, 0, nullptr);
+      command_buffer->Wait(UINT64_MAX);
+    }
+    result.frame_time = (base::TimeTicks::Now() - start) / kFrameCount;
+
+    const VkPhysicalDeviceMemoryProperties& memory_properties =
+        GetDeviceQueue()->GetMemoryProperties();
+    for (const std::unique_ptr<VulkanImage>& image : images) {
+      const VulkanMemoryAllocation& allocation = image->allocation();
+      if (!(memory_properties.memoryTypes[allocation.memory_type_index]
+                .propertyFlags &
+            VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+        continue;
+      }
+      VkDeviceSize committed = 0;
+      vkGetDeviceMemoryCommitment(GetDeviceQueue()->GetVulkanDevice(),
+                                  allocation.memory, &committed);
+      result.lazily_allocated = true;
+      result.committed_bytes += committed;
+    }
+
+    command_buffer->Destroy();
+    command_pool->Destroy();
+    for (std::unique_ptr<VulkanImage>& image : images)
+      image->Destroy();
+    render_pass_cache->Release(render_pass);
+    return result;
+  }
+
+ private:
+  VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+};
+
+void PrintResult(const std::string& modifier,
+                 const std::string& story,
+                 const MsaaPerfTest::Result& result) {
+  perf_test::PrintResult("msaa_frame_time", modifier, story,
+                         result.frame_time.InMillisecondsF(), "ms", true);
+  perf_test::PrintResult("msaa_attachment_traffic", modifier, story,
+                         result.attachment_traffic / (1024.0 * 1024.0), "MB",
+                         true);
+  if (result.lazily_allocated) {
+    perf_test::PrintResult("msaa_committed_memory", modifier, story,
+                           result.committed_bytes / (1024.0 * 1024.0), "MB",
+                           true);
+  }
+}
+
+}  // namespace
+
+TEST_F(MsaaPerfTest, TransientAgainstSingleSampled) {
+  const std::string story = base::StringPrintf(
+      "%ux%u_%u_layers", kExtent.width, kExtent.height, kLayerCount);
+
+  Result single_sampled = RenderFrames(VK_SAMPLE_COUNT_1_BIT, true);
+  PrintResult("_1x", story, single_sampled);
+
+  if (!SupportsSamples(VK_SAMPLE_COUNT_4_BIT))
+    return;
+  Result transient = RenderFrames(VK_SAMPLE_COUNT_4_BIT, true);
+  PrintResult("_4x_transient", story, transient);
+  Result stored = RenderFrames(VK_SAMPLE_COUNT_4_BIT, false);
+  PrintResult("_4x_stored", story, stored);
+
+  // Storing the samples writes all of them out on top of the resolve.
+  EXPECT_LT(transient.attachment_traffic, stored.attachment_traffic);
+  perf_test::PrintResult("msaa_frame_time_ratio", "_4x_transient", story,
+                         transient.frame_time.InMillisecondsF() /
+                             single_sampled.frame_time.InMillisecondsF(),
+                         "x", false);
+}
+
+}  // namespace gpu
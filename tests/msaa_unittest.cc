@@ -0,0 +1,208 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <memory>
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+#include "../vulkan/vulkan_surface.h"
+
+// This file tests transient multisampled attachments, render passes that
+// resolve them, and multisampled pipelines.
+namespace gpu {
+
+namespace {
+
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {64, 64};
+
+// A multisampled color attachment that is cleared, rendered and resolved
+// without ever being stored.
+VulkanRenderPassDescription ResolveDescription(VkSampleCountFlagBits samples) {
+  VkAttachmentDescription color_attachment = {};
+  color_attachment.format = kColorFormat;
+  color_attachment.samples = samples;
+  color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription resolve_attachment = color_attachment;
+  resolve_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  resolve_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  resolve_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+  subpass.resolve_attachments.push_back(
+      {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(color_attachment);
+  description.attachments.push_back(resolve_attachment);
+  description.subpasses.push_back(subpass);
+  return description;
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, TransientMemory) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+  VulkanImage image(device_queue);
+  ASSERT_TRUE(image.Initialize(
+      kColorFormat, kExtent,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+          VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+      VulkanImageView::IMAGE_TYPE_COLOR, VK_SAMPLE_COUNT_1_BIT,
+      VulkanMemoryUsage::TRANSIENT));
+
+  // Transient attachments land in lazily allocated memory wherever the
+  // device has it, and in device local memory otherwise.
+  const VkPhysicalDeviceMemoryProperties& memory_properties =
+      device_queue->GetMemoryProperties();
+  bool has_lazily_allocated = false;
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+    if (memory_properties.memoryTypes[i].propertyFlags &
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+      has_lazily_allocated = true;
+    }
+  }
+  const VkMemoryPropertyFlags flags =
+      memory_properties.memoryTypes[image.allocation().memory_type_index]
+          .propertyFlags;
+  EXPECT_TRUE(flags & (has_lazily_allocated
+                           ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                           : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+  EXPECT_FALSE(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  image.Destroy();
+}
+
+TEST_F(BasicVulkanTest, MultisampleResolve) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+  // 4x color attachments are required by the spec, but be lenient.
+  const VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_4_BIT;
+  if (!(device_queue->GetPhysicalDeviceProperties()
+            .limits.framebufferColorSampleCounts &
+        samples)) {
+    return;
+  }
+
+  VulkanImage multisampled_image(device_queue);
+  ASSERT_TRUE(multisampled_image.Initialize(
+      kColorFormat, kExtent,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+          VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+      VulkanImageView::IMAGE_TYPE_COLOR, samples,
+      VulkanMemoryUsage::TRANSIENT));
+  EXPECT_EQ(samples, multisampled_image.samples());
+  VulkanImage resolve_image(device_queue);
+  ASSERT_TRUE(resolve_image.Initialize(kColorFormat, kExtent,
+                                       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                       VulkanImageView::IMAGE_TYPE_COLOR));
+
+  VulkanRenderPassCache* render_pass_cache =
+      device_queue->GetRenderPassCache();
+  const VulkanRenderPassDescription description = ResolveDescription(samples);
+  VkRenderPass render_pass = render_pass_cache->Acquire(description);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+  // The sample count is part of compatibility.
+  EXPECT_FALSE(
+      description.IsCompatibleWith(ResolveDescription(VK_SAMPLE_COUNT_2_BIT)));
+
+  VulkanFramebufferCache* framebuffer_cache =
+      device_queue->GetFramebufferCache();
+  std::vector<VkImageView> attachments = {
+      multisampled_image.image_view()->handle(),
+      resolve_image.image_view()->handle()};
+  EXPECT_NE(static_cast<VkFramebuffer>(VK_NULL_HANDLE),
+            framebuffer_cache->Get(render_pass, attachments, kExtent));
+
+  VulkanPipelineRegistry* registry = device_queue->GetPipelineRegistry();
+  VulkanPipelineDescription pipeline_description;
+  pipeline_description.vertex_shader_source = kPositionVertexShaderSource;
+  pipeline_description.fragment_shader_source = kWhiteFragmentShaderSource;
+  pipeline_description.vertex_input.bindings.push_back(
+      {0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX});
+  pipeline_description.vertex_input.attributes.push_back(
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0});
+  pipeline_description.layout = registry->GetPipelineLayout({}, {});
+  pipeline_description.render_pass = render_pass;
+  pipeline_description.samples = samples;
+  VkPipeline pipeline = registry->Get(pipeline_description);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline);
+
+  // A single sampled pipeline is another one.
+  VulkanPipelineDescription single_sampled = pipeline_description;
+  single_sampled.samples = VK_SAMPLE_COUNT_1_BIT;
+  EXPECT_FALSE(single_sampled == pipeline_description);
+  EXPECT_NE(HashPipelineDescription(pipeline_description),
+            HashPipelineDescription(single_sampled));
+
+  multisampled_image.Destroy();
+  EXPECT_EQ(0u, framebuffer_cache->size());
+  resolve_image.Destroy();
+  render_pass_cache->Release(render_pass);
+  EXPECT_EQ(0u, registry->size());
+}
+
+TEST_F(BasicVulkanTest, RenderPassClampsSampleCount) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  std::unique_ptr<VulkanSurface> surface =
+      VulkanSurface::CreateViewSurface(window());
+  ASSERT_TRUE(surface);
+  ASSERT_TRUE(surface->CreateSurface());
+  SetSurface(surface.get());
+  ASSERT_TRUE(surface->Initialize(device_queue,
+                                  VulkanSurface::DEFAULT_SURFACE_FORMAT));
+
+  const VkPhysicalDeviceLimits& limits =
+      device_queue->GetPhysicalDeviceProperties().limits;
+  const VkSampleCountFlags supported = limits.framebufferColorSampleCounts;
+  // Requests that aren't a single bit, like 3 and 6, and ones beyond what
+  // any device supports are rounded down to the highest supported count.
+  for (uint32_t requested = 1; requested <= 2 * VK_SAMPLE_COUNT_64_BIT;
+       ++requested) {
+    VkSampleCountFlags expected = VK_SAMPLE_COUNT_1_BIT;
+    for (VkSampleCountFlags bit = 1; bit <= requested; bit <<= 1) {
+      if (supported & bit)
+        expected = bit;
+    }
+
+    std::vector<VkSubpassDependency> subpass_dependencies;
+    VulkanRenderPass render_pass(device_queue);
+    ASSERT_TRUE(render_pass.Initialize(
+        surface->GetSwapChain(), subpass_dependencies,
+        VulkanRenderPass::DepthMode::DEPTH_MODE_NONE,
+        static_cast<VkSampleCountFlagBits>(requested)));
+    EXPECT_EQ(expected, static_cast<VkSampleCountFlags>(render_pass.samples()))
+        << "requested " << requested;
+    render_pass.Destroy();
+  }
+
+  surface->Destroy();
+}
+
+}  // namespace gpu
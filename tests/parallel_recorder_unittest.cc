@@ -0,0 +1,74 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_pool.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_parallel_recorder.h"
+
+// This file tests recording secondary command buffers on several threads.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, ParallelRecorderCoversEveryDraw) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  std::unique_ptr<VulkanCommandPool> command_pool =
+      GetDeviceQueue()->CreateCommandPool(
+          nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          GetDeviceQueue()->GetGraphicsQueueFamilyIndex());
+  ASSERT_TRUE(command_pool);
+  std::unique_ptr<VulkanCommandBuffer> primary =
+      command_pool->CreatePrimaryCommandBuffer();
+  ASSERT_TRUE(primary);
+
+  const uint32_t kThreadCount = 4;
+  VulkanParallelRecorder recorder(GetDeviceQueue(), kThreadCount, 2);
+  ASSERT_TRUE(recorder.Initialize());
+  EXPECT_EQ(kThreadCount, recorder.thread_count());
+
+  // Fewer draws than threads leaves some ranges empty.
+  const uint32_t kDrawCounts[] = {1000, 3, 0};
+  for (uint32_t draw_count : kDrawCounts) {
+    std::vector<std::atomic<uint32_t>> recorded(draw_count);
+    for (std::atomic<uint32_t>& count : recorded)
+      count = 0;
+    std::atomic<uint32_t> thread_mask(0);
+
+    {
+      ScopedSingleUseCommandBufferRecorder primary_recorder(*primary);
+      recorder.Record(
+          0, primary_recorder.handle(), VK_NULL_HANDLE, 0, VK_NULL_HANDLE,
+          draw_count,
+          [&recorded, &thread_mask](VkCommandBuffer command_buffer,
+                                    uint32_t begin, uint32_t end,
+                                    uint32_t thread_index) {
+            EXPECT_NE(static_cast<VkCommandBuffer>(VK_NULL_HANDLE),
+                      command_buffer);
+            EXPECT_LT(begin, end);
+            for (uint32_t draw = begin; draw < end; ++draw)
+              ++recorded[draw];
+            thread_mask |= 1u << thread_index;
+          });
+    }
+
+    for (uint32_t draw = 0; draw < draw_count; ++draw)
+      EXPECT_EQ(1u, recorded[draw]) << "draw " << draw;
+    if (draw_count >= kThreadCount)
+      EXPECT_EQ((1u << kThreadCount) - 1, thread_mask.load());
+  }
+
+  recorder.Destroy();
+  primary->Destroy();
+  command_pool->Destroy();
+}
+
+}  // namespace gpu
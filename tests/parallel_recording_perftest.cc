@@ -0,0 +1,226 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#include "basic_vulkan_test.h"
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_pool.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_framebuffer_cache.h"
+#include "../vulkan/vulkan_image.h"
+#include "../vulkan/vulkan_parallel_recorder.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+
+// CPU time of recording a many-draw frame on a growing number of threads.
+namespace gpu {
+
+namespace {
+
+const uint32_t kDrawCount = 20000;
+const uint32_t kFramesInFlight = 2;
+const uint32_t kFrameCount = 20;
+const VkFormat kColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+const VkExtent2D kExtent = {300, 300};
+// Each draw is a triangle with its own vertices, and per-draw data pushed
+// as push constants, like a transform.
+const uint32_t kVertexCount = 3;
+const uint32_t kVertexSize = 4 * sizeof(float);
+const uint32_t kDrawDataSize = 64;
+const uint32_t kVertexSlots = 256;
+
+// One color attachment, cleared and stored.
+VulkanRenderPassDescription ColorDescription() {
+  VkAttachmentDescription attachment = {};
+  attachment.format = kColorFormat;
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(attachment);
+  description.subpasses.push_back(subpass);
+  return description;
+}
+
+class ParallelRecordingPerfTest : public VulkanPerfTest {
+ public:
+  ParallelRecordingPerfTest() : color_image_(GetDeviceQueue()) {}
+
+  void SetUp() override {
+    VulkanPerfTest::SetUp();
+    if (HasFatalFailure())
+      return;
+    VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+    std::vector<uint8_t> zeros(kVertexCount * kVertexSize * kVertexSlots);
+    ASSERT_TRUE(vertex_buffer_.Initialize(
+        device_queue, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, zeros.data(),
+        zeros.size(), VulkanBuffer::MEMORY_MODE_DEVICE_LOCAL));
+
+    render_pass_ =
+        device_queue->GetRenderPassCache()->Acquire(ColorDescription());
+    ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass_);
+    ASSERT_TRUE(color_image_.Initialize(kColorFormat, kExtent,
+                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                                        VulkanImageView::IMAGE_TYPE_COLOR));
+    framebuffer_ = device_queue->GetFramebufferCache()->Get(
+        render_pass_, {color_image_.image_view()->handle()}, kExtent);
+    ASSERT_NE(static_cast<VkFramebuffer>(VK_NULL_HANDLE), framebuffer_);
+
+    VulkanPipelineRegistry* registry = device_queue->GetPipelineRegistry();
+    const VkPushConstantRange push_constant_range = {
+        VK_SHADER_STAGE_VERTEX_BIT, 0, kDrawDataSize};
+    VulkanPipelineDescription description;
+    description.vertex_shader_source = kPositionVertexShaderSource;
+    description.fragment_shader_source = kWhiteFragmentShaderSource;
+    description.vertex_input.bindings.push_back(
+        {0, kVertexSize, VK_VERTEX_INPUT_RATE_VERTEX});
+    description.vertex_input.attributes.push_back(
+        {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0});
+    description.cull_mode = VK_CULL_MODE_NONE;
+    description.layout = registry->GetPipelineLayout({}, {push_constant_range});
+    description.render_pass = render_pass_;
+    pipeline_layout_ = description.layout;
+    pipeline_ = registry->Get(description);
+    ASSERT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline_);
+  }
+
+  void TearDown() override {
+    color_image_.Destroy();
+    if (render_pass_ != VK_NULL_HANDLE)
+      GetDeviceQueue()->GetRenderPassCache()->Release(render_pass_);
+    vertex_buffer_.Destroy();
+    VulkanPerfTest::TearDown();
+  }
+
+  // Records |kFrameCount| frames and returns the average time per frame.
+  base::TimeDelta RecordFrames(uint32_t thread_count) {
+    VulkanDeviceQueue* device_queue = GetDeviceQueue();
+    std::unique_ptr<VulkanCommandPool> command_pool =
+        device_queue->CreateCommandPool(
+            nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            device_queue->GetGraphicsQueueFamilyIndex());
+    std::unique_ptr<VulkanCommandBuffer> primaries[kFramesInFlight];
+    for (std::unique_ptr<VulkanCommandBuffer>& primary : primaries)
+      primary = command_pool->CreatePrimaryCommandBuffer();
+
+    VulkanParallelRecorder recorder(device_queue, thread_count,
+                                    kFramesInFlight);
+    EXPECT_TRUE(recorder.Initialize());
+
+    VkBuffer vertex_buffer = *vertex_buffer_.handle();
+    VkPipeline pipeline = pipeline_;
+    VkPipelineLayout pipeline_layout = pipeline_layout_;
+    VulkanParallelRecorder::RecordCallback record_draws =
+        [vertex_buffer, pipeline, pipeline_layout](
+            VkCommandBuffer command_buffer, uint32_t begin, uint32_t end,
+            uint32_t thread_index) {
+          // Secondary command buffers inherit no state from the primary.
+          vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline);
+          VkViewport viewport = {0.0f,
+                                 0.0f,
+                                 static_cast<float>(kExtent.width),
+                                 static_cast<float>(kExtent.height),
+                                 0.0f,
+                                 1.0f};
+          vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+          VkRect2D scissor = {{0, 0}, kExtent};
+          vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+          const uint8_t draw_data[kDrawDataSize] = {};
+          for (uint32_t draw = begin; draw < end; ++draw) {
+            const VkDeviceSize offset =
+                (draw % kVertexSlots) * kVertexCount * kVertexSize;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer,
+                                   &offset);
+            vkCmdPushConstants(command_buffer, pipeline_layout,
+                               VK_SHADER_STAGE_VERTEX_BIT, 0, kDrawDataSize,
+                               draw_data);
+            vkCmdDraw(command_buffer, kVertexCount, 1, 0, 0);
+          }
+        };
+
+    VkClearValue clear_value = {};
+    VkRenderPassBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.renderPass = render_pass_;
+    begin_info.framebuffer = framebuffer_;
+    begin_info.renderArea = {{0, 0}, kExtent};
+    begin_info.clearValueCount = 1;
+    begin_info.pClearValues = &clear_value;
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+      const uint32_t frame_index = frame % kFramesInFlight;
+      ScopedSingleUseCommandBufferRecorder primary_recorder(
+          *primaries[frame_index]);
+      vkCmdBeginRenderPass(primary_recorder.handle(), &begin_info,
+                           VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+      recorder.Record(frame_index, primary_recorder.handle(), render_pass_, 0,
+                      framebuffer_, kDrawCount, record_draws);
+      vkCmdEndRenderPass(primary_recorder.handle());
+    }
+    base::TimeDelta elapsed = (base::TimeTicks::Now() - start) / kFrameCount;
+
+    recorder.Destroy();
+    for (std::unique_ptr<VulkanCommandBuffer>& primary : primaries)
+      primary->Destroy();
+    command_pool->Destroy();
+    return elapsed;
+  }
+
+ private:
+  VulkanBuffer vertex_buffer_;
+  VulkanImage color_image_;
+  VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+};
+
+}  // namespace
+
+TEST_F(ParallelRecordingPerfTest, ManyDraws) {
+  const uint32_t max_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  const std::string story = base::StringPrintf("%u_draws", kDrawCount);
+
+  base::TimeDelta single_thread;
+  for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+    base::TimeDelta elapsed = RecordFrames(threads);
+    if (threads == 1)
+      single_thread = elapsed;
+    perf_test::PrintResult("parallel_recording",
+                           base::StringPrintf("_%u_threads", threads), story,
+                           elapsed.InMillisecondsF(), "ms", true);
+    perf_test::PrintResult("parallel_recording_speedup",
+                           base::StringPrintf("_%u_threads", threads), story,
+                           single_thread.InMillisecondsF() /
+                               elapsed.InMillisecondsF(),
+                           "x", false);
+  }
+}
+
+}  // namespace gpu
@@ -0,0 +1,224 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#include "basic_vulkan_test.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_pipeline_cache.h"
+#include "../vulkan/vulkan_shader_module.h"
+
+// Startup cost of creating pipelines with an empty pipeline cache and with
+// one a previous run saved to disk.
+namespace gpu {
+
+namespace {
+
+// Distinct pipelines, made different by a specialization constant so the
+// driver has to compile each one.
+const uint32_t kPipelineCount = 32;
+const char kCachePath[] = "pipeline_cache_perftest.bin";
+
+const char kFragmentShaderSource[] =
+    "#version 450\n"
+    "layout(constant_id = 0) const float kScale = 1.0;\n"
+    "layout(location = 0) out vec4 o_Color;\n"
+    "void main() {\n"
+    "  vec4 color = vec4(0.0);\n"
+    "  for (int i = 0; i < 16; ++i)\n"
+    "    color += sin(gl_FragCoord * kScale * float(i));\n"
+    "  o_Color = color;\n"
+    "}\n";
+
+class PipelineCachePerfTest : public VulkanPerfTest {
+ public:
+  void SetUp() override {
+    VulkanPerfTest::SetUp();
+    if (HasFatalFailure())
+      return;
+    VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+    remove(kCachePath);
+
+    // Shaders are compiled to SPIR-V once, outside of the measurements.
+    vertex_shader_.reset(new VulkanShaderModule(device));
+    ASSERT_TRUE(vertex_shader_->InitializeGLSL(
+        VulkanShaderModule::ShaderType::VERTEX, "vertex", "main",
+        kPositionVertexShaderSource));
+    fragment_shader_.reset(new VulkanShaderModule(device));
+    ASSERT_TRUE(fragment_shader_->InitializeGLSL(
+        VulkanShaderModule::ShaderType::FRAGMENT, "fragment", "main",
+        kFragmentShaderSource));
+
+    render_pass_ = CreateColorRenderPass(device, VK_FORMAT_B8G8R8A8_UNORM);
+    ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass_);
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    ASSERT_EQ(VK_SUCCESS, vkCreatePipelineLayout(device, &layout_create_info,
+                                                 nullptr, &pipeline_layout_));
+  }
+
+  void TearDown() override {
+    VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+    vkDestroyPipelineLayout(device, pipeline_layout_, nullptr);
+    vkDestroyRenderPass(device, render_pass_, nullptr);
+    fragment_shader_->Destroy();
+    vertex_shader_->Destroy();
+    VulkanPerfTest::TearDown();
+    remove(kCachePath);
+  }
+
+  // Creates and destroys |kPipelineCount| pipelines and returns the time it
+  // took to create them.
+  base::TimeDelta CreatePipelines(VkPipelineCache pipeline_cache) {
+    VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertex_shader_->handle();
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragment_shader_->handle();
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = {0, 4 * sizeof(float),
+                                               VK_VERTEX_INPUT_RATE_VERTEX};
+    VkVertexInputAttributeDescription attribute = {
+        0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &binding;
+    vertex_input.vertexAttributeDescriptionCount = 1;
+    vertex_input.pVertexAttributeDescriptions = &attribute;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo color_blend = {};
+    color_blend.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &blend_attachment;
+
+    const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                             VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkSpecializationMapEntry map_entry = {0, 0, sizeof(float)};
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = 1;
+    specialization.pMapEntries = &map_entry;
+    specialization.dataSize = sizeof(float);
+    stages[1].pSpecializationInfo = &specialization;
+
+    VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+    pipeline_create_info.sType =
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stageCount = 2;
+    pipeline_create_info.pStages = stages;
+    pipeline_create_info.pVertexInputState = &vertex_input;
+    pipeline_create_info.pInputAssemblyState = &input_assembly;
+    pipeline_create_info.pViewportState = &viewport_state;
+    pipeline_create_info.pRasterizationState = &rasterization;
+    pipeline_create_info.pMultisampleState = &multisample;
+    pipeline_create_info.pColorBlendState = &color_blend;
+    pipeline_create_info.pDynamicState = &dynamic_state;
+    pipeline_create_info.layout = pipeline_layout_;
+    pipeline_create_info.renderPass = render_pass_;
+    pipeline_create_info.basePipelineIndex = -1;
+
+    std::vector<VkPipeline> pipelines(kPipelineCount, VK_NULL_HANDLE);
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (uint32_t i = 0; i < kPipelineCount; ++i) {
+      const float scale = 1.0f + i;
+      specialization.pData = &scale;
+      EXPECT_EQ(VK_SUCCESS,
+                vkCreateGraphicsPipelines(device, pipeline_cache, 1,
+                                          &pipeline_create_info, nullptr,
+                                          &pipelines[i]));
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    for (VkPipeline pipeline : pipelines)
+      vkDestroyPipeline(device, pipeline, nullptr);
+    return elapsed;
+  }
+
+ protected:
+  std::unique_ptr<VulkanShaderModule> vertex_shader_;
+  std::unique_ptr<VulkanShaderModule> fragment_shader_;
+  VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+};
+
+}  // namespace
+
+TEST_F(PipelineCachePerfTest, ColdAndWarmStartup) {
+  const std::string story = base::StringPrintf("%u_pipelines", kPipelineCount);
+
+  // First launch: nothing on disk yet.
+  VulkanPipelineCache cold_cache(GetDeviceQueue());
+  ASSERT_TRUE(cold_cache.Initialize(kCachePath));
+  EXPECT_EQ(0u, cold_cache.loaded_size());
+  base::TimeDelta cold = CreatePipelines(cold_cache.handle());
+  cold_cache.Destroy();
+
+  // Next launch: the saved cache is loaded back.
+  VulkanPipelineCache warm_cache(GetDeviceQueue());
+  ASSERT_TRUE(warm_cache.Initialize(kCachePath));
+  EXPECT_LT(0u, warm_cache.loaded_size());
+  base::TimeDelta warm = CreatePipelines(warm_cache.handle());
+  warm_cache.Destroy();
+
+  perf_test::PrintResult("pipeline_creation", "_cold", story,
+                         cold.InMillisecondsF(), "ms", true);
+  perf_test::PrintResult("pipeline_creation", "_warm", story,
+                         warm.InMillisecondsF(), "ms", true);
+  perf_test::PrintResult("pipeline_creation_speedup", "", story,
+                         cold.InMillisecondsF() / warm.InMillisecondsF(), "x",
+                         false);
+}
+
+}  // namespace gpu
@@ -0,0 +1,108 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <stdio.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_pipeline_cache.h"
+
+// This file tests that the pipeline cache round-trips through its file and
+// that data from another device or driver is rejected.
+namespace gpu {
+
+namespace {
+
+const char kCachePath[] = "pipeline_cache_unittest.bin";
+
+std::vector<uint8_t> ReadFile(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, PipelineCacheRoundTrip) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  remove(kCachePath);
+
+  // Nothing to load on the first run. Destroy() saves the (header only) cache.
+  VulkanPipelineCache cold_cache(device_queue);
+  ASSERT_TRUE(cold_cache.Initialize(kCachePath));
+  EXPECT_EQ(0u, cold_cache.loaded_size());
+  cold_cache.Destroy();
+
+  std::vector<uint8_t> data = ReadFile(kCachePath);
+  ASSERT_FALSE(data.empty());
+  EXPECT_TRUE(cold_cache.IsCompatible(data));
+
+  VulkanPipelineCache warm_cache(device_queue);
+  ASSERT_TRUE(warm_cache.Initialize(kCachePath));
+  EXPECT_EQ(data.size(), warm_cache.loaded_size());
+
+  // Another driver version has another pipelineCacheUUID.
+  std::vector<uint8_t> other_driver = data;
+  other_driver[16] ^= 0xff;
+  EXPECT_FALSE(warm_cache.IsCompatible(other_driver));
+  // A truncated header.
+  EXPECT_FALSE(warm_cache.IsCompatible(
+      std::vector<uint8_t>(data.begin(), data.begin() + 8)));
+  warm_cache.Destroy();
+
+  // A file from another device is ignored rather than handed to the driver.
+  {
+    std::ofstream file(kCachePath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(other_driver.data()),
+               other_driver.size());
+  }
+  VulkanPipelineCache stale_cache(device_queue);
+  ASSERT_TRUE(stale_cache.Initialize(kCachePath));
+  EXPECT_EQ(0u, stale_cache.loaded_size());
+  stale_cache.Destroy();
+
+  // An empty path keeps the cache in memory.
+  VulkanPipelineCache memory_cache(device_queue);
+  ASSERT_TRUE(memory_cache.Initialize(""));
+  EXPECT_NE(static_cast<VkPipelineCache>(VK_NULL_HANDLE),
+            memory_cache.handle());
+  memory_cache.Destroy();
+
+  remove(kCachePath);
+}
+
+TEST_F(BasicVulkanTest, PipelineCacheSaveIfDirty) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  const std::string temp_path = std::string(kCachePath) + ".tmp";
+  remove(kCachePath);
+
+  // A save right after loading is deferred, so a burst of compiles at
+  // startup is written once.
+  VulkanPipelineCache cache(device_queue);
+  ASSERT_TRUE(cache.Initialize(kCachePath));
+  cache.OnPipelineCreated();
+  EXPECT_TRUE(cache.SaveIfDirty());
+  EXPECT_TRUE(ReadFile(kCachePath).empty());
+
+  EXPECT_TRUE(cache.Save());
+  EXPECT_FALSE(ReadFile(kCachePath).empty());
+  EXPECT_TRUE(ReadFile(temp_path.c_str()).empty());
+  cache.Destroy();
+
+  remove(kCachePath);
+}
+
+}  // namespace gpu
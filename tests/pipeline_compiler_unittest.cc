@@ -0,0 +1,105 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <memory>
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_compiler.h"
+
+// This file tests that pipelines are built on the compiler's threads and
+// that failed and cancelled builds still become ready.
+namespace gpu {
+
+namespace {
+
+VulkanVertexInput PositionInput() {
+  VulkanVertexInput vertex_input;
+  vertex_input.bindings.push_back(
+      {0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX});
+  vertex_input.attributes.push_back(
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0});
+  return vertex_input;
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, PipelineCompiler) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VkDevice device = device_queue->GetVulkanDevice();
+
+  VkRenderPass render_pass =
+      CreateColorRenderPass(device, VK_FORMAT_R8G8B8A8_UNORM);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+  VkPipelineLayoutCreateInfo layout_create_info = {};
+  layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS, vkCreatePipelineLayout(device, &layout_create_info,
+                                               nullptr, &layout));
+
+  VulkanPipelineDescription description;
+  description.vertex_shader_source = kPositionVertexShaderSource;
+  description.fragment_shader_source = kWhiteFragmentShaderSource;
+  description.vertex_input = PositionInput();
+  description.layout = layout;
+  description.render_pass = render_pass;
+
+  VulkanPipelineCompiler compiler(device_queue, 2);
+  ASSERT_TRUE(compiler.Initialize());
+
+  std::vector<std::shared_ptr<VulkanPendingPipeline>> pending;
+  for (int i = 0; i < 4; ++i) {
+    description.cull_mode =
+        i % 2 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+    pending.push_back(compiler.Compile(description));
+  }
+  VulkanPipelineDescription broken = description;
+  broken.fragment_shader_source = "#version 450\nvoid main() { oops }\n";
+  std::shared_ptr<VulkanPendingPipeline> broken_pending =
+      compiler.Compile(broken);
+  // Nobody waits for this one. It is skipped or destroyed with its handle.
+  compiler.Compile(description);
+
+  compiler.WaitIdle();
+  EXPECT_EQ(0u, compiler.num_queued());
+  std::vector<VkPipeline> pipelines;
+  for (const std::shared_ptr<VulkanPendingPipeline>& p : pending) {
+    ASSERT_TRUE(p->IsReady());
+    VkPipeline pipeline = p->GetOr(VK_NULL_HANDLE);
+    EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline);
+    pipelines.push_back(pipeline);
+  }
+
+  // A failed build is ready, without a pipeline.
+  ASSERT_TRUE(broken_pending->IsReady());
+  EXPECT_EQ(static_cast<VkPipeline>(VK_NULL_HANDLE),
+            broken_pending->pipeline());
+  EXPECT_FALSE(broken_pending->error().empty());
+  EXPECT_EQ(pipelines[0], broken_pending->GetOr(pipelines[0]));
+
+  // Destroy() leaves nothing pending: builds either finish or are cancelled.
+  std::vector<std::shared_ptr<VulkanPendingPipeline>> late;
+  for (int i = 0; i < 8; ++i)
+    late.push_back(compiler.Compile(description));
+  compiler.Destroy();
+  for (const std::shared_ptr<VulkanPendingPipeline>& p : late) {
+    p->Wait();
+    EXPECT_TRUE(p->IsReady());
+  }
+  // Pipelines that were never handed out are destroyed with their handles.
+  late.clear();
+
+  for (VkPipeline pipeline : pipelines)
+    vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, layout, nullptr);
+  vkDestroyRenderPass(device, render_pass, nullptr);
+}
+
+}  // namespace gpu
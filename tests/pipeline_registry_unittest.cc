@@ -0,0 +1,109 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <string>
+#include <vector>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_pipeline.h"
+#include "../vulkan/vulkan_pipeline_compiler.h"
+#include "../vulkan/vulkan_pipeline_registry.h"
+
+// This file tests that identical pipeline state maps to one pipeline and
+// that pipelines are evicted with their render pass.
+namespace gpu {
+
+TEST(PipelineRegistryTest, ShaderSource) {
+  VulkanShaderSource source = kPositionVertexShaderSource;
+  VulkanShaderSource copy = source;
+  VulkanShaderSource same_text = std::string(kPositionVertexShaderSource);
+  VulkanShaderSource other = kWhiteFragmentShaderSource;
+  EXPECT_EQ(source.hash(), same_text.hash());
+  EXPECT_EQ(kPositionVertexShaderSource, copy.str());
+  EXPECT_TRUE(source == copy);
+  EXPECT_TRUE(source == same_text);
+  EXPECT_TRUE(source != other);
+  EXPECT_TRUE(VulkanShaderSource().empty());
+  EXPECT_TRUE(VulkanShaderSource("").empty());
+  EXPECT_TRUE(source != VulkanShaderSource());
+}
+
+TEST_F(BasicVulkanTest, PipelineRegistry) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VkDevice device = device_queue->GetVulkanDevice();
+  VulkanPipelineRegistry* registry = device_queue->GetPipelineRegistry();
+
+  // Layouts are shared too.
+  VkPipelineLayout layout = registry->GetPipelineLayout({}, {});
+  ASSERT_NE(static_cast<VkPipelineLayout>(VK_NULL_HANDLE), layout);
+  EXPECT_EQ(layout, registry->GetPipelineLayout({}, {}));
+  VkPushConstantRange push_constants = {VK_SHADER_STAGE_VERTEX_BIT, 0, 64};
+  EXPECT_NE(layout, registry->GetPipelineLayout({}, {push_constants}));
+
+  VkRenderPass render_pass =
+      CreateColorRenderPass(device, VK_FORMAT_R8G8B8A8_UNORM);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+
+  VulkanPipelineDescription description;
+  description.vertex_shader_source = kPositionVertexShaderSource;
+  description.fragment_shader_source = kWhiteFragmentShaderSource;
+  description.vertex_input.bindings.push_back(
+      {0, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX});
+  description.vertex_input.attributes.push_back(
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0});
+  description.layout = layout;
+  description.render_pass = render_pass;
+
+  VkPipeline pipeline = registry->Get(description);
+  ASSERT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), pipeline);
+  VulkanPipelineDescription same = description;
+  EXPECT_EQ(HashPipelineDescription(description),
+            HashPipelineDescription(same));
+  EXPECT_EQ(pipeline, registry->Get(same));
+  EXPECT_EQ(1u, registry->hits());
+  EXPECT_EQ(1u, registry->misses());
+
+  // The baked-in extent doesn't matter with a dynamic viewport.
+  same.static_extent = {64, 64};
+  EXPECT_EQ(pipeline, registry->Get(same));
+
+  // Any state that changes the pipeline is another pipeline of the same
+  // render pass.
+  VulkanPipelineDescription blended = description;
+  blended.blend_enable = true;
+  EXPECT_FALSE(blended == description);
+  VkPipeline blended_pipeline = registry->Get(blended);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), blended_pipeline);
+  EXPECT_NE(pipeline, blended_pipeline);
+  VulkanPipelineDescription lines = description;
+  lines.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+  EXPECT_NE(pipeline, registry->Get(lines));
+  EXPECT_EQ(3u, registry->size());
+
+  // A pipeline built in the background is found once it is ready.
+  VulkanPipelineCompiler compiler(device_queue, 1);
+  ASSERT_TRUE(compiler.Initialize());
+  VulkanPipelineDescription culled = description;
+  culled.cull_mode = VK_CULL_MODE_NONE;
+  const size_t culled_hash = HashPipelineDescription(culled);
+  registry->GetOrCompile(culled, culled_hash, &compiler);
+  compiler.WaitIdle();
+  VkPipeline culled_pipeline =
+      registry->GetOrCompile(culled, culled_hash, &compiler);
+  EXPECT_NE(static_cast<VkPipeline>(VK_NULL_HANDLE), culled_pipeline);
+  EXPECT_EQ(culled_pipeline, registry->Get(culled, culled_hash));
+  compiler.Destroy();
+
+  // Destroying the render pass evicts all four.
+  registry->EvictRenderPass(render_pass);
+  EXPECT_EQ(0u, registry->size());
+  vkDestroyRenderPass(device, render_pass, nullptr);
+}
+
+}  // namespace gpu
@@ -0,0 +1,186 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "../vulkan/vulkan_render_graph.h"
+
+// This file tests how the render graph culls passes and derives barriers.
+// Compile() doesn't touch the device, so made-up image handles do.
+namespace gpu {
+
+namespace {
+
+const uint32_t kGraphicsFamily = 0;
+const uint32_t kPresentFamily = 1;
+
+VkImage FakeImage(uintptr_t value) {
+  return reinterpret_cast<VkImage>(value);
+}
+
+}  // namespace
+
+TEST(RenderGraphTest, ShadowMapThenMainPass) {
+  VulkanRenderGraph graph(kGraphicsFamily);
+  VulkanRenderGraph::ResourceId shadow_map = graph.ImportImage(
+      FakeImage(1), VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  VulkanRenderGraph::ResourceId back_buffer = graph.ImportImage(
+      FakeImage(2), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  graph.SetOutput(back_buffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+  VulkanRenderGraph::PassId shadow = graph.AddPass("shadow", nullptr);
+  graph.Write(shadow, shadow_map, VulkanRenderGraph::DepthStencilAttachment());
+  VulkanRenderGraph::PassId main = graph.AddPass("main", nullptr);
+  graph.Read(main, shadow_map, VulkanRenderGraph::FragmentShaderRead());
+  graph.Write(main, back_buffer, VulkanRenderGraph::ColorAttachment());
+  graph.Compile();
+
+  EXPECT_EQ(0u, graph.num_culled_passes());
+  // One barrier before each pass and the transition to present.
+  EXPECT_EQ(3u, graph.num_pipeline_barriers());
+
+  const VulkanRenderGraph::BarrierBatch& before_shadow =
+      graph.GetBarriersBefore(shadow);
+  ASSERT_EQ(1u, before_shadow.image_barriers.size());
+  EXPECT_EQ(VK_IMAGE_LAYOUT_UNDEFINED,
+            before_shadow.image_barriers[0].oldLayout);
+  EXPECT_EQ(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            before_shadow.image_barriers[0].newLayout);
+  EXPECT_EQ(static_cast<VkPipelineStageFlags>(
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+            before_shadow.src_stages);
+
+  // The shadow map and the back buffer are transitioned together.
+  const VulkanRenderGraph::BarrierBatch& before_main =
+      graph.GetBarriersBefore(main);
+  ASSERT_EQ(2u, before_main.image_barriers.size());
+  const VkImageMemoryBarrier& shadow_barrier = before_main.image_barriers[0];
+  EXPECT_EQ(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            shadow_barrier.oldLayout);
+  EXPECT_EQ(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            shadow_barrier.newLayout);
+  EXPECT_TRUE(shadow_barrier.srcAccessMask &
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+  EXPECT_TRUE(shadow_barrier.dstAccessMask & VK_ACCESS_SHADER_READ_BIT);
+  EXPECT_TRUE(before_main.src_stages &
+              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+  EXPECT_TRUE(before_main.src_stages &
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  EXPECT_TRUE(before_main.dst_stages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  EXPECT_EQ(FakeImage(2), before_main.image_barriers[1].image);
+
+  const VulkanRenderGraph::BarrierBatch& final_barriers =
+      graph.GetFinalBarriers();
+  ASSERT_EQ(1u, final_barriers.image_barriers.size());
+  EXPECT_EQ(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            final_barriers.image_barriers[0].oldLayout);
+  EXPECT_EQ(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            final_barriers.image_barriers[0].newLayout);
+}
+
+TEST(RenderGraphTest, CullsPassesNoOutputDependsOn) {
+  VulkanRenderGraph graph(kGraphicsFamily);
+  VulkanRenderGraph::ResourceId debug_view = graph.ImportImage(
+      FakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  VulkanRenderGraph::ResourceId back_buffer = graph.ImportImage(
+      FakeImage(2), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  graph.SetOutput(back_buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+
+  VulkanRenderGraph::PassId debug = graph.AddPass("debug", nullptr);
+  graph.Write(debug, debug_view, VulkanRenderGraph::ColorAttachment());
+  VulkanRenderGraph::PassId main = graph.AddPass("main", nullptr);
+  graph.Write(main, back_buffer, VulkanRenderGraph::ColorAttachment());
+  graph.Compile();
+
+  EXPECT_TRUE(graph.IsPassCulled(debug));
+  EXPECT_FALSE(graph.IsPassCulled(main));
+  EXPECT_EQ(1u, graph.num_culled_passes());
+  EXPECT_TRUE(graph.GetBarriersBefore(debug).empty());
+  EXPECT_TRUE(graph.GetFinalBarriers().empty());
+
+  // Reading the debug view from the main pass keeps it alive.
+  graph.Reset();
+  debug_view = graph.ImportImage(FakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT,
+                                 VK_IMAGE_LAYOUT_UNDEFINED);
+  back_buffer = graph.ImportImage(FakeImage(2), VK_IMAGE_ASPECT_COLOR_BIT,
+                                  VK_IMAGE_LAYOUT_UNDEFINED);
+  graph.SetOutput(back_buffer, VK_IMAGE_LAYOUT_UNDEFINED);
+  debug = graph.AddPass("debug", nullptr);
+  graph.Write(debug, debug_view, VulkanRenderGraph::ColorAttachment());
+  main = graph.AddPass("main", nullptr);
+  graph.Read(main, debug_view, VulkanRenderGraph::FragmentShaderRead());
+  graph.Write(main, back_buffer, VulkanRenderGraph::ColorAttachment());
+  graph.Compile();
+  EXPECT_EQ(0u, graph.num_culled_passes());
+}
+
+TEST(RenderGraphTest, ReadsShareOneDependency) {
+  VulkanRenderGraph graph(kGraphicsFamily);
+  VulkanRenderGraph::ResourceId texture = graph.ImportImage(
+      FakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  VulkanRenderGraph::ResourceId target = graph.ImportImage(
+      FakeImage(2), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+  graph.SetOutput(target, VK_IMAGE_LAYOUT_UNDEFINED);
+
+  VulkanRenderGraph::PassId upload = graph.AddPass("upload", nullptr);
+  graph.Write(upload, texture, VulkanRenderGraph::TransferDestination());
+  VulkanRenderGraph::PassId first = graph.AddPass("first", nullptr);
+  graph.Read(first, texture, VulkanRenderGraph::FragmentShaderRead());
+  graph.Write(first, target, VulkanRenderGraph::ColorAttachment());
+  VulkanRenderGraph::PassId second = graph.AddPass("second", nullptr);
+  graph.Read(second, texture, VulkanRenderGraph::FragmentShaderRead());
+  graph.Write(second, target, VulkanRenderGraph::ColorAttachment());
+  graph.Compile();
+
+  // The texture is already visible to the second pass, which only has to
+  // wait for the first pass's color writes.
+  const VulkanRenderGraph::BarrierBatch& before_second =
+      graph.GetBarriersBefore(second);
+  EXPECT_TRUE(before_second.image_barriers.empty());
+  EXPECT_EQ(static_cast<VkPipelineStageFlags>(
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT),
+            before_second.src_stages);
+  EXPECT_EQ(static_cast<VkAccessFlags>(VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT),
+            before_second.src_access);
+}
+
+TEST(RenderGraphTest, RenderPassTransitionsSwapImage) {
+  VulkanRenderGraph graph(kGraphicsFamily);
+  VulkanRenderGraph::ResourceId swap_image = graph.ImportImage(
+      FakeImage(1), VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  graph.SetOutput(swap_image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                  kPresentFamily);
+
+  VulkanRenderGraph::PassId draw = graph.AddPass("draw", nullptr);
+  graph.Write(draw, swap_image,
+              VulkanRenderGraph::ColorAttachment(
+                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+  graph.Compile();
+
+  // The render pass transitions the image, so the graph only waits for the
+  // acquire semaphore's stage.
+  const VulkanRenderGraph::BarrierBatch& before_draw =
+      graph.GetBarriersBefore(draw);
+  EXPECT_TRUE(before_draw.image_barriers.empty());
+  EXPECT_EQ(static_cast<VkPipelineStageFlags>(
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT),
+            before_draw.src_stages);
+
+  // The image is already in the present layout and is only released to the
+  // present queue.
+  const VulkanRenderGraph::BarrierBatch& final_barriers =
+      graph.GetFinalBarriers();
+  ASSERT_EQ(1u, final_barriers.image_barriers.size());
+  const VkImageMemoryBarrier& release = final_barriers.image_barriers[0];
+  EXPECT_EQ(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, release.oldLayout);
+  EXPECT_EQ(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, release.newLayout);
+  EXPECT_EQ(kGraphicsFamily, release.srcQueueFamilyIndex);
+  EXPECT_EQ(kPresentFamily, release.dstQueueFamilyIndex);
+  EXPECT_TRUE(release.srcAccessMask & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+}
+
+}  // namespace gpu
@@ -0,0 +1,91 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_render_pass_cache.h"
+
+// This file tests that render passes are shared by description, released
+// with their last reference, and that compatible render passes resolve to
+// the same one for pipelines and framebuffers.
+namespace gpu {
+
+namespace {
+
+VulkanRenderPassDescription ColorDescription(VkFormat format,
+                                             VkAttachmentLoadOp load_op) {
+  VkAttachmentDescription attachment = {};
+  attachment.format = format;
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = load_op;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachment.initialLayout = load_op == VK_ATTACHMENT_LOAD_OP_LOAD
+                                 ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                 : VK_IMAGE_LAYOUT_UNDEFINED;
+  attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(attachment);
+  description.subpasses.push_back(subpass);
+  return description;
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, RenderPassCache) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanRenderPassCache* cache = GetDeviceQueue()->GetRenderPassCache();
+
+  const VulkanRenderPassDescription clear = ColorDescription(
+      VK_FORMAT_R8G8B8A8_UNORM, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  VkRenderPass render_pass = cache->Acquire(clear);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass);
+  EXPECT_EQ(render_pass, cache->Acquire(clear));
+  EXPECT_EQ(1u, cache->hits());
+  EXPECT_EQ(1u, cache->misses());
+  EXPECT_EQ(render_pass, cache->GetCompatible(render_pass));
+
+  // Loading instead of clearing is another render pass, but a compatible
+  // one.
+  const VulkanRenderPassDescription load = ColorDescription(
+      VK_FORMAT_R8G8B8A8_UNORM, VK_ATTACHMENT_LOAD_OP_LOAD);
+  EXPECT_FALSE(load == clear);
+  EXPECT_TRUE(load.IsCompatibleWith(clear));
+  VkRenderPass load_render_pass = cache->Acquire(load);
+  ASSERT_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE), load_render_pass);
+  EXPECT_NE(render_pass, load_render_pass);
+  EXPECT_EQ(render_pass, cache->GetCompatible(load_render_pass));
+
+  // Another format isn't compatible.
+  const VulkanRenderPassDescription other_format = ColorDescription(
+      VK_FORMAT_B8G8R8A8_UNORM, VK_ATTACHMENT_LOAD_OP_CLEAR);
+  EXPECT_FALSE(other_format.IsCompatibleWith(clear));
+  VkRenderPass other_render_pass = cache->Acquire(other_format);
+  EXPECT_EQ(other_render_pass, cache->GetCompatible(other_render_pass));
+  EXPECT_EQ(3u, cache->size());
+
+  cache->Release(other_render_pass);
+  EXPECT_EQ(2u, cache->size());
+
+  // Both references to |render_pass| are gone, but the compatible render
+  // pass keeps it alive.
+  cache->Release(render_pass);
+  cache->Release(render_pass);
+  EXPECT_EQ(2u, cache->size());
+  EXPECT_EQ(render_pass, cache->GetCompatible(load_render_pass));
+
+  cache->Release(load_render_pass);
+  EXPECT_EQ(0u, cache->size());
+}
+
+}  // namespace gpu
@@ -0,0 +1,140 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <algorithm>
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_memory_allocator.h"
+#include "../vulkan/vulkan_ring_buffer.h"
+
+// This file tests the per-frame regions of VulkanRingBuffer, the alignment
+// of its allocations and the ranges it flushes.
+namespace gpu {
+
+namespace {
+
+const uint32_t kFrameCount = 3;
+const VkDeviceSize kBytesPerFrame = 1000;
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, RingBufferRegions) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  const VkPhysicalDeviceLimits& limits =
+      device_queue->GetPhysicalDeviceProperties().limits;
+
+  VulkanRingBuffer ring_buffer(device_queue);
+  ASSERT_TRUE(ring_buffer.Initialize(kBytesPerFrame, kFrameCount,
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT));
+  EXPECT_EQ(0u, ring_buffer.alignment() %
+                    std::max<VkDeviceSize>(
+                        1, limits.minUniformBufferOffsetAlignment));
+  EXPECT_GE(ring_buffer.bytes_per_frame(), kBytesPerFrame);
+  EXPECT_EQ(0u, ring_buffer.bytes_per_frame() % ring_buffer.alignment());
+  ASSERT_NE(nullptr, ring_buffer.allocation().mapped_data);
+
+  // Each frame allocates from its own region, aligned for uniform buffers,
+  // and the regions come around again after |kFrameCount| frames.
+  for (uint32_t frame = 0; frame < 2 * kFrameCount; ++frame) {
+    const uint32_t frame_index = frame % kFrameCount;
+    const VkDeviceSize region_begin =
+        ring_buffer.bytes_per_frame() * frame_index;
+    ASSERT_TRUE(ring_buffer.BeginFrame(frame_index, nullptr, 0));
+
+    VkDeviceSize offset = 0;
+    void* data = ring_buffer.Allocate(3, &offset);
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(region_begin, offset);
+    EXPECT_EQ(static_cast<uint8_t*>(ring_buffer.allocation().mapped_data) +
+                  offset,
+              data);
+    ASSERT_NE(nullptr, ring_buffer.Allocate(3, &offset));
+    EXPECT_EQ(region_begin + ring_buffer.alignment(), offset);
+    EXPECT_EQ(0u, offset % ring_buffer.alignment());
+    EXPECT_TRUE(ring_buffer.EndFrame());
+  }
+  EXPECT_EQ(ring_buffer.alignment() + 3, ring_buffer.peak_bytes_used());
+
+  // A frame can't spill into the next region.
+  ASSERT_TRUE(ring_buffer.BeginFrame(0, nullptr, 0));
+  VkDeviceSize offset = 0;
+  ASSERT_NE(nullptr,
+            ring_buffer.Allocate(ring_buffer.bytes_per_frame(), &offset));
+  EXPECT_EQ(nullptr, ring_buffer.Allocate(1, &offset));
+  EXPECT_TRUE(ring_buffer.EndFrame());
+  EXPECT_EQ(ring_buffer.bytes_per_frame(), ring_buffer.peak_bytes_used());
+
+  ring_buffer.Destroy();
+}
+
+TEST_F(BasicVulkanTest, RingBufferFlushRange) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  const VkDeviceSize atom_size = std::max<VkDeviceSize>(
+      1,
+      device_queue->GetPhysicalDeviceProperties().limits.nonCoherentAtomSize);
+
+  VulkanRingBuffer ring_buffer(device_queue);
+  ASSERT_TRUE(ring_buffer.Initialize(kBytesPerFrame, kFrameCount,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
+  const VulkanMemoryAllocation& allocation = ring_buffer.allocation();
+  const bool coherent =
+      device_queue->GetMemoryAllocator()->IsCoherent(allocation);
+  const VkDeviceSize bytes_per_frame = ring_buffer.bytes_per_frame();
+
+  // Regions start on atom boundaries in the memory object.
+  EXPECT_EQ(0u, bytes_per_frame % atom_size);
+  if (!coherent)
+    EXPECT_EQ(0u, allocation.offset % atom_size);
+
+  // Fill the last region, then wrap around to the first one with a smaller
+  // frame. Each EndFrame() flushes exactly what its own frame wrote.
+  for (uint32_t frame = 0; frame <= kFrameCount; ++frame) {
+    const uint32_t frame_index = frame % kFrameCount;
+    const VkDeviceSize region_begin = bytes_per_frame * frame_index;
+    ASSERT_TRUE(ring_buffer.BeginFrame(frame_index, nullptr, 0));
+    VkDeviceSize first_offset = 0;
+    VkDeviceSize last_offset = 0;
+    const VkDeviceSize last_size = frame_index ? 5 : 1;
+    ASSERT_NE(nullptr, ring_buffer.Allocate(7, &first_offset));
+    ASSERT_NE(nullptr, ring_buffer.Allocate(last_size, &last_offset));
+    EXPECT_TRUE(ring_buffer.EndFrame());
+
+    EXPECT_EQ(region_begin, first_offset);
+    EXPECT_EQ(first_offset, ring_buffer.last_flush_offset());
+    EXPECT_EQ(last_offset + last_size - first_offset,
+              ring_buffer.last_flush_size());
+    if (coherent)
+      continue;
+
+    // Rounded out to whole atoms, the flush still stays inside the region,
+    // so it never touches a frame the GPU may be reading.
+    VkDeviceSize flush_offset = 0;
+    VkDeviceSize flush_size = 0;
+    VulkanMemoryAllocator::GetFlushRange(
+        allocation.offset + ring_buffer.last_flush_offset(),
+        ring_buffer.last_flush_size(), VK_WHOLE_SIZE, atom_size,
+        &flush_offset, &flush_size);
+    EXPECT_EQ(allocation.offset + region_begin, flush_offset);
+    EXPECT_LE(flush_offset + flush_size,
+              allocation.offset + region_begin + bytes_per_frame);
+  }
+
+  // A frame that wrote nothing flushes nothing.
+  ASSERT_TRUE(ring_buffer.BeginFrame(1, nullptr, 0));
+  EXPECT_TRUE(ring_buffer.EndFrame());
+  EXPECT_EQ(bytes_per_frame, ring_buffer.last_flush_offset());
+  EXPECT_EQ(0u, ring_buffer.last_flush_size());
+
+  ring_buffer.Destroy();
+}
+
+}  // namespace gpu
@@ -0,0 +1,149 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_frame_command_allocator.h"
+#include "../vulkan/vulkan_submit_batch.h"
+
+// This file tests coalescing submissions into one vkQueueSubmit().
+namespace gpu {
+
+namespace {
+
+// Fills |command_buffers| with empty, ended command buffers from
+// |allocator|'s current frame.
+bool RecordEmptyCommandBuffers(VulkanFrameCommandAllocator* allocator,
+                               size_t count,
+                               VkCommandBuffer* command_buffers) {
+  for (size_t i = 0; i < count; ++i) {
+    command_buffers[i] = allocator->AllocatePrimary();
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffers[i], &begin_info) != VK_SUCCESS ||
+        vkEndCommandBuffer(command_buffers[i]) != VK_SUCCESS) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, SubmitBatchCoalescesSubmissions) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+
+  VulkanFrameCommandAllocator allocator(GetDeviceQueue(), 1);
+  ASSERT_TRUE(allocator.Initialize());
+  ASSERT_TRUE(allocator.BeginFrame(0));
+  VkCommandBuffer command_buffers[4];
+  ASSERT_TRUE(RecordEmptyCommandBuffers(&allocator, 4, command_buffers));
+
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS, vkCreateSemaphore(device, &semaphore_create_info,
+                                          nullptr, &semaphore));
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS,
+            vkCreateFence(device, &fence_create_info, nullptr, &fence));
+
+  VulkanSubmitBatch* batch = GetDeviceQueue()->GetSubmitBatch();
+  EXPECT_TRUE(batch->empty());
+  const VkPipelineStageFlags kWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+  // A signal ends a VkSubmitInfo and a wait starts one. Plain command
+  // buffers join the current one.
+  batch->Add(1, &command_buffers[0], 0, nullptr, nullptr, 1, &semaphore);
+  EXPECT_EQ(1u, batch->num_pending_submit_infos());
+  batch->Add(1, &command_buffers[1], 1, &semaphore, &kWaitStage);
+  EXPECT_EQ(2u, batch->num_pending_submit_infos());
+  batch->Add(command_buffers[2]);
+  batch->Add(command_buffers[3]);
+  EXPECT_EQ(2u, batch->num_pending_submit_infos());
+
+  GetDeviceQueue()->EndFrame();
+  ASSERT_TRUE(batch->Flush(fence));
+  EXPECT_TRUE(batch->empty());
+  EXPECT_EQ(VK_SUCCESS, vkWaitForFences(device, 1, &fence, VK_TRUE,
+                                        UINT64_MAX));
+
+  const VulkanDeviceQueue::SubmitCounters& counters =
+      GetDeviceQueue()->GetFrameSubmitCounters();
+  EXPECT_EQ(1u, counters.queue_submits);
+  EXPECT_EQ(2u, counters.submit_infos);
+  EXPECT_EQ(4u, counters.command_buffers);
+
+  GetDeviceQueue()->EndFrame();
+  EXPECT_EQ(1u, GetDeviceQueue()->GetLastFrameSubmitCounters().queue_submits);
+  EXPECT_EQ(0u, GetDeviceQueue()->GetFrameSubmitCounters().queue_submits);
+
+  vkDestroyFence(device, fence, nullptr);
+  vkDestroySemaphore(device, semaphore, nullptr);
+  allocator.Destroy();
+}
+
+TEST_F(BasicVulkanTest, SubmitBatchMergesWaits) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+
+  VulkanFrameCommandAllocator allocator(GetDeviceQueue(), 1);
+  ASSERT_TRUE(allocator.Initialize());
+  ASSERT_TRUE(allocator.BeginFrame(0));
+  VkCommandBuffer command_buffers[3];
+  ASSERT_TRUE(RecordEmptyCommandBuffers(&allocator, 3, command_buffers));
+
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkSemaphore semaphores[3];
+  for (VkSemaphore& semaphore : semaphores) {
+    ASSERT_EQ(VK_SUCCESS, vkCreateSemaphore(device, &semaphore_create_info,
+                                            nullptr, &semaphore));
+  }
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence = VK_NULL_HANDLE;
+  ASSERT_EQ(VK_SUCCESS,
+            vkCreateFence(device, &fence_create_info, nullptr, &fence));
+
+  VulkanSubmitBatch* batch = GetDeviceQueue()->GetSubmitBatch();
+  const VkPipelineStageFlags kWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  batch->Add(1, &command_buffers[0], 0, nullptr, nullptr, 3, semaphores);
+  EXPECT_EQ(1u, batch->num_pending_submit_infos());
+
+  // Waits added one by one before any command buffer share a VkSubmitInfo
+  // with the command buffers that follow them.
+  batch->Add(0, nullptr, 1, &semaphores[0], &kWaitStage);
+  EXPECT_EQ(2u, batch->num_pending_submit_infos());
+  batch->Add(0, nullptr, 1, &semaphores[1], &kWaitStage);
+  EXPECT_EQ(2u, batch->num_pending_submit_infos());
+  batch->Add(command_buffers[1]);
+  EXPECT_EQ(2u, batch->num_pending_submit_infos());
+
+  // Once it has command buffers, a wait starts a new one again.
+  batch->Add(1, &command_buffers[2], 1, &semaphores[2], &kWaitStage);
+  EXPECT_EQ(3u, batch->num_pending_submit_infos());
+
+  GetDeviceQueue()->EndFrame();
+  ASSERT_TRUE(batch->Flush(fence));
+  EXPECT_EQ(VK_SUCCESS, vkWaitForFences(device, 1, &fence, VK_TRUE,
+                                        UINT64_MAX));
+  EXPECT_EQ(3u, GetDeviceQueue()->GetFrameSubmitCounters().submit_infos);
+
+  vkDestroyFence(device, fence, nullptr);
+  for (VkSemaphore semaphore : semaphores)
+    vkDestroySemaphore(device, semaphore, nullptr);
+  allocator.Destroy();
+}
+
+}  // namespace gpu
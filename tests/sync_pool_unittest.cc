@@ -0,0 +1,78 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_submit_batch.h"
+#include "../vulkan/vulkan_sync_pool.h"
+#include "../vulkan/vulkan_timeline.h"
+
+// This file tests that the fence and semaphore pools hand out reset objects
+// and recycle them instead of creating new ones.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, FencePoolRecyclesSignaledFences) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VkDevice device = GetDeviceQueue()->GetVulkanDevice();
+  VulkanFencePool* fence_pool = GetDeviceQueue()->GetFencePool();
+  const uint64_t misses = fence_pool->misses();
+  const uint64_t hits = fence_pool->hits();
+
+  VkFence fence = fence_pool->Acquire();
+  ASSERT_NE(static_cast<VkFence>(VK_NULL_HANDLE), fence);
+  EXPECT_EQ(VK_NOT_READY, vkGetFenceStatus(device, fence));
+  EXPECT_EQ(misses + 1, fence_pool->misses());
+
+  // Signal the fence with an empty submission before handing it back.
+  VulkanSubmitBatch* submit_batch = GetDeviceQueue()->GetSubmitBatch();
+  ASSERT_TRUE(submit_batch->Flush(fence));
+  ASSERT_EQ(VK_SUCCESS,
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+  fence_pool->Release(fence);
+
+  VkFence recycled = fence_pool->Acquire();
+  EXPECT_EQ(fence, recycled);
+  EXPECT_EQ(hits + 1, fence_pool->hits());
+  EXPECT_EQ(misses + 1, fence_pool->misses());
+  EXPECT_EQ(VK_NOT_READY, vkGetFenceStatus(device, recycled));
+  fence_pool->Release(recycled);
+}
+
+TEST_F(BasicVulkanTest, SemaphorePoolWaitsForTimeline) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  VulkanSemaphorePool* semaphore_pool = device_queue->GetSemaphorePool();
+  VulkanTimeline* timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+  ASSERT_TRUE(timeline);
+  const uint64_t misses = semaphore_pool->misses();
+
+  VkSemaphore first = semaphore_pool->Acquire();
+  ASSERT_NE(static_cast<VkSemaphore>(VK_NULL_HANDLE), first);
+  // Not reusable before the timeline reaches the next value.
+  semaphore_pool->Release(first, timeline,
+                          timeline->last_submitted_value() + 1);
+  EXPECT_EQ(1u, semaphore_pool->num_pending());
+
+  VkSemaphore second = semaphore_pool->Acquire();
+  EXPECT_NE(first, second);
+  EXPECT_EQ(misses + 2, semaphore_pool->misses());
+
+  ASSERT_TRUE(timeline->Wait(timeline->Signal()));
+  VkSemaphore recycled = semaphore_pool->Acquire();
+  EXPECT_EQ(first, recycled);
+  EXPECT_EQ(misses + 2, semaphore_pool->misses());
+  EXPECT_EQ(0u, semaphore_pool->num_pending());
+
+  semaphore_pool->Release(second);
+  semaphore_pool->Release(recycled);
+  EXPECT_LE(2u, semaphore_pool->num_free());
+}
+
+}  // namespace gpu
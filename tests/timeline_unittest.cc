@@ -0,0 +1,119 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <memory>
+
+#include "../vulkan/vulkan_command_buffer.h"
+#include "../vulkan/vulkan_command_pool.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_submit_batch.h"
+#include "../vulkan/vulkan_timeline.h"
+
+// This file tests the per-queue timelines, with timeline semaphores when
+// the device supports them and with the fence fallback.
+namespace gpu {
+
+namespace {
+
+void ExpectTimelineCountsSubmissions(VulkanTimeline* timeline) {
+  const uint64_t start = timeline->last_submitted_value();
+  uint64_t first = timeline->Signal();
+  uint64_t second = timeline->Signal();
+  EXPECT_EQ(start + 1, first);
+  EXPECT_EQ(start + 2, second);
+  EXPECT_EQ(second, timeline->last_submitted_value());
+
+  // Reaching a value implies every earlier one.
+  EXPECT_TRUE(timeline->Wait(second));
+  EXPECT_TRUE(timeline->IsComplete(first));
+  EXPECT_EQ(second, timeline->GetCompletedValue());
+}
+
+}  // namespace
+
+TEST_F(BasicVulkanTest, QueueTimelines) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+  VulkanTimeline* graphics_timeline =
+      device_queue->GetTimeline(device_queue->GetGraphicsQueue());
+  ASSERT_TRUE(graphics_timeline);
+  EXPECT_EQ(device_queue->SupportsTimelineSemaphores(),
+            graphics_timeline->uses_timeline_semaphore());
+  ExpectTimelineCountsSubmissions(graphics_timeline);
+
+  // Work on the graphics queue waits for a value of the transfer queue.
+  VulkanTimeline* transfer_timeline =
+      device_queue->GetTimeline(device_queue->GetTransferQueue());
+  ASSERT_TRUE(transfer_timeline);
+  uint64_t transfer_value = transfer_timeline->Signal();
+  ASSERT_NE(0u, transfer_value);
+  VulkanSubmitBatch* submit_batch = device_queue->GetSubmitBatch();
+  EXPECT_TRUE(transfer_timeline->AddWait(submit_batch, transfer_value,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT));
+  uint64_t graphics_value = graphics_timeline->Flush(submit_batch);
+  ASSERT_NE(0u, graphics_value);
+  EXPECT_TRUE(graphics_timeline->Wait(graphics_value));
+  EXPECT_TRUE(transfer_timeline->IsComplete(transfer_value));
+}
+
+TEST_F(BasicVulkanTest, QueueTimelineFenceFallback) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  VulkanTimeline timeline(GetDeviceQueue(),
+                          GetDeviceQueue()->GetGraphicsQueue(), false);
+  ASSERT_TRUE(timeline.Initialize());
+  EXPECT_FALSE(timeline.uses_timeline_semaphore());
+  EXPECT_EQ(static_cast<VkSemaphore>(VK_NULL_HANDLE), timeline.semaphore());
+
+  ExpectTimelineCountsSubmissions(&timeline);
+  // Fences are recycled once their value is reached.
+  ExpectTimelineCountsSubmissions(&timeline);
+
+  timeline.Destroy();
+}
+
+TEST_F(BasicVulkanTest, CommandBufferSubmitSignalsTimeline) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+
+  std::unique_ptr<VulkanCommandPool> command_pool =
+      device_queue->CreateCommandPool(
+          nullptr, 0, device_queue->GetGraphicsQueueFamilyIndex());
+  ASSERT_TRUE(command_pool);
+  std::unique_ptr<VulkanCommandBuffer> command_buffer =
+      command_pool->CreatePrimaryCommandBuffer();
+  ASSERT_TRUE(command_buffer);
+  EXPECT_TRUE(command_buffer->SubmissionFinished());
+
+  VulkanTimeline* timeline = device_queue->GetTimeline(command_pool->queue());
+  ASSERT_TRUE(timeline);
+  for (int i = 0; i < 2; ++i) {
+    { ScopedSingleUseCommandBufferRecorder recorder(*command_buffer); }
+    const uint64_t queue_submits =
+        device_queue->GetFrameSubmitCounters().queue_submits;
+    ASSERT_TRUE(command_buffer->Submit(0, nullptr, 0, nullptr));
+    // The timeline is signaled by the command buffer's own submission.
+    EXPECT_EQ(queue_submits + 1,
+              device_queue->GetFrameSubmitCounters().queue_submits);
+    EXPECT_EQ(timeline, command_buffer->timeline());
+    EXPECT_EQ(timeline->last_submitted_value(),
+              command_buffer->timeline_value());
+    command_buffer->Wait(UINT64_MAX);
+    EXPECT_TRUE(command_buffer->SubmissionFinished());
+  }
+
+  command_buffer->Destroy();
+  command_pool->Destroy();
+}
+
+}  // namespace gpu
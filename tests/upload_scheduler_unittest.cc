@@ -0,0 +1,86 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "basic_vulkan_test.h"
+
+#include <vector>
+
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_device_queue.h"
+#include "../vulkan/vulkan_upload_scheduler.h"
+
+// This file tests uploads through the transfer queue.
+namespace gpu {
+
+TEST_F(BasicVulkanTest, TransferQueueFamily) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+  VulkanDeviceQueue* device_queue = GetDeviceQueue();
+  EXPECT_NE(UINT32_MAX, device_queue->GetTransferQueueFamilyIndex());
+  EXPECT_NE(static_cast<VkQueue>(VK_NULL_HANDLE),
+            device_queue->GetTransferQueue());
+  EXPECT_EQ(device_queue->GetTransferQueue(),
+            device_queue->GetQueueForFamily(
+                device_queue->GetTransferQueueFamilyIndex()));
+  if (!device_queue->HasDedicatedTransferQueue()) {
+    EXPECT_EQ(device_queue->GetGraphicsQueue(),
+              device_queue->GetTransferQueue());
+  }
+}
+
+TEST_F(BasicVulkanTest, UploadScheduler) {
+  ASSERT_TRUE(GetDeviceQueue()->Initialize(
+      VulkanDeviceQueue::GRAPHICS_QUEUE_FLAG |
+      VulkanDeviceQueue::PRESENTATION_SUPPORT_QUEUE_FLAG));
+
+  const uint32_t kCount = 64 * 1024;
+  std::vector<uint32_t> data(kCount);
+  for (uint32_t i = 0; i < kCount; ++i)
+    data[i] = i;
+
+  VulkanBuffer buffers[2];
+  for (VulkanBuffer& buffer : buffers) {
+    ASSERT_TRUE(buffer.Initialize(GetDeviceQueue(),
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                  data.data(), data.size() * sizeof(uint32_t),
+                                  VulkanBuffer::MEMORY_MODE_DEVICE_LOCAL));
+  }
+
+  VulkanUploadScheduler scheduler(GetDeviceQueue());
+  ASSERT_TRUE(scheduler.Initialize());
+  EXPECT_EQ(GetDeviceQueue()->HasDedicatedTransferQueue(),
+            scheduler.HasDedicatedTransferQueue());
+
+  // Nothing flushed yet.
+  EXPECT_EQ(0u, scheduler.Flush());
+  EXPECT_FALSE(scheduler.IsTransferComplete(1));
+
+  VulkanUploadScheduler::Ticket tickets[2];
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(scheduler.Upload(
+        *buffers[i].handle(), 0, data.data(), buffers[i].size(),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT));
+    EXPECT_EQ(1u, scheduler.num_pending_uploads());
+    tickets[i] = scheduler.Flush();
+    EXPECT_EQ(i + 1, tickets[i]);
+    EXPECT_EQ(0u, scheduler.num_pending_uploads());
+  }
+  EXPECT_EQ(tickets[1], scheduler.Flush());
+
+  // Acquiring the first batch leaves the second one to its transfer.
+  ASSERT_TRUE(scheduler.Acquire(tickets[0]));
+  EXPECT_GE(scheduler.num_batches_in_flight(), 1u);
+
+  scheduler.Finish();
+  EXPECT_TRUE(scheduler.IsTransferComplete(tickets[1]));
+  EXPECT_EQ(0u, scheduler.num_batches_in_flight());
+
+  scheduler.Destroy();
+  for (VulkanBuffer& buffer : buffers)
+    buffer.Destroy();
+}
+
+}  // namespace gpu
@@ -0,0 +1,110 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_vertex_format.h"
+
+// This file tests the packed vertex formats and compile-time vertex layouts.
+namespace gpu {
+
+namespace {
+
+struct PackedVertex {
+  Half4 position;
+  SNorm8x4 normal;
+  UNorm16x2 texcoord;
+};
+
+using PackedVertexLayout =
+    VulkanVertexLayout<PackedVertex,
+                       GPU_VERTEX_ATTRIBUTE(PackedVertex, position),
+                       GPU_VERTEX_ATTRIBUTE(PackedVertex, normal),
+                       GPU_VERTEX_ATTRIBUTE(PackedVertex, texcoord)>;
+
+// The whole layout is available at compile time.
+static_assert(PackedVertexLayout::kStride == 16, "Unexpected stride");
+static_assert(PackedVertexLayout::kAttributeCount == 3,
+              "Unexpected attribute count");
+constexpr PackedVertexLayout::AttributeArray kPackedAttributes =
+    PackedVertexLayout::Attributes(0, 1);
+static_assert(kPackedAttributes[0].location == 1 &&
+                  kPackedAttributes[0].format ==
+                      VK_FORMAT_R16G16B16A16_SFLOAT &&
+                  kPackedAttributes[0].offset == 0,
+              "Unexpected position attribute");
+static_assert(kPackedAttributes[1].location == 2 &&
+                  kPackedAttributes[1].format == VK_FORMAT_R8G8B8A8_SNORM &&
+                  kPackedAttributes[1].offset == 8,
+              "Unexpected normal attribute");
+static_assert(kPackedAttributes[2].location == 3 &&
+                  kPackedAttributes[2].format == VK_FORMAT_R16G16_UNORM &&
+                  kPackedAttributes[2].offset == 12,
+              "Unexpected texcoord attribute");
+
+}  // namespace
+
+TEST(VertexFormatTest, HalfRoundTrip) {
+  const float kExact[] = {0.0f, 1.0f, -1.0f, 0.5f, 2048.0f, 65504.0f};
+  for (float value : kExact)
+    EXPECT_EQ(value, HalfToFloat(FloatToHalf(value)));
+
+  EXPECT_EQ(0x3c00, FloatToHalf(1.0f));
+  EXPECT_EQ(0xc000, FloatToHalf(-2.0f));
+  EXPECT_EQ(0x8000, FloatToHalf(-0.0f));
+
+  // Smallest denormal half.
+  EXPECT_EQ(0x0001, FloatToHalf(5.96046448e-8f));
+  EXPECT_FLOAT_EQ(5.96046448e-8f, HalfToFloat(0x0001));
+}
+
+TEST(VertexFormatTest, HalfRounding) {
+  // 2049 is halfway between 2048 and 2050 and rounds to the even mantissa.
+  EXPECT_EQ(2048.0f, HalfToFloat(FloatToHalf(2049.0f)));
+  EXPECT_EQ(2052.0f, HalfToFloat(FloatToHalf(2051.0f)));
+  EXPECT_EQ(0.333251953f, HalfToFloat(FloatToHalf(1.0f / 3.0f)));
+
+  // Out of range values turn into infinity.
+  EXPECT_EQ(0x7c00, FloatToHalf(65520.0f));
+  EXPECT_EQ(0xfc00, FloatToHalf(-1e10f));
+  EXPECT_EQ(0, FloatToHalf(1e-10f));
+}
+
+TEST(VertexFormatTest, NormalizedIntegers) {
+  UNorm8x4 color = PackUNorm8x4(0.0f, 1.0f, 0.5f, 2.0f);
+  EXPECT_EQ(0, color.x);
+  EXPECT_EQ(255, color.y);
+  EXPECT_EQ(128, color.z);
+  EXPECT_EQ(255, color.w);
+
+  SNorm8x4 normal = PackSNorm8x4(-1.0f, 1.0f, 0.0f, -2.0f);
+  EXPECT_EQ(-127, normal.x);
+  EXPECT_EQ(127, normal.y);
+  EXPECT_EQ(0, normal.z);
+  EXPECT_EQ(-127, normal.w);
+
+  UNorm16x2 texcoord = PackUNorm16x2(0.25f, -1.0f);
+  EXPECT_EQ(16384, texcoord.x);
+  EXPECT_EQ(0, texcoord.y);
+}
+
+TEST(VertexFormatTest, DescribeMatchesVertexData) {
+  // The layout replacing VulkanRenderPass' hardcoded vertex input.
+  VulkanVertexInput input = VulkanBuffer::VertexDataLayout::Describe();
+  ASSERT_EQ(1u, input.bindings.size());
+  EXPECT_EQ(0u, input.bindings[0].binding);
+  EXPECT_EQ(sizeof(VulkanBuffer::VertexData), input.bindings[0].stride);
+  EXPECT_EQ(VK_VERTEX_INPUT_RATE_VERTEX, input.bindings[0].inputRate);
+
+  ASSERT_EQ(2u, input.attributes.size());
+  EXPECT_EQ(0u, input.attributes[0].location);
+  EXPECT_EQ(VK_FORMAT_R32G32B32A32_SFLOAT, input.attributes[0].format);
+  EXPECT_EQ(0u, input.attributes[0].offset);
+  EXPECT_EQ(1u, input.attributes[1].location);
+  EXPECT_EQ(VK_FORMAT_R32G32B32A32_SFLOAT, input.attributes[1].format);
+  EXPECT_EQ(4 * sizeof(float), input.attributes[1].offset);
+}
+
+}  // namespace gpu
@@ -609,6 +609,7 @@ TEST_F(BasicVulkanTest, BasicVulkanSurface3) {
 
   render_pass.Destroy();
   surface->Destroy();
+  vertexBuffer.Destroy();
 }
 
 }  // namespace gpu
@@ -1,30 +1,61 @@
 #include "vulkan_buffer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <vector>
 
+#include "base/logging.h"
+
+#include "vulkan_deletion_queue.h"
 #include "vulkan_device_queue.h"
+#include "vulkan_upload_batch.h"
 
 namespace gpu {
 
 VulkanBuffer::VulkanBuffer()
-    : device_(VK_NULL_HANDLE),
+    : device_queue_(nullptr),
+      device_(VK_NULL_HANDLE),
       handle_(VK_NULL_HANDLE),
-      memory_(VK_NULL_HANDLE) {}
+      memory_mode_(MEMORY_MODE_HOST_VISIBLE),
+      index_type_(VK_INDEX_TYPE_UINT16),
+      index_count_(0) {}
 
 VulkanBuffer::~VulkanBuffer() {}
 
 bool VulkanBuffer::Initialize(VulkanDeviceQueue* device_queue,
-                              VertexData* vertex_data, uint32_t num_vertics) {
+                              VertexData* vertex_data, uint32_t num_vertics,
+                              MemoryMode memory_mode,
+                              VulkanUploadBatch* upload_batch) {
+  return Initialize(device_queue, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                    vertex_data, sizeof(*vertex_data) * num_vertics,
+                    memory_mode, upload_batch);
+}
+
+bool VulkanBuffer::Initialize(VulkanDeviceQueue* device_queue,
+                              VkBufferUsageFlags usage,
+                              const void* data,
+                              VkDeviceSize size,
+                              MemoryMode memory_mode,
+                              VulkanUploadBatch* upload_batch) {
+  device_queue_ = device_queue;
+  memory_mode_ = memory_mode;
   device_ = device_queue->GetVulkanDevice();
-  size_ = sizeof(*vertex_data) * num_vertics;
-  printf(" Vertext size=%d\n", size_);
+  size_ = size;
+
+  VulkanMemoryUsage memory_usage = VulkanMemoryUsage::DIRECT_WRITE;
+  if (memory_mode_ == MEMORY_MODE_DEVICE_LOCAL) {
+    usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    memory_usage = VulkanMemoryUsage::GPU_ONLY;
+  }
 
   VkBufferCreateInfo buffer_create_info = {
       VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // VkStructureType
       nullptr,                               // const void *pNext
       0,                                     // VkBufferCreateFlags
       size_,                                 // VkDeviceSize
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,     // VkBufferUsageFlags
+      usage,                                 // VkBufferUsageFlags
       VK_SHARING_MODE_EXCLUSIVE,             // VkSharingMode
       0,                                     // uint32_t queueFamilyIndexCount
       nullptr  // const uint32_t *pQueueFamilyIndices
@@ -36,65 +67,114 @@ bool VulkanBuffer::Initialize(VulkanDeviceQueue* device_queue,
     return false;
   }
 
-  if (!AllocateBufferMemory(device_queue->GetVulkanPhysicalDevice())) {
+  if (!AllocateBufferMemory(memory_usage)) {
     std::cout << "Could not allocate memory for a vertex buffer!" << std::endl;
     return false;
   }
 
-  if (vkBindBufferMemory(device_, handle_, memory_, 0) != VK_SUCCESS) {
+  if (vkBindBufferMemory(device_, handle_, allocation_.memory,
+                         allocation_.offset) != VK_SUCCESS) {
     std::cout << "Could not bind memory for a vertex buffer!" << std::endl;
     return false;
   }
 
-  void* vertex_buffer_memory_pointer; 
-  if (vkMapMemory(device_, memory_, 0, size_, 0,
-                  &vertex_buffer_memory_pointer) != VK_SUCCESS) {
-    std::cout << "Could not map memory and upload data to a vertex buffer!"
-              << std::endl;
+  if (memory_mode_ == MEMORY_MODE_DEVICE_LOCAL) {
+    if (!UploadToDeviceLocal(data, upload_batch)) {
+      std::cout << "Could not upload data to a vertex buffer!" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // The allocator keeps host visible blocks mapped, so there is no
+  // vkMapMemory()/vkUnmapMemory() pair per upload.
+  memcpy(allocation_.mapped_data, data, size_);
+
+  if (!device_queue_->GetMemoryAllocator()->Flush(allocation_)) {
+    std::cout << "Could not flush memory of a vertex buffer!" << std::endl;
     return false;
   }
 
-  memcpy(vertex_buffer_memory_pointer, vertex_data, size_);
+  return true;
+}
 
-  VkMappedMemoryRange flush_range = {
-      VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,  // VkStructureType
-      nullptr,                                // const void            *pNext
-      memory_,                                // VkDeviceMemory         memory
-      0,                                      // VkDeviceSize           offset
-      VK_WHOLE_SIZE                           // VkDeviceSize           size
-  };
+bool VulkanBuffer::InitializeIndices(VulkanDeviceQueue* device_queue,
+                                     const uint16_t* indices,
+                                     uint32_t num_indices,
+                                     MemoryMode memory_mode,
+                                     VulkanUploadBatch* upload_batch) {
+  index_type_ = VK_INDEX_TYPE_UINT16;
+  index_count_ = num_indices;
+  return Initialize(device_queue, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices,
+                    sizeof(uint16_t) * num_indices, memory_mode, upload_batch);
+}
 
-  vkFlushMappedMemoryRanges(device_, 1, &flush_range);
-  vkUnmapMemory(device_, memory_);
+bool VulkanBuffer::InitializeIndices(VulkanDeviceQueue* device_queue,
+                                     const uint32_t* indices,
+                                     uint32_t num_indices,
+                                     MemoryMode memory_mode,
+                                     VulkanUploadBatch* upload_batch) {
+  uint32_t max_index =
+      num_indices ? *std::max_element(indices, indices + num_indices) : 0;
+  if (max_index <= std::numeric_limits<uint16_t>::max()) {
+    std::vector<uint16_t> short_indices(indices, indices + num_indices);
+    return InitializeIndices(device_queue, short_indices.data(), num_indices,
+                             memory_mode, upload_batch);
+  }
 
-  return true;
+  index_type_ = VK_INDEX_TYPE_UINT32;
+  index_count_ = num_indices;
+  return Initialize(device_queue, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices,
+                    sizeof(uint32_t) * num_indices, memory_mode, upload_batch);
+}
+
+void VulkanBuffer::BindIndexBuffer(VkCommandBuffer command_buffer) {
+  DCHECK_NE(static_cast<VkBuffer>(VK_NULL_HANDLE), handle_);
+  vkCmdBindIndexBuffer(command_buffer, handle_, 0, index_type_);
+}
+
+void VulkanBuffer::DrawIndexed(VkCommandBuffer command_buffer,
+                               uint32_t instance_count,
+                               int32_t vertex_offset) {
+  DCHECK_GT(index_count_, 0u);
+  vkCmdDrawIndexed(command_buffer, index_count_, instance_count, 0,
+                   vertex_offset, 0);
+}
+
+void VulkanBuffer::Destroy() {
+  if (!device_queue_)
+    return;
+  // Draws recorded with the buffer may still be in flight.
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  if (VK_NULL_HANDLE != handle_) {
+    deletion_queue->Enqueue(handle_);
+    handle_ = VK_NULL_HANDLE;
+  }
+  if (allocation_.IsValid()) {
+    deletion_queue->Enqueue(allocation_);
+    allocation_ = VulkanMemoryAllocation();
+  }
 }
 
-bool VulkanBuffer::AllocateBufferMemory(VkPhysicalDevice physical_device) {
+bool VulkanBuffer::UploadToDeviceLocal(const void* data,
+                                       VulkanUploadBatch* upload_batch) {
+  if (upload_batch)
+    return upload_batch->Upload(handle_, 0, data, size_);
+
+  VulkanUploadBatch local_batch(device_queue_);
+  bool result = local_batch.Initialize() &&
+                local_batch.Upload(handle_, 0, data, size_) &&
+                local_batch.Submit();
+  local_batch.Destroy();
+  return result;
+}
+
+bool VulkanBuffer::AllocateBufferMemory(VulkanMemoryUsage usage) {
   VkMemoryRequirements buffer_memory_requirements;
   vkGetBufferMemoryRequirements(device_, handle_, &buffer_memory_requirements);
 
-  VkPhysicalDeviceMemoryProperties memory_properties;
-  vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
-
-  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
-    if ((buffer_memory_requirements.memoryTypeBits & (1 << i)) &&
-        (memory_properties.memoryTypes[i].propertyFlags &
-         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) {
-      VkMemoryAllocateInfo memory_allocate_info = {
-          VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // VkStructureType sType
-          nullptr,                                 // const void  *pNext
-          buffer_memory_requirements.size,  // VkDeviceSize allocationSize
-          i                                 // uint32_t memoryTypeIndex
-      };
-
-      if (vkAllocateMemory(device_, &memory_allocate_info, nullptr, &memory_) ==
-          VK_SUCCESS) {
-        return true;
-      }
-    }
-  }
-  return false;
+  return device_queue_->GetMemoryAllocator()->Allocate(
+      buffer_memory_requirements, usage, true, &allocation_);
 }
 
 }  // namespace gpu
@@ -4,9 +4,13 @@
 
 #include <vulkan/vulkan.h>
 
+#include "vulkan_memory_allocator.h"
+#include "vulkan_vertex_format.h"
+
 namespace gpu {
 
 class VulkanDeviceQueue;
+class VulkanUploadBatch;
 
 class VulkanBuffer {
  public:
@@ -14,19 +18,93 @@ class VulkanBuffer {
     float x, y, z, w;
     float r, g, b, a;
   };
+  using VertexDataLayout = VulkanVertexLayout<
+      VertexData,
+      GPU_VERTEX_ATTRIBUTE_FORMAT(VertexData, x, VK_FORMAT_R32G32B32A32_SFLOAT),
+      GPU_VERTEX_ATTRIBUTE_FORMAT(VertexData,
+                                  r,
+                                  VK_FORMAT_R32G32B32A32_SFLOAT)>;
+
+  enum MemoryMode {
+    // Vertices are written straight into host visible memory. Cheap to
+    // update, but every vertex fetch may cross the PCIe bus on discrete GPUs.
+    MEMORY_MODE_HOST_VISIBLE,
+
+    // Vertices live in device local memory and are copied there from a
+    // staging buffer.
+    MEMORY_MODE_DEVICE_LOCAL,
+  };
 
   VulkanBuffer();
   ~VulkanBuffer();
-  bool Initialize(VulkanDeviceQueue*, VertexData*, uint32_t num_vertics);
+
+  // With MEMORY_MODE_DEVICE_LOCAL the copy is recorded into |upload_batch|
+  // and the buffer must not be drawn from before the batch is submitted. If
+  // no batch is given, the upload is submitted and waited for right away.
+  bool Initialize(VulkanDeviceQueue*,
+                  VertexData*,
+                  uint32_t num_vertics,
+                  MemoryMode memory_mode = MEMORY_MODE_HOST_VISIBLE,
+                  VulkanUploadBatch* upload_batch = nullptr);
+  // Creates a buffer for |usage| holding |size| bytes of |data|.
+  bool Initialize(VulkanDeviceQueue*,
+                  VkBufferUsageFlags usage,
+                  const void* data,
+                  VkDeviceSize size,
+                  MemoryMode memory_mode = MEMORY_MODE_HOST_VISIBLE,
+                  VulkanUploadBatch* upload_batch = nullptr);
+
+  // Vertex buffer of any vertex type, see vulkan_vertex_format.h.
+  template <typename Vertex>
+  bool InitializeVertices(VulkanDeviceQueue* device_queue,
+                          const Vertex* vertices,
+                          uint32_t num_vertices,
+                          MemoryMode memory_mode = MEMORY_MODE_HOST_VISIBLE,
+                          VulkanUploadBatch* upload_batch = nullptr) {
+    return Initialize(device_queue, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                      vertices, sizeof(Vertex) * num_vertices, memory_mode,
+                      upload_batch);
+  }
+
+  // Index buffers. 32-bit indices are stored as 16-bit ones when they all
+  // fit, halving the index fetch bandwidth.
+  bool InitializeIndices(VulkanDeviceQueue* device_queue,
+                         const uint16_t* indices,
+                         uint32_t num_indices,
+                         MemoryMode memory_mode = MEMORY_MODE_HOST_VISIBLE,
+                         VulkanUploadBatch* upload_batch = nullptr);
+  bool InitializeIndices(VulkanDeviceQueue* device_queue,
+                         const uint32_t* indices,
+                         uint32_t num_indices,
+                         MemoryMode memory_mode = MEMORY_MODE_HOST_VISIBLE,
+                         VulkanUploadBatch* upload_batch = nullptr);
+
+  // Records vkCmdBindIndexBuffer() and vkCmdDrawIndexed() of all indices for
+  // a buffer created by InitializeIndices().
+  void BindIndexBuffer(VkCommandBuffer command_buffer);
+  void DrawIndexed(VkCommandBuffer command_buffer,
+                   uint32_t instance_count = 1,
+                   int32_t vertex_offset = 0);
+
+  void Destroy();
   VkBuffer* handle() { return &handle_; }
+  VkDeviceSize size() const { return size_; }
+  MemoryMode memory_mode() const { return memory_mode_; }
+  VkIndexType index_type() const { return index_type_; }
+  uint32_t index_count() const { return index_count_; }
 
  private:
-  bool AllocateBufferMemory(VkPhysicalDevice physical_device);
+  bool AllocateBufferMemory(VulkanMemoryUsage usage);
+  bool UploadToDeviceLocal(const void* data, VulkanUploadBatch* upload_batch);
 
+  VulkanDeviceQueue* device_queue_;
   VkDevice device_;
   VkBuffer handle_;
-  VkDeviceMemory memory_;
-  uint32_t size_;
+  VulkanMemoryAllocation allocation_;
+  VkDeviceSize size_;
+  MemoryMode memory_mode_;
+  VkIndexType index_type_;
+  uint32_t index_count_;
 };
 
 }  // namespace gpu
@@ -4,10 +4,14 @@
 
 #include "vulkan_command_buffer.h"
 
+#include <vector>
+
 #include "base/logging.h"
 #include "vulkan_command_pool.h"
 #include "vulkan_device_queue.h"
 #include "vulkan_implementation.h"
+#include "vulkan_submit_batch.h"
+#include "vulkan_timeline.h"
 
 namespace gpu {
 
@@ -22,7 +26,6 @@ VulkanCommandBuffer::VulkanCommandBuffer(VulkanDeviceQueue* device_queue,
 
 VulkanCommandBuffer::~VulkanCommandBuffer() {
   DCHECK_EQ(static_cast<VkCommandBuffer>(VK_NULL_HANDLE), command_buffer_);
-  DCHECK_EQ(static_cast<VkFence>(VK_NULL_HANDLE), submission_fence_);
   DCHECK(!recording_);
   //command_pool_->DecrementCommandBufferCount();
 }
@@ -45,28 +48,15 @@ bool VulkanCommandBuffer::Initialize() {
     return false;
   }
 
-  VkFenceCreateInfo fence_create_info = {};
-  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  result =
-      vkCreateFence(device, &fence_create_info, nullptr, &submission_fence_);
-  if (VK_SUCCESS != result) {
-    DLOG(ERROR) << "vkCreateFence(submission) failed: " << result;
-    return false;
-  }
-
   record_type_ = RECORD_TYPE_EMPTY;
   return true;
 }
 
 void VulkanCommandBuffer::Destroy() {
   VkDevice device = device_queue_->GetVulkanDevice();
-  if (VK_NULL_HANDLE != submission_fence_) {
-    DCHECK(SubmissionFinished());
-    vkDestroyFence(device, submission_fence_, nullptr);
-    submission_fence_ = VK_NULL_HANDLE;
-  }
+  DCHECK(SubmissionFinished());
+  timeline_ = nullptr;
+  timeline_value_ = 0;
 
   if (VK_NULL_HANDLE != command_buffer_) {
     vkFreeCommandBuffers(device, command_pool_->handle(), 1, &command_buffer_);
@@ -77,35 +67,36 @@ void VulkanCommandBuffer::Destroy() {
 bool VulkanCommandBuffer::Submit(uint32_t num_wait_semaphores,
                                  VkSemaphore* wait_semaphores,
                                  uint32_t num_signal_semaphores,
-                                 VkSemaphore* signal_semaphores) {
+                                 VkSemaphore* signal_semaphores,
+                                 const VkPipelineStageFlags*
+                                     wait_dst_stage_masks) {
   DCHECK(primary_);
-  VkSubmitInfo submit_info = {};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffer_;
-  submit_info.waitSemaphoreCount = num_wait_semaphores;
-  submit_info.pWaitSemaphores = wait_semaphores;
-  submit_info.signalSemaphoreCount = num_signal_semaphores;
-  submit_info.pSignalSemaphores = signal_semaphores;
-
-  VkResult result = VK_SUCCESS;
-
-  result =
-      vkResetFences(device_queue_->GetVulkanDevice(), 1, &submission_fence_);
-  if (VK_SUCCESS != result) {
-    DLOG(ERROR) << "vkResetFences() failed: " << result;
-    return false;
+  std::vector<VkPipelineStageFlags> wait_dst_stage_mask(
+      num_wait_semaphores, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  if (wait_dst_stage_masks) {
+    wait_dst_stage_mask.assign(wait_dst_stage_masks,
+                               wait_dst_stage_masks + num_wait_semaphores);
   }
 
-  result = vkQueueSubmit(device_queue_->GetVulkanQueue(), 1, &submit_info,
-                         submission_fence_);
+  // The queue's timeline signals its next value in the same vkQueueSubmit(),
+  // and only falls back to a fence from the pool without timeline
+  // semaphores.
+  VulkanTimeline* timeline = device_queue_->GetTimeline(command_pool_->queue());
+  DCHECK(timeline);
+  VulkanSubmitBatch batch(device_queue_, command_pool_->queue());
+  batch.Add(1, &command_buffer_, num_wait_semaphores, wait_semaphores,
+            wait_dst_stage_mask.data(), num_signal_semaphores,
+            signal_semaphores);
+  const uint64_t value = timeline->Flush(&batch);
 
   PostExecution();
-  if (VK_SUCCESS != result) {
-    DLOG(ERROR) << "vkQueueSubmit() failed: " << result;
+  if (!value) {
+    DLOG(ERROR) << "Could not submit the command buffer.";
     return false;
   }
 
+  timeline_ = timeline;
+  timeline_value_ = value;
   return true;
 }
 
@@ -115,6 +106,22 @@ void VulkanCommandBuffer::Enqueue(VkCommandBuffer primary_command_buffer) {
   PostExecution();
 }
 
+// static
+void VulkanCommandBuffer::EnqueueAll(VkCommandBuffer primary_command_buffer,
+                                     VulkanCommandBuffer* const* secondaries,
+                                     uint32_t count) {
+  if (!count)
+    return;
+  std::vector<VkCommandBuffer> handles(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    DCHECK(!secondaries[i]->primary_);
+    handles[i] = secondaries[i]->command_buffer_;
+  }
+  vkCmdExecuteCommands(primary_command_buffer, count, handles.data());
+  for (uint32_t i = 0; i < count; ++i)
+    secondaries[i]->PostExecution();
+}
+
 void VulkanCommandBuffer::Clear() {
   // Mark to reset upon next use.
   if (record_type_ != RECORD_TYPE_EMPTY)
@@ -122,13 +129,12 @@ void VulkanCommandBuffer::Clear() {
 }
 
 void VulkanCommandBuffer::Wait(uint64_t timeout) {
-  VkDevice device = device_queue_->GetVulkanDevice();
-  vkWaitForFences(device, 1, &submission_fence_, true, timeout);
+  if (timeline_)
+    timeline_->Wait(timeline_value_, timeout);
 }
 
 bool VulkanCommandBuffer::SubmissionFinished() {
-  VkDevice device = device_queue_->GetVulkanDevice();
-  return VK_SUCCESS == vkGetFenceStatus(device, submission_fence_);
+  return !timeline_ || timeline_->IsComplete(timeline_value_);
 }
 
 void VulkanCommandBuffer::PostExecution() {
@@ -146,8 +152,7 @@ void VulkanCommandBuffer::ResetIfDirty() {
   if (record_type_ == RECORD_TYPE_DIRTY) {
     // Block if command buffer is still in use. This can be externally avoided
     // using the asynchronous SubmissionFinished() function.
-    VkDevice device = device_queue_->GetVulkanDevice();
-    vkWaitForFences(device, 1, &submission_fence_, true, UINT64_MAX);
+    Wait(UINT64_MAX);
     VkResult result = vkResetCommandBuffer(command_buffer_, 0);
     if (VK_SUCCESS != result) {
       DLOG(ERROR) << "vkResetCommandBuffer() failed: " << result;
@@ -191,4 +196,30 @@ ScopedSingleUseCommandBufferRecorder::ScopedSingleUseCommandBufferRecorder(
   }
 }
 
+ScopedSecondaryCommandBufferRecorder::ScopedSecondaryCommandBufferRecorder(
+    VulkanCommandBuffer& command_buffer,
+    VkRenderPass render_pass,
+    uint32_t subpass,
+    VkFramebuffer framebuffer)
+    : CommandBufferRecorderBase(command_buffer) {
+  ValidateSingleUse(command_buffer);
+  VkCommandBufferInheritanceInfo inheritance_info = {};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = render_pass;
+  inheritance_info.subpass = subpass;
+  inheritance_info.framebuffer = framebuffer;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (VK_NULL_HANDLE != render_pass)
+    begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+  VkResult result = vkBeginCommandBuffer(handle_, &begin_info);
+
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkBeginCommandBuffer() failed: " << result;
+  }
+}
+
 }  // namespace gpu
@@ -15,6 +15,7 @@ namespace gpu {
 
 class VulkanCommandPool;
 class VulkanDeviceQueue;
+class VulkanTimeline;
 
 class VULKAN_EXPORT VulkanCommandBuffer {
  public:
@@ -27,15 +28,24 @@ class VULKAN_EXPORT VulkanCommandBuffer {
   void Destroy();
   VkCommandBuffer handle() const { return command_buffer_; }
 
-  // Submit primary command buffer to the queue.
+  // Submit primary command buffer to the queue of its pool. Each wait
+  // semaphore blocks the matching stage of |wait_dst_stage_masks|, or the
+  // color attachment output stage when none are given.
   bool Submit(uint32_t num_wait_semaphores,
               VkSemaphore* wait_semaphores,
               uint32_t num_signal_semaphores,
-              VkSemaphore* signal_semaphores);
+              VkSemaphore* signal_semaphores,
+              const VkPipelineStageFlags* wait_dst_stage_masks = nullptr);
 
   // Enqueue secondary command buffer within a primary command buffer.
   void Enqueue(VkCommandBuffer primary_command_buffer);
 
+  // Enqueues |count| secondary command buffers with a single
+  // vkCmdExecuteCommands().
+  static void EnqueueAll(VkCommandBuffer primary_command_buffer,
+                         VulkanCommandBuffer* const* secondaries,
+                         uint32_t count);
+
   void Clear();
 
   // This blocks until the commands from the previous submit are done.
@@ -45,6 +55,11 @@ class VULKAN_EXPORT VulkanCommandBuffer {
   // is finished.
   bool SubmissionFinished();
 
+  // The timeline of the pool's queue and the value it reaches once the last
+  // Submit() has completed, or null before the first one.
+  VulkanTimeline* timeline() const { return timeline_; }
+  uint64_t timeline_value() const { return timeline_value_; }
+
  private:
   friend class CommandBufferRecorderBase;
 
@@ -75,7 +90,8 @@ class VULKAN_EXPORT VulkanCommandBuffer {
   VulkanDeviceQueue* device_queue_;
   VulkanCommandPool* command_pool_;
   VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
-  VkFence submission_fence_ = VK_NULL_HANDLE;
+  VulkanTimeline* timeline_ = nullptr;
+  uint64_t timeline_value_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(VulkanCommandBuffer);
 };
@@ -131,6 +147,23 @@ class VULKAN_EXPORT ScopedSingleUseCommandBufferRecorder
   DISALLOW_COPY_AND_ASSIGN(ScopedSingleUseCommandBufferRecorder);
 };
 
+// Records a secondary command buffer for single use. With a |render_pass|
+// the commands continue |subpass| of the primary command buffer they are
+// enqueued into, which must have begun it with
+// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. |framebuffer| is optional.
+class VULKAN_EXPORT ScopedSecondaryCommandBufferRecorder
+    : public CommandBufferRecorderBase {
+ public:
+  ScopedSecondaryCommandBufferRecorder(VulkanCommandBuffer& command_buffer,
+                                       VkRenderPass render_pass,
+                                       uint32_t subpass,
+                                       VkFramebuffer framebuffer);
+  ~ScopedSecondaryCommandBufferRecorder() override {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedSecondaryCommandBufferRecorder);
+};
+
 }  // namespace gpu
 
 #endif  // GPU_VULKAN_VULKAN_COMMAND_BUFFER_H_
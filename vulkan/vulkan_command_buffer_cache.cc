@@ -0,0 +1,103 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_command_buffer_cache.h"
+
+#include "base/logging.h"
+#include "vulkan_command_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+struct VulkanCommandBufferCache::Entry {
+  Key key;
+  std::unique_ptr<VulkanCommandBuffer> command_buffer;
+};
+
+VulkanCommandBufferCache::VulkanCommandBufferCache(
+    VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanCommandBufferCache::~VulkanCommandBufferCache() {
+  DCHECK(entries_.empty());
+  DCHECK(!command_pool_);
+}
+
+bool VulkanCommandBufferCache::Initialize() {
+  // Command buffers are reset one by one when they go stale.
+  command_pool_ = device_queue_->CreateCommandPool(
+      nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      device_queue_->GetGraphicsQueueFamilyIndex());
+  return !!command_pool_;
+}
+
+void VulkanCommandBufferCache::Destroy() {
+  Invalidate();
+  if (command_pool_) {
+    // Goes after the command buffers Invalidate() handed to the deletion
+    // queue, which frees them back into the pool.
+    VulkanCommandPool* command_pool = command_pool_.release();
+    device_queue_->GetDeletionQueue()->EnqueueTask(
+        [command_pool](VkDevice) {
+          command_pool->Destroy();
+          delete command_pool;
+        });
+  }
+}
+
+VkCommandBuffer VulkanCommandBufferCache::GetOrRecord(
+    const Key& key,
+    const RecordCallback& record) {
+  DCHECK(command_pool_);
+  std::unique_ptr<Entry>& entry =
+      entries_[std::make_pair(key.frame_slot, key.image_index)];
+  if (entry) {
+    if (entry->key.framebuffer == key.framebuffer &&
+        entry->key.pipeline == key.pipeline &&
+        entry->key.scene_version == key.scene_version) {
+      ++hits_;
+      return entry->command_buffer->handle();
+    }
+    // The slot's fence has signaled, so the stale recording is idle.
+    entry->command_buffer->Clear();
+  } else {
+    std::unique_ptr<VulkanCommandBuffer> command_buffer =
+        command_pool_->CreatePrimaryCommandBuffer();
+    if (!command_buffer) {
+      entries_.erase(std::make_pair(key.frame_slot, key.image_index));
+      return VK_NULL_HANDLE;
+    }
+    entry.reset(new Entry);
+    entry->command_buffer = std::move(command_buffer);
+  }
+
+  ++misses_;
+  entry->key = key;
+  {
+    ScopedMultiUseCommandBufferRecorder recorder(*entry->command_buffer);
+    record(recorder.handle());
+  }
+  return entry->command_buffer->handle();
+}
+
+void VulkanCommandBufferCache::Invalidate() {
+  if (entries_.empty())
+    return;
+
+  // Cached command buffers may be pending on any slot, so they are freed
+  // once the graphics queue has retired them.
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  for (auto& it : entries_) {
+    VulkanCommandBuffer* command_buffer = it.second->command_buffer.release();
+    deletion_queue->EnqueueTask([command_buffer](VkDevice) {
+      command_buffer->Destroy();
+      delete command_buffer;
+    });
+  }
+  entries_.clear();
+}
+
+}  // namespace gpu
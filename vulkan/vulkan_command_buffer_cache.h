@@ -0,0 +1,85 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_COMMAND_BUFFER_CACHE_H_
+#define GPU_VULKAN_VULKAN_COMMAND_BUFFER_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanCommandBuffer;
+class VulkanCommandPool;
+class VulkanDeviceQueue;
+
+// Keeps the primary command buffers of a static scene recorded for multi use,
+// so that a frame which draws the same thing as before only resubmits them
+// instead of recording again.
+//
+// A command buffer is cached per frame slot and swap chain image. It is
+// re-recorded when the framebuffer, pipeline or scene version it was recorded
+// with changes; callers bump the scene version whenever they edit the scene
+// and call Invalidate() on resize. Because a command buffer can't be pending
+// twice, a slot's command buffers are only submitted and re-recorded after
+// the timeline value of the slot's last submission has been reached, as the
+// swap chain does.
+class VULKAN_EXPORT VulkanCommandBufferCache {
+ public:
+  struct Key {
+    uint32_t frame_slot = 0;
+    uint32_t image_index = 0;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    uint64_t scene_version = 0;
+  };
+
+  // Records the frame into |command_buffer|, which has already begun.
+  using RecordCallback = std::function<void(VkCommandBuffer command_buffer)>;
+
+  explicit VulkanCommandBufferCache(VulkanDeviceQueue* device_queue);
+  ~VulkanCommandBufferCache();
+
+  bool Initialize();
+  void Destroy();
+
+  // Returns the command buffer recorded for |key|, calling |record| to
+  // record it first when none is cached yet or the cached one is stale.
+  // Returns VK_NULL_HANDLE on failure.
+  VkCommandBuffer GetOrRecord(const Key& key, const RecordCallback& record);
+
+  // Drops every cached command buffer, e.g. after the swap chain was
+  // resized. The command buffers are freed through the device's deletion
+  // queue once the graphics queue is done with them.
+  void Invalidate();
+
+  size_t size() const { return entries_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Entry;
+
+  VulkanDeviceQueue* device_queue_;
+  std::unique_ptr<VulkanCommandPool> command_pool_;
+
+  // Keyed by frame slot and swap chain image.
+  std::map<std::pair<uint32_t, uint32_t>, std::unique_ptr<Entry>> entries_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanCommandBufferCache);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_COMMAND_BUFFER_CACHE_H_
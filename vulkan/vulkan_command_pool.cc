@@ -28,14 +28,16 @@ VulkanCommandPool::~VulkanCommandPool() {
 // Execute commands on a device we submit them to queues through command
 // buffers.
 bool VulkanCommandPool::Initialize(VkCommandPoolCreateFlags
-    command_pool_create_flags) {
+    command_pool_create_flags, uint32_t queue_family_index) {
   VkDevice vk_device = device_queue_->GetVulkanDevice();
+  if (queue_family_index == UINT32_MAX)
+    queue_family_index = device_queue_->GetPresentQueueFamilyIndex();
 
   VkCommandPoolCreateInfo cmd_pool_create_info = {
       VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,  // VkStructureType sType
       nullptr,  // const void 
       command_pool_create_flags, // VkCommandPoolCreateFlags
-      device_queue_->GetPresentQueueFamilyIndex() // uint32_t queueFamilyIndex
+      queue_family_index  // uint32_t queueFamilyIndex
   };
 
   if (vkCreateCommandPool(vk_device, &cmd_pool_create_info, nullptr,
@@ -44,6 +46,8 @@ bool VulkanCommandPool::Initialize(VkCommandPoolCreateFlags
     return false;
   }
 
+  queue_family_index_ = queue_family_index;
+  queue_ = device_queue_->GetQueueForFamily(queue_family_index);
   return true;
 }
 
@@ -78,8 +82,8 @@ bool VulkanCommandPool::Submit(const VkCommandBuffer command_buffer,
       signal_semaphores       // const VkSemaphore           *pSignalSemaphores
   };
 
-  if (vkQueueSubmit(device_queue_->GetPresentQueue(), 1, &submit_info,
-                    VK_NULL_HANDLE) != VK_SUCCESS) {
+  if (device_queue_->QueueSubmit(queue_, 1, &submit_info, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
     return false;
   }
 
@@ -24,7 +24,10 @@ class VulkanCommandPool {
                              VulkanSwapChain* swap_chain);
   ~VulkanCommandPool();
 
-  bool Initialize(VkCommandPoolCreateFlags flags = 0);
+  // Command buffers are submitted to the queue of |queue_family_index|, the
+  // present family when UINT32_MAX.
+  bool Initialize(VkCommandPoolCreateFlags flags = 0,
+                  uint32_t queue_family_index = UINT32_MAX);
   void Destroy();
 
   std::unique_ptr<VulkanCommandBuffer> CreatePrimaryCommandBuffer();
@@ -36,6 +39,8 @@ class VulkanCommandPool {
               VkSemaphore* signal_semaphores);
 
   VkCommandPool handle() { return handle_; }
+  uint32_t queue_family_index() const { return queue_family_index_; }
+  VkQueue queue() const { return queue_; }
 
  private:
   friend class VulkanCommandBuffer;
@@ -46,6 +51,8 @@ class VulkanCommandPool {
   VulkanDeviceQueue* device_queue_;
   VulkanSwapChain* swap_chain_;
   VkCommandPool handle_ = VK_NULL_HANDLE;
+  uint32_t queue_family_index_ = UINT32_MAX;
+  VkQueue queue_ = VK_NULL_HANDLE;
   uint32_t command_buffer_count_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(VulkanCommandPool);
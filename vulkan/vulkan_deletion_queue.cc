@@ -0,0 +1,144 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_deletion_queue.h"
+
+#include <iterator>
+#include <utility>
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_timeline.h"
+
+namespace gpu {
+
+VulkanDeletionQueue::VulkanDeletionQueue(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanDeletionQueue::~VulkanDeletionQueue() {
+  DCHECK(entries_.empty());
+}
+
+void VulkanDeletionQueue::Destroy() {
+  VkDevice device = device_queue_->GetVulkanDevice();
+  if (entries_.empty())
+    return;
+
+  VkResult result = vkDeviceWaitIdle(device);
+  if (VK_SUCCESS != result)
+    DLOG(ERROR) << "vkDeviceWaitIdle() failed: " << result;
+  // Tasks may enqueue more cleanup, e.g. a pool after its objects.
+  while (!entries_.empty()) {
+    std::vector<Entry> entries;
+    entries.swap(entries_);
+    for (Entry& entry : entries)
+      entry.task(device);
+    num_collected_ += entries.size();
+  }
+}
+
+void VulkanDeletionQueue::Enqueue(VkFramebuffer framebuffer) {
+  EnqueueTask([framebuffer](VkDevice device) {
+    vkDestroyFramebuffer(device, framebuffer, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkImageView image_view) {
+  EnqueueTask([image_view](VkDevice device) {
+    vkDestroyImageView(device, image_view, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkImage image) {
+  EnqueueTask(
+      [image](VkDevice device) { vkDestroyImage(device, image, nullptr); });
+}
+
+void VulkanDeletionQueue::Enqueue(VkBuffer buffer) {
+  EnqueueTask(
+      [buffer](VkDevice device) { vkDestroyBuffer(device, buffer, nullptr); });
+}
+
+void VulkanDeletionQueue::Enqueue(VkSemaphore semaphore) {
+  EnqueueTask([semaphore](VkDevice device) {
+    vkDestroySemaphore(device, semaphore, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkRenderPass render_pass) {
+  EnqueueTask([render_pass](VkDevice device) {
+    vkDestroyRenderPass(device, render_pass, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkPipeline pipeline) {
+  EnqueueTask([pipeline](VkDevice device) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkPipelineLayout pipeline_layout) {
+  EnqueueTask([pipeline_layout](VkDevice device) {
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkDescriptorSetLayout descriptor_set_layout) {
+  EnqueueTask([descriptor_set_layout](VkDevice device) {
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(VkDescriptorPool descriptor_pool) {
+  EnqueueTask([descriptor_pool](VkDevice device) {
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+  });
+}
+
+void VulkanDeletionQueue::Enqueue(const VulkanMemoryAllocation& allocation) {
+  VulkanMemoryAllocator* allocator = device_queue_->GetMemoryAllocator();
+  VulkanMemoryAllocation copy = allocation;
+  EnqueueTask([allocator, copy](VkDevice) mutable { allocator->Free(&copy); });
+}
+
+void VulkanDeletionQueue::EnqueueTask(CleanupTask task) {
+  VulkanTimeline* timeline =
+      device_queue_->GetTimeline(device_queue_->GetGraphicsQueue());
+  DCHECK(timeline);
+  // The next value also covers command buffers batched but not submitted.
+  EnqueueTask(std::move(task), timeline, timeline->last_submitted_value() + 1);
+}
+
+void VulkanDeletionQueue::EnqueueTask(CleanupTask task,
+                                      VulkanTimeline* timeline,
+                                      uint64_t value) {
+  DCHECK(timeline);
+  entries_.push_back({timeline, value, std::move(task)});
+}
+
+void VulkanDeletionQueue::Collect() {
+  if (entries_.empty())
+    return;
+
+  VkDevice device = device_queue_->GetVulkanDevice();
+  std::vector<Entry> entries;
+  entries.swap(entries_);
+  std::vector<Entry> pending;
+  for (Entry& entry : entries) {
+    if (entry.timeline->IsComplete(entry.value)) {
+      entry.task(device);
+      ++num_collected_;
+    } else {
+      pending.push_back(std::move(entry));
+    }
+  }
+
+  // Keep the order with whatever the tasks enqueued.
+  pending.insert(pending.end(), std::make_move_iterator(entries_.begin()),
+                 std::make_move_iterator(entries_.end()));
+  entries_.swap(pending);
+}
+
+}  // namespace gpu
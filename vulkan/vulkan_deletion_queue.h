@@ -0,0 +1,84 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_DELETION_QUEUE_H_
+#define GPU_VULKAN_VULKAN_DELETION_QUEUE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanTimeline;
+struct VulkanMemoryAllocation;
+
+// Destroys objects once the GPU work that may still use them has retired,
+// instead of waiting for the device to become idle first.
+//
+// Every entry is tagged with a timeline value. By default that is the next
+// value of the graphics queue's timeline, which covers the work submitted so
+// far and the work batched for the next submission. The entries are freed in
+// bulk by Collect(), which VulkanDeviceQueue::EndFrame() calls once a frame.
+// VulkanDeviceQueue owns one, see GetDeletionQueue().
+class VULKAN_EXPORT VulkanDeletionQueue {
+ public:
+  using CleanupTask = std::function<void(VkDevice device)>;
+
+  explicit VulkanDeletionQueue(VulkanDeviceQueue* device_queue);
+  ~VulkanDeletionQueue();
+
+  // Waits for the device to become idle and runs every pending task.
+  void Destroy();
+
+  void Enqueue(VkFramebuffer framebuffer);
+  void Enqueue(VkImageView image_view);
+  void Enqueue(VkImage image);
+  void Enqueue(VkBuffer buffer);
+  void Enqueue(VkSemaphore semaphore);
+  void Enqueue(VkRenderPass render_pass);
+  void Enqueue(VkPipeline pipeline);
+  void Enqueue(VkPipelineLayout pipeline_layout);
+  void Enqueue(VkDescriptorSetLayout descriptor_set_layout);
+  // Also frees the descriptor sets allocated from |descriptor_pool|.
+  void Enqueue(VkDescriptorPool descriptor_pool);
+  // Returns |allocation| to the device's VulkanMemoryAllocator. Enqueue it
+  // after the resource bound to it, which is destroyed first.
+  void Enqueue(const VulkanMemoryAllocation& allocation);
+  // Runs |task| after the graphics queue work submitted so far.
+  void EnqueueTask(CleanupTask task);
+  // Runs |task| once |timeline| has reached |value|, e.g. for objects used
+  // on the transfer queue.
+  void EnqueueTask(CleanupTask task, VulkanTimeline* timeline,
+                   uint64_t value);
+
+  // Runs the tasks whose work has retired, in the order they were enqueued.
+  void Collect();
+
+  size_t num_pending() const { return entries_.size(); }
+  uint64_t num_collected() const { return num_collected_; }
+
+ private:
+  struct Entry {
+    VulkanTimeline* timeline;
+    uint64_t value;
+    CleanupTask task;
+  };
+
+  VulkanDeviceQueue* device_queue_;
+  // Oldest first. Entries of different timelines retire out of order.
+  std::vector<Entry> entries_;
+  uint64_t num_collected_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanDeletionQueue);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_DELETION_QUEUE_H_
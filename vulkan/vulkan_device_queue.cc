@@ -11,9 +11,18 @@
 
 #include "gpu/vulkan/vulkan_platform.h"
 #include "vulkan_command_pool.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_framebuffer_cache.h"
 #include "vulkan_implementation.h"
+#include "vulkan_memory_allocator.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_pipeline_registry.h"
+#include "vulkan_render_pass_cache.h"
+#include "vulkan_submit_batch.h"
 #include "vulkan_surface.h"
 #include "vulkan_swap_chain.h"
+#include "vulkan_sync_pool.h"
+#include "vulkan_timeline.h"
 
 #if defined(VK_USE_PLATFORM_XLIB_KHR)
 #include "ui/gfx/x/x11_types.h"
@@ -85,6 +94,11 @@ bool VulkanDeviceQueue::Initialize(uint32_t options) {
     return false;
   }
 
+  vkGetPhysicalDeviceProperties(vk_physical_device_,
+                                &vk_physical_device_properties_);
+  vkGetPhysicalDeviceMemoryProperties(vk_physical_device_,
+                                      &vk_memory_properties_);
+
   std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
   std::vector<float> queue_priorities = {1.0f};
 
@@ -109,8 +123,74 @@ bool VulkanDeviceQueue::Initialize(uint32_t options) {
     });
   }
 
+  uint32_t selected_transfer_queue_family_index =
+      SelectTransferQueueFamily(selected_graphics_queue_family_index);
+  if (selected_transfer_queue_family_index !=
+          selected_graphics_queue_family_index &&
+      selected_transfer_queue_family_index !=
+          selected_present_queue_family_index) {
+    queue_create_infos.push_back({
+        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,  // VkStructureType sType
+        nullptr,  // const void                  *pNext
+        0,        // VkDeviceQueueCreateFlags     flags
+        selected_transfer_queue_family_index,  // uint32_t queueFamilyIndex
+        static_cast<uint32_t>(queue_priorities.size()),  // uint32_t queueCount
+        &queue_priorities[0]  // const float                 *pQueuePriorities
+    });
+  }
+
   std::vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+  // Optional extensions are enabled when the device has them and checked for
+  // through IsExtensionEnabled().
+  uint32_t extensions_count = 0;
+  vkEnumerateDeviceExtensionProperties(vk_physical_device_, nullptr,
+                                       &extensions_count, nullptr);
+  std::vector<VkExtensionProperties> available_extensions(extensions_count);
+  if (extensions_count) {
+    vkEnumerateDeviceExtensionProperties(vk_physical_device_, nullptr,
+                                         &extensions_count,
+                                         &available_extensions[0]);
+  }
+  std::vector<const char*> optional_extensions;
+#if defined(VK_EXT_memory_budget)
+  // Reported through vkGetPhysicalDeviceMemoryProperties2KHR().
+  if (IsVulkanInstanceExtensionEnabled(
+          VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    optional_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+#endif
+  for (const char* extension : optional_extensions) {
+    if (CheckExtensionAvailability(extension, available_extensions))
+      extensions.push_back(extension);
+  }
+
+#if defined(VK_KHR_timeline_semaphore)
+  // The extension is only usable with its feature, which is queried and
+  // enabled through a VkPhysicalDeviceFeatures2KHR chain.
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features =
+      {};
+  timeline_semaphore_features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  if (IsVulkanInstanceExtensionEnabled(
+          VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) &&
+      CheckExtensionAvailability(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+                                 available_extensions)) {
+    PFN_vkGetPhysicalDeviceFeatures2KHR get_physical_device_features2 =
+        reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+            vkGetInstanceProcAddr(vk_instance,
+                                  "vkGetPhysicalDeviceFeatures2KHR"));
+    if (get_physical_device_features2) {
+      VkPhysicalDeviceFeatures2KHR features = {};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+      features.pNext = &timeline_semaphore_features;
+      get_physical_device_features2(vk_physical_device_, &features);
+    }
+    if (timeline_semaphore_features.timelineSemaphore)
+      extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  }
+#endif
+
   VkDeviceCreateInfo device_create_info = {
       VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,  // VkStructureType sType
       nullptr,  // const void                        *pNext
@@ -126,6 +206,10 @@ bool VulkanDeviceQueue::Initialize(uint32_t options) {
       &extensions[0],          // const char * const *ppEnabledExtensionNames
       nullptr  // const VkPhysicalDeviceFeatures    *pEnabledFeatures
   };
+#if defined(VK_KHR_timeline_semaphore)
+  if (timeline_semaphore_features.timelineSemaphore)
+    device_create_info.pNext = &timeline_semaphore_features;
+#endif
 
   if (vkCreateDevice(vk_physical_device_, &device_create_info, nullptr,
                      &vk_device_) != VK_SUCCESS) {
@@ -133,8 +217,10 @@ bool VulkanDeviceQueue::Initialize(uint32_t options) {
     return false;
   }
 
+  enabled_extensions_.insert(extensions.begin(), extensions.end());
   vk_graphics_queue_family_index_ = selected_graphics_queue_family_index;
   vk_present_queue_family_index_ = selected_present_queue_family_index;
+  vk_transfer_queue_family_index_ = selected_transfer_queue_family_index;
   // end of CreateDevice()
 
 
@@ -143,10 +229,122 @@ bool VulkanDeviceQueue::Initialize(uint32_t options) {
                    &GraphicsQueue_);
   vkGetDeviceQueue(vk_device_, vk_present_queue_family_index_, 0,
                    &PresentQueue_);
+  vkGetDeviceQueue(vk_device_, vk_transfer_queue_family_index_, 0,
+                   &TransferQueue_);
+
+  memory_allocator_.reset(new VulkanMemoryAllocator(this));
+  if (!memory_allocator_->Initialize()) {
+    std::cout << "Could not initialize memory allocator!" << std::endl;
+    return false;
+  }
+
+  fence_pool_.reset(new VulkanFencePool(this));
+  semaphore_pool_.reset(new VulkanSemaphorePool(this));
+  submit_batch_.reset(new VulkanSubmitBatch(this, GraphicsQueue_));
+  deletion_queue_.reset(new VulkanDeletionQueue(this));
+  framebuffer_cache_.reset(new VulkanFramebufferCache(this));
+
+  pipeline_cache_.reset(new VulkanPipelineCache(this));
+  if (!pipeline_cache_->Initialize(pipeline_cache_path_)) {
+    std::cout << "Could not create pipeline cache!" << std::endl;
+    return false;
+  }
+  pipeline_registry_.reset(new VulkanPipelineRegistry(this));
+  render_pass_cache_.reset(new VulkanRenderPassCache(this));
+
+  for (VkQueue queue : {GraphicsQueue_, PresentQueue_, TransferQueue_}) {
+    if (GetTimeline(queue))
+      continue;
+    std::unique_ptr<VulkanTimeline> timeline(new VulkanTimeline(this, queue));
+    if (!timeline->Initialize()) {
+      std::cout << "Could not initialize queue timeline!" << std::endl;
+      return false;
+    }
+    timelines_.push_back(std::move(timeline));
+  }
 
   return true;
 }
 
+bool VulkanDeviceQueue::SupportsTimelineSemaphores() const {
+#if defined(VK_KHR_timeline_semaphore)
+  return IsExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+#else
+  return false;
+#endif
+}
+
+VulkanTimeline* VulkanDeviceQueue::GetTimeline(VkQueue queue) const {
+  for (const std::unique_ptr<VulkanTimeline>& timeline : timelines_) {
+    if (timeline->queue() == queue)
+      return timeline.get();
+  }
+  return nullptr;
+}
+
+VkResult VulkanDeviceQueue::QueueSubmit(VkQueue queue,
+                                        uint32_t submit_count,
+                                        const VkSubmitInfo* submits,
+                                        VkFence fence) {
+  frame_submit_counters_.queue_submits++;
+  frame_submit_counters_.submit_infos += submit_count;
+  for (uint32_t i = 0; i < submit_count; ++i)
+    frame_submit_counters_.command_buffers += submits[i].commandBufferCount;
+  return vkQueueSubmit(queue, submit_count, submits, fence);
+}
+
+void VulkanDeviceQueue::EndFrame() {
+  last_frame_submit_counters_ = frame_submit_counters_;
+  frame_submit_counters_ = SubmitCounters();
+  deletion_queue_->Collect();
+  pipeline_cache_->SaveIfDirty();
+}
+
+VkQueue VulkanDeviceQueue::GetQueueForFamily(
+    uint32_t queue_family_index) const {
+  if (queue_family_index == vk_graphics_queue_family_index_)
+    return GraphicsQueue_;
+  if (queue_family_index == vk_present_queue_family_index_)
+    return PresentQueue_;
+  DCHECK_EQ(vk_transfer_queue_family_index_, queue_family_index);
+  return TransferQueue_;
+}
+
+// Prefers a family that can only copy, then one without graphics (an async
+// compute family can copy too), and shares the graphics family otherwise.
+uint32_t VulkanDeviceQueue::SelectTransferQueueFamily(
+    uint32_t graphics_queue_family_index) const {
+  uint32_t queue_families_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device_,
+                                           &queue_families_count, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_family_properties(
+      queue_families_count);
+  if (queue_families_count) {
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        vk_physical_device_, &queue_families_count,
+        &queue_family_properties[0]);
+  }
+
+  const VkQueueFlags kCopyCapable =
+      VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+  uint32_t non_graphics_family = UINT32_MAX;
+  for (uint32_t i = 0; i < queue_families_count; ++i) {
+    const VkQueueFlags flags = queue_family_properties[i].queueFlags;
+    if (queue_family_properties[i].queueCount == 0 ||
+        !(flags & kCopyCapable) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    if (!(flags & VK_QUEUE_COMPUTE_BIT))
+      return i;
+    if (non_graphics_family == UINT32_MAX)
+      non_graphics_family = i;
+  }
+
+  if (non_graphics_family != UINT32_MAX)
+    return non_graphics_family;
+  return graphics_queue_family_index;
+}
+
 bool VulkanDeviceQueue::CheckExtensionAvailability(
     const char* extension_name,
     const std::vector<VkExtensionProperties>& available_extensions) {
@@ -289,6 +487,59 @@ bool VulkanDeviceQueue::CheckPhysicalDeviceProperties(
 
 void VulkanDeviceQueue::Destroy() {
   printf("VulkanDeviceQueue::%s\n", __func__);
+  if (submit_batch_) {
+    submit_batch_->Flush();
+    submit_batch_.reset();
+  }
+
+  // Evicts the framebuffers and pipelines of the render passes.
+  if (render_pass_cache_) {
+    render_pass_cache_->Destroy();
+    render_pass_cache_.reset();
+  }
+
+  if (framebuffer_cache_) {
+    framebuffer_cache_->Destroy();
+    framebuffer_cache_.reset();
+  }
+
+  // Waits for pipelines still being built, which use the pipeline cache.
+  if (pipeline_registry_) {
+    pipeline_registry_->Destroy();
+    pipeline_registry_.reset();
+  }
+
+  if (pipeline_cache_) {
+    pipeline_cache_->Destroy();
+    pipeline_cache_.reset();
+  }
+
+  // Cleanup tasks may still release fences and memory to the pools and the
+  // allocator below.
+  if (deletion_queue_) {
+    deletion_queue_->Destroy();
+    deletion_queue_.reset();
+  }
+
+  for (std::unique_ptr<VulkanTimeline>& timeline : timelines_)
+    timeline->Destroy();
+  timelines_.clear();
+
+  // Everything that borrowed from the pools has released its objects by now.
+  if (semaphore_pool_) {
+    semaphore_pool_->Destroy();
+    semaphore_pool_.reset();
+  }
+  if (fence_pool_) {
+    fence_pool_->Destroy();
+    fence_pool_.reset();
+  }
+
+  if (memory_allocator_) {
+    memory_allocator_->Destroy();
+    memory_allocator_.reset();
+  }
+
   if (VK_NULL_HANDLE != vk_device_) {
     vkDestroyDevice(vk_device_, nullptr);
     // vk_device_ = VK_NULL_HANDLE;
@@ -296,16 +547,21 @@ void VulkanDeviceQueue::Destroy() {
 
   vk_graphics_queue_family_index_ = UINT32_MAX;
   vk_present_queue_family_index_ = UINT32_MAX;
+  vk_transfer_queue_family_index_ = UINT32_MAX;
+  TransferQueue_ = VK_NULL_HANDLE;
+  enabled_extensions_.clear();
 
   vk_physical_device_ = VK_NULL_HANDLE;
 }
 
 std::unique_ptr<VulkanCommandPool> VulkanDeviceQueue::CreateCommandPool(
-    VulkanSwapChain* swap_chain, VkCommandPoolCreateFlags flags) {
+    VulkanSwapChain* swap_chain,
+    VkCommandPoolCreateFlags flags,
+    uint32_t queue_family_index) {
   std::unique_ptr<VulkanCommandPool> command_pool(
       new VulkanCommandPool(this, swap_chain));
 
-  if (!command_pool->Initialize(flags))
+  if (!command_pool->Initialize(flags, queue_family_index))
     return nullptr;
 
   return command_pool;
@@ -8,17 +8,29 @@
 #include <vulkan/vulkan.h>
 
 #include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "base/logging.h"
 #include "base/macros.h"
 #include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_memory_allocator.h"
 
 namespace gpu {
 
 class VulkanCommandPool;
+class VulkanDeletionQueue;
+class VulkanFencePool;
+class VulkanFramebufferCache;
+class VulkanPipelineCache;
+class VulkanPipelineRegistry;
+class VulkanRenderPassCache;
+class VulkanSemaphorePool;
+class VulkanSubmitBatch;
 class VulkanSurface;
 class VulkanSwapChain;
+class VulkanTimeline;
 
 class VULKAN_EXPORT VulkanDeviceQueue {
  public:
@@ -33,6 +45,12 @@ class VULKAN_EXPORT VulkanDeviceQueue {
   bool Initialize(uint32_t option);
   void Destroy();
 
+  // File the pipeline cache is loaded from in Initialize() and saved to in
+  // Destroy(). Without one the cache only lives as long as the device.
+  void SetPipelineCachePath(const std::string& path) {
+    pipeline_cache_path_ = path;
+  }
+
   VkPhysicalDevice GetVulkanPhysicalDevice() const {
     DCHECK_NE(static_cast<VkPhysicalDevice>(VK_NULL_HANDLE),
               vk_physical_device_);
@@ -44,6 +62,35 @@ class VULKAN_EXPORT VulkanDeviceQueue {
     return vk_device_;
   }
 
+  // Cached in Initialize(), so callers never need to query them again.
+  const VkPhysicalDeviceProperties& GetPhysicalDeviceProperties() const {
+    return vk_physical_device_properties_;
+  }
+  const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const {
+    return vk_memory_properties_;
+  }
+
+  // Returns the best memory type in |memory_type_bits| for |usage|, or
+  // UINT32_MAX if none qualifies.
+  uint32_t FindMemoryTypeIndex(uint32_t memory_type_bits,
+                               VulkanMemoryUsage usage) const {
+    return VulkanMemoryAllocator::FindMemoryTypeIndex(
+        vk_memory_properties_, memory_type_bits, usage);
+  }
+
+  // Whether an optional device extension, e.g. VK_EXT_memory_budget, was
+  // available and enabled.
+  bool IsExtensionEnabled(const char* name) const {
+    return enabled_extensions_.count(name) > 0;
+  }
+
+  // Whether VK_KHR_timeline_semaphore is enabled along with its feature.
+  bool SupportsTimelineSemaphores() const;
+
+  // Returns the counter of the graphics, present or transfer |queue|, or
+  // null for any other queue. Valid between Initialize() and Destroy().
+  VulkanTimeline* GetTimeline(VkQueue queue) const;
+
   // for Chromium Vulkan Demo
   VkQueue GetVulkanQueue() const {
     //DCHECK_NE(static_cast<VkQueue>(VK_NULL_HANDLE), vk_queue_);
@@ -68,26 +115,153 @@ class VULKAN_EXPORT VulkanDeviceQueue {
   uint32_t GetGraphicsQueueFamilyIndex() const {
     return vk_graphics_queue_family_index_;
   }
+
+  // Queue for copies that should overlap with rendering. It comes from a
+  // transfer-only family when the device has one, which usually maps to a
+  // DMA engine, and falls back to the graphics queue otherwise.
+  VkQueue GetTransferQueue() const { return TransferQueue_; }
+  uint32_t GetTransferQueueFamilyIndex() const {
+    return vk_transfer_queue_family_index_;
+  }
+  bool HasDedicatedTransferQueue() const {
+    return vk_transfer_queue_family_index_ != vk_graphics_queue_family_index_;
+  }
+
+  // Returns the queue created for |queue_family_index|, which must be the
+  // graphics, present or transfer family.
+  VkQueue GetQueueForFamily(uint32_t queue_family_index) const;
+
+  // vkQueueSubmit() activity during one frame.
+  struct SubmitCounters {
+    uint32_t queue_submits = 0;
+    uint32_t submit_infos = 0;
+    uint32_t command_buffers = 0;
+  };
+
+  // Calls vkQueueSubmit() and counts it. Everything in gpu/vulkan submits
+  // through here so the counters see all submissions.
+  VkResult QueueSubmit(VkQueue queue,
+                       uint32_t submit_count,
+                       const VkSubmitInfo* submits,
+                       VkFence fence);
+
+  // Collects the graphics queue submissions of a frame so they go out with
+  // a single vkQueueSubmit(). Valid between Initialize() and Destroy().
+  VulkanSubmitBatch* GetSubmitBatch() const {
+    DCHECK(submit_batch_);
+    return submit_batch_.get();
+  }
+
+  // Counters of the frame being recorded and of the last complete one.
+  // VulkanSwapChain ends a frame after presenting it, which also collects
+  // the retired entries of the deletion queue and saves the pipeline cache
+  // when new pipelines were created.
+  const SubmitCounters& GetFrameSubmitCounters() const {
+    return frame_submit_counters_;
+  }
+  const SubmitCounters& GetLastFrameSubmitCounters() const {
+    return last_frame_submit_counters_;
+  }
+  void EndFrame();
+
+  // Allocator for buffer and image memory. Valid between Initialize() and
+  // Destroy().
+  VulkanMemoryAllocator* GetMemoryAllocator() const {
+    DCHECK(memory_allocator_);
+    return memory_allocator_.get();
+  }
+
+  // Recycled fences and binary semaphores. Valid between Initialize() and
+  // Destroy().
+  VulkanFencePool* GetFencePool() const {
+    DCHECK(fence_pool_);
+    return fence_pool_.get();
+  }
+  VulkanSemaphorePool* GetSemaphorePool() const {
+    DCHECK(semaphore_pool_);
+    return semaphore_pool_.get();
+  }
+
+  // Destroys objects once the work using them has retired. Valid between
+  // Initialize() and Destroy().
+  VulkanDeletionQueue* GetDeletionQueue() const {
+    DCHECK(deletion_queue_);
+    return deletion_queue_.get();
+  }
+
+  // Framebuffers by render pass, attachments and extent. Valid between
+  // Initialize() and Destroy().
+  VulkanFramebufferCache* GetFramebufferCache() const {
+    DCHECK(framebuffer_cache_);
+    return framebuffer_cache_.get();
+  }
+
+  // Passed to every vkCreate*Pipelines() call. Valid between Initialize()
+  // and Destroy().
+  VulkanPipelineCache* GetPipelineCache() const {
+    DCHECK(pipeline_cache_);
+    return pipeline_cache_.get();
+  }
+
+  // Pipelines and pipeline layouts by their state. Valid between
+  // Initialize() and Destroy().
+  VulkanPipelineRegistry* GetPipelineRegistry() const {
+    DCHECK(pipeline_registry_);
+    return pipeline_registry_.get();
+  }
+
+  // Shared render passes by their description. Valid between Initialize()
+  // and Destroy().
+  VulkanRenderPassCache* GetRenderPassCache() const {
+    DCHECK(render_pass_cache_);
+    return render_pass_cache_.get();
+  }
+
   bool OnWindowSizeChanged();
   bool ReadyToDraw() { return CanRender_; }
 
+  // Command buffers from the pool are submitted to the queue of
+  // |queue_family_index|, the present family when UINT32_MAX.
   std::unique_ptr<gpu::VulkanCommandPool> CreateCommandPool(VulkanSwapChain*,
-      VkCommandPoolCreateFlags command_pool_create_flags);
+      VkCommandPoolCreateFlags command_pool_create_flags,
+      uint32_t queue_family_index = UINT32_MAX);
 
   void CanRender(bool val) { CanRender_ = val; }
 
  private:
   VkPhysicalDevice vk_physical_device_ = VK_NULL_HANDLE;
   VkDevice vk_device_ = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties vk_physical_device_properties_ = {};
+  VkPhysicalDeviceMemoryProperties vk_memory_properties_ = {};
   //VkQueue vk_queue_ = VK_NULL_HANDLE;
   VkQueue GraphicsQueue_ = VK_NULL_HANDLE;
   VkQueue PresentQueue_ = VK_NULL_HANDLE;
+  VkQueue TransferQueue_ = VK_NULL_HANDLE;
 
   uint32_t vk_graphics_queue_family_index_ = UINT32_MAX;
   uint32_t vk_present_queue_family_index_ = UINT32_MAX;
+  uint32_t vk_transfer_queue_family_index_ = UINT32_MAX;
 
   bool CanRender_ = false;
 
+  std::unordered_set<std::string> enabled_extensions_;
+
+  std::unique_ptr<VulkanMemoryAllocator> memory_allocator_;
+  std::unique_ptr<VulkanFencePool> fence_pool_;
+  std::unique_ptr<VulkanSemaphorePool> semaphore_pool_;
+  std::unique_ptr<VulkanSubmitBatch> submit_batch_;
+  std::unique_ptr<VulkanDeletionQueue> deletion_queue_;
+  std::unique_ptr<VulkanFramebufferCache> framebuffer_cache_;
+  std::string pipeline_cache_path_;
+  std::unique_ptr<VulkanPipelineCache> pipeline_cache_;
+  std::unique_ptr<VulkanPipelineRegistry> pipeline_registry_;
+  std::unique_ptr<VulkanRenderPassCache> render_pass_cache_;
+  // One per distinct queue.
+  std::vector<std::unique_ptr<VulkanTimeline>> timelines_;
+
+  SubmitCounters frame_submit_counters_;
+  SubmitCounters last_frame_submit_counters_;
+
   bool CheckExtensionAvailability(
       const char* extension_name,
       const std::vector<VkExtensionProperties>& available_extensions);
@@ -95,6 +269,8 @@ class VULKAN_EXPORT VulkanDeviceQueue {
       VkPhysicalDevice vk_physical_device,
       uint32_t& selected_graphics_queue_family_index,
       uint32_t& selected_present_queue_family_index);
+  uint32_t SelectTransferQueueFamily(
+      uint32_t graphics_queue_family_index) const;
 
   DISALLOW_COPY_AND_ASSIGN(VulkanDeviceQueue);
 };
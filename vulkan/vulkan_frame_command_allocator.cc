@@ -0,0 +1,126 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_frame_command_allocator.h"
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+VulkanFrameCommandAllocator::CommandBuffers::CommandBuffers() {}
+
+VulkanFrameCommandAllocator::CommandBuffers::~CommandBuffers() {}
+
+VulkanFrameCommandAllocator::Frame::Frame() {}
+
+VulkanFrameCommandAllocator::Frame::~Frame() {}
+
+VulkanFrameCommandAllocator::VulkanFrameCommandAllocator(
+    VulkanDeviceQueue* device_queue,
+    uint32_t frames_in_flight,
+    uint32_t queue_family_index)
+    : device_queue_(device_queue),
+      frames_in_flight_(frames_in_flight),
+      queue_family_index_(queue_family_index) {}
+
+VulkanFrameCommandAllocator::~VulkanFrameCommandAllocator() {
+  DCHECK(frames_.empty());
+}
+
+bool VulkanFrameCommandAllocator::Initialize() {
+  DCHECK_LT(0u, frames_in_flight_);
+  if (queue_family_index_ == UINT32_MAX)
+    queue_family_index_ = device_queue_->GetGraphicsQueueFamilyIndex();
+
+  // Without VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT the driver
+  // doesn't have to track command buffers individually.
+  VkCommandPoolCreateInfo command_pool_create_info = {};
+  command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  command_pool_create_info.queueFamilyIndex = queue_family_index_;
+
+  frames_.resize(frames_in_flight_);
+  for (Frame& frame : frames_) {
+    VkResult result =
+        vkCreateCommandPool(device_queue_->GetVulkanDevice(),
+                            &command_pool_create_info, nullptr,
+                            &frame.command_pool);
+    if (VK_SUCCESS != result) {
+      DLOG(ERROR) << "vkCreateCommandPool() failed: " << result;
+      return false;
+    }
+  }
+  current_frame_ = 0;
+  return true;
+}
+
+void VulkanFrameCommandAllocator::Destroy() {
+  // Destroying a pool frees its command buffers.
+  for (Frame& frame : frames_) {
+    if (VK_NULL_HANDLE != frame.command_pool) {
+      vkDestroyCommandPool(device_queue_->GetVulkanDevice(),
+                           frame.command_pool, nullptr);
+    }
+  }
+  frames_.clear();
+}
+
+bool VulkanFrameCommandAllocator::BeginFrame(uint32_t frame_index) {
+  DCHECK_LT(frame_index, frames_.size());
+  current_frame_ = frame_index;
+  Frame& frame = frames_[frame_index];
+  frame.primaries.used = 0;
+  frame.secondaries.used = 0;
+
+  VkResult result = vkResetCommandPool(device_queue_->GetVulkanDevice(),
+                                       frame.command_pool, 0);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkResetCommandPool() failed: " << result;
+    return false;
+  }
+  return true;
+}
+
+VkCommandBuffer VulkanFrameCommandAllocator::AllocatePrimary() {
+  return Allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                  &frames_[current_frame_].primaries);
+}
+
+VkCommandBuffer VulkanFrameCommandAllocator::AllocateSecondary() {
+  return Allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                  &frames_[current_frame_].secondaries);
+}
+
+size_t VulkanFrameCommandAllocator::allocated_command_buffer_count() const {
+  size_t count = 0;
+  for (const Frame& frame : frames_)
+    count += frame.primaries.handles.size() + frame.secondaries.handles.size();
+  return count;
+}
+
+VkCommandBuffer VulkanFrameCommandAllocator::Allocate(
+    VkCommandBufferLevel level,
+    CommandBuffers* command_buffers) {
+  if (command_buffers->used == command_buffers->handles.size()) {
+    VkCommandBufferAllocateInfo command_buffer_info = {};
+    command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_info.commandPool = frames_[current_frame_].command_pool;
+    command_buffer_info.level = level;
+    command_buffer_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkResult result = vkAllocateCommandBuffers(
+        device_queue_->GetVulkanDevice(), &command_buffer_info,
+        &command_buffer);
+    if (VK_SUCCESS != result) {
+      DLOG(ERROR) << "vkAllocateCommandBuffers() failed: " << result;
+      return VK_NULL_HANDLE;
+    }
+    command_buffers->handles.push_back(command_buffer);
+  }
+  return command_buffers->handles[command_buffers->used++];
+}
+
+}  // namespace gpu
@@ -0,0 +1,88 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_FRAME_COMMAND_ALLOCATOR_H_
+#define GPU_VULKAN_VULKAN_FRAME_COMMAND_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// Hands out command buffers that live for one frame. Every frame in flight
+// has its own transient command pool; command buffers are handed out
+// linearly during the frame and all of them are recycled with a single
+// vkResetCommandPool() when the frame slot comes around again. That avoids
+// resetting command buffers one by one and lets the driver reclaim command
+// memory in bulk. The command buffers are allocated once and reused, so a
+// steady state frame allocates nothing.
+class VULKAN_EXPORT VulkanFrameCommandAllocator {
+ public:
+  // Command buffers are submitted to the queue of |queue_family_index|, the
+  // graphics family when UINT32_MAX.
+  VulkanFrameCommandAllocator(VulkanDeviceQueue* device_queue,
+                              uint32_t frames_in_flight,
+                              uint32_t queue_family_index = UINT32_MAX);
+  ~VulkanFrameCommandAllocator();
+
+  bool Initialize();
+  void Destroy();
+
+  // Starts frame slot |frame_index| and resets every command buffer handed
+  // out for it before. The caller must have waited for the slot's last
+  // submission, i.e. for its queue's VulkanTimeline to reach the value that
+  // submission signaled, as VulkanSwapChain::WaitFences() does.
+  bool BeginFrame(uint32_t frame_index);
+
+  // Returns a command buffer in the initial state, valid until the next
+  // BeginFrame() of the current slot. The caller begins, records and submits
+  // it, and must not reset it. Returns VK_NULL_HANDLE on failure.
+  VkCommandBuffer AllocatePrimary();
+  VkCommandBuffer AllocateSecondary();
+
+  uint32_t frames_in_flight() const { return frames_in_flight_; }
+  uint32_t current_frame() const { return current_frame_; }
+  // Command buffers allocated from the driver over all slots so far.
+  size_t allocated_command_buffer_count() const;
+
+ private:
+  struct CommandBuffers {
+    CommandBuffers();
+    ~CommandBuffers();
+
+    // Allocated ones, of which the first |used| are handed out this frame.
+    std::vector<VkCommandBuffer> handles;
+    size_t used = 0;
+  };
+
+  struct Frame {
+    Frame();
+    ~Frame();
+
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    CommandBuffers primaries;
+    CommandBuffers secondaries;
+  };
+
+  VkCommandBuffer Allocate(VkCommandBufferLevel level,
+                           CommandBuffers* command_buffers);
+
+  VulkanDeviceQueue* device_queue_;
+  const uint32_t frames_in_flight_;
+  uint32_t queue_family_index_;
+  std::vector<Frame> frames_;
+  uint32_t current_frame_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanFrameCommandAllocator);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_FRAME_COMMAND_ALLOCATOR_H_
@@ -0,0 +1,116 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_framebuffer_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "base/logging.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+namespace {
+
+template <typename T>
+size_t HashCombine(size_t seed, const T& value) {
+  return seed * 31 + std::hash<T>()(value);
+}
+
+}  // namespace
+
+bool VulkanFramebufferCache::Key::operator==(const Key& other) const {
+  return render_pass == other.render_pass &&
+         attachments == other.attachments && width == other.width &&
+         height == other.height && layers == other.layers;
+}
+
+size_t VulkanFramebufferCache::KeyHash::operator()(const Key& key) const {
+  size_t hash = std::hash<VkRenderPass>()(key.render_pass);
+  for (VkImageView attachment : key.attachments)
+    hash = HashCombine(hash, attachment);
+  hash = HashCombine(hash, key.width);
+  hash = HashCombine(hash, key.height);
+  return HashCombine(hash, key.layers);
+}
+
+VulkanFramebufferCache::VulkanFramebufferCache(
+    VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanFramebufferCache::~VulkanFramebufferCache() {
+  DCHECK(framebuffers_.empty());
+}
+
+void VulkanFramebufferCache::Destroy() {
+  for (auto it = framebuffers_.begin(); it != framebuffers_.end();)
+    it = Evict(it);
+}
+
+VkFramebuffer VulkanFramebufferCache::Get(
+    VkRenderPass render_pass,
+    const std::vector<VkImageView>& attachments,
+    const VkExtent2D& extent,
+    uint32_t layers) {
+  Key key = {render_pass, attachments, extent.width, extent.height, layers};
+  auto it = framebuffers_.find(key);
+  if (it != framebuffers_.end()) {
+    ++hits_;
+    return it->second;
+  }
+
+  ++misses_;
+  VkFramebufferCreateInfo framebuffer_create_info = {};
+  framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebuffer_create_info.renderPass = render_pass;
+  framebuffer_create_info.attachmentCount =
+      static_cast<uint32_t>(attachments.size());
+  framebuffer_create_info.pAttachments = attachments.data();
+  framebuffer_create_info.width = extent.width;
+  framebuffer_create_info.height = extent.height;
+  framebuffer_create_info.layers = layers;
+
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+  VkResult result =
+      vkCreateFramebuffer(device_queue_->GetVulkanDevice(),
+                          &framebuffer_create_info, nullptr, &framebuffer);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateFramebuffer() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  framebuffers_.emplace(std::move(key), framebuffer);
+  return framebuffer;
+}
+
+void VulkanFramebufferCache::EvictImageView(VkImageView image_view) {
+  for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+    const std::vector<VkImageView>& attachments = it->first.attachments;
+    if (std::find(attachments.begin(), attachments.end(), image_view) !=
+        attachments.end()) {
+      it = Evict(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void VulkanFramebufferCache::EvictRenderPass(VkRenderPass render_pass) {
+  for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+    if (it->first.render_pass == render_pass)
+      it = Evict(it);
+    else
+      ++it;
+  }
+}
+
+VulkanFramebufferCache::FramebufferMap::iterator VulkanFramebufferCache::Evict(
+    FramebufferMap::iterator it) {
+  device_queue_->GetDeletionQueue()->Enqueue(it->second);
+  return framebuffers_.erase(it);
+}
+
+}  // namespace gpu
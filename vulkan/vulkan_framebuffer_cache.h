@@ -0,0 +1,82 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_FRAMEBUFFER_CACHE_H_
+#define GPU_VULKAN_VULKAN_FRAMEBUFFER_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// Keeps one VkFramebuffer per render pass, attachment list, extent and layer
+// count, so that drawing a frame looks its framebuffer up instead of creating
+// one.
+//
+// Entries live until an attachment or the render pass is destroyed:
+// VulkanImageView::Destroy() evicts the framebuffers using the view, which
+// covers recreating the swap chain, and render passes call EvictRenderPass().
+// Evicted framebuffers go through the device's deletion queue.
+// VulkanDeviceQueue owns one, see GetFramebufferCache().
+class VULKAN_EXPORT VulkanFramebufferCache {
+ public:
+  explicit VulkanFramebufferCache(VulkanDeviceQueue* device_queue);
+  ~VulkanFramebufferCache();
+
+  // Hands every framebuffer to the deletion queue.
+  void Destroy();
+
+  // Returns the framebuffer of |render_pass| with |attachments|, creating it
+  // on the first call. Returns VK_NULL_HANDLE on failure.
+  VkFramebuffer Get(VkRenderPass render_pass,
+                    const std::vector<VkImageView>& attachments,
+                    const VkExtent2D& extent,
+                    uint32_t layers = 1);
+
+  void EvictImageView(VkImageView image_view);
+  void EvictRenderPass(VkRenderPass render_pass);
+
+  size_t size() const { return framebuffers_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Key {
+    VkRenderPass render_pass;
+    std::vector<VkImageView> attachments;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layers;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  using FramebufferMap = std::unordered_map<Key, VkFramebuffer, KeyHash>;
+
+  // Returns the entry after |it|.
+  FramebufferMap::iterator Evict(FramebufferMap::iterator it);
+
+  VulkanDeviceQueue* device_queue_;
+  FramebufferMap framebuffers_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanFramebufferCache);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_FRAMEBUFFER_CACHE_H_
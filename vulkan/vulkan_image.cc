@@ -0,0 +1,127 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_image.h"
+
+#include "base/logging.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+VulkanImage::VulkanImage(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanImage::~VulkanImage() {
+  DCHECK_EQ(static_cast<VkImage>(VK_NULL_HANDLE), handle_);
+}
+
+bool VulkanImage::Initialize(VkFormat format,
+                             const VkExtent2D& extent,
+                             VkImageUsageFlags usage,
+                             VulkanImageView::ImageType image_type,
+                             VkSampleCountFlagBits samples,
+                             VulkanMemoryUsage memory_usage) {
+  DCHECK_EQ(static_cast<VkImage>(VK_NULL_HANDLE), handle_);
+  VkDevice device = device_queue_->GetVulkanDevice();
+
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = format;
+  image_create_info.extent = {extent.width, extent.height, 1};
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = samples;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.usage = usage;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkResult result =
+      vkCreateImage(device, &image_create_info, nullptr, &handle_);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateImage() failed: " << result;
+    return false;
+  }
+
+  VkMemoryRequirements memory_requirements;
+  vkGetImageMemoryRequirements(device, handle_, &memory_requirements);
+  if (!device_queue_->GetMemoryAllocator()->Allocate(
+          memory_requirements, memory_usage, false, &allocation_)) {
+    DLOG(ERROR) << "Could not allocate image memory.";
+    Destroy();
+    return false;
+  }
+  result = vkBindImageMemory(device, handle_, allocation_.memory,
+                             allocation_.offset);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkBindImageMemory() failed: " << result;
+    Destroy();
+    return false;
+  }
+
+  image_view_.reset(new VulkanImageView(device_queue_));
+  if (!image_view_->Initialize(handle_, VK_IMAGE_VIEW_TYPE_2D, image_type,
+                               format, extent.width, extent.height, 0, 1, 0,
+                               1)) {
+    Destroy();
+    return false;
+  }
+
+  format_ = format;
+  extent_ = extent;
+  samples_ = samples;
+  return true;
+}
+
+void VulkanImage::Destroy() {
+  if (image_view_) {
+    image_view_->Destroy();
+    image_view_.reset();
+  }
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  if (VK_NULL_HANDLE != handle_) {
+    deletion_queue->Enqueue(handle_);
+    handle_ = VK_NULL_HANDLE;
+  }
+  // Tasks run in the order they were enqueued, so the view goes before the
+  // image and the memory is freed last.
+  if (allocation_.IsValid()) {
+    deletion_queue->Enqueue(allocation_);
+    allocation_ = VulkanMemoryAllocation();
+  }
+}
+
+// static
+VkFormat VulkanImage::FindDepthFormat(VulkanDeviceQueue* device_queue,
+                                      bool need_stencil) {
+  // Ordered by precision. D32_SFLOAT is what desktop GPUs prefer; mobile GPUs
+  // often only have D24_UNORM_S8_UINT or D16_UNORM.
+  const VkFormat kCandidates[] = {
+      VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+      VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM};
+  for (VkFormat format : kCandidates) {
+    if (need_stencil && !HasStencil(format))
+      continue;
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(
+        device_queue->GetVulkanPhysicalDevice(), format, &properties);
+    if (properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+// static
+bool VulkanImage::HasStencil(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT ||
+         format == VK_FORMAT_S8_UINT;
+}
+
+}  // namespace gpu
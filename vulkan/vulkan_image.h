@@ -0,0 +1,66 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_IMAGE_H_
+#define GPU_VULKAN_VULKAN_IMAGE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_image_view.h"
+#include "vulkan_memory_allocator.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// A 2D optimal tiling image with its memory and a view of all of it, e.g. a
+// depth buffer or an offscreen color attachment.
+class VULKAN_EXPORT VulkanImage {
+ public:
+  explicit VulkanImage(VulkanDeviceQueue* device_queue);
+  ~VulkanImage();
+
+  bool Initialize(VkFormat format,
+                  const VkExtent2D& extent,
+                  VkImageUsageFlags usage,
+                  VulkanImageView::ImageType image_type,
+                  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+                  VulkanMemoryUsage memory_usage = VulkanMemoryUsage::GPU_ONLY);
+  // The view, the image and its memory go through the device's deletion
+  // queue. Destroying the view evicts its framebuffers right away.
+  void Destroy();
+
+  // The first format of D32_SFLOAT, D32_SFLOAT_S8_UINT, D24_UNORM_S8_UINT and
+  // D16_UNORM that supports optimal tiling depth attachments, only the ones
+  // with a stencil aspect if |need_stencil|. VK_FORMAT_UNDEFINED if none.
+  static VkFormat FindDepthFormat(VulkanDeviceQueue* device_queue,
+                                  bool need_stencil);
+  static bool HasStencil(VkFormat format);
+
+  VkImage handle() const { return handle_; }
+  VulkanImageView* image_view() const { return image_view_.get(); }
+  VkFormat format() const { return format_; }
+  const VkExtent2D& extent() const { return extent_; }
+  VkSampleCountFlagBits samples() const { return samples_; }
+  const VulkanMemoryAllocation& allocation() const { return allocation_; }
+
+ private:
+  VulkanDeviceQueue* device_queue_;
+  VkImage handle_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocation allocation_;
+  std::unique_ptr<VulkanImageView> image_view_;
+  VkFormat format_ = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent_ = {0, 0};
+  VkSampleCountFlagBits samples_ = VK_SAMPLE_COUNT_1_BIT;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanImage);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_IMAGE_H_
@@ -5,7 +5,9 @@
 #include "vulkan_image_view.h"
 
 #include "base/logging.h"
+#include "vulkan_deletion_queue.h"
 #include "vulkan_device_queue.h"
+#include "vulkan_framebuffer_cache.h"
 
 namespace gpu {
 
@@ -84,7 +86,9 @@ bool VulkanImageView::Initialize(VkImage image,
 
 void VulkanImageView::Destroy() {
   if (VK_NULL_HANDLE != handle_) {
-    vkDestroyImageView(device_queue_->GetVulkanDevice(), handle_, nullptr);
+    // Frames in flight may still render into the view and its framebuffers.
+    device_queue_->GetFramebufferCache()->EvictImageView(handle_);
+    device_queue_->GetDeletionQueue()->Enqueue(handle_);
     image_type_ = IMAGE_TYPE_INVALID;
     handle_ = VK_NULL_HANDLE;
   }
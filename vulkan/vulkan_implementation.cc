@@ -5,6 +5,7 @@
 #include "gpu/vulkan/vulkan_implementation.h"
 
 #include <iostream>
+#include <string>
 #include <unordered_set>
 #include <vector>
 #include "base/logging.h"
@@ -72,6 +73,18 @@ struct VulkanInstance {
       }
     }
 
+    // Optional extensions are enabled when present and checked for through
+    // IsVulkanInstanceExtensionEnabled().
+    std::vector<const char*> optional_extensions = {
+#if defined(VK_KHR_get_physical_device_properties2)
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+#endif
+    };
+    for (const char* extension : optional_extensions) {
+      if (CheckExtensionAvailability(extension, available_extensions))
+        extensions.push_back(extension);
+    }
+
     VkApplicationInfo application_info = {
         VK_STRUCTURE_TYPE_APPLICATION_INFO,  // VkStructureType            sType
         nullptr,                             // const void                *pNext
@@ -99,12 +112,14 @@ struct VulkanInstance {
       std::cout << "Could not create Vulkan instance!" << std::endl;
       return false;
     }
+    enabled_extensions.insert(extensions.begin(), extensions.end());
     printf("%s_end\n", __func__);
     return true;
   }
 
   bool valid = false;
   VkInstance vk_instance = VK_NULL_HANDLE;
+  std::unordered_set<std::string> enabled_extensions;
 };
 
 static VulkanInstance* vulkan_instance = nullptr;
@@ -128,4 +143,9 @@ VkInstance GetVulkanInstance() {
   return vulkan_instance->vk_instance;
 }
 
+bool IsVulkanInstanceExtensionEnabled(const char* name) {
+  DCHECK(vulkan_instance);
+  return vulkan_instance->enabled_extensions.count(name) > 0;
+}
+
 }  // namespace gpu
@@ -15,6 +15,10 @@ VULKAN_EXPORT bool VulkanSupported();
 
 VkInstance GetVulkanInstance();
 
+// Whether an optional instance extension, e.g.
+// VK_KHR_get_physical_device_properties2, was available and enabled.
+VULKAN_EXPORT bool IsVulkanInstanceExtensionEnabled(const char* name);
+
 }  // namespace gpu
 
 #endif  // GPU_VULKAN_VULKAN_WSI_API_IMPLEMENTATION_H_
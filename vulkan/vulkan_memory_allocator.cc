@@ -0,0 +1,671 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_memory_allocator.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/values.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_implementation.h"
+
+namespace gpu {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  DCHECK_GT(alignment, 0u);
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment) {
+  DCHECK_GT(alignment, 0u);
+  return value / alignment * alignment;
+}
+
+int CountBits(uint32_t value) {
+  int count = 0;
+  for (; value; value &= value - 1)
+    count++;
+  return count;
+}
+
+size_t UsageIndex(VulkanMemoryUsage usage) {
+  return static_cast<size_t>(usage);
+}
+
+// JSON numbers are doubles, which hold byte counts exactly up to 8 PB.
+void SetBytes(base::DictionaryValue* dictionary,
+              const std::string& key,
+              VkDeviceSize bytes) {
+  dictionary->SetDouble(key, static_cast<double>(bytes));
+}
+
+}  // namespace
+
+const char* VulkanMemoryUsageToString(VulkanMemoryUsage usage) {
+  switch (usage) {
+    case VulkanMemoryUsage::GPU_ONLY:
+      return "gpu_only";
+    case VulkanMemoryUsage::UPLOAD:
+      return "upload";
+    case VulkanMemoryUsage::READBACK:
+      return "readback";
+    case VulkanMemoryUsage::DIRECT_WRITE:
+      return "direct_write";
+    case VulkanMemoryUsage::TRANSIENT:
+      return "transient";
+  }
+  NOTREACHED();
+  return "";
+}
+
+// One VkDeviceMemory object and the free ranges left in it.
+class VulkanMemoryBlock {
+ public:
+  VulkanMemoryBlock(VkDeviceMemory memory,
+                    uint32_t memory_type_index,
+                    bool linear_resource,
+                    VkDeviceSize size,
+                    void* mapped_data,
+                    bool dedicated)
+      : memory_(memory),
+        memory_type_index_(memory_type_index),
+        linear_resource_(linear_resource),
+        size_(size),
+        mapped_data_(mapped_data),
+        dedicated_(dedicated) {
+    free_ranges_[0] = size;
+  }
+
+  // First-fit search over the free ranges. Padding created by |alignment| is
+  // returned to the free list so it can be reused by smaller requests.
+  bool Allocate(VkDeviceSize size,
+                VkDeviceSize alignment,
+                VkDeviceSize* offset) {
+    for (auto it = free_ranges_.begin(); it != free_ranges_.end(); ++it) {
+      const VkDeviceSize range_offset = it->first;
+      const VkDeviceSize range_end = it->first + it->second;
+      const VkDeviceSize aligned_offset = AlignUp(range_offset, alignment);
+      if (aligned_offset + size > range_end)
+        continue;
+
+      free_ranges_.erase(it);
+      if (aligned_offset > range_offset)
+        free_ranges_[range_offset] = aligned_offset - range_offset;
+      if (aligned_offset + size < range_end)
+        free_ranges_[aligned_offset + size] = range_end - aligned_offset - size;
+
+      used_ += size;
+      *offset = aligned_offset;
+      return true;
+    }
+    return false;
+  }
+
+  // Returns [offset, offset + size) to the free list, merging it with the
+  // neighbouring free ranges.
+  void Free(VkDeviceSize offset, VkDeviceSize size) {
+    DCHECK_GE(used_, size);
+    used_ -= size;
+
+    auto next = free_ranges_.lower_bound(offset);
+    if (next != free_ranges_.end() && offset + size == next->first) {
+      size += next->second;
+      next = free_ranges_.erase(next);
+    }
+    if (next != free_ranges_.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += size;
+        return;
+      }
+    }
+    free_ranges_[offset] = size;
+  }
+
+  VkDeviceMemory memory() const { return memory_; }
+  uint32_t memory_type_index() const { return memory_type_index_; }
+  bool linear_resource() const { return linear_resource_; }
+  VkDeviceSize size() const { return size_; }
+  VkDeviceSize used() const { return used_; }
+  void* mapped_data() const { return mapped_data_; }
+  bool dedicated() const { return dedicated_; }
+  bool IsEmpty() const { return used_ == 0; }
+  const std::map<VkDeviceSize, VkDeviceSize>& free_ranges() const {
+    return free_ranges_;
+  }
+
+ private:
+  const VkDeviceMemory memory_;
+  const uint32_t memory_type_index_;
+  const bool linear_resource_;
+  const VkDeviceSize size_;
+  void* const mapped_data_;
+  const bool dedicated_;
+  VkDeviceSize used_ = 0;
+
+  // Free ranges keyed by offset, mapping to their size.
+  std::map<VkDeviceSize, VkDeviceSize> free_ranges_;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanMemoryBlock);
+};
+
+VulkanMemoryAllocator::Statistics::Statistics() {}
+
+VulkanMemoryAllocator::Statistics::Statistics(const Statistics& other) =
+    default;
+
+VulkanMemoryAllocator::Statistics::~Statistics() {}
+
+bool VulkanMemoryAllocator::Statistics::IsOverBudget() const {
+  for (const HeapStatistics& heap : heaps) {
+    if (heap.budget && heap.usage >= heap.budget)
+      return true;
+  }
+  return false;
+}
+
+std::string VulkanMemoryAllocator::Statistics::ToJSON() const {
+  base::DictionaryValue value;
+  value.SetDouble("allocate_memory_calls",
+                  static_cast<double>(allocate_memory_calls));
+  value.SetDouble("allocate_memory_ms", allocate_memory_time.InMillisecondsF());
+  value.SetDouble("total_allocations", static_cast<double>(total_allocations));
+  value.SetDouble("live_allocations", static_cast<double>(live_allocations));
+  value.SetInteger("block_count", block_count);
+  SetBytes(&value, "block_bytes", block_bytes);
+  SetBytes(&value, "peak_block_bytes", peak_block_bytes);
+  SetBytes(&value, "used_bytes", used_bytes);
+  SetBytes(&value, "free_bytes", free_bytes);
+  SetBytes(&value, "largest_free_range", largest_free_range);
+  value.SetDouble("fragmentation", fragmentation);
+  value.SetBoolean("over_budget", IsOverBudget());
+
+  auto heap_list = std::make_unique<base::ListValue>();
+  for (const HeapStatistics& heap : heaps) {
+    auto heap_value = std::make_unique<base::DictionaryValue>();
+    SetBytes(heap_value.get(), "heap_size", heap.heap_size);
+    heap_value->SetBoolean("device_local", heap.device_local);
+    heap_value->SetInteger("block_count", heap.block_count);
+    SetBytes(heap_value.get(), "block_bytes", heap.block_bytes);
+    SetBytes(heap_value.get(), "used_bytes", heap.used_bytes);
+    SetBytes(heap_value.get(), "peak_block_bytes", heap.peak_block_bytes);
+    SetBytes(heap_value.get(), "budget", heap.budget);
+    SetBytes(heap_value.get(), "usage", heap.usage);
+    heap_value->SetBoolean("budget_from_extension", heap.budget_from_extension);
+    heap_list->Append(std::move(heap_value));
+  }
+  value.Set("heaps", std::move(heap_list));
+
+  auto usage_dictionary = std::make_unique<base::DictionaryValue>();
+  for (size_t i = 0; i < kMemoryUsageCount; ++i) {
+    auto usage_value = std::make_unique<base::DictionaryValue>();
+    usage_value->SetDouble("allocation_count",
+                           static_cast<double>(usages[i].allocation_count));
+    SetBytes(usage_value.get(), "used_bytes", usages[i].used_bytes);
+    SetBytes(usage_value.get(), "peak_used_bytes", usages[i].peak_used_bytes);
+    usage_dictionary->SetWithoutPathExpansion(
+        VulkanMemoryUsageToString(static_cast<VulkanMemoryUsage>(i)),
+        std::move(usage_value));
+  }
+  value.Set("usages", std::move(usage_dictionary));
+
+  std::string json;
+  base::JSONWriter::Write(value, &json);
+  return json;
+}
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator() {
+  DCHECK(block_lists_.empty());
+}
+
+bool VulkanMemoryAllocator::Initialize() {
+  memory_properties_ = device_queue_->GetMemoryProperties();
+  non_coherent_atom_size_ = std::max<VkDeviceSize>(
+      1, device_queue_->GetPhysicalDeviceProperties()
+             .limits.nonCoherentAtomSize);
+
+  block_lists_.resize(2 * memory_properties_.memoryTypeCount);
+  heap_block_bytes_.assign(memory_properties_.memoryHeapCount, 0);
+  heap_peak_block_bytes_.assign(memory_properties_.memoryHeapCount, 0);
+
+#if defined(VK_EXT_memory_budget)
+  if (device_queue_->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    vkGetPhysicalDeviceMemoryProperties2KHR_ =
+        reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+            vkGetInstanceProcAddr(GetVulkanInstance(),
+                                  "vkGetPhysicalDeviceMemoryProperties2KHR"));
+  }
+#endif
+  return true;
+}
+
+void VulkanMemoryAllocator::Destroy() {
+  DCHECK_EQ(0u, live_allocations_);
+  VkDevice device = device_queue_->GetVulkanDevice();
+  for (BlockList& block_list : block_lists_) {
+    for (const std::unique_ptr<VulkanMemoryBlock>& block : block_list) {
+      if (block->mapped_data())
+        vkUnmapMemory(device, block->memory());
+      vkFreeMemory(device, block->memory(), nullptr);
+    }
+  }
+  block_lists_.clear();
+}
+
+bool VulkanMemoryAllocator::AllocateFromMemoryType(
+    const VkMemoryRequirements& requirements,
+    uint32_t memory_type_index,
+    VulkanMemoryUsage usage,
+    bool linear_resource,
+    VulkanMemoryAllocation* allocation) {
+  DCHECK_LT(memory_type_index, memory_properties_.memoryTypeCount);
+  DCHECK(requirements.memoryTypeBits & (1u << memory_type_index));
+  DCHECK(!allocation->IsValid());
+
+  // Small heaps (e.g. the 256MB host visible device local heap) get smaller
+  // blocks so a single block can't exhaust them.
+  const uint32_t heap_index =
+      memory_properties_.memoryTypes[memory_type_index].heapIndex;
+  const VkDeviceSize block_size = std::min(
+      kDefaultBlockSize, memory_properties_.memoryHeaps[heap_index].size / 8);
+
+  // Flushes of incoherent memory cover whole nonCoherentAtomSize units, so
+  // such allocations start and end on them.
+  VkDeviceSize size = requirements.size;
+  VkDeviceSize alignment = requirements.alignment;
+  const VkMemoryPropertyFlags flags =
+      memory_properties_.memoryTypes[memory_type_index].propertyFlags;
+  if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+    size = AlignUp(size, non_coherent_atom_size_);
+    alignment = std::max(alignment, non_coherent_atom_size_);
+  }
+
+  VulkanMemoryBlock* block = nullptr;
+  VkDeviceSize offset = 0;
+  if (size > block_size / 2) {
+    // Large resources get a dedicated allocation instead of wasting most of a
+    // shared block.
+    block = CreateBlock(memory_type_index, linear_resource, size, true);
+    if (!block || !block->Allocate(size, 1, &offset))
+      return false;
+  } else {
+    for (const std::unique_ptr<VulkanMemoryBlock>& candidate :
+         GetBlockList(memory_type_index, linear_resource)) {
+      if (!candidate->dedicated() &&
+          candidate->Allocate(size, alignment, &offset)) {
+        block = candidate.get();
+        break;
+      }
+    }
+    if (!block) {
+      block =
+          CreateBlock(memory_type_index, linear_resource, block_size, false);
+      if (!block || !block->Allocate(size, alignment, &offset))
+        return false;
+    }
+  }
+
+  allocation->memory = block->memory();
+  allocation->offset = offset;
+  allocation->size = size;
+  allocation->memory_type_index = memory_type_index;
+  allocation->usage = usage;
+  allocation->mapped_data =
+      block->mapped_data()
+          ? static_cast<uint8_t*>(block->mapped_data()) + offset
+          : nullptr;
+  allocation->block = block;
+
+  total_allocations_++;
+  live_allocations_++;
+
+  UsageStatistics& usage_statistics = usages_[UsageIndex(usage)];
+  usage_statistics.allocation_count++;
+  usage_statistics.used_bytes += size;
+  usage_statistics.peak_used_bytes = std::max(
+      usage_statistics.peak_used_bytes, usage_statistics.used_bytes);
+  return true;
+}
+
+bool VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                     VulkanMemoryUsage usage,
+                                     bool linear_resource,
+                                     VulkanMemoryAllocation* allocation) {
+  // Walk the acceptable types from best to worst, so a full heap (e.g. the
+  // small ReBAR heap) falls back to the next best type.
+  uint32_t memory_type_bits = requirements.memoryTypeBits;
+  while (memory_type_bits) {
+    uint32_t memory_type_index =
+        FindMemoryTypeIndex(memory_properties_, memory_type_bits, usage);
+    if (memory_type_index == UINT32_MAX)
+      return false;
+    if (AllocateFromMemoryType(requirements, memory_type_index, usage,
+                               linear_resource, allocation)) {
+      return true;
+    }
+    memory_type_bits &= ~(1u << memory_type_index);
+  }
+  return false;
+}
+
+void VulkanMemoryAllocator::Free(VulkanMemoryAllocation* allocation) {
+  if (!allocation->IsValid())
+    return;
+
+  VulkanMemoryBlock* block = allocation->block;
+  DCHECK(block);
+  block->Free(allocation->offset, allocation->size);
+  DCHECK_GT(live_allocations_, 0u);
+  live_allocations_--;
+
+  UsageStatistics& usage_statistics = usages_[UsageIndex(allocation->usage)];
+  DCHECK_GT(usage_statistics.allocation_count, 0u);
+  DCHECK_GE(usage_statistics.used_bytes, allocation->size);
+  usage_statistics.allocation_count--;
+  usage_statistics.used_bytes -= allocation->size;
+
+  if (block->IsEmpty()) {
+    // Keep one empty shared block around per list so that a buffer being
+    // recreated doesn't bounce between vkFreeMemory and vkAllocateMemory.
+    const BlockList& block_list =
+        GetBlockList(block->memory_type_index(), block->linear_resource());
+    size_t empty_blocks = std::count_if(
+        block_list.begin(), block_list.end(),
+        [](const std::unique_ptr<VulkanMemoryBlock>& candidate) {
+          return candidate->IsEmpty() && !candidate->dedicated();
+        });
+    if (block->dedicated() || empty_blocks > 1)
+      DestroyBlock(block);
+  }
+
+  *allocation = VulkanMemoryAllocation();
+}
+
+bool VulkanMemoryAllocator::Flush(const VulkanMemoryAllocation& allocation) {
+  return FlushRange(allocation, 0, allocation.size);
+}
+
+bool VulkanMemoryAllocator::FlushRange(const VulkanMemoryAllocation& allocation,
+                                       VkDeviceSize offset,
+                                       VkDeviceSize size) {
+  DCHECK(allocation.IsValid());
+  DCHECK(allocation.mapped_data);
+  DCHECK_LE(offset + size, allocation.size);
+  if (IsCoherent(allocation))
+    return true;
+
+  VkDeviceSize flush_offset = 0;
+  VkDeviceSize flush_size = 0;
+  GetFlushRange(allocation.offset + offset, size, allocation.block->size(),
+                non_coherent_atom_size_, &flush_offset, &flush_size);
+
+  VkMappedMemoryRange flush_range = {
+      VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,  // VkStructureType sType
+      nullptr,                                // const void     *pNext
+      allocation.memory,                      // VkDeviceMemory memory
+      flush_offset,                           // VkDeviceSize   offset
+      flush_size                              // VkDeviceSize   size
+  };
+
+  VkResult result = vkFlushMappedMemoryRanges(device_queue_->GetVulkanDevice(),
+                                              1, &flush_range);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkFlushMappedMemoryRanges() failed: " << result;
+    return false;
+  }
+  return true;
+}
+
+bool VulkanMemoryAllocator::IsCoherent(
+    const VulkanMemoryAllocation& allocation) const {
+  DCHECK_LT(allocation.memory_type_index, memory_properties_.memoryTypeCount);
+  return !!(memory_properties_.memoryTypes[allocation.memory_type_index]
+                .propertyFlags &
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+// static
+void VulkanMemoryAllocator::GetFlushRange(VkDeviceSize offset,
+                                          VkDeviceSize size,
+                                          VkDeviceSize block_size,
+                                          VkDeviceSize non_coherent_atom_size,
+                                          VkDeviceSize* flush_offset,
+                                          VkDeviceSize* flush_size) {
+  DCHECK_LE(offset + size, block_size);
+  *flush_offset = AlignDown(offset, non_coherent_atom_size);
+  const VkDeviceSize end = AlignUp(offset + size, non_coherent_atom_size);
+  // The block size needn't be a multiple of the atom size, in which case
+  // only VK_WHOLE_SIZE can reach its end.
+  *flush_size = end >= block_size ? VK_WHOLE_SIZE : end - *flush_offset;
+}
+
+// static
+uint32_t VulkanMemoryAllocator::FindMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    uint32_t memory_type_bits,
+    VulkanMemoryUsage usage) {
+  // A type must have every |required| flag. It scores 4 for the |primary|
+  // flag, 1 per |secondary| flag and loses 2 per |avoided| flag.
+  VkMemoryPropertyFlags required = 0;
+  VkMemoryPropertyFlags primary = 0;
+  VkMemoryPropertyFlags secondary = 0;
+  VkMemoryPropertyFlags avoided = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  switch (usage) {
+    case VulkanMemoryUsage::GPU_ONLY:
+      primary = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      avoided |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+      break;
+    case VulkanMemoryUsage::UPLOAD:
+      // Written once sequentially by the CPU, so uncached write-combined
+      // memory is ideal. Device local host visible memory is scarce and kept
+      // for DIRECT_WRITE.
+      required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+      primary = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      avoided |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                 VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      break;
+    case VulkanMemoryUsage::READBACK:
+      // CPU reads from uncached memory are extremely slow.
+      required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+      primary = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      secondary = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      break;
+    case VulkanMemoryUsage::DIRECT_WRITE:
+      // Resizable BAR or UMA memory written by the CPU and read by the GPU
+      // in place.
+      required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+      primary = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      secondary = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      avoided |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      break;
+    case VulkanMemoryUsage::TRANSIENT:
+      // Without lazily allocated memory, e.g. on desktop GPUs, this is
+      // GPU_ONLY.
+      primary = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+      secondary = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+      break;
+  }
+
+  // Ties go to the lowest index, since the spec asks implementations to
+  // order types with equal flags by performance.
+  uint32_t best_index = UINT32_MAX;
+  int best_score = 0;
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+    if (!(memory_type_bits & (1u << i)))
+      continue;
+    const VkMemoryPropertyFlags flags =
+        memory_properties.memoryTypes[i].propertyFlags;
+    if ((flags & required) != required)
+      continue;
+
+    int score = (flags & primary) ? 4 : 0;
+    score += CountBits(flags & secondary);
+    score -= 2 * CountBits(flags & avoided);
+    if (best_index == UINT32_MAX || score > best_score) {
+      best_score = score;
+      best_index = i;
+    }
+  }
+  return best_index;
+}
+
+VulkanMemoryAllocator::Statistics VulkanMemoryAllocator::GetStatistics()
+    const {
+  Statistics stats;
+  stats.allocate_memory_calls = allocate_memory_calls_;
+  stats.allocate_memory_time = allocate_memory_time_;
+  stats.total_allocations = total_allocations_;
+  stats.live_allocations = live_allocations_;
+
+  stats.peak_block_bytes = peak_block_bytes_;
+  for (size_t i = 0; i < kMemoryUsageCount; ++i)
+    stats.usages[i] = usages_[i];
+
+  stats.heaps.resize(memory_properties_.memoryHeapCount);
+  for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i) {
+    HeapStatistics& heap = stats.heaps[i];
+    heap.heap_size = memory_properties_.memoryHeaps[i].size;
+    heap.device_local = !!(memory_properties_.memoryHeaps[i].flags &
+                           VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+    heap.block_bytes = heap_block_bytes_[i];
+    heap.peak_block_bytes = heap_peak_block_bytes_[i];
+    heap.budget = heap.heap_size / 10 * 8;
+    heap.usage = heap.block_bytes;
+  }
+
+#if defined(VK_EXT_memory_budget)
+  if (vkGetPhysicalDeviceMemoryProperties2KHR_) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    VkPhysicalDeviceMemoryProperties2KHR memory_properties = {
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+        &budget_properties};
+    vkGetPhysicalDeviceMemoryProperties2KHR_(
+        device_queue_->GetVulkanPhysicalDevice(), &memory_properties);
+    for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i) {
+      stats.heaps[i].budget = budget_properties.heapBudget[i];
+      stats.heaps[i].usage = budget_properties.heapUsage[i];
+      stats.heaps[i].budget_from_extension = true;
+    }
+  }
+#endif
+
+  for (const BlockList& block_list : block_lists_) {
+    for (const std::unique_ptr<VulkanMemoryBlock>& block : block_list) {
+      HeapStatistics& heap =
+          stats.heaps[memory_properties_.memoryTypes[block->memory_type_index()]
+                          .heapIndex];
+      heap.block_count++;
+      heap.used_bytes += block->used();
+      stats.block_count++;
+      stats.block_bytes += block->size();
+      stats.used_bytes += block->used();
+      for (const auto& free_range : block->free_ranges()) {
+        stats.free_range_count++;
+        stats.free_bytes += free_range.second;
+        stats.largest_free_range =
+            std::max(stats.largest_free_range, free_range.second);
+      }
+    }
+  }
+
+  if (stats.free_bytes) {
+    stats.fragmentation =
+        1.0f - static_cast<float>(stats.largest_free_range) /
+                   static_cast<float>(stats.free_bytes);
+  }
+  return stats;
+}
+
+VulkanMemoryAllocator::BlockList& VulkanMemoryAllocator::GetBlockList(
+    uint32_t memory_type_index,
+    bool linear_resource) {
+  DCHECK_LT(2 * memory_type_index + 1, block_lists_.size());
+  return block_lists_[2 * memory_type_index + (linear_resource ? 0 : 1)];
+}
+
+VulkanMemoryBlock* VulkanMemoryAllocator::CreateBlock(
+    uint32_t memory_type_index,
+    bool linear_resource,
+    VkDeviceSize size,
+    bool dedicated) {
+  VkDevice device = device_queue_->GetVulkanDevice();
+
+  VkMemoryAllocateInfo memory_allocate_info = {
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,  // VkStructureType sType
+      nullptr,                                 // const void     *pNext
+      size,               // VkDeviceSize allocationSize
+      memory_type_index   // uint32_t     memoryTypeIndex
+  };
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  VkResult result =
+      vkAllocateMemory(device, &memory_allocate_info, nullptr, &memory);
+  allocate_memory_time_ += base::TimeTicks::Now() - start_time;
+  allocate_memory_calls_++;
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkAllocateMemory() failed: " << result;
+    return nullptr;
+  }
+
+  void* mapped_data = nullptr;
+  if (memory_properties_.memoryTypes[memory_type_index].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped_data);
+    if (VK_SUCCESS != result) {
+      DLOG(ERROR) << "vkMapMemory() failed: " << result;
+      vkFreeMemory(device, memory, nullptr);
+      return nullptr;
+    }
+  }
+
+  const uint32_t heap_index =
+      memory_properties_.memoryTypes[memory_type_index].heapIndex;
+  heap_block_bytes_[heap_index] += size;
+  heap_peak_block_bytes_[heap_index] = std::max(
+      heap_peak_block_bytes_[heap_index], heap_block_bytes_[heap_index]);
+  block_bytes_ += size;
+  peak_block_bytes_ = std::max(peak_block_bytes_, block_bytes_);
+
+  BlockList& block_list = GetBlockList(memory_type_index, linear_resource);
+  block_list.push_back(std::make_unique<VulkanMemoryBlock>(
+      memory, memory_type_index, linear_resource, size, mapped_data,
+      dedicated));
+  return block_list.back().get();
+}
+
+void VulkanMemoryAllocator::DestroyBlock(VulkanMemoryBlock* block) {
+  VkDevice device = device_queue_->GetVulkanDevice();
+  if (block->mapped_data())
+    vkUnmapMemory(device, block->memory());
+  vkFreeMemory(device, block->memory(), nullptr);
+
+  const uint32_t heap_index =
+      memory_properties_.memoryTypes[block->memory_type_index()].heapIndex;
+  DCHECK_GE(heap_block_bytes_[heap_index], block->size());
+  heap_block_bytes_[heap_index] -= block->size();
+  block_bytes_ -= block->size();
+
+  BlockList& block_list =
+      GetBlockList(block->memory_type_index(), block->linear_resource());
+  block_list.erase(
+      std::find_if(block_list.begin(), block_list.end(),
+                   [block](const std::unique_ptr<VulkanMemoryBlock>& candidate) {
+                     return candidate.get() == block;
+                   }));
+}
+
+}  // namespace gpu
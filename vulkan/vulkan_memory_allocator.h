@@ -0,0 +1,235 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
+#define GPU_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanMemoryBlock;
+
+// How a resource's memory is accessed, used to pick a memory type.
+enum class VulkanMemoryUsage {
+  // Only accessed by the GPU, e.g. device local vertex buffers.
+  GPU_ONLY,
+  // Written once by the CPU and copied from by the GPU, e.g. staging buffers.
+  UPLOAD,
+  // Written by the GPU and read back by the CPU.
+  READBACK,
+  // Written by the CPU and read in place by the GPU every frame. Prefers
+  // device local host visible memory (ReBAR/UMA) when it exists.
+  DIRECT_WRITE,
+  // Attachments that are neither loaded nor stored, e.g. multisampled color
+  // or depth. Prefers lazily allocated memory, which tile-based GPUs only
+  // back with pages if the attachment ever leaves tile memory.
+  TRANSIENT,
+
+  LAST = TRANSIENT,
+};
+
+VULKAN_EXPORT const char* VulkanMemoryUsageToString(VulkanMemoryUsage usage);
+
+// A sub-range of a VkDeviceMemory block handed out by VulkanMemoryAllocator.
+// Resources bind to |memory| at |offset|.
+struct VULKAN_EXPORT VulkanMemoryAllocation {
+  bool IsValid() const { return memory != VK_NULL_HANDLE; }
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  uint32_t memory_type_index = UINT32_MAX;
+  VulkanMemoryUsage usage = VulkanMemoryUsage::GPU_ONLY;
+
+  // Host address of |offset| when the memory type is host visible. Blocks are
+  // mapped once for their whole lifetime so this stays valid until Free().
+  void* mapped_data = nullptr;
+
+  // Owning block, only meaningful to the allocator.
+  VulkanMemoryBlock* block = nullptr;
+};
+
+// Device level allocator which reserves large VkDeviceMemory blocks per
+// memory type and sub-allocates aligned ranges out of them, so the number of
+// vkAllocateMemory() calls stays far below maxMemoryAllocationCount.
+class VULKAN_EXPORT VulkanMemoryAllocator {
+ public:
+  static const size_t kMemoryUsageCount =
+      static_cast<size_t>(VulkanMemoryUsage::LAST) + 1;
+
+  struct HeapStatistics {
+    VkDeviceSize heap_size = 0;
+    bool device_local = false;
+
+    // Memory this allocator reserved from the heap and sub-allocated out of
+    // it, and the high-water mark of the former.
+    uint32_t block_count = 0;
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+    VkDeviceSize peak_block_bytes = 0;
+
+    // How much of the heap the process may use and uses, counting other
+    // allocators and the driver. Reported by VK_EXT_memory_budget when
+    // |budget_from_extension|, otherwise estimated as 80% of the heap and
+    // |block_bytes|.
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    bool budget_from_extension = false;
+  };
+
+  struct UsageStatistics {
+    uint64_t allocation_count = 0;
+    VkDeviceSize used_bytes = 0;
+    VkDeviceSize peak_used_bytes = 0;
+  };
+
+  struct VULKAN_EXPORT Statistics {
+    Statistics();
+    Statistics(const Statistics& other);
+    ~Statistics();
+
+    // Number of vkAllocateMemory() calls made and the time spent in them.
+    uint64_t allocate_memory_calls = 0;
+    base::TimeDelta allocate_memory_time;
+
+    // Sub-allocations handed out since creation and currently alive.
+    uint64_t total_allocations = 0;
+    uint64_t live_allocations = 0;
+
+    uint32_t block_count = 0;
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+
+    // Free space of all blocks and the largest contiguous part of it.
+    uint32_t free_range_count = 0;
+    VkDeviceSize free_bytes = 0;
+    VkDeviceSize largest_free_range = 0;
+
+    // 0 when all free space is contiguous, approaching 1 as it gets split
+    // into many small ranges.
+    float fragmentation = 0.0f;
+
+    VkDeviceSize peak_block_bytes = 0;
+    std::vector<HeapStatistics> heaps;
+    UsageStatistics usages[kMemoryUsageCount];
+
+    // Whether any heap is at or over its budget, which is when further
+    // allocations start evicting or failing.
+    bool IsOverBudget() const;
+
+    // Serializes the statistics with base::JSONWriter, e.g. for sampling in
+    // production or attaching to bug reports.
+    std::string ToJSON() const;
+  };
+
+  explicit VulkanMemoryAllocator(VulkanDeviceQueue* device_queue);
+  ~VulkanMemoryAllocator();
+
+  bool Initialize();
+  void Destroy();
+
+  // Sub-allocates memory satisfying |requirements| from the best memory type
+  // for |usage|, falling back to the next best type if the preferred heap is
+  // exhausted. |linear_resource| is true for buffers and linear images, which
+  // are kept in separate blocks from optimal images so
+  // bufferImageGranularity never needs to be honored between neighbours.
+  bool Allocate(const VkMemoryRequirements& requirements,
+                VulkanMemoryUsage usage,
+                bool linear_resource,
+                VulkanMemoryAllocation* allocation);
+  void Free(VulkanMemoryAllocation* allocation);
+
+  // Flushes host writes to |allocation|, rounded to nonCoherentAtomSize.
+  // This is a no-op for coherent memory. Allocations of incoherent memory
+  // are padded to whole atoms, so the rounding never reaches a neighbour.
+  bool Flush(const VulkanMemoryAllocation& allocation);
+  // Same for the |size| bytes at |offset| within |allocation|.
+  bool FlushRange(const VulkanMemoryAllocation& allocation,
+                  VkDeviceSize offset,
+                  VkDeviceSize size);
+  bool IsCoherent(const VulkanMemoryAllocation& allocation) const;
+
+  // Computes the range to flush for host writes to [|offset|, |offset| +
+  // |size|) of a block of |block_size| bytes. The start is rounded down and
+  // the end up to |non_coherent_atom_size|, and a range reaching the end of
+  // the block becomes VK_WHOLE_SIZE.
+  static void GetFlushRange(VkDeviceSize offset,
+                            VkDeviceSize size,
+                            VkDeviceSize block_size,
+                            VkDeviceSize non_coherent_atom_size,
+                            VkDeviceSize* flush_offset,
+                            VkDeviceSize* flush_size);
+
+  // Scores the types in |memory_type_bits| for |usage| and returns the best
+  // one, or UINT32_MAX if none is usable.
+  static uint32_t FindMemoryTypeIndex(
+      const VkPhysicalDeviceMemoryProperties& memory_properties,
+      uint32_t memory_type_bits,
+      VulkanMemoryUsage usage);
+
+  Statistics GetStatistics() const;
+
+  // Default size of the blocks reserved per memory type.
+  static const VkDeviceSize kDefaultBlockSize = 64 * 1024 * 1024;
+
+ private:
+  using BlockList = std::vector<std::unique_ptr<VulkanMemoryBlock>>;
+
+  bool AllocateFromMemoryType(const VkMemoryRequirements& requirements,
+                              uint32_t memory_type_index,
+                              VulkanMemoryUsage usage,
+                              bool linear_resource,
+                              VulkanMemoryAllocation* allocation);
+  BlockList& GetBlockList(uint32_t memory_type_index, bool linear_resource);
+  VulkanMemoryBlock* CreateBlock(uint32_t memory_type_index,
+                                 bool linear_resource,
+                                 VkDeviceSize size,
+                                 bool dedicated);
+  void DestroyBlock(VulkanMemoryBlock* block);
+
+  VulkanDeviceQueue* device_queue_;
+
+  // Copied from VulkanDeviceQueue's cache in Initialize().
+  VkPhysicalDeviceMemoryProperties memory_properties_ = {};
+  VkDeviceSize non_coherent_atom_size_ = 1;
+
+  // Two block lists per memory type: [2 * type] for linear resources and
+  // [2 * type + 1] for optimal images.
+  std::vector<BlockList> block_lists_;
+
+  uint64_t allocate_memory_calls_ = 0;
+  base::TimeDelta allocate_memory_time_;
+  uint64_t total_allocations_ = 0;
+  uint64_t live_allocations_ = 0;
+
+  // Bytes in blocks per heap, their peaks and the peak over all heaps.
+  std::vector<VkDeviceSize> heap_block_bytes_;
+  std::vector<VkDeviceSize> heap_peak_block_bytes_;
+  VkDeviceSize block_bytes_ = 0;
+  VkDeviceSize peak_block_bytes_ = 0;
+
+  UsageStatistics usages_[kMemoryUsageCount];
+
+#if defined(VK_EXT_memory_budget)
+  // Set when VK_EXT_memory_budget is enabled.
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR
+      vkGetPhysicalDeviceMemoryProperties2KHR_ = nullptr;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanMemoryAllocator);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
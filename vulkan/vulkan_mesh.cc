@@ -0,0 +1,65 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_mesh.h"
+
+#include <string.h>
+
+#include <unordered_map>
+
+#include "base/logging.h"
+
+namespace gpu {
+
+namespace {
+
+struct VertexKey {
+  const uint8_t* data;
+  size_t size;
+};
+
+struct VertexKeyHash {
+  size_t operator()(const VertexKey& key) const {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key.size; ++i) {
+      hash ^= key.data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+};
+
+struct VertexKeyEqual {
+  bool operator()(const VertexKey& a, const VertexKey& b) const {
+    return memcmp(a.data, b.data, a.size) == 0;
+  }
+};
+
+}  // namespace
+
+uint32_t GenerateVertexRemap(const void* vertices,
+                             uint32_t vertex_count,
+                             size_t vertex_size,
+                             std::vector<uint32_t>* remap) {
+  DCHECK(vertices || !vertex_count);
+  DCHECK_GT(vertex_size, 0u);
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+  std::unordered_map<VertexKey, uint32_t, VertexKeyHash, VertexKeyEqual>
+      unique_vertices(vertex_count);
+
+  remap->resize(vertex_count);
+  uint32_t unique_count = 0;
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    VertexKey key = {bytes + i * vertex_size, vertex_size};
+    auto result = unique_vertices.insert(std::make_pair(key, unique_count));
+    if (result.second)
+      unique_count++;
+    (*remap)[i] = result.first->second;
+  }
+  return unique_count;
+}
+
+}  // namespace gpu
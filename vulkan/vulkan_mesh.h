@@ -0,0 +1,49 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_MESH_H_
+#define GPU_VULKAN_VULKAN_MESH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+// Deduplicates |vertex_count| vertices of |vertex_size| bytes each. Vertices
+// are compared byte by byte, so vertex types must not contain uninitialized
+// padding. Fills |remap| with the unique index of every input vertex, unique
+// vertices being numbered in order of first occurrence, and returns the
+// number of unique vertices.
+VULKAN_EXPORT uint32_t GenerateVertexRemap(const void* vertices,
+                                           uint32_t vertex_count,
+                                           size_t vertex_size,
+                                           std::vector<uint32_t>* remap);
+
+// An indexed triangle list.
+template <typename Vertex>
+struct VulkanMesh {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Turns an expanded triangle list, e.g. the 36 vertices of a cube, into
+// unique vertices and an index list drawing the same triangles.
+template <typename Vertex>
+VulkanMesh<Vertex> WeldVertices(const Vertex* vertices, uint32_t vertex_count) {
+  VulkanMesh<Vertex> mesh;
+  uint32_t unique_count = GenerateVertexRemap(vertices, vertex_count,
+                                              sizeof(Vertex), &mesh.indices);
+  mesh.vertices.resize(unique_count);
+  for (uint32_t i = 0; i < vertex_count; ++i)
+    mesh.vertices[mesh.indices[i]] = vertices[i];
+  return mesh;
+}
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_MESH_H_
@@ -0,0 +1,387 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_mesh_optimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace gpu {
+
+namespace {
+
+// Tuning of Forsyth's scoring function, see
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+const uint32_t kForsythCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+const uint32_t kMaxScoredValence = 32;
+
+class VertexScoreTable {
+ public:
+  VertexScoreTable() {
+    for (uint32_t i = 0; i < kForsythCacheSize; ++i) {
+      if (i < 3) {
+        cache_scores_[i] = kLastTriangleScore;
+      } else {
+        const float scale = 1.0f / (kForsythCacheSize - 3);
+        cache_scores_[i] =
+            powf(1.0f - (i - 3) * scale, kCacheDecayPower);
+      }
+    }
+    valence_scores_[0] = 0.0f;
+    for (uint32_t i = 1; i <= kMaxScoredValence; ++i) {
+      valence_scores_[i] =
+          kValenceBoostScale * powf(static_cast<float>(i), -kValenceBoostPower);
+    }
+  }
+
+  // |cache_position| is -1 for vertices that aren't cached.
+  float Score(int cache_position, uint32_t remaining_valence) const {
+    if (remaining_valence == 0)
+      return -1.0f;
+    float score = cache_position >= 0 ? cache_scores_[cache_position] : 0.0f;
+    return score +
+           valence_scores_[std::min(remaining_valence, kMaxScoredValence)];
+  }
+
+ private:
+  float cache_scores_[kForsythCacheSize];
+  float valence_scores_[kMaxScoredValence + 1];
+};
+
+// Simulates a FIFO post-transform cache one vertex at a time.
+class FifoCache {
+ public:
+  FifoCache(uint32_t vertex_count, uint32_t cache_size)
+      : timestamps_(vertex_count, 0),
+        cache_size_(cache_size),
+        timestamp_(cache_size + 1) {}
+
+  // Returns true if |vertex| had to be transformed.
+  bool Access(uint32_t vertex) {
+    if (timestamp_ - timestamps_[vertex] <= cache_size_)
+      return false;
+    timestamps_[vertex] = timestamp_++;
+    return true;
+  }
+
+ private:
+  std::vector<uint32_t> timestamps_;
+  const uint32_t cache_size_;
+  uint32_t timestamp_;
+};
+
+struct Cluster {
+  size_t first_triangle;
+  size_t triangle_count;
+  float sort_key;
+};
+
+const float* Position(const float* vertex_positions,
+                      size_t stride,
+                      uint32_t vertex) {
+  return reinterpret_cast<const float*>(
+      reinterpret_cast<const uint8_t*>(vertex_positions) + vertex * stride);
+}
+
+}  // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices,
+                                         size_t index_count,
+                                         uint32_t vertex_count,
+                                         uint32_t cache_size) {
+  DCHECK_EQ(0u, index_count % 3);
+  DCHECK_GT(cache_size, 0u);
+
+  VertexCacheStatistics statistics;
+  if (!index_count)
+    return statistics;
+
+  FifoCache cache(vertex_count, cache_size);
+  std::vector<bool> referenced(vertex_count, false);
+  uint32_t unique_vertices = 0;
+  for (size_t i = 0; i < index_count; ++i) {
+    DCHECK_LT(indices[i], vertex_count);
+    if (cache.Access(indices[i]))
+      statistics.vertices_transformed++;
+    if (!referenced[indices[i]]) {
+      referenced[indices[i]] = true;
+      unique_vertices++;
+    }
+  }
+
+  statistics.acmr =
+      static_cast<float>(statistics.vertices_transformed) / (index_count / 3);
+  statistics.atvr =
+      static_cast<float>(statistics.vertices_transformed) / unique_vertices;
+  return statistics;
+}
+
+void OptimizeVertexCache(uint32_t* destination,
+                         const uint32_t* indices,
+                         size_t index_count,
+                         uint32_t vertex_count) {
+  DCHECK_EQ(0u, index_count % 3);
+  const size_t triangle_count = index_count / 3;
+  if (!triangle_count)
+    return;
+
+  // Triangles using each vertex, in CSR form. The first
+  // |remaining_valence[v]| entries of a vertex's range are the triangles not
+  // emitted yet.
+  std::vector<uint32_t> remaining_valence(vertex_count, 0);
+  for (size_t i = 0; i < index_count; ++i) {
+    DCHECK_LT(indices[i], vertex_count);
+    remaining_valence[indices[i]]++;
+  }
+  std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+  for (uint32_t v = 0; v < vertex_count; ++v)
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining_valence[v];
+  std::vector<uint32_t> adjacency(index_count);
+  {
+    std::vector<uint32_t> fill(adjacency_offsets.begin(),
+                               adjacency_offsets.end() - 1);
+    for (size_t i = 0; i < index_count; ++i)
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  const VertexScoreTable score_table;
+  std::vector<int> cache_positions(vertex_count, -1);
+  std::vector<float> vertex_scores(vertex_count);
+  for (uint32_t v = 0; v < vertex_count; ++v)
+    vertex_scores[v] = score_table.Score(-1, remaining_valence[v]);
+
+  std::vector<float> triangle_scores(triangle_count);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    triangle_scores[t] = vertex_scores[indices[t * 3]] +
+                         vertex_scores[indices[t * 3 + 1]] +
+                         vertex_scores[indices[t * 3 + 2]];
+  }
+  std::vector<bool> emitted(triangle_count, false);
+
+  // |destination| may alias |indices|, which is read until the end.
+  std::vector<uint32_t> result(index_count);
+
+  uint32_t cache[kForsythCacheSize + 3];
+  size_t cache_count = 0;
+  size_t input_cursor = 0;
+  size_t best_triangle =
+      std::max_element(triangle_scores.begin(), triangle_scores.end()) -
+      triangle_scores.begin();
+
+  for (size_t output = 0; output < triangle_count; ++output) {
+    if (best_triangle == SIZE_MAX) {
+      // Nothing in the cache has triangles left. Restart at the next triangle
+      // in input order, which is as good as any and keeps this linear.
+      while (emitted[input_cursor])
+        input_cursor++;
+      best_triangle = input_cursor;
+    }
+
+    const uint32_t* triangle = &indices[best_triangle * 3];
+    memcpy(&result[output * 3], triangle, 3 * sizeof(uint32_t));
+    emitted[best_triangle] = true;
+
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t v = triangle[corner];
+      uint32_t* begin = &adjacency[adjacency_offsets[v]];
+      uint32_t* end = begin + remaining_valence[v];
+      uint32_t* it = std::find(begin, end, best_triangle);
+      DCHECK(it != end);
+      std::swap(*it, *(end - 1));
+      remaining_valence[v]--;
+    }
+
+    // Move the triangle's vertices to the front of the LRU cache. The ones
+    // pushed past kForsythCacheSize are evicted.
+    uint32_t new_cache[kForsythCacheSize + 3];
+    size_t new_cache_count = 0;
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t v = triangle[corner];
+      if (std::find(new_cache, new_cache + new_cache_count, v) ==
+          new_cache + new_cache_count) {
+        new_cache[new_cache_count++] = v;
+      }
+    }
+    for (size_t i = 0; i < cache_count; ++i) {
+      const uint32_t v = cache[i];
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+        new_cache[new_cache_count++] = v;
+    }
+
+    for (size_t i = 0; i < new_cache_count; ++i) {
+      const uint32_t v = new_cache[i];
+      cache_positions[v] =
+          i < kForsythCacheSize ? static_cast<int>(i) : -1;
+      vertex_scores[v] =
+          score_table.Score(cache_positions[v], remaining_valence[v]);
+    }
+    cache_count = std::min<size_t>(new_cache_count, kForsythCacheSize);
+    memcpy(cache, new_cache, cache_count * sizeof(uint32_t));
+
+    // Rescore the triangles touching changed vertices and continue with the
+    // best one that uses a cached vertex.
+    best_triangle = SIZE_MAX;
+    float best_score = -1.0f;
+    for (size_t i = 0; i < new_cache_count; ++i) {
+      const uint32_t v = new_cache[i];
+      const uint32_t* begin = &adjacency[adjacency_offsets[v]];
+      for (const uint32_t* it = begin; it != begin + remaining_valence[v];
+           ++it) {
+        const uint32_t t = *it;
+        const float score = vertex_scores[indices[t * 3]] +
+                            vertex_scores[indices[t * 3 + 1]] +
+                            vertex_scores[indices[t * 3 + 2]];
+        triangle_scores[t] = score;
+        if (i < kForsythCacheSize && score > best_score) {
+          best_score = score;
+          best_triangle = t;
+        }
+      }
+    }
+  }
+
+  memcpy(destination, result.data(), index_count * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* destination,
+                      const uint32_t* indices,
+                      size_t index_count,
+                      const float* vertex_positions,
+                      uint32_t vertex_count,
+                      size_t vertex_positions_stride) {
+  DCHECK_EQ(0u, index_count % 3);
+  DCHECK_GE(vertex_positions_stride, 3 * sizeof(float));
+  const size_t triangle_count = index_count / 3;
+  if (triangle_count < 2) {
+    memmove(destination, indices, index_count * sizeof(uint32_t));
+    return;
+  }
+
+  // Split into clusters where all three vertices miss the cache, i.e. where
+  // the cache order started over, and where a triangle misses twice while
+  // the cluster so far is at least as cache friendly as the whole mesh.
+  const VertexCacheStatistics mesh_statistics =
+      AnalyzeVertexCache(indices, index_count, vertex_count);
+  std::vector<Cluster> clusters;
+  {
+    FifoCache cache(vertex_count, kDefaultVertexCacheSize);
+    size_t cluster_start = 0;
+    uint32_t cluster_misses = 0;
+    for (size_t t = 0; t < triangle_count; ++t) {
+      uint32_t misses = 0;
+      for (int corner = 0; corner < 3; ++corner)
+        misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+
+      const size_t cluster_size = t - cluster_start;
+      const bool split =
+          misses == 3 ||
+          (misses == 2 && cluster_size &&
+           cluster_misses <= mesh_statistics.acmr * cluster_size);
+      if (t > cluster_start && split) {
+        clusters.push_back({cluster_start, cluster_size, 0.0f});
+        cluster_start = t;
+        cluster_misses = 0;
+      }
+      cluster_misses += misses;
+    }
+    clusters.push_back({cluster_start, triangle_count - cluster_start, 0.0f});
+  }
+
+  // Area weighted centroid and normal of each cluster.
+  std::vector<float> centroids(clusters.size() * 3, 0.0f);
+  std::vector<float> normals(clusters.size() * 3, 0.0f);
+  float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+  float mesh_area = 0.0f;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    float* centroid = &centroids[c * 3];
+    float* normal = &normals[c * 3];
+    float cluster_area = 0.0f;
+    for (size_t t = clusters[c].first_triangle;
+         t < clusters[c].first_triangle + clusters[c].triangle_count; ++t) {
+      const float* p0 =
+          Position(vertex_positions, vertex_positions_stride, indices[t * 3]);
+      const float* p1 = Position(vertex_positions, vertex_positions_stride,
+                                 indices[t * 3 + 1]);
+      const float* p2 = Position(vertex_positions, vertex_positions_stride,
+                                 indices[t * 3 + 2]);
+      const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      const float cross[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                              e1[2] * e2[0] - e1[0] * e2[2],
+                              e1[0] * e2[1] - e1[1] * e2[0]};
+      const float area = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] +
+                               cross[2] * cross[2]);
+      for (int i = 0; i < 3; ++i) {
+        centroid[i] += (p0[i] + p1[i] + p2[i]) * (area / 3.0f);
+        normal[i] += cross[i];
+      }
+      cluster_area += area;
+    }
+    for (int i = 0; i < 3; ++i)
+      mesh_centroid[i] += centroid[i];
+    mesh_area += cluster_area;
+    if (cluster_area > 0.0f) {
+      for (int i = 0; i < 3; ++i)
+        centroid[i] /= cluster_area;
+    }
+  }
+  if (mesh_area > 0.0f) {
+    for (int i = 0; i < 3; ++i)
+      mesh_centroid[i] /= mesh_area;
+  }
+
+  // Clusters far out along their normal occlude the rest of the mesh from
+  // most view directions, so draw them first.
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const float* centroid = &centroids[c * 3];
+    const float* normal = &normals[c * 3];
+    const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                               normal[2] * normal[2]);
+    float key = 0.0f;
+    if (length > 0.0f) {
+      for (int i = 0; i < 3; ++i)
+        key += (centroid[i] - mesh_centroid[i]) * normal[i] / length;
+    }
+    clusters[c].sort_key = key;
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.sort_key > b.sort_key;
+                   });
+
+  std::vector<uint32_t> result;
+  result.reserve(index_count);
+  for (const Cluster& cluster : clusters) {
+    result.insert(result.end(), indices + cluster.first_triangle * 3,
+                  indices + (cluster.first_triangle + cluster.triangle_count) *
+                                3);
+  }
+  memcpy(destination, result.data(), index_count * sizeof(uint32_t));
+}
+
+uint32_t OptimizeVertexFetchRemap(uint32_t* indices,
+                                  size_t index_count,
+                                  uint32_t vertex_count,
+                                  std::vector<uint32_t>* remap) {
+  remap->assign(vertex_count, UINT32_MAX);
+  uint32_t next_vertex = 0;
+  for (size_t i = 0; i < index_count; ++i) {
+    DCHECK_LT(indices[i], vertex_count);
+    uint32_t& new_index = (*remap)[indices[i]];
+    if (new_index == UINT32_MAX)
+      new_index = next_vertex++;
+    indices[i] = new_index;
+  }
+  return next_vertex;
+}
+
+}  // namespace gpu
@@ -0,0 +1,185 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_parallel_recorder.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "vulkan_command_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+namespace {
+
+// First draw of |thread_index|'s range. 64-bit so that many draws on many
+// threads can't overflow.
+uint32_t RangeBegin(uint32_t draw_count,
+                    uint32_t thread_index,
+                    uint32_t thread_count) {
+  return static_cast<uint32_t>(static_cast<uint64_t>(draw_count) *
+                               thread_index / thread_count);
+}
+
+}  // namespace
+
+VulkanParallelRecorder::ThreadData::ThreadData() {}
+
+VulkanParallelRecorder::ThreadData::~ThreadData() {
+  DCHECK(command_pools.empty());
+  DCHECK(command_buffers.empty());
+}
+
+VulkanParallelRecorder::VulkanParallelRecorder(VulkanDeviceQueue* device_queue,
+                                               uint32_t thread_count,
+                                               uint32_t frames_in_flight)
+    : device_queue_(device_queue),
+      thread_count_(thread_count
+                        ? thread_count
+                        : std::max(1u, std::thread::hardware_concurrency())),
+      frames_in_flight_(frames_in_flight) {}
+
+VulkanParallelRecorder::~VulkanParallelRecorder() {
+  DCHECK(thread_data_.empty());
+  DCHECK(workers_.empty());
+}
+
+bool VulkanParallelRecorder::Initialize() {
+  quit_ = false;
+  for (uint32_t i = 0; i < thread_count_; ++i) {
+    std::unique_ptr<ThreadData> data(new ThreadData);
+    for (uint32_t frame = 0; frame < frames_in_flight_; ++frame) {
+      std::unique_ptr<VulkanCommandPool> command_pool =
+          device_queue_->CreateCommandPool(
+              nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                           VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+              device_queue_->GetGraphicsQueueFamilyIndex());
+      if (!command_pool) {
+        thread_data_.push_back(std::move(data));
+        return false;
+      }
+      std::unique_ptr<VulkanCommandBuffer> command_buffer =
+          command_pool->CreateSecondaryCommandBuffer();
+      data->command_pools.push_back(std::move(command_pool));
+      if (!command_buffer) {
+        thread_data_.push_back(std::move(data));
+        return false;
+      }
+      data->command_buffers.push_back(std::move(command_buffer));
+    }
+    thread_data_.push_back(std::move(data));
+  }
+
+  // The calling thread records range 0.
+  for (uint32_t i = 1; i < thread_count_; ++i)
+    workers_.emplace_back(&VulkanParallelRecorder::WorkerMain, this, i);
+  return true;
+}
+
+void VulkanParallelRecorder::Destroy() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    quit_ = true;
+  }
+  work_available_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+  workers_.clear();
+
+  for (std::unique_ptr<ThreadData>& data : thread_data_) {
+    for (std::unique_ptr<VulkanCommandBuffer>& command_buffer :
+         data->command_buffers) {
+      command_buffer->Destroy();
+    }
+    data->command_buffers.clear();
+    for (std::unique_ptr<VulkanCommandPool>& command_pool :
+         data->command_pools) {
+      command_pool->Destroy();
+    }
+    data->command_pools.clear();
+  }
+  thread_data_.clear();
+}
+
+void VulkanParallelRecorder::Record(uint32_t frame_index,
+                                    VkCommandBuffer primary_command_buffer,
+                                    VkRenderPass render_pass,
+                                    uint32_t subpass,
+                                    VkFramebuffer framebuffer,
+                                    uint32_t draw_count,
+                                    const RecordCallback& callback) {
+  DCHECK_LT(frame_index, frames_in_flight_);
+  DCHECK_EQ(thread_count_, thread_data_.size());
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    DCHECK_EQ(0u, busy_workers_);
+    frame_index_ = frame_index;
+    render_pass_ = render_pass;
+    subpass_ = subpass;
+    framebuffer_ = framebuffer;
+    draw_count_ = draw_count;
+    callback_ = &callback;
+    busy_workers_ = thread_count_ - 1;
+    ++generation_;
+  }
+  work_available_.notify_all();
+
+  RecordRange(0);
+
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    work_done_.wait(lock, [this] { return busy_workers_ == 0; });
+    callback_ = nullptr;
+  }
+
+  // Threads whose range came out empty recorded nothing.
+  std::vector<VulkanCommandBuffer*> secondaries;
+  for (uint32_t i = 0; i < thread_count_; ++i) {
+    if (RangeBegin(draw_count, i, thread_count_) !=
+        RangeBegin(draw_count, i + 1, thread_count_)) {
+      secondaries.push_back(
+          thread_data_[i]->command_buffers[frame_index].get());
+    }
+  }
+  VulkanCommandBuffer::EnqueueAll(primary_command_buffer, secondaries.data(),
+                                  static_cast<uint32_t>(secondaries.size()));
+}
+
+void VulkanParallelRecorder::WorkerMain(uint32_t thread_index) {
+  uint64_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      work_available_.wait(lock, [this, generation] {
+        return quit_ || generation_ != generation;
+      });
+      if (quit_)
+        return;
+      generation = generation_;
+    }
+
+    RecordRange(thread_index);
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (--busy_workers_ == 0)
+      work_done_.notify_one();
+  }
+}
+
+void VulkanParallelRecorder::RecordRange(uint32_t thread_index) {
+  const uint32_t begin = RangeBegin(draw_count_, thread_index, thread_count_);
+  const uint32_t end = RangeBegin(draw_count_, thread_index + 1, thread_count_);
+  if (begin == end)
+    return;
+
+  VulkanCommandBuffer* command_buffer =
+      thread_data_[thread_index]->command_buffers[frame_index_].get();
+  ScopedSecondaryCommandBufferRecorder recorder(*command_buffer, render_pass_,
+                                                subpass_, framebuffer_);
+  (*callback_)(recorder.handle(), begin, end, thread_index);
+}
+
+}  // namespace gpu
@@ -0,0 +1,105 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_PARALLEL_RECORDER_H_
+#define GPU_VULKAN_VULKAN_PARALLEL_RECORDER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanCommandBuffer;
+class VulkanCommandPool;
+class VulkanDeviceQueue;
+
+// Records the draws of a frame on several threads. Vulkan command pools must
+// be externally synchronized, so every thread gets its own pool per frame in
+// flight and records a secondary command buffer for a contiguous range of
+// the draws. The calling thread records the first range itself, and the
+// primary command buffer executes all of them with one
+// vkCmdExecuteCommands().
+class VULKAN_EXPORT VulkanParallelRecorder {
+ public:
+  // Records draws [begin, end) into |command_buffer|. Called concurrently
+  // from all threads, so it must only read shared state.
+  using RecordCallback = std::function<void(VkCommandBuffer command_buffer,
+                                            uint32_t begin,
+                                            uint32_t end,
+                                            uint32_t thread_index)>;
+
+  // |thread_count| includes the calling thread; 0 uses every core.
+  VulkanParallelRecorder(VulkanDeviceQueue* device_queue,
+                         uint32_t thread_count,
+                         uint32_t frames_in_flight);
+  ~VulkanParallelRecorder();
+
+  bool Initialize();
+  void Destroy();
+
+  // Splits |draw_count| draws across the threads and enqueues the recorded
+  // secondary command buffers into |primary_command_buffer|. With a
+  // |render_pass| the primary must be inside |subpass| of it, begun with
+  // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. The command buffers of
+  // |frame_index| are reused, so the previous submission of that frame must
+  // have completed.
+  void Record(uint32_t frame_index,
+              VkCommandBuffer primary_command_buffer,
+              VkRenderPass render_pass,
+              uint32_t subpass,
+              VkFramebuffer framebuffer,
+              uint32_t draw_count,
+              const RecordCallback& callback);
+
+  uint32_t thread_count() const { return thread_count_; }
+
+ private:
+  struct ThreadData {
+    ThreadData();
+    ~ThreadData();
+
+    // One pool and secondary command buffer per frame in flight.
+    std::vector<std::unique_ptr<VulkanCommandPool>> command_pools;
+    std::vector<std::unique_ptr<VulkanCommandBuffer>> command_buffers;
+  };
+
+  void WorkerMain(uint32_t thread_index);
+  void RecordRange(uint32_t thread_index);
+
+  VulkanDeviceQueue* device_queue_;
+  const uint32_t thread_count_;
+  const uint32_t frames_in_flight_;
+  std::vector<std::unique_ptr<ThreadData>> thread_data_;
+  std::vector<std::thread> workers_;
+
+  // Guards the job below, which workers pick up when |generation_| changes.
+  std::mutex lock_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+  uint64_t generation_ = 0;
+  uint32_t busy_workers_ = 0;
+  bool quit_ = false;
+
+  uint32_t frame_index_ = 0;
+  VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  uint32_t subpass_ = 0;
+  VkFramebuffer framebuffer_ = VK_NULL_HANDLE;
+  uint32_t draw_count_ = 0;
+  const RecordCallback* callback_ = nullptr;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanParallelRecorder);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_PARALLEL_RECORDER_H_
@@ -0,0 +1,334 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_pipeline.h"
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_shader_module.h"
+
+namespace gpu {
+
+VulkanShaderSource::VulkanShaderSource() {}
+
+VulkanShaderSource::VulkanShaderSource(const char* source)
+    : VulkanShaderSource(std::string(source)) {}
+
+VulkanShaderSource::VulkanShaderSource(const std::string& source) {
+  if (source.empty())
+    return;
+  source_ = std::make_shared<const std::string>(source);
+  hash_ = std::hash<std::string>()(source);
+}
+
+VulkanShaderSource::VulkanShaderSource(const VulkanShaderSource& other) =
+    default;
+
+VulkanShaderSource::~VulkanShaderSource() {}
+
+VulkanShaderSource& VulkanShaderSource::operator=(
+    const VulkanShaderSource& other) = default;
+
+std::string VulkanShaderSource::str() const {
+  return source_ ? *source_ : std::string();
+}
+
+bool VulkanShaderSource::operator==(const VulkanShaderSource& other) const {
+  if (source_ == other.source_)
+    return true;
+  if (!source_ || !other.source_ || hash_ != other.hash_)
+    return false;
+  return *source_ == *other.source_;
+}
+
+VulkanPipelineDescription::VulkanPipelineDescription() {}
+
+VulkanPipelineDescription::VulkanPipelineDescription(
+    const VulkanPipelineDescription& other) = default;
+
+VulkanPipelineDescription::~VulkanPipelineDescription() {}
+
+namespace {
+
+template <typename T>
+size_t HashCombine(size_t seed, const T& value) {
+  return seed * 31 + std::hash<T>()(value);
+}
+
+bool BindingsEqual(const VkVertexInputBindingDescription& a,
+                   const VkVertexInputBindingDescription& b) {
+  return a.binding == b.binding && a.stride == b.stride &&
+         a.inputRate == b.inputRate;
+}
+
+bool AttributesEqual(const VkVertexInputAttributeDescription& a,
+                     const VkVertexInputAttributeDescription& b) {
+  return a.location == b.location && a.binding == b.binding &&
+         a.format == b.format && a.offset == b.offset;
+}
+
+}  // namespace
+
+bool VulkanPipelineDescription::operator==(
+    const VulkanPipelineDescription& other) const {
+  if (dynamic_viewport != other.dynamic_viewport)
+    return false;
+  if (!dynamic_viewport &&
+      (static_extent.width != other.static_extent.width ||
+       static_extent.height != other.static_extent.height)) {
+    return false;
+  }
+  // Cheap fields first, the shader sources last. Those compare their hashes
+  // before the text.
+  return layout == other.layout && render_pass == other.render_pass &&
+         subpass == other.subpass && topology == other.topology &&
+         polygon_mode == other.polygon_mode &&
+         cull_mode == other.cull_mode && front_face == other.front_face &&
+         samples == other.samples &&
+         blend_enable == other.blend_enable &&
+         additive_blend == other.additive_blend &&
+         color_attachment_count == other.color_attachment_count &&
+         color_write_enable == other.color_write_enable &&
+         depth_test_enable == other.depth_test_enable &&
+         depth_write_enable == other.depth_write_enable &&
+         depth_compare_op == other.depth_compare_op &&
+         vertex_input.bindings.size() == other.vertex_input.bindings.size() &&
+         std::equal(vertex_input.bindings.begin(), vertex_input.bindings.end(),
+                    other.vertex_input.bindings.begin(), BindingsEqual) &&
+         vertex_input.attributes.size() ==
+             other.vertex_input.attributes.size() &&
+         std::equal(vertex_input.attributes.begin(),
+                    vertex_input.attributes.end(),
+                    other.vertex_input.attributes.begin(), AttributesEqual) &&
+         vertex_shader_source == other.vertex_shader_source &&
+         fragment_shader_source == other.fragment_shader_source;
+}
+
+size_t HashPipelineDescription(const VulkanPipelineDescription& description) {
+  size_t hash = description.vertex_shader_source.hash();
+  hash = HashCombine(hash, description.fragment_shader_source.hash());
+  hash = HashCombine(hash, static_cast<uint32_t>(description.topology));
+  for (const VkVertexInputBindingDescription& binding :
+       description.vertex_input.bindings) {
+    hash = HashCombine(hash, binding.binding);
+    hash = HashCombine(hash, binding.stride);
+    hash = HashCombine(hash, static_cast<uint32_t>(binding.inputRate));
+  }
+  for (const VkVertexInputAttributeDescription& attribute :
+       description.vertex_input.attributes) {
+    hash = HashCombine(hash, attribute.location);
+    hash = HashCombine(hash, attribute.binding);
+    hash = HashCombine(hash, static_cast<uint32_t>(attribute.format));
+    hash = HashCombine(hash, attribute.offset);
+  }
+  hash = HashCombine(hash, static_cast<uint32_t>(description.polygon_mode));
+  hash = HashCombine(hash, description.cull_mode);
+  hash = HashCombine(hash, static_cast<uint32_t>(description.front_face));
+  hash = HashCombine(hash, static_cast<uint32_t>(description.samples));
+  hash = HashCombine(hash, description.blend_enable);
+  hash = HashCombine(hash, description.additive_blend);
+  hash = HashCombine(hash, description.color_attachment_count);
+  hash = HashCombine(hash, description.color_write_enable);
+  hash = HashCombine(hash, description.depth_test_enable);
+  hash = HashCombine(hash, description.depth_write_enable);
+  hash = HashCombine(hash, static_cast<uint32_t>(description.depth_compare_op));
+  hash = HashCombine(hash, description.dynamic_viewport);
+  if (!description.dynamic_viewport) {
+    hash = HashCombine(hash, description.static_extent.width);
+    hash = HashCombine(hash, description.static_extent.height);
+  }
+  hash = HashCombine(hash, description.layout);
+  hash = HashCombine(hash, description.render_pass);
+  return HashCombine(hash, description.subpass);
+}
+
+VkPipeline BuildGraphicsPipeline(VulkanDeviceQueue* device_queue,
+                                 const VulkanPipelineDescription& description,
+                                 std::string* error) {
+  DCHECK_NE(static_cast<VkPipelineLayout>(VK_NULL_HANDLE), description.layout);
+  DCHECK_NE(static_cast<VkRenderPass>(VK_NULL_HANDLE),
+            description.render_pass);
+  VkDevice device = device_queue->GetVulkanDevice();
+
+  // shaderc compilers are created per call, so the shaders of several
+  // pipelines can be compiled concurrently.
+  VulkanShaderModule vertex_shader_module(device);
+  if (!vertex_shader_module.InitializeGLSL(
+          VulkanShaderModule::ShaderType::VERTEX, "vertex", "main",
+          description.vertex_shader_source.str())) {
+    *error = "vertex shader error = " + vertex_shader_module.GetErrorMessages();
+    return VK_NULL_HANDLE;
+  }
+  const bool has_fragment_shader = !description.fragment_shader_source.empty();
+  DCHECK(has_fragment_shader || !description.color_write_enable);
+  VulkanShaderModule fragment_shader_module(device);
+  if (has_fragment_shader &&
+      !fragment_shader_module.InitializeGLSL(
+          VulkanShaderModule::ShaderType::FRAGMENT, "fragment", "main",
+          description.fragment_shader_source.str())) {
+    *error = "fragment shader error = " +
+             fragment_shader_module.GetErrorMessages();
+    vertex_shader_module.Destroy();
+    return VK_NULL_HANDLE;
+  }
+
+  VkPipelineShaderStageCreateInfo shader_stages[2] = {};
+  shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shader_stages[0].module = vertex_shader_module.handle();
+  shader_stages[0].pName = "main";
+  shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shader_stages[1].module = fragment_shader_module.handle();
+  shader_stages[1].pName = "main";
+
+  const VulkanVertexInput& vertex_input = description.vertex_input;
+  VkPipelineVertexInputStateCreateInfo vertex_input_state = {};
+  vertex_input_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input_state.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(vertex_input.bindings.size());
+  vertex_input_state.pVertexBindingDescriptions = vertex_input.bindings.data();
+  vertex_input_state.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(vertex_input.attributes.size());
+  vertex_input_state.pVertexAttributeDescriptions =
+      vertex_input.attributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {};
+  input_assembly_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly_state.topology = description.topology;
+
+  VkViewport viewport = {
+      0.0f, 0.0f,
+      static_cast<float>(description.static_extent.width),
+      static_cast<float>(description.static_extent.height),
+      0.0f, 1.0f};
+  VkRect2D scissor = {{0, 0}, description.static_extent};
+  VkPipelineViewportStateCreateInfo viewport_state = {};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+  if (!description.dynamic_viewport) {
+    viewport_state.pViewports = &viewport;
+    viewport_state.pScissors = &scissor;
+  }
+
+  VkPipelineRasterizationStateCreateInfo rasterization_state = {};
+  rasterization_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization_state.polygonMode = description.polygon_mode;
+  rasterization_state.cullMode = description.cull_mode;
+  rasterization_state.frontFace = description.front_face;
+  rasterization_state.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisample_state = {};
+  multisample_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample_state.rasterizationSamples = description.samples;
+  multisample_state.minSampleShading = 1.0f;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {};
+  depth_stencil_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil_state.depthTestEnable =
+      description.depth_test_enable ? VK_TRUE : VK_FALSE;
+  depth_stencil_state.depthWriteEnable =
+      description.depth_write_enable ? VK_TRUE : VK_FALSE;
+  depth_stencil_state.depthCompareOp = description.depth_compare_op;
+  depth_stencil_state.minDepthBounds = 0.0f;
+  depth_stencil_state.maxDepthBounds = 1.0f;
+
+  VkPipelineColorBlendAttachmentState color_blend_attachment_state = {};
+  color_blend_attachment_state.blendEnable =
+      description.blend_enable ? VK_TRUE : VK_FALSE;
+  color_blend_attachment_state.srcColorBlendFactor =
+      description.blend_enable && !description.additive_blend
+          ? VK_BLEND_FACTOR_SRC_ALPHA
+          : VK_BLEND_FACTOR_ONE;
+  color_blend_attachment_state.colorBlendOp = VK_BLEND_OP_ADD;
+  color_blend_attachment_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  color_blend_attachment_state.alphaBlendOp = VK_BLEND_OP_ADD;
+  if (!description.blend_enable) {
+    color_blend_attachment_state.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  } else if (description.additive_blend) {
+    color_blend_attachment_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  } else {
+    color_blend_attachment_state.dstColorBlendFactor =
+        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment_state.dstAlphaBlendFactor =
+        VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  }
+  if (description.color_write_enable) {
+    color_blend_attachment_state.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  }
+  // Without independentBlend every attachment must have the same state.
+  const std::vector<VkPipelineColorBlendAttachmentState>
+      color_blend_attachment_states(description.color_attachment_count,
+                                    color_blend_attachment_state);
+  VkPipelineColorBlendStateCreateInfo color_blend_state = {};
+  color_blend_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  color_blend_state.logicOp = VK_LOGIC_OP_COPY;
+  color_blend_state.attachmentCount = description.color_attachment_count;
+  color_blend_state.pAttachments = color_blend_attachment_states.data();
+
+  const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                           VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamic_state = {};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = arraysize(dynamic_states);
+  dynamic_state.pDynamicStates = dynamic_states;
+
+  VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+  pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_create_info.stageCount = has_fragment_shader ? 2 : 1;
+  pipeline_create_info.pStages = shader_stages;
+  pipeline_create_info.pVertexInputState = &vertex_input_state;
+  pipeline_create_info.pInputAssemblyState = &input_assembly_state;
+  pipeline_create_info.pViewportState = &viewport_state;
+  pipeline_create_info.pRasterizationState = &rasterization_state;
+  pipeline_create_info.pMultisampleState = &multisample_state;
+  pipeline_create_info.pDepthStencilState = &depth_stencil_state;
+  pipeline_create_info.pColorBlendState = &color_blend_state;
+  pipeline_create_info.pDynamicState =
+      description.dynamic_viewport ? &dynamic_state : nullptr;
+  pipeline_create_info.layout = description.layout;
+  pipeline_create_info.renderPass = description.render_pass;
+  pipeline_create_info.subpass = description.subpass;
+  pipeline_create_info.basePipelineIndex = -1;
+
+  // VkPipelineCache is internally synchronized, so concurrent builds share
+  // the device's cache.
+  VulkanPipelineCache* pipeline_cache = device_queue->GetPipelineCache();
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult result =
+      vkCreateGraphicsPipelines(device, pipeline_cache->handle(), 1,
+                                &pipeline_create_info, nullptr, &pipeline);
+
+  vertex_shader_module.Destroy();
+  fragment_shader_module.Destroy();
+
+  if (VK_SUCCESS != result) {
+    std::stringstream ss;
+    ss << "vkCreateGraphicsPipelines() failed: " << result;
+    *error = ss.str();
+    return VK_NULL_HANDLE;
+  }
+  pipeline_cache->OnPipelineCreated();
+  return pipeline;
+}
+
+}  // namespace gpu
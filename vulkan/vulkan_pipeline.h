@@ -0,0 +1,115 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_PIPELINE_H_
+#define GPU_VULKAN_VULKAN_PIPELINE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <string>
+
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_vertex_format.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// GLSL source of a shader stage, hashed once when it is assigned. Copies
+// share the string, so descriptions copied from one another compare their
+// shaders by pointer, and others only compare the text when the hashes
+// match.
+class VULKAN_EXPORT VulkanShaderSource {
+ public:
+  VulkanShaderSource();
+  // Implicit, so descriptions can be assigned GLSL directly.
+  VulkanShaderSource(const char* source);         // NOLINT(runtime/explicit)
+  VulkanShaderSource(const std::string& source);  // NOLINT(runtime/explicit)
+  VulkanShaderSource(const VulkanShaderSource& other);
+  ~VulkanShaderSource();
+
+  VulkanShaderSource& operator=(const VulkanShaderSource& other);
+
+  std::string str() const;
+  bool empty() const { return !source_; }
+  size_t hash() const { return hash_; }
+
+  bool operator==(const VulkanShaderSource& other) const;
+  bool operator!=(const VulkanShaderSource& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  // Null for an empty source.
+  std::shared_ptr<const std::string> source_;
+  size_t hash_ = 0;
+};
+
+// Everything needed to build a graphics pipeline, with the shaders still in
+// GLSL. A description is plain data, so it can be handed to another thread
+// and built there, see VulkanPipelineCompiler.
+struct VULKAN_EXPORT VulkanPipelineDescription {
+  VulkanPipelineDescription();
+  VulkanPipelineDescription(const VulkanPipelineDescription& other);
+  ~VulkanPipelineDescription();
+
+  VulkanShaderSource vertex_shader_source;
+  VulkanShaderSource fragment_shader_source;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VulkanVertexInput vertex_input;
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  // Must match the sample count of the subpass's attachments.
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  // Blends the fragment over the attachment by its alpha, or adds it with
+  // |additive_blend|, e.g. to accumulate lights.
+  bool blend_enable = false;
+  bool additive_blend = false;
+  // Must match the subpass's color attachments, which all get the same blend
+  // state.
+  uint32_t color_attachment_count = 1;
+  // Without color writes, e.g. for a depth pre-pass, the fragment shader
+  // may be empty and then only the vertex shader runs.
+  bool color_write_enable = true;
+
+  // Only used when the subpass has a depth attachment.
+  bool depth_test_enable = false;
+  bool depth_write_enable = false;
+  VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  // Viewport and scissor are set with vkCmdSetViewport() and
+  // vkCmdSetScissor(). Otherwise both are baked in at |static_extent|.
+  bool dynamic_viewport = true;
+  VkExtent2D static_extent = {300, 300};
+
+  // Not owned. Both must stay alive until the pipeline is built.
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+
+  // Whether both build the same pipeline. |static_extent| is ignored with a
+  // dynamic viewport.
+  bool operator==(const VulkanPipelineDescription& other) const;
+  bool operator!=(const VulkanPipelineDescription& other) const {
+    return !(*this == other);
+  }
+};
+
+// Hash of everything operator==() compares, see VulkanPipelineRegistry.
+VULKAN_EXPORT size_t
+HashPipelineDescription(const VulkanPipelineDescription& description);
+
+// Compiles the shaders of |description| and creates its pipeline through the
+// device's pipeline cache. Safe to call from any thread. On failure returns
+// VK_NULL_HANDLE and sets |error|.
+VULKAN_EXPORT VkPipeline
+BuildGraphicsPipeline(VulkanDeviceQueue* device_queue,
+                      const VulkanPipelineDescription& description,
+                      std::string* error);
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_PIPELINE_H_
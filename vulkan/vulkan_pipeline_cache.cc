@@ -0,0 +1,210 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_pipeline_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+namespace {
+
+// Minimum time between two saves by SaveIfDirty().
+const int64_t kSaveIntervalSeconds = 5;
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE.
+struct PipelineCacheHeader {
+  uint32_t header_length;
+  uint32_t header_version;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+};
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  data->assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+bool WriteAll(int fd, const std::vector<uint8_t>& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    written += result;
+  }
+  return true;
+}
+
+bool WriteFileAtomically(const std::string& path,
+                         const std::vector<uint8_t>& data) {
+  const std::string temp_path = path + ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0600);
+  if (fd < 0)
+    return false;
+  // The data must be on disk before the rename, or a power loss could leave
+  // |path| pointing at an empty file.
+  const bool written = WriteAll(fd, data) && fsync(fd) == 0;
+  if (close(fd) != 0 || !written) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  // rename() replaces |path| atomically.
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    remove(temp_path.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable.
+  const size_t separator = path.rfind('/');
+  const std::string directory =
+      separator == std::string::npos ? "." : path.substr(0, separator + 1);
+  int directory_fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+  if (directory_fd >= 0) {
+    fsync(directory_fd);
+    close(directory_fd);
+  }
+  return true;
+}
+
+}  // namespace
+
+VulkanPipelineCache::VulkanPipelineCache(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanPipelineCache::~VulkanPipelineCache() {
+  DCHECK_EQ(static_cast<VkPipelineCache>(VK_NULL_HANDLE), handle_);
+}
+
+bool VulkanPipelineCache::Initialize(const std::string& path) {
+  DCHECK_EQ(static_cast<VkPipelineCache>(VK_NULL_HANDLE), handle_);
+  path_ = path;
+
+  std::vector<uint8_t> data;
+  if (!path_.empty() && ReadFile(path_, &data)) {
+    if (!IsCompatible(data)) {
+      DLOG(ERROR) << "Ignoring pipeline cache from another device or driver: "
+                  << path_;
+      data.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo pipeline_cache_create_info = {};
+  pipeline_cache_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipeline_cache_create_info.initialDataSize = data.size();
+  pipeline_cache_create_info.pInitialData = data.empty() ? nullptr
+                                                         : data.data();
+  VkResult result =
+      vkCreatePipelineCache(device_queue_->GetVulkanDevice(),
+                            &pipeline_cache_create_info, nullptr, &handle_);
+  if (VK_SUCCESS != result && !data.empty()) {
+    // The driver may still reject data with a matching header.
+    DLOG(ERROR) << "vkCreatePipelineCache() rejected " << path_ << ": "
+                << result;
+    data.clear();
+    pipeline_cache_create_info.initialDataSize = 0;
+    pipeline_cache_create_info.pInitialData = nullptr;
+    result = vkCreatePipelineCache(device_queue_->GetVulkanDevice(),
+                                   &pipeline_cache_create_info, nullptr,
+                                   &handle_);
+  }
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreatePipelineCache() failed: " << result;
+    return false;
+  }
+
+  loaded_size_ = data.size();
+  saved_size_ = data.size();
+  last_save_time_ = base::TimeTicks::Now();
+  return true;
+}
+
+void VulkanPipelineCache::Destroy() {
+  if (VK_NULL_HANDLE == handle_)
+    return;
+  Save();
+  vkDestroyPipelineCache(device_queue_->GetVulkanDevice(), handle_, nullptr);
+  handle_ = VK_NULL_HANDLE;
+}
+
+bool VulkanPipelineCache::Save() {
+  if (path_.empty() || VK_NULL_HANDLE == handle_)
+    return true;
+  // Pipelines created from here on are in the next save.
+  dirty_ = false;
+  last_save_time_ = base::TimeTicks::Now();
+
+  VkDevice device = device_queue_->GetVulkanDevice();
+  size_t size = 0;
+  VkResult result = vkGetPipelineCacheData(device, handle_, &size, nullptr);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkGetPipelineCacheData() failed: " << result;
+    return false;
+  }
+  // Pipeline caches only grow, so an unchanged size means nothing was added.
+  if (size == saved_size_)
+    return true;
+
+  std::vector<uint8_t> data(size);
+  result = vkGetPipelineCacheData(device, handle_, &size, data.data());
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkGetPipelineCacheData() failed: " << result;
+    return false;
+  }
+  data.resize(size);
+
+  if (!WriteFileAtomically(path_, data)) {
+    DLOG(ERROR) << "Could not write pipeline cache " << path_;
+    return false;
+  }
+  saved_size_ = size;
+  return true;
+}
+
+bool VulkanPipelineCache::SaveIfDirty() {
+  if (!dirty_ || base::TimeTicks::Now() - last_save_time_ <
+                     base::TimeDelta::FromSeconds(kSaveIntervalSeconds)) {
+    return true;
+  }
+  return Save();
+}
+
+bool VulkanPipelineCache::IsCompatible(
+    const std::vector<uint8_t>& data) const {
+  PipelineCacheHeader header;
+  if (data.size() < sizeof(header))
+    return false;
+  memcpy(&header, data.data(), sizeof(header));
+
+  const VkPhysicalDeviceProperties& properties =
+      device_queue_->GetPhysicalDeviceProperties();
+  return header.header_length >= sizeof(header) &&
+         header.header_length <= data.size() &&
+         header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendor_id == properties.vendorID &&
+         header.device_id == properties.deviceID &&
+         memcmp(header.pipeline_cache_uuid, properties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+}  // namespace gpu
@@ -0,0 +1,77 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_PIPELINE_CACHE_H_
+#define GPU_VULKAN_VULKAN_PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/time/time.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// A VkPipelineCache persisted to a file, so that pipelines compiled by an
+// earlier run are reused instead of compiled again.
+//
+// The file holds the data returned by vkGetPipelineCacheData(). It is only
+// used when its header matches the device's vendorID, deviceID and
+// pipelineCacheUUID, since a driver update or another GPU can't use it.
+// Saving writes and syncs a temporary file and renames it over the old one,
+// so neither a crash nor a power loss leaves a truncated cache behind.
+// VulkanDeviceQueue owns one, see GetPipelineCache(), and saves it from
+// EndFrame() a while after new pipelines were created.
+class VULKAN_EXPORT VulkanPipelineCache {
+ public:
+  explicit VulkanPipelineCache(VulkanDeviceQueue* device_queue);
+  ~VulkanPipelineCache();
+
+  // Loads |path| when it exists. An empty |path| keeps the cache in memory.
+  bool Initialize(const std::string& path);
+  // Saves the cache and destroys it.
+  void Destroy();
+
+  // Writes the cache to its file if pipelines were added since the last
+  // save. Returns false on failure.
+  bool Save();
+  // Calls Save() if OnPipelineCreated() was called since the last save and
+  // the last save is at least a few seconds old, so a burst of compiles is
+  // written once.
+  bool SaveIfDirty();
+
+  // Marks the cache as changed. Called by BuildGraphicsPipeline() on any
+  // thread.
+  void OnPipelineCreated() { dirty_ = true; }
+
+  // Whether |data| starts with a header for this device.
+  bool IsCompatible(const std::vector<uint8_t>& data) const;
+
+  VkPipelineCache handle() const { return handle_; }
+  const std::string& path() const { return path_; }
+  // Size of the data Initialize() accepted from the file, 0 on a cold start.
+  size_t loaded_size() const { return loaded_size_; }
+
+ private:
+  VulkanDeviceQueue* device_queue_;
+  VkPipelineCache handle_ = VK_NULL_HANDLE;
+  std::string path_;
+  size_t loaded_size_ = 0;
+  // Size of the data last loaded or saved, to skip saving an unchanged cache.
+  size_t saved_size_ = 0;
+  std::atomic<bool> dirty_{false};
+  base::TimeTicks last_save_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanPipelineCache);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_PIPELINE_CACHE_H_
@@ -0,0 +1,164 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_pipeline_compiler.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+namespace {
+
+uint32_t DefaultThreadCount() {
+  const uint32_t cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+}  // namespace
+
+VulkanPendingPipeline::VulkanPendingPipeline(VkDevice device)
+    : device_(device) {}
+
+VulkanPendingPipeline::~VulkanPendingPipeline() {
+  // Nothing can have recorded a pipeline that was never handed out.
+  if (VK_NULL_HANDLE != pipeline_ && !handed_out_)
+    vkDestroyPipeline(device_, pipeline_, nullptr);
+}
+
+void VulkanPendingPipeline::Wait() const {
+  std::unique_lock<std::mutex> lock(lock_);
+  finished_.wait(lock, [this] { return IsReady(); });
+}
+
+VkPipeline VulkanPendingPipeline::pipeline() {
+  return GetOr(VK_NULL_HANDLE);
+}
+
+VkPipeline VulkanPendingPipeline::GetOr(VkPipeline fallback) {
+  if (!IsReady() || VK_NULL_HANDLE == pipeline_)
+    return fallback;
+  handed_out_ = true;
+  return pipeline_;
+}
+
+const std::string& VulkanPendingPipeline::error() const {
+  DCHECK(IsReady());
+  return error_;
+}
+
+void VulkanPendingPipeline::Finish(VkPipeline pipeline, std::string error) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    DCHECK(!IsReady());
+    pipeline_ = pipeline;
+    error_ = std::move(error);
+    ready_.store(true, std::memory_order_release);
+  }
+  finished_.notify_all();
+}
+
+VulkanPipelineCompiler::Job::Job() {}
+
+VulkanPipelineCompiler::Job::Job(Job&& other) = default;
+
+VulkanPipelineCompiler::Job::~Job() {}
+
+VulkanPipelineCompiler::VulkanPipelineCompiler(VulkanDeviceQueue* device_queue,
+                                               uint32_t thread_count)
+    : device_queue_(device_queue),
+      thread_count_(thread_count ? thread_count : DefaultThreadCount()) {}
+
+VulkanPipelineCompiler::~VulkanPipelineCompiler() {
+  DCHECK(workers_.empty());
+}
+
+bool VulkanPipelineCompiler::Initialize() {
+  DCHECK(workers_.empty());
+  quit_ = false;
+  for (uint32_t i = 0; i < thread_count_; ++i)
+    workers_.emplace_back(&VulkanPipelineCompiler::WorkerMain, this);
+  return true;
+}
+
+void VulkanPipelineCompiler::Destroy() {
+  std::deque<Job> cancelled;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    quit_ = true;
+    cancelled.swap(jobs_);
+  }
+  work_available_.notify_all();
+  for (std::thread& worker : workers_)
+    worker.join();
+  workers_.clear();
+
+  for (Job& job : cancelled) {
+    std::shared_ptr<VulkanPendingPipeline> pending = job.pending.lock();
+    if (pending)
+      pending->Finish(VK_NULL_HANDLE, "Pipeline compilation was cancelled");
+  }
+  idle_.notify_all();
+}
+
+std::shared_ptr<VulkanPendingPipeline> VulkanPipelineCompiler::Compile(
+    const VulkanPipelineDescription& description) {
+  DCHECK(!workers_.empty());
+  std::shared_ptr<VulkanPendingPipeline> pending =
+      std::make_shared<VulkanPendingPipeline>(device_queue_->GetVulkanDevice());
+  Job job;
+  job.description = description;
+  job.pending = pending;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    jobs_.push_back(std::move(job));
+  }
+  work_available_.notify_one();
+  return pending;
+}
+
+void VulkanPipelineCompiler::WaitIdle() {
+  std::unique_lock<std::mutex> lock(lock_);
+  idle_.wait(lock, [this] { return jobs_.empty() && busy_workers_ == 0; });
+}
+
+size_t VulkanPipelineCompiler::num_queued() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return jobs_.size();
+}
+
+void VulkanPipelineCompiler::WorkerMain() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    work_available_.wait(lock, [this] { return quit_ || !jobs_.empty(); });
+    if (quit_)
+      return;
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    ++busy_workers_;
+    lock.unlock();
+
+    // Holding a reference for the whole build keeps the result alive until
+    // Finish() hands it over.
+    std::shared_ptr<VulkanPendingPipeline> pending = job.pending.lock();
+    if (pending) {
+      std::string error;
+      VkPipeline pipeline =
+          BuildGraphicsPipeline(device_queue_, job.description, &error);
+      if (VK_NULL_HANDLE == pipeline)
+        DLOG(ERROR) << error;
+      pending->Finish(pipeline, std::move(error));
+      pending.reset();
+    }
+
+    lock.lock();
+    --busy_workers_;
+    if (jobs_.empty() && busy_workers_ == 0)
+      idle_.notify_all();
+  }
+}
+
+}  // namespace gpu
@@ -0,0 +1,130 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_PIPELINE_COMPILER_H_
+#define GPU_VULKAN_VULKAN_PIPELINE_COMPILER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_pipeline.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// A pipeline that VulkanPipelineCompiler is building. The frame loop polls
+// IsReady() and draws with a fallback pipeline, or skips the draw, until it
+// is.
+//
+// Once pipeline() or GetOr() has returned the pipeline, it belongs to the
+// caller, who destroys it like any other pipeline, e.g. with
+// VulkanDeletionQueue. A pipeline that was never handed out is destroyed
+// with its VulkanPendingPipeline.
+class VULKAN_EXPORT VulkanPendingPipeline {
+ public:
+  explicit VulkanPendingPipeline(VkDevice device);
+  ~VulkanPendingPipeline();
+
+  // Whether the build finished, successfully or not. Never blocks.
+  bool IsReady() const { return ready_.load(std::memory_order_acquire); }
+  // Blocks until the build finished.
+  void Wait() const;
+
+  // The pipeline, or VK_NULL_HANDLE while building and on failure.
+  VkPipeline pipeline();
+  // The pipeline if it is ready, otherwise |fallback|.
+  VkPipeline GetOr(VkPipeline fallback);
+  // Why the build failed. Only valid once ready.
+  const std::string& error() const;
+
+ private:
+  friend class VulkanPipelineCompiler;
+
+  void Finish(VkPipeline pipeline, std::string error);
+
+  VkDevice device_;
+  mutable std::mutex lock_;
+  mutable std::condition_variable finished_;
+  std::atomic<bool> ready_{false};
+  // Written once before |ready_| is set.
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  std::string error_;
+  std::atomic<bool> handed_out_{false};
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanPendingPipeline);
+};
+
+// Builds pipelines on a pool of worker threads, so that new materials don't
+// stall the frame loop on shader compilation and vkCreateGraphicsPipelines().
+// Builds share the device's VulkanPipelineCache, so a pipeline compiled by an
+// earlier run is usually ready within a few frames.
+//
+// Compile() is called from one thread, typically the frame loop. A build is
+// skipped when every reference to its VulkanPendingPipeline was dropped
+// before a worker got to it.
+class VULKAN_EXPORT VulkanPipelineCompiler {
+ public:
+  // 0 threads uses every core but one, which is left to the frame loop.
+  VulkanPipelineCompiler(VulkanDeviceQueue* device_queue,
+                         uint32_t thread_count);
+  ~VulkanPipelineCompiler();
+
+  bool Initialize();
+  // Finishes the builds in progress and cancels the queued ones, which fail
+  // with an error.
+  void Destroy();
+
+  // Queues a build of |description|. Its layout and render pass must stay
+  // alive until the returned pipeline is ready.
+  std::shared_ptr<VulkanPendingPipeline> Compile(
+      const VulkanPipelineDescription& description);
+
+  // Blocks until every queued build finished, e.g. behind a loading screen.
+  void WaitIdle();
+
+  uint32_t thread_count() const { return thread_count_; }
+  // Builds that haven't started yet.
+  size_t num_queued() const;
+
+ private:
+  struct Job {
+    Job();
+    Job(Job&& other);
+    ~Job();
+
+    VulkanPipelineDescription description;
+    std::weak_ptr<VulkanPendingPipeline> pending;
+  };
+
+  void WorkerMain();
+
+  VulkanDeviceQueue* device_queue_;
+  const uint32_t thread_count_;
+  std::vector<std::thread> workers_;
+
+  // Guards the members below.
+  mutable std::mutex lock_;
+  std::condition_variable work_available_;
+  std::condition_variable idle_;
+  std::deque<Job> jobs_;
+  uint32_t busy_workers_ = 0;
+  bool quit_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanPipelineCompiler);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_PIPELINE_COMPILER_H_
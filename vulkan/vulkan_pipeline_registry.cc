@@ -0,0 +1,252 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_pipeline_registry.h"
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_pipeline_compiler.h"
+
+namespace gpu {
+
+namespace {
+
+bool PushConstantRangesEqual(const VkPushConstantRange& a,
+                             const VkPushConstantRange& b) {
+  return a.stageFlags == b.stageFlags && a.offset == b.offset &&
+         a.size == b.size;
+}
+
+bool BindingsEqual(const VkDescriptorSetLayoutBinding& a,
+                   const VkDescriptorSetLayoutBinding& b) {
+  return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+         a.descriptorCount == b.descriptorCount &&
+         a.stageFlags == b.stageFlags;
+}
+
+}  // namespace
+
+VulkanPipelineRegistry::Entry::Entry() {}
+
+VulkanPipelineRegistry::Entry::Entry(Entry&& other) = default;
+
+VulkanPipelineRegistry::Entry::~Entry() {}
+
+VulkanPipelineRegistry::Entry& VulkanPipelineRegistry::Entry::operator=(
+    Entry&& other) = default;
+
+VulkanPipelineRegistry::Layout::Layout() {}
+
+VulkanPipelineRegistry::Layout::Layout(const Layout& other) = default;
+
+VulkanPipelineRegistry::Layout::~Layout() {}
+
+VulkanPipelineRegistry::SetLayout::SetLayout() {}
+
+VulkanPipelineRegistry::SetLayout::SetLayout(const SetLayout& other) =
+    default;
+
+VulkanPipelineRegistry::SetLayout::~SetLayout() {}
+
+VulkanPipelineRegistry::VulkanPipelineRegistry(
+    VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanPipelineRegistry::~VulkanPipelineRegistry() {
+  DCHECK(entries_.empty());
+  DCHECK(layouts_.empty());
+  DCHECK(set_layouts_.empty());
+}
+
+void VulkanPipelineRegistry::Destroy() {
+  for (auto& bucket : entries_) {
+    for (Entry& entry : bucket.second)
+      Evict(&entry);
+  }
+  entries_.clear();
+  size_ = 0;
+
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  for (Layout& layout : layouts_)
+    deletion_queue->Enqueue(layout.handle);
+  layouts_.clear();
+  for (SetLayout& set_layout : set_layouts_)
+    deletion_queue->Enqueue(set_layout.handle);
+  set_layouts_.clear();
+}
+
+VkPipeline VulkanPipelineRegistry::Get(
+    const VulkanPipelineDescription& description) {
+  return Get(description, HashPipelineDescription(description));
+}
+
+VkPipeline VulkanPipelineRegistry::Get(
+    const VulkanPipelineDescription& description,
+    size_t hash) {
+  DCHECK_EQ(HashPipelineDescription(description), hash);
+  if (Entry* entry = Find(description, hash)) {
+    ++hits_;
+    // A pipeline queued with GetOrCompile() is needed right now.
+    if (entry->pending)
+      entry->pending->Wait();
+    Resolve(entry);
+    return entry->pipeline;
+  }
+
+  ++misses_;
+  Entry entry;
+  entry.description = description;
+  std::string error;
+  entry.pipeline = BuildGraphicsPipeline(device_queue_, description, &error);
+  if (VK_NULL_HANDLE == entry.pipeline)
+    DLOG(ERROR) << error;
+  VkPipeline pipeline = entry.pipeline;
+  entries_[hash].push_back(std::move(entry));
+  ++size_;
+  return pipeline;
+}
+
+VkPipeline VulkanPipelineRegistry::GetOrCompile(
+    const VulkanPipelineDescription& description,
+    size_t hash,
+    VulkanPipelineCompiler* compiler) {
+  DCHECK_EQ(HashPipelineDescription(description), hash);
+  if (Entry* entry = Find(description, hash)) {
+    ++hits_;
+    Resolve(entry);
+    return entry->pipeline;
+  }
+
+  ++misses_;
+  Entry entry;
+  entry.description = description;
+  entry.pending = compiler->Compile(description);
+  entries_[hash].push_back(std::move(entry));
+  ++size_;
+  return VK_NULL_HANDLE;
+}
+
+VkPipelineLayout VulkanPipelineRegistry::GetPipelineLayout(
+    const std::vector<VkDescriptorSetLayout>& set_layouts,
+    const std::vector<VkPushConstantRange>& push_constant_ranges) {
+  for (const Layout& layout : layouts_) {
+    if (layout.set_layouts == set_layouts &&
+        layout.push_constant_ranges.size() == push_constant_ranges.size() &&
+        std::equal(layout.push_constant_ranges.begin(),
+                   layout.push_constant_ranges.end(),
+                   push_constant_ranges.begin(), PushConstantRangesEqual)) {
+      return layout.handle;
+    }
+  }
+
+  VkPipelineLayoutCreateInfo layout_create_info = {};
+  layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_create_info.setLayoutCount =
+      static_cast<uint32_t>(set_layouts.size());
+  layout_create_info.pSetLayouts = set_layouts.data();
+  layout_create_info.pushConstantRangeCount =
+      static_cast<uint32_t>(push_constant_ranges.size());
+  layout_create_info.pPushConstantRanges = push_constant_ranges.data();
+
+  Layout layout;
+  layout.set_layouts = set_layouts;
+  layout.push_constant_ranges = push_constant_ranges;
+  VkResult result =
+      vkCreatePipelineLayout(device_queue_->GetVulkanDevice(),
+                             &layout_create_info, nullptr, &layout.handle);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreatePipelineLayout() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  layouts_.push_back(layout);
+  return layout.handle;
+}
+
+VkDescriptorSetLayout VulkanPipelineRegistry::GetDescriptorSetLayout(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  for (const SetLayout& set_layout : set_layouts_) {
+    if (set_layout.bindings.size() == bindings.size() &&
+        std::equal(set_layout.bindings.begin(), set_layout.bindings.end(),
+                   bindings.begin(), BindingsEqual)) {
+      return set_layout.handle;
+    }
+  }
+
+  for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    DCHECK(!binding.pImmutableSamplers);
+  SetLayout set_layout;
+  set_layout.bindings = bindings;
+  VkDescriptorSetLayoutCreateInfo set_layout_create_info = {};
+  set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_create_info.bindingCount =
+      static_cast<uint32_t>(set_layout.bindings.size());
+  set_layout_create_info.pBindings = set_layout.bindings.data();
+  VkResult result = vkCreateDescriptorSetLayout(
+      device_queue_->GetVulkanDevice(), &set_layout_create_info, nullptr,
+      &set_layout.handle);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateDescriptorSetLayout() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  set_layouts_.push_back(set_layout);
+  return set_layout.handle;
+}
+
+void VulkanPipelineRegistry::EvictRenderPass(VkRenderPass render_pass) {
+  for (auto bucket = entries_.begin(); bucket != entries_.end();) {
+    std::vector<Entry>& entries = bucket->second;
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->description.render_pass == render_pass) {
+        Evict(&*it);
+        it = entries.erase(it);
+        --size_;
+      } else {
+        ++it;
+      }
+    }
+    if (entries.empty())
+      bucket = entries_.erase(bucket);
+    else
+      ++bucket;
+  }
+}
+
+VulkanPipelineRegistry::Entry* VulkanPipelineRegistry::Find(
+    const VulkanPipelineDescription& description,
+    size_t hash) {
+  auto bucket = entries_.find(hash);
+  if (bucket == entries_.end())
+    return nullptr;
+  for (Entry& entry : bucket->second) {
+    if (entry.description == description)
+      return &entry;
+  }
+  return nullptr;
+}
+
+void VulkanPipelineRegistry::Resolve(Entry* entry) {
+  if (!entry->pending || !entry->pending->IsReady())
+    return;
+  entry->pipeline = entry->pending->pipeline();
+  entry->pending.reset();
+}
+
+void VulkanPipelineRegistry::Evict(Entry* entry) {
+  // The build still uses the description's render pass and layout.
+  if (entry->pending) {
+    entry->pending->Wait();
+    Resolve(entry);
+  }
+  if (VK_NULL_HANDLE != entry->pipeline) {
+    device_queue_->GetDeletionQueue()->Enqueue(entry->pipeline);
+    entry->pipeline = VK_NULL_HANDLE;
+  }
+}
+
+}  // namespace gpu
@@ -0,0 +1,137 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_PIPELINE_REGISTRY_H_
+#define GPU_VULKAN_VULKAN_PIPELINE_REGISTRY_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_pipeline.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanPendingPipeline;
+class VulkanPipelineCompiler;
+
+// Keeps one VkPipeline per distinct VulkanPipelineDescription, one
+// VkPipelineLayout per distinct set of descriptor set layouts and push
+// constant ranges, and one VkDescriptorSetLayout per distinct set of
+// bindings, so that asking for the same state twice returns the same handle
+// instead of building it again.
+//
+// Lookups hash the whole description, using the hashes VulkanShaderSource
+// computed for the shaders instead of their text. Callers that look
+// pipelines up while recording draws hash a description once with
+// HashPipelineDescription() and pass the hash along, which leaves a single
+// map lookup and a comparison.
+//
+// Pipelines live until their render pass is destroyed, which calls
+// EvictRenderPass(), or until Destroy(). Both hand them to the device's
+// deletion queue. VulkanDeviceQueue owns one, see GetPipelineRegistry().
+class VULKAN_EXPORT VulkanPipelineRegistry {
+ public:
+  explicit VulkanPipelineRegistry(VulkanDeviceQueue* device_queue);
+  ~VulkanPipelineRegistry();
+
+  // Waits for pipelines still being built and hands every pipeline and
+  // layout to the deletion queue.
+  void Destroy();
+
+  // Returns the pipeline of |description|, building it on the first call.
+  // Returns VK_NULL_HANDLE on failure, and failed descriptions aren't built
+  // again.
+  VkPipeline Get(const VulkanPipelineDescription& description);
+  VkPipeline Get(const VulkanPipelineDescription& description, size_t hash);
+
+  // Like Get(), but a missing pipeline is built on |compiler|'s threads and
+  // VK_NULL_HANDLE is returned until it is ready.
+  VkPipeline GetOrCompile(const VulkanPipelineDescription& description,
+                          size_t hash,
+                          VulkanPipelineCompiler* compiler);
+
+  // Returns the layout with |set_layouts| and |push_constant_ranges|,
+  // creating it on the first call. Returns VK_NULL_HANDLE on failure.
+  VkPipelineLayout GetPipelineLayout(
+      const std::vector<VkDescriptorSetLayout>& set_layouts,
+      const std::vector<VkPushConstantRange>& push_constant_ranges);
+
+  // Returns the descriptor set layout with |bindings|, creating it on the
+  // first call. Returns VK_NULL_HANDLE on failure. Immutable samplers are
+  // not supported.
+  VkDescriptorSetLayout GetDescriptorSetLayout(
+      const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+  // Waits for the pipelines of |render_pass| still being built and evicts
+  // all of its pipelines. Called before destroying |render_pass|.
+  void EvictRenderPass(VkRenderPass render_pass);
+
+  // Number of distinct pipelines, including those being built.
+  size_t size() const { return size_; }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Entry {
+    Entry();
+    Entry(Entry&& other);
+    ~Entry();
+    Entry& operator=(Entry&& other);
+
+    VulkanPipelineDescription description;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    // Set while |compiler| builds the pipeline.
+    std::shared_ptr<VulkanPendingPipeline> pending;
+  };
+
+  struct Layout {
+    Layout();
+    Layout(const Layout& other);
+    ~Layout();
+
+    std::vector<VkDescriptorSetLayout> set_layouts;
+    std::vector<VkPushConstantRange> push_constant_ranges;
+    VkPipelineLayout handle = VK_NULL_HANDLE;
+  };
+
+  struct SetLayout {
+    SetLayout();
+    SetLayout(const SetLayout& other);
+    ~SetLayout();
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    VkDescriptorSetLayout handle = VK_NULL_HANDLE;
+  };
+
+  // Entries by the hash of their description. Colliding descriptions share a
+  // bucket.
+  using EntryMap = std::unordered_map<size_t, std::vector<Entry>>;
+
+  Entry* Find(const VulkanPipelineDescription& description, size_t hash);
+  // Picks up the pipeline of |entry| once its build finished.
+  void Resolve(Entry* entry);
+  void Evict(Entry* entry);
+
+  VulkanDeviceQueue* device_queue_;
+  EntryMap entries_;
+  size_t size_ = 0;
+  // Few enough to search linearly.
+  std::vector<Layout> layouts_;
+  std::vector<SetLayout> set_layouts_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanPipelineRegistry);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_PIPELINE_REGISTRY_H_
@@ -0,0 +1,350 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_render_graph.h"
+
+#include "base/logging.h"
+
+namespace gpu {
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::ColorAttachment(
+    VkImageLayout initial_layout,
+    VkImageLayout final_layout) {
+  return {initial_layout, final_layout,
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+}
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::DepthStencilAttachment(
+    VkImageLayout initial_layout,
+    VkImageLayout final_layout) {
+  return {initial_layout, final_layout,
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+}
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::DepthStencilReadOnly() {
+  return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+              VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT};
+}
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::FragmentShaderRead() {
+  return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT};
+}
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::TransferSource() {
+  return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_ACCESS_TRANSFER_READ_BIT};
+}
+
+// static
+VulkanRenderGraph::ImageAccess VulkanRenderGraph::TransferDestination() {
+  return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_ACCESS_TRANSFER_WRITE_BIT};
+}
+
+VulkanRenderGraph::BarrierBatch::BarrierBatch() {}
+
+VulkanRenderGraph::BarrierBatch::BarrierBatch(const BarrierBatch& other) =
+    default;
+
+VulkanRenderGraph::BarrierBatch::~BarrierBatch() {}
+
+VulkanRenderGraph::Pass::Pass() {}
+
+VulkanRenderGraph::Pass::Pass(const Pass& other) = default;
+
+VulkanRenderGraph::Pass::~Pass() {}
+
+VulkanRenderGraph::VulkanRenderGraph(uint32_t queue_family_index)
+    : queue_family_index_(queue_family_index) {}
+
+VulkanRenderGraph::~VulkanRenderGraph() {}
+
+VulkanRenderGraph::ResourceId VulkanRenderGraph::ImportImage(
+    VkImage image,
+    VkImageAspectFlags aspect_mask,
+    VkImageLayout initial_layout,
+    VkPipelineStageFlags initial_stages) {
+  DCHECK(!compiled_);
+  Image imported;
+  imported.image = image;
+  imported.aspect_mask = aspect_mask;
+  imported.initial_layout = initial_layout;
+  imported.initial_stages = initial_stages;
+  images_.push_back(imported);
+  return static_cast<ResourceId>(images_.size() - 1);
+}
+
+void VulkanRenderGraph::SetOutput(ResourceId image,
+                                  VkImageLayout final_layout,
+                                  uint32_t dst_queue_family_index) {
+  DCHECK(!compiled_);
+  DCHECK_LT(image, images_.size());
+  images_[image].output = true;
+  images_[image].final_layout = final_layout;
+  images_[image].dst_queue_family_index = dst_queue_family_index;
+}
+
+VulkanRenderGraph::PassId VulkanRenderGraph::AddPass(
+    const std::string& name,
+    const RecordCallback& record) {
+  DCHECK(!compiled_);
+  Pass pass;
+  pass.name = name;
+  pass.record = record;
+  passes_.push_back(pass);
+  return static_cast<PassId>(passes_.size() - 1);
+}
+
+void VulkanRenderGraph::Read(PassId pass,
+                             ResourceId image,
+                             const ImageAccess& access) {
+  AddUse(pass, image, access, false);
+}
+
+void VulkanRenderGraph::Write(PassId pass,
+                              ResourceId image,
+                              const ImageAccess& access) {
+  AddUse(pass, image, access, true);
+}
+
+void VulkanRenderGraph::AddUse(PassId pass,
+                               ResourceId image,
+                               const ImageAccess& access,
+                               bool write) {
+  DCHECK(!compiled_);
+  DCHECK_LT(pass, passes_.size());
+  DCHECK_LT(image, images_.size());
+  passes_[pass].uses.push_back({image, access, write});
+}
+
+void VulkanRenderGraph::Compile() {
+  DCHECK(!compiled_);
+  CullPasses();
+
+  std::vector<ImageState> states(images_.size());
+  for (size_t i = 0; i < images_.size(); ++i) {
+    // Whatever made the image available is treated as a write at
+    // |initial_stages| which the first use has to wait for.
+    states[i].layout = images_[i].initial_layout;
+    states[i].write_stages =
+        images_[i].initial_stages & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+
+  num_pipeline_barriers_ = 0;
+  for (Pass& pass : passes_) {
+    if (pass.culled)
+      continue;
+    for (const Use& use : pass.uses)
+      AddDependency(use, &states[use.image], &pass.barriers);
+    if (!pass.barriers.empty())
+      ++num_pipeline_barriers_;
+  }
+
+  for (size_t i = 0; i < images_.size(); ++i) {
+    const Image& image = images_[i];
+    if (!image.output)
+      continue;
+    const ImageState& state = states[i];
+    VkImageLayout final_layout = image.final_layout;
+    if (VK_IMAGE_LAYOUT_UNDEFINED == final_layout)
+      final_layout = state.layout;
+    bool release =
+        VK_QUEUE_FAMILY_IGNORED != image.dst_queue_family_index &&
+        queue_family_index_ != image.dst_queue_family_index;
+    if (final_layout != state.layout || release) {
+      // Whoever takes over waits on a semaphore, which covers the rest.
+      AddImageBarrier(image, state, final_layout,
+                      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                      image.dst_queue_family_index, &final_barriers_);
+    }
+  }
+  if (!final_barriers_.empty())
+    ++num_pipeline_barriers_;
+  compiled_ = true;
+}
+
+void VulkanRenderGraph::Execute(VkCommandBuffer command_buffer) const {
+  DCHECK(compiled_);
+  for (const Pass& pass : passes_) {
+    if (pass.culled)
+      continue;
+    if (!pass.barriers.empty())
+      RecordBarriers(command_buffer, pass.barriers);
+    if (pass.record)
+      pass.record(command_buffer);
+  }
+  if (!final_barriers_.empty())
+    RecordBarriers(command_buffer, final_barriers_);
+}
+
+void VulkanRenderGraph::Reset() {
+  images_.clear();
+  passes_.clear();
+  final_barriers_ = BarrierBatch();
+  compiled_ = false;
+  num_culled_passes_ = 0;
+  num_pipeline_barriers_ = 0;
+}
+
+const VulkanRenderGraph::BarrierBatch& VulkanRenderGraph::GetBarriersBefore(
+    PassId pass) const {
+  DCHECK(compiled_);
+  DCHECK_LT(pass, passes_.size());
+  return passes_[pass].barriers;
+}
+
+bool VulkanRenderGraph::IsPassCulled(PassId pass) const {
+  DCHECK(compiled_);
+  DCHECK_LT(pass, passes_.size());
+  return passes_[pass].culled;
+}
+
+const std::string& VulkanRenderGraph::GetPassName(PassId pass) const {
+  DCHECK_LT(pass, passes_.size());
+  return passes_[pass].name;
+}
+
+void VulkanRenderGraph::CullPasses() {
+  // Walking backwards, a pass is needed if it writes an image that an
+  // output or a later needed pass depends on. Writes don't end a
+  // dependency since passes may load what was there before.
+  std::vector<bool> needed(images_.size());
+  for (size_t i = 0; i < images_.size(); ++i)
+    needed[i] = images_[i].output;
+
+  num_culled_passes_ = 0;
+  for (auto pass = passes_.rbegin(); pass != passes_.rend(); ++pass) {
+    bool live = false;
+    for (const Use& use : pass->uses)
+      live |= use.write && needed[use.image];
+    pass->culled = !live;
+    if (!live) {
+      ++num_culled_passes_;
+      continue;
+    }
+    for (const Use& use : pass->uses)
+      needed[use.image] = true;
+  }
+}
+
+void VulkanRenderGraph::AddDependency(const Use& use,
+                                      ImageState* state,
+                                      BarrierBatch* batch) {
+  const Image& image = images_[use.image];
+  const ImageAccess& access = use.access;
+  const bool transition = VK_IMAGE_LAYOUT_UNDEFINED != access.layout &&
+                          access.layout != state->layout;
+
+  if (transition) {
+    AddImageBarrier(image, *state, access.layout, access.stages,
+                    access.access, VK_QUEUE_FAMILY_IGNORED, batch);
+  } else if (use.write) {
+    // Write after write needs the earlier write made available, write after
+    // read only needs the reads to have executed.
+    VkPipelineStageFlags src_stages = state->write_stages | state->read_stages;
+    if (src_stages) {
+      batch->src_stages |= src_stages;
+      batch->dst_stages |= access.stages;
+      batch->src_access |= state->write_access;
+      batch->dst_access |= access.access;
+    }
+  } else if (state->write_stages &&
+             ((access.stages & ~state->read_stages) ||
+              (access.access & ~state->read_access))) {
+    // Reads after the same write share the first dependency that covers
+    // them.
+    batch->src_stages |= state->write_stages;
+    batch->dst_stages |= access.stages;
+    batch->src_access |= state->write_access;
+    batch->dst_access |= access.access;
+  }
+
+  // A layout transition, whether done by a barrier or the pass, writes the
+  // image too.
+  const bool modified =
+      use.write || transition ||
+      (VK_IMAGE_LAYOUT_UNDEFINED != access.final_layout &&
+       access.final_layout != state->layout);
+  if (modified) {
+    state->write_stages = access.stages;
+    state->write_access = use.write ? access.access : 0;
+    state->read_stages = use.write ? 0 : access.stages;
+    state->read_access = use.write ? 0 : access.access;
+  } else {
+    state->read_stages |= access.stages;
+    state->read_access |= access.access;
+  }
+  if (VK_IMAGE_LAYOUT_UNDEFINED != access.final_layout)
+    state->layout = access.final_layout;
+}
+
+void VulkanRenderGraph::AddImageBarrier(const Image& image,
+                                        const ImageState& state,
+                                        VkImageLayout new_layout,
+                                        VkPipelineStageFlags dst_stages,
+                                        VkAccessFlags dst_access,
+                                        uint32_t dst_queue_family_index,
+                                        BarrierBatch* batch) {
+  VkPipelineStageFlags src_stages = state.write_stages | state.read_stages;
+  if (!src_stages)
+    src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = state.write_access;
+  barrier.dstAccessMask = dst_access;
+  barrier.oldLayout = state.layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  if (VK_QUEUE_FAMILY_IGNORED != dst_queue_family_index &&
+      queue_family_index_ != dst_queue_family_index) {
+    barrier.srcQueueFamilyIndex = queue_family_index_;
+    barrier.dstQueueFamilyIndex = dst_queue_family_index;
+  }
+  barrier.image = image.image;
+  barrier.subresourceRange.aspectMask = image.aspect_mask;
+  barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+  batch->src_stages |= src_stages;
+  batch->dst_stages |= dst_stages;
+  batch->image_barriers.push_back(barrier);
+}
+
+// static
+void VulkanRenderGraph::RecordBarriers(VkCommandBuffer command_buffer,
+                                       const BarrierBatch& batch) {
+  VkMemoryBarrier memory_barrier = {};
+  memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memory_barrier.srcAccessMask = batch.src_access;
+  memory_barrier.dstAccessMask = batch.dst_access;
+  const bool has_memory_barrier = batch.src_access || batch.dst_access;
+
+  vkCmdPipelineBarrier(
+      command_buffer, batch.src_stages, batch.dst_stages, 0,
+      has_memory_barrier ? 1 : 0, &memory_barrier, 0, nullptr,
+      static_cast<uint32_t>(batch.image_barriers.size()),
+      batch.image_barriers.data());
+}
+
+}  // namespace gpu
@@ -0,0 +1,199 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_RENDER_GRAPH_H_
+#define GPU_VULKAN_VULKAN_RENDER_GRAPH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+// Orders the passes of a frame by the images they read and write, and
+// derives the pipeline barriers and layout transitions between them instead
+// of having every pass hand-write its own.
+//
+// A frame is built by importing the images it touches, adding passes in
+// submission order and declaring each pass's reads and writes. Compile()
+// culls the passes that contribute nothing to an output and works out, for
+// every remaining pass, the one vkCmdPipelineBarrier() it needs: only
+// hazards that exist get a dependency, reads after the same write share it,
+// and a layout only changes when a pass needs a different one. Execute()
+// then records the barriers and the passes into a command buffer.
+//
+// The graph records into a single queue. Reset() clears it for the next
+// frame while keeping its allocations.
+class VULKAN_EXPORT VulkanRenderGraph {
+ public:
+  using ResourceId = uint32_t;
+  using PassId = uint32_t;
+  using RecordCallback = std::function<void(VkCommandBuffer command_buffer)>;
+
+  // How a pass accesses an image.
+  struct ImageAccess {
+    // Layout the pass needs the image in. VK_IMAGE_LAYOUT_UNDEFINED leaves
+    // the layout to the pass, e.g. a render pass whose attachment has an
+    // undefined initialLayout.
+    VkImageLayout layout;
+    // Layout the pass leaves the image in, which differs from |layout| when
+    // the pass transitions it itself, e.g. to a render pass's finalLayout.
+    VkImageLayout final_layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+  };
+
+  // Color attachment of a render pass with the given initial and final
+  // layouts.
+  static ImageAccess ColorAttachment(
+      VkImageLayout initial_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      VkImageLayout final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+  static ImageAccess DepthStencilAttachment(
+      VkImageLayout initial_layout =
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+      VkImageLayout final_layout =
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+  // Depth test without depth writes.
+  static ImageAccess DepthStencilReadOnly();
+  // Sampled or input attachment read from a fragment shader.
+  static ImageAccess FragmentShaderRead();
+  static ImageAccess TransferSource();
+  static ImageAccess TransferDestination();
+
+  // Dependencies are recorded on the queue of |queue_family_index|.
+  explicit VulkanRenderGraph(uint32_t queue_family_index);
+  ~VulkanRenderGraph();
+
+  // Adds an image the frame uses, currently in |initial_layout|. Commands
+  // that precede the graph on the queue, or a semaphore wait, must have
+  // made it available to |initial_stages|, e.g. the stage the swap chain's
+  // acquire semaphore is waited on at.
+  ResourceId ImportImage(
+      VkImage image,
+      VkImageAspectFlags aspect_mask,
+      VkImageLayout initial_layout,
+      VkPipelineStageFlags initial_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+  // Marks |image| as a result of the frame, to be left in |final_layout|
+  // (or its last layout if VK_IMAGE_LAYOUT_UNDEFINED). Passes only survive
+  // culling if an output depends on them. A |dst_queue_family_index| other
+  // than the graph's records only the release of the image to that queue
+  // family; the caller records the matching acquire on a queue of it.
+  // VulkanSwapChain images are shared by the graphics and present families
+  // and need no transfer.
+  void SetOutput(ResourceId image,
+                 VkImageLayout final_layout,
+                 uint32_t dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED);
+
+  // Adds a pass, run in the order added. |record| records its commands.
+  PassId AddPass(const std::string& name, const RecordCallback& record);
+  void Read(PassId pass, ResourceId image, const ImageAccess& access);
+  void Write(PassId pass, ResourceId image, const ImageAccess& access);
+
+  // Culls unused passes and computes the barriers. Must be called once
+  // after the frame is built and before Execute().
+  void Compile();
+  void Execute(VkCommandBuffer command_buffer) const;
+
+  // Forgets the frame so a new one can be built.
+  void Reset();
+
+  // The dependencies recorded right before a pass, or after the last pass.
+  struct BarrierBatch {
+    BarrierBatch();
+    BarrierBatch(const BarrierBatch& other);
+    ~BarrierBatch();
+
+    bool empty() const { return !src_stages; }
+
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    // Memory dependency for hazards that don't change the layout.
+    VkAccessFlags src_access = 0;
+    VkAccessFlags dst_access = 0;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+  };
+  const BarrierBatch& GetBarriersBefore(PassId pass) const;
+  const BarrierBatch& GetFinalBarriers() const { return final_barriers_; }
+
+  bool IsPassCulled(PassId pass) const;
+  const std::string& GetPassName(PassId pass) const;
+  size_t num_passes() const { return passes_.size(); }
+  size_t num_culled_passes() const { return num_culled_passes_; }
+  // vkCmdPipelineBarrier() calls Execute() makes.
+  size_t num_pipeline_barriers() const { return num_pipeline_barriers_; }
+
+ private:
+  struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageAspectFlags aspect_mask = 0;
+    VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags initial_stages = 0;
+    bool output = false;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    uint32_t dst_queue_family_index = VK_QUEUE_FAMILY_IGNORED;
+  };
+
+  struct Use {
+    ResourceId image;
+    ImageAccess access;
+    bool write;
+  };
+
+  struct Pass {
+    Pass();
+    Pass(const Pass& other);
+    ~Pass();
+
+    std::string name;
+    RecordCallback record;
+    std::vector<Use> uses;
+    bool culled = false;
+    BarrierBatch barriers;
+  };
+
+  // What the graph knows about an image while walking the passes.
+  struct ImageState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // The last write and the accesses it has been made visible to since.
+    VkPipelineStageFlags write_stages = 0;
+    VkAccessFlags write_access = 0;
+    VkPipelineStageFlags read_stages = 0;
+    VkAccessFlags read_access = 0;
+  };
+
+  void AddUse(PassId pass, ResourceId image, const ImageAccess& access,
+              bool write);
+  void CullPasses();
+  // Adds the dependency |use| needs after |state| to |batch|.
+  void AddDependency(const Use& use, ImageState* state, BarrierBatch* batch);
+  void AddImageBarrier(const Image& image,
+                       const ImageState& state,
+                       VkImageLayout new_layout,
+                       VkPipelineStageFlags dst_stages,
+                       VkAccessFlags dst_access,
+                       uint32_t dst_queue_family_index,
+                       BarrierBatch* batch);
+  static void RecordBarriers(VkCommandBuffer command_buffer,
+                             const BarrierBatch& batch);
+
+  const uint32_t queue_family_index_;
+  std::vector<Image> images_;
+  std::vector<Pass> passes_;
+  BarrierBatch final_barriers_;
+  bool compiled_ = false;
+  size_t num_culled_passes_ = 0;
+  size_t num_pipeline_barriers_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanRenderGraph);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_RENDER_GRAPH_H_
@@ -4,15 +4,21 @@
 
 #include "vulkan_render_pass.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "base/logging.h"
 #include "vulkan_implementation.h"
 #include "ui/gfx/geometry/size.h"
 #include "vulkan_buffer.h"
+#include "vulkan_deletion_queue.h"
 #include "vulkan_device_queue.h"
+#include "vulkan_framebuffer_cache.h"
+#include "vulkan_image.h"
 #include "vulkan_image_view.h"
-#include "vulkan_shader_module.h"
+#include "vulkan_pipeline.h"
+#include "vulkan_pipeline_registry.h"
+#include "vulkan_render_pass_cache.h"
 #include "vulkan_swap_chain.h"
 
 namespace gpu {
@@ -25,27 +31,74 @@ VulkanRenderPass::~VulkanRenderPass() {
   DCHECK(frame_buffers_.empty());
 }
 
+namespace {
+
+// The highest sample count up to |samples| that color attachments and, with
+// |depth|, depth attachments support.
+VkSampleCountFlagBits ClampSampleCount(const VkPhysicalDeviceLimits& limits,
+                                       VkSampleCountFlagBits samples,
+                                       bool depth) {
+  VkSampleCountFlags supported = limits.framebufferColorSampleCounts;
+  if (depth)
+    supported &= limits.framebufferDepthSampleCounts;
+  // Counts that aren't a single bit, e.g. 6, are rounded down to the
+  // highest supported bit below them, 4.
+  VkSampleCountFlags result = VK_SAMPLE_COUNT_1_BIT;
+  for (VkSampleCountFlags bit = VK_SAMPLE_COUNT_2_BIT; bit <= samples;
+       bit <<= 1) {
+    if (supported & bit)
+      result = bit;
+  }
+  return static_cast<VkSampleCountFlagBits>(result);
+}
+
+// The sample count of the attachments |subpass| renders to.
+VkSampleCountFlagBits SubpassSamples(
+    const std::vector<VkAttachmentDescription>& attachments,
+    const VulkanRenderPassDescription::Subpass& subpass) {
+  if (!subpass.color_attachments.empty())
+    return attachments[subpass.color_attachments[0].attachment].samples;
+  if (subpass.depth_stencil_attachment.attachment != VK_ATTACHMENT_UNUSED)
+    return attachments[subpass.depth_stencil_attachment.attachment].samples;
+  return VK_SAMPLE_COUNT_1_BIT;
+}
+
+void AddUsage(const std::vector<VkAttachmentReference>& references,
+              VkImageUsageFlags usage,
+              std::vector<VkImageUsageFlags>* usages) {
+  for (const VkAttachmentReference& reference : references) {
+    if (reference.attachment != VK_ATTACHMENT_UNUSED)
+      (*usages)[reference.attachment] |= usage;
+  }
+}
+
+}  // namespace
+
 // Render pass describes the internal organization of rendering resources
 // (images/attachments), how they are used, and how they change during the
 // rendering process.
 bool VulkanRenderPass::Initialize(const VulkanSwapChain* swap_chain,
-    std::vector<VkSubpassDependency>& subpass_dependencies) {
-  DCHECK(!executing_);
-  DCHECK_EQ(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass_);
-  DCHECK(frame_buffers_.empty());
-  // DCHECK(render_pass_data.ValidateData(swap_chain));
-
-  VkDevice device = device_queue_->GetVulkanDevice();
-  //  VkResult result = VK_SUCCESS;
-
-  swap_chain_ = swap_chain;
-
-  // for Tutorial4
-  frame_buffers_.resize(ResourcesCount_);
-  // Create VkRenderPass;
-  VkAttachmentDescription attachment_descriptions[] = {{
+    std::vector<VkSubpassDependency>& subpass_dependencies,
+    DepthMode depth_mode,
+    VkSampleCountFlagBits samples) {
+  VkFormat depth_format = VK_FORMAT_UNDEFINED;
+  if (depth_mode != DepthMode::DEPTH_MODE_NONE) {
+    depth_format = VulkanImage::FindDepthFormat(device_queue_, false);
+    if (VK_FORMAT_UNDEFINED == depth_format) {
+      std::cout << "No supported depth format!" << std::endl;
+      return false;
+    }
+  }
+  samples =
+      ClampSampleCount(device_queue_->GetPhysicalDeviceProperties().limits,
+                       samples, VK_FORMAT_UNDEFINED != depth_format);
+  const bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+  // for Tutorial4: the swap chain image is the only attachment. It is
+  // cleared and presented afterwards.
+  VkAttachmentDescription color_attachment = {
       0,                             // VkAttachmentDescriptionFlags   flags
-      swap_chain_->format(),         // VkFormat                       format
+      swap_chain->format(),          // VkFormat                       format
       VK_SAMPLE_COUNT_1_BIT,         // VkSampleCountFlagBits          samples
       VK_ATTACHMENT_LOAD_OP_CLEAR,   // VkAttachmentLoadOp             loadOp
       VK_ATTACHMENT_STORE_OP_STORE,  // VkAttachmentStoreOp            storeOp
@@ -53,393 +106,571 @@ bool VulkanRenderPass::Initialize(const VulkanSwapChain* swap_chain,
       VK_ATTACHMENT_STORE_OP_DONT_CARE,  // VkAttachmentStoreOp stencilStoreOp
       VK_IMAGE_LAYOUT_UNDEFINED,         // VkImageLayout initialLayout;
       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR    // VkImageLayout finalLayout
-  }};
-
-  VkAttachmentReference color_attachment_references[] = {{
-      0,  // uint32_t                       attachment
-      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL  // VkImageLayout layout
-  }};
-
-  VkSubpassDescription subpass_descriptions[] = {{
-      0,                                // VkSubpassDescriptionFlags      flags
-      VK_PIPELINE_BIND_POINT_GRAPHICS,  // VkPipelineBindPoint pipelineBindPoint
-      0,        // uint32_t                       inputAttachmentCount
-      nullptr,  // const VkAttachmentReference   *pInputAttachments
-      1,        // uint32_t                       colorAttachmentCount
-      color_attachment_references,  // VkAttachmentReference(color attachments)
-      nullptr,  // const VkAttachmentReference   *pResolveAttachments
-      nullptr,  // const VkAttachmentReference   *pDepthStencilAttachment
-      0,        // uint32_t                       preserveAttachmentCount
-      nullptr   // const uint32_t*                pPreserveAttachments
-  }};
-
-  const VkSubpassDependency *pDependencies;
-  uint32_t dependencyCount = subpass_dependencies.size();
-  if (dependencyCount == 0) {
-    pDependencies = nullptr;
-    std::cout << "dependency count = 0\n";
-  } else
-    pDependencies = &subpass_dependencies[0];
-
-  VkRenderPassCreateInfo render_pass_create_info = {
-      VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // VkStructureType sType
-      nullptr,  // const void                    *pNext
-      0,        // VkRenderPassCreateFlags        flags
-      1,        // uint32_t                       attachmentCount
-      attachment_descriptions,  // const VkAttachmentDescription *pAttachments
-      1,                        // uint32_t                       subpassCount
-      subpass_descriptions,     // const VkSubpassDescription    *pSubpasses
-      dependencyCount,  // uint32_t dependencyCount
-      pDependencies  // const VkSubpassDependency     *pDependencies
   };
+  // Multisampled, the swap chain image is only written by the resolve at the
+  // end of the subpass, and the samples themselves are discarded.
+  VkAttachmentDescription swap_image_attachment = color_attachment;
+  if (multisampled) {
+    color_attachment.samples = samples;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    swap_image_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  }
+
+  VulkanRenderPassDescription::Subpass subpass;
+  subpass.color_attachments.push_back(
+      {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  VulkanRenderPassDescription description;
+  description.attachments.push_back(color_attachment);
+  description.subpasses.push_back(subpass);
+  description.dependencies = subpass_dependencies;
+  if (subpass_dependencies.empty())
+    std::cout << "dependency count = 0\n";
+
+  if (VK_FORMAT_UNDEFINED != depth_format) {
+    // Depth is only needed during the render pass, so it is never stored.
+    VkAttachmentDescription depth_attachment = {
+        0,                                 // VkAttachmentDescriptionFlags
+        depth_format,                      // VkFormat format
+        samples,                           // VkSampleCountFlagBits samples
+        VK_ATTACHMENT_LOAD_OP_CLEAR,       // VkAttachmentLoadOp loadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,  // VkAttachmentStoreOp storeOp
+        VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // VkAttachmentLoadOp stencilLoadOp
+        VK_ATTACHMENT_STORE_OP_DONT_CARE,  // VkAttachmentStoreOp
+                                           // stencilStoreOp
+        VK_IMAGE_LAYOUT_UNDEFINED,         // VkImageLayout initialLayout
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL  // finalLayout
+    };
+    description.attachments.push_back(depth_attachment);
+    description.subpasses[0].depth_stencil_attachment = {
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    // The depth image of a framebuffer is cleared while the previous frame
+    // drawn to it may still be testing against it.
+    VkSubpassDependency depth_dependency = {
+        VK_SUBPASS_EXTERNAL,  // uint32_t srcSubpass
+        0,                    // uint32_t dstSubpass
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,  // srcStageMask
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,  // dstStageMask
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,   // srcAccessMask
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,  // dstAccessMask
+        VK_DEPENDENCY_BY_REGION_BIT  // VkDependencyFlags dependencyFlags
+    };
+    description.dependencies.push_back(depth_dependency);
+  }
+
+  if (multisampled) {
+    description.subpasses[0].resolve_attachments.push_back(
+        {static_cast<uint32_t>(description.attachments.size()),
+         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    description.attachments.push_back(swap_image_attachment);
+  }
+  return Initialize(swap_chain, description, depth_mode);
+}
+
+bool VulkanRenderPass::Initialize(
+    const VulkanSwapChain* swap_chain,
+    const VulkanRenderPassDescription& description,
+    DepthMode depth_mode) {
+  DCHECK(!executing_);
+  DCHECK_EQ(static_cast<VkRenderPass>(VK_NULL_HANDLE), render_pass_);
+  DCHECK(frame_buffers_.empty());
+  DCHECK(!description.subpasses.empty());
 
-  if (vkCreateRenderPass(device, &render_pass_create_info, nullptr,
-                         &render_pass_) != VK_SUCCESS) {
+  swap_chain_ = swap_chain;
+  depth_mode_ = depth_mode;
+  const VulkanRenderPassDescription::Subpass& first_subpass =
+      description.subpasses[0];
+  depth_attachment_index_ = first_subpass.depth_stencil_attachment.attachment;
+  DCHECK_EQ(depth_mode_ != DepthMode::DEPTH_MODE_NONE,
+            depth_attachment_index_ != VK_ATTACHMENT_UNUSED);
+  if (depth_attachment_index_ != VK_ATTACHMENT_UNUSED)
+    depth_format_ = description.attachments[depth_attachment_index_].format;
+  samples_ = SubpassSamples(description.attachments, first_subpass);
+
+  attachments_ = description.attachments;
+  subpasses_ = description.subpasses;
+  attachment_usages_.assign(attachments_.size(), 0);
+  for (const VulkanRenderPassDescription::Subpass& subpass :
+       description.subpasses) {
+    AddUsage(subpass.input_attachments, VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+             &attachment_usages_);
+    AddUsage(subpass.color_attachments, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+             &attachment_usages_);
+    AddUsage(subpass.resolve_attachments, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+             &attachment_usages_);
+    AddUsage({subpass.depth_stencil_attachment},
+             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &attachment_usages_);
+  }
+  swap_image_attachment_ = VK_ATTACHMENT_UNUSED;
+  for (uint32_t i = 0; i < attachments_.size(); ++i) {
+    if (attachments_[i].finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+      swap_image_attachment_ = i;
+  }
+  DCHECK_NE(VK_ATTACHMENT_UNUSED, swap_image_attachment_);
+
+  // Color attachments are cleared to black and depth to the far plane until
+  // SetClearValue() says otherwise.
+  attachment_clear_values_.assign(attachments_.size(), VkClearValue());
+  for (uint32_t i = 0; i < attachments_.size(); ++i) {
+    if (attachment_usages_[i] & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+      attachment_clear_values_[i].depthStencil = {1.0f, 0};
+  }
+
+  // for Tutorial4
+  frame_buffers_.resize(ResourcesCount_);
+
+  // Render passes with the same description are shared, and pipelines and
+  // framebuffers are created against the oldest compatible one.
+  VulkanRenderPassCache* render_pass_cache =
+      device_queue_->GetRenderPassCache();
+  render_pass_ = render_pass_cache->Acquire(description);
+  if (VK_NULL_HANDLE == render_pass_) {
     std::cout << "Could not create render pass!" << std::endl;
     return false;
   }
+  compatible_render_pass_ = render_pass_cache->GetCompatible(render_pass_);
+
+  // Every input attachment of a subpass is one binding of its set layout.
+  VulkanPipelineRegistry* registry = device_queue_->GetPipelineRegistry();
+  input_set_layouts_.assign(subpasses_.size(), VK_NULL_HANDLE);
+  for (size_t i = 0; i < subpasses_.size(); ++i) {
+    const std::vector<VkAttachmentReference>& inputs =
+        subpasses_[i].input_attachments;
+    if (inputs.empty())
+      continue;
+    std::vector<VkDescriptorSetLayoutBinding> bindings(inputs.size());
+    for (uint32_t binding = 0; binding < bindings.size(); ++binding) {
+      bindings[binding].binding = binding;
+      bindings[binding].descriptorType =
+          VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      bindings[binding].descriptorCount = 1;
+      bindings[binding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    input_set_layouts_[i] = registry->GetDescriptorSetLayout(bindings);
+    if (VK_NULL_HANDLE == input_set_layouts_[i]) {
+      std::cout << "Could not create input attachment set layout!"
+                << std::endl;
+      return false;
+    }
+  }
+  return CreateInputAttachmentPool(std::max(
+      swap_chain->num_images(), static_cast<uint32_t>(ResourcesCount_)));
+}
+
+bool VulkanRenderPass::CreateInputAttachmentPool(uint32_t framebuffer_count) {
+  uint32_t set_count = 0;
+  uint32_t descriptor_count = 0;
+  for (const VulkanRenderPassDescription::Subpass& subpass : subpasses_) {
+    if (subpass.input_attachments.empty())
+      continue;
+    ++set_count;
+    descriptor_count +=
+        static_cast<uint32_t>(subpass.input_attachments.size());
+  }
+  if (!set_count)
+    return true;
 
+  VkDescriptorPoolSize pool_size = {
+      VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,     // VkDescriptorType type
+      descriptor_count * framebuffer_count     // uint32_t descriptorCount
+  };
+  VkDescriptorPoolCreateInfo pool_create_info = {};
+  pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_create_info.maxSets = set_count * framebuffer_count;
+  pool_create_info.poolSizeCount = 1;
+  pool_create_info.pPoolSizes = &pool_size;
+  if (vkCreateDescriptorPool(device_queue_->GetVulkanDevice(),
+                             &pool_create_info, nullptr,
+                             &input_set_pool_) != VK_SUCCESS) {
+    std::cout << "Could not create input attachment descriptor pool!"
+              << std::endl;
+    return false;
+  }
+  input_set_capacity_ = framebuffer_count;
   return true;
 }
 
-bool VulkanRenderPass::CreateFrameBuffer(const VulkanSwapChain* swap_chain,
-                                         uint32_t resource_index) {
+bool VulkanRenderPass::WriteInputAttachmentSets(
+    uint32_t resource_index,
+    const std::vector<VkImageView>& attachments) {
+  if (VK_NULL_HANDLE == input_set_pool_)
+    return true;
+  if (resource_index >= input_set_capacity_) {
+    std::cout << "No input attachment sets left for framebuffer "
+              << resource_index << std::endl;
+    return false;
+  }
+  if (resource_index >= input_sets_.size()) {
+    input_sets_.resize(resource_index + 1);
+    input_set_views_.resize(resource_index + 1);
+  }
+  // The views only change when the attachment images were recreated.
+  if (input_set_views_[resource_index] == attachments)
+    return true;
+
   VkDevice device = device_queue_->GetVulkanDevice();
+  std::vector<VkDescriptorSet>& sets = input_sets_[resource_index];
+  if (sets.empty()) {
+    sets.assign(subpasses_.size(), VK_NULL_HANDLE);
+    for (size_t i = 0; i < subpasses_.size(); ++i) {
+      if (VK_NULL_HANDLE == input_set_layouts_[i])
+        continue;
+      VkDescriptorSetAllocateInfo allocate_info = {};
+      allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocate_info.descriptorPool = input_set_pool_;
+      allocate_info.descriptorSetCount = 1;
+      allocate_info.pSetLayouts = &input_set_layouts_[i];
+      if (vkAllocateDescriptorSets(device, &allocate_info, &sets[i]) !=
+          VK_SUCCESS) {
+        std::cout << "Could not allocate input attachment set!" << std::endl;
+        sets.clear();
+        return false;
+      }
+    }
+  }
 
-  // for Tutorial4
-  if (frame_buffers_.size()) {
-    if (frame_buffers_[resource_index] != VK_NULL_HANDLE) {
-      vkDestroyFramebuffer(device, frame_buffers_[resource_index], nullptr);
-      frame_buffers_[resource_index] = VK_NULL_HANDLE;
+  std::vector<VkDescriptorImageInfo> image_infos;
+  std::vector<VkWriteDescriptorSet> writes;
+  for (size_t i = 0; i < subpasses_.size(); ++i) {
+    for (const VkAttachmentReference& input :
+         subpasses_[i].input_attachments) {
+      // Input attachments are read in the layout of the reference, e.g.
+      // SHADER_READ_ONLY_OPTIMAL.
+      image_infos.push_back(
+          {VK_NULL_HANDLE, attachments[input.attachment], input.layout});
     }
   }
+  size_t image_info_index = 0;
+  for (size_t i = 0; i < subpasses_.size(); ++i) {
+    const std::vector<VkAttachmentReference>& inputs =
+        subpasses_[i].input_attachments;
+    for (uint32_t binding = 0; binding < inputs.size(); ++binding) {
+      VkWriteDescriptorSet write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = sets[i];
+      write.dstBinding = binding;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      write.pImageInfo = &image_infos[image_info_index++];
+      writes.push_back(write);
+    }
+  }
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+  input_set_views_[resource_index] = attachments;
+  return true;
+}
 
-  VkImageView image_view = swap_chain->GetImageView(resource_index)->handle();
-  VkFramebufferCreateInfo framebuffer_create_info = {
-      VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // VkStructureType sType
-      nullptr,       // const void                    *pNext
-      0,             // VkFramebufferCreateFlags       flags
-      render_pass_,  // VkRenderPass                   renderPass
-      1,
-      &image_view,  // const VkImageView             *pAttachments
-      300,          // uint32_t                       width
-      300,          // uint32_t                       height
-      1             // uint32_t                       layers
-  };
+VkDescriptorSet VulkanRenderPass::GetInputAttachmentSet(
+    uint32_t subpass,
+    uint32_t resource_index) const {
+  DCHECK_LT(subpass, subpasses_.size());
+  DCHECK_LT(resource_index, input_sets_.size());
+  return input_sets_[resource_index][subpass];
+}
 
-  if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr,
-                          &frame_buffers_[resource_index]) != VK_SUCCESS) {
+bool VulkanRenderPass::CreateFrameBuffer(const VulkanSwapChain* swap_chain,
+                                         uint32_t resource_index) {
+  // The cache hands out the same framebuffer for the image view until the
+  // swap chain is recreated, so this is only a lookup after the first frame.
+  std::vector<VkImageView> attachments(attachments_.size(), VK_NULL_HANDLE);
+  for (uint32_t i = 0; i < attachments_.size(); ++i) {
+    if (i == swap_image_attachment_) {
+      attachments[i] = swap_chain->GetImageView(resource_index)->handle();
+      continue;
+    }
+    VulkanImage* image =
+        GetAttachmentImage(resource_index, i, swap_chain->GetExtent());
+    if (!image)
+      return false;
+    attachments[i] = image->image_view()->handle();
+  }
+  if (!WriteInputAttachmentSets(resource_index, attachments))
+    return false;
+  VkFramebuffer framebuffer = device_queue_->GetFramebufferCache()->Get(
+      compatible_render_pass_, attachments, swap_chain->GetExtent());
+  if (VK_NULL_HANDLE == framebuffer) {
     std::cout << "Could not create a framebuffer!" << std::endl;
     return false;
   }
 
+  if (resource_index >= frame_buffers_.size())
+    frame_buffers_.resize(resource_index + 1, VK_NULL_HANDLE);
+  frame_buffers_[resource_index] = framebuffer;
   return true;
 }
 
+VulkanImage* VulkanRenderPass::GetAttachmentImage(uint32_t resource_index,
+                                                  uint32_t attachment,
+                                                  const VkExtent2D& extent) {
+  if (resource_index >= attachment_images_.size())
+    attachment_images_.resize(resource_index + 1);
+  std::vector<std::unique_ptr<VulkanImage>>& images =
+      attachment_images_[resource_index];
+  if (images.empty())
+    images.resize(attachments_.size());
+  std::unique_ptr<VulkanImage>& image = images[attachment];
+  if (image && (image->extent().width != extent.width ||
+                image->extent().height != extent.height)) {
+    // Evicts the framebuffers of the old extent.
+    image->Destroy();
+    image.reset();
+  }
+  if (image)
+    return image.get();
+
+  const VkAttachmentDescription& description = attachments_[attachment];
+  VkImageUsageFlags usage = attachment_usages_[attachment];
+  VulkanImageView::ImageType image_type = VulkanImageView::IMAGE_TYPE_COLOR;
+  if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+    image_type = VulkanImage::HasStencil(description.format)
+                     ? VulkanImageView::IMAGE_TYPE_DEPTH_STENCIL
+                     : VulkanImageView::IMAGE_TYPE_DEPTH;
+  }
+  // Attachments whose contents neither come from nor go to memory only
+  // live in tile memory on tile-based GPUs, where lazily allocated memory
+  // then never gets backed.
+  VulkanMemoryUsage memory_usage = VulkanMemoryUsage::GPU_ONLY;
+  if (description.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD &&
+      description.storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE &&
+      description.stencilLoadOp != VK_ATTACHMENT_LOAD_OP_LOAD &&
+      description.stencilStoreOp == VK_ATTACHMENT_STORE_OP_DONT_CARE) {
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    memory_usage = VulkanMemoryUsage::TRANSIENT;
+  }
+
+  image.reset(new VulkanImage(device_queue_));
+  if (!image->Initialize(description.format, extent, usage, image_type,
+                         description.samples, memory_usage)) {
+    std::cout << "Could not create an attachment image!" << std::endl;
+    image.reset();
+    return nullptr;
+  }
+  return image.get();
+}
+
 bool VulkanRenderPass::CreatePipeline(const std::string& kVertexShaderSource,
                                       const std::string& kFragShaderSource,
                                       VkPrimitiveTopology primitiveTopology,
                                       bool vertex_binding) {
-  VkDevice device = device_queue_->GetVulkanDevice();
-
-  VulkanShaderModule vertex_shader_module(device);
-  vertex_shader_module.InitializeGLSL(VulkanShaderModule::ShaderType::VERTEX,
-                                      "vetext", "main", kVertexShaderSource);
+  // only for tutorial4
+  VulkanVertexInput vertex_input;
+  if (vertex_binding)
+    vertex_input = VulkanBuffer::VertexDataLayout::Describe();
+  return CreateGraphicsPipeline(kVertexShaderSource, kFragShaderSource,
+                                primitiveTopology, vertex_input,
+                                vertex_binding);
+}
 
-  VulkanShaderModule fragment_shader_module(device);
-  fragment_shader_module.InitializeGLSL(
-      VulkanShaderModule::ShaderType::FRAGMENT, "fragment", "main",
-      kFragShaderSource);
+bool VulkanRenderPass::CreatePipeline(const std::string& kVertexShaderSource,
+                                      const std::string& kFragShaderSource,
+                                      VkPrimitiveTopology primitiveTopology,
+                                      const VulkanVertexInput& vertex_input) {
+  return CreateGraphicsPipeline(kVertexShaderSource, kFragShaderSource,
+                                primitiveTopology, vertex_input, true);
+}
 
-  if (!vertex_shader_module.IsValid()) {
-    std::cout << "vertext shader error = "
-              << vertex_shader_module.GetErrorMessages();
+bool VulkanRenderPass::CreateGraphicsPipeline(
+    const std::string& kVertexShaderSource,
+    const std::string& kFragShaderSource,
+    VkPrimitiveTopology primitiveTopology,
+    const VulkanVertexInput& vertex_input,
+    bool dynamic_viewport) {
+  VulkanPipelineDescription description;
+  if (!DescribePipeline(kVertexShaderSource, kFragShaderSource,
+                        primitiveTopology, vertex_input, dynamic_viewport,
+                        &description)) {
     return false;
   }
 
-  if (!fragment_shader_module.IsValid()) {
-    std::cout << "fragment shader error = "
-              << fragment_shader_module.GetErrorMessages();
+  // The registry returns the existing pipeline for identical state.
+  graphics_pipeline_ = device_queue_->GetPipelineRegistry()->Get(description);
+  if (VK_NULL_HANDLE == graphics_pipeline_) {
+    std::cout << "Could not create graphics pipeline!" << std::endl;
     return false;
   }
+  return true;
+}
 
-  std::vector<VkPipelineShaderStageCreateInfo> shader_stage_create_infos = {
-      // Vertex shader
-      {
-          VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // VkStructureType
-                                                                // sType
-          nullptr,  // const void                                    *pNext
-          0,        // VkPipelineShaderStageCreateFlags               flags
-          VK_SHADER_STAGE_VERTEX_BIT,     // VkShaderStageFlagBits stage
-          vertex_shader_module.handle(),  // VkShaderModule module
-          "main",  // const char                                    *pName
-          nullptr  // const VkSpecializationInfo *pSpecializationInfo
-      },
-      // Fragment shader
-      {
-          VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // VkStructureType
-                                                                // sType
-          nullptr,  // const void                                    *pNext
-          0,        // VkPipelineShaderStageCreateFlags               flags
-          VK_SHADER_STAGE_FRAGMENT_BIT,     // VkShaderStageFlagBits stage
-          fragment_shader_module.handle(),  // VkShaderModule module
-          "main",  // const char                                    *pName
-          nullptr  // const VkSpecializationInfo *pSpecializationInfo
-      }};
-
-  // only for tutorial4
-  std::vector<VkVertexInputBindingDescription> vertex_binding_descriptions = {{
-      0,                                 // uint32_t          binding
-      sizeof(VulkanBuffer::VertexData),  // uint32_t          stride
-      VK_VERTEX_INPUT_RATE_VERTEX        // VkVertexInputRate inputRate
-  }};
-
-  std::vector<VkVertexInputAttributeDescription> vertex_attribute_descriptions =
-      {{
-           0,  // uint32_t location
-           vertex_binding_descriptions[0].binding,       // uint32_t binding
-           VK_FORMAT_R32G32B32A32_SFLOAT,                // VkFormat format
-           offsetof(struct VulkanBuffer::VertexData, x)  // uint32_t offset
-       },
-       {
-           1,  // uint32_t location
-           vertex_binding_descriptions[0].binding,  // uint32_t binding
-           VK_FORMAT_R32G32B32A32_SFLOAT,  // VkFormat format
-           offsetof(struct VulkanBuffer::VertexData, r)  // uint32_t offset
-       }};
-  // end of only for tutorial4
-
-  VkVertexInputBindingDescription* pVertexBindingDescriptions = nullptr;
-  VkVertexInputAttributeDescription* pVertexAttributeDescriptions = nullptr;
-  uint32_t binding_size = 0;
-  uint32_t attribute_size = 0;
-
-  if (vertex_binding) {
-    pVertexBindingDescriptions = &vertex_binding_descriptions[0];
-    pVertexAttributeDescriptions = &vertex_attribute_descriptions[0];
-    binding_size = static_cast<uint32_t>(vertex_binding_descriptions.size());
-    attribute_size =
-        static_cast<uint32_t>(vertex_attribute_descriptions.size());
-  }
-
-  VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,  // StructureType
-                                                                  // sType
-      nullptr,       // const void   *pNext
-      0,             // VkPipelineVertexInputStateCreateFlags          flags;
-      binding_size,  // uint32_t vertexBindingDescriptionCount
-      pVertexBindingDescriptions,  // const VkVertexInputBindingDescription
-                                   // *pVertexBindingDescriptions
-      attribute_size,              // uint32_t vertexAttributeDescriptionCount
-      pVertexAttributeDescriptions};
-
-  VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,  // VkStructureType
-                                                                    // sType
-      nullptr,  // const void                                    *pNext
-      0,        // VkPipelineInputAssemblyStateCreateFlags        flags
-      primitiveTopology,  // VkPrimitiveTopology topology
-      VK_FALSE                              // VkBool32 primitiveRestartEnable
-  };
-
-  // for tutorial3
-  VkViewport viewport = {
-      0.0f,    // x
-      0.0f,    // y
-      300.0f,  // width
-      300.0f,  // height
-      0.0f,    // minDepth
-      1.0f     // maxDepth
-  };
-
-  // for tutorial3
-  VkRect2D scissor = {{
-                          // VkOffset2D offset
-                          0,  // x
-                          0   // y
-                      },
-                      {
-                          // VkExtent2D extent
-                          300,  // width
-                          300   // height
-                      }};
-
-  VkViewport* pViewport = nullptr;
-  VkRect2D* pScissor = nullptr;
-
-  if (!vertex_binding) {
-    pViewport = &viewport;
-    pScissor = &scissor;
-  }
-
-  VkPipelineViewportStateCreateInfo viewport_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,  // VkStructureType
-                                                              // sType
-      nullptr,  // const void                                    *pNext
-      0,        // VkPipelineViewportStateCreateFlags             flags
-      1,        // uint32_t                                       viewportCount
-      pViewport,  // const VkViewport                              *pViewports
-      1,          // uint32_t                                       scissorCount
-      pScissor    // const VkRect2D                                *pScissors
-  };
-
-  // Preparing the Rasterization State’s Description
-  VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,  // VkStructureType
-                                                                   // sType
-      nullptr,   // const void                                    *pNext
-      0,         // VkPipelineRasterizationStateCreateFlags        flags
-      VK_FALSE,  // VkBool32 depthClampEnable
-      VK_FALSE,  // VkBool32 rasterizerDiscardEnable
-      VK_POLYGON_MODE_FILL,             // VkPolygonMode polygonMode
-      VK_CULL_MODE_BACK_BIT,            // VkCullModeFlags cullMode
-      VK_FRONT_FACE_COUNTER_CLOCKWISE,  // VkFrontFace frontFace
-      VK_FALSE,                         // VkBool32 depthBiasEnable
-      0.0f,                             // float depthBiasConstantFactor
-      0.0f,  // float                                          depthBiasClamp
-      0.0f,  // float depthBiasSlopeFactor
-      1.0f   // float                                          lineWidth
-  };
-
-  // Preparing the Rasterization State’s Description
-  VkPipelineMultisampleStateCreateInfo multisample_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,  // VkStructureType
-                                                                 // sType
-      nullptr,  // const void                                    *pNext
-      0,        // VkPipelineMultisampleStateCreateFlags          flags
-      VK_SAMPLE_COUNT_1_BIT,  // VkSampleCountFlagBits rasterizationSamples
-      VK_FALSE,               // VkBool32 sampleShadingEnable
-      1.0f,  // float                                          minSampleShading
-      nullptr,   // const VkSampleMask                            *pSampleMask
-      VK_FALSE,  // VkBool32 alphaToCoverageEnable
-      VK_FALSE   // VkBool32 alphaToOneEnable
-  };
-
-  // Setting the Blending State’s Description
-  VkPipelineColorBlendAttachmentState color_blend_attachment_state = {
-      VK_FALSE,  // VkBool32                                       blendEnable
-      VK_BLEND_FACTOR_ONE,   // VkBlendFactor srcColorBlendFactor
-      VK_BLEND_FACTOR_ZERO,  // VkBlendFactor dstColorBlendFactor
-      VK_BLEND_OP_ADD,       // VkBlendOp colorBlendOp
-      VK_BLEND_FACTOR_ONE,   // VkBlendFactor srcAlphaBlendFactor
-      VK_BLEND_FACTOR_ZERO,  // VkBlendFactor dstAlphaBlendFactor
-      VK_BLEND_OP_ADD,       // VkBlendOp alphaBlendOp
-      VK_COLOR_COMPONENT_R_BIT |
-          VK_COLOR_COMPONENT_G_BIT |  // VkColorComponentFlags colorWriteMask
-          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
-
-  VkPipelineColorBlendStateCreateInfo color_blend_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,  // VkStructureType
-                                                                 // sType
-      nullptr,   // const void                                    *pNext
-      0,         // VkPipelineColorBlendStateCreateFlags           flags
-      VK_FALSE,  // VkBool32                                       logicOpEnable
-      VK_LOGIC_OP_COPY,  // VkLogicOp logicOp
-      1,  // uint32_t                                       attachmentCount
-      &color_blend_attachment_state,  // const
-                                      // VkPipelineColorBlendAttachmentState
-                                      // *pAttachments
-      {0.0f, 0.0f, 0.0f, 0.0f}        // float blendConstants[4]
-  };
-
-  // only for tutorial4
-  std::vector<VkDynamicState> dynamic_states = {
-      VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
-  };
+bool VulkanRenderPass::CreatePipelineAsync(
+    const std::string& kVertexShaderSource,
+    const std::string& kFragShaderSource,
+    VkPrimitiveTopology primitiveTopology,
+    const VulkanVertexInput& vertex_input,
+    VulkanPipelineCompiler* compiler) {
+  if (!DescribePipeline(kVertexShaderSource, kFragShaderSource,
+                        primitiveTopology, vertex_input, true,
+                        &pipeline_description_)) {
+    return false;
+  }
+  pipeline_hash_ = HashPipelineDescription(pipeline_description_);
+  pipeline_compiler_ = compiler;
+  graphics_pipeline_ = VK_NULL_HANDLE;
+  GetGraphicsPipeline();
+  return true;
+}
 
-  VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,  // VkStructureType
-                                                             // sType
-      nullptr,  // const void                                    *pNext
-      0,        // VkPipelineDynamicStateCreateFlags              flags
-      static_cast<uint32_t>(
-          dynamic_states.size()),  // uint32_t dynamicStateCount
-      &dynamic_states[0]           // const VkDynamicState *pDynamicStates
-  };
-  // end of tutorial4
+bool VulkanRenderPass::CreateDepthPrepassPipeline(
+    const std::string& kVertexShaderSource,
+    VkPrimitiveTopology primitiveTopology,
+    const VulkanVertexInput& vertex_input) {
+  DCHECK(depth_mode_ == DepthMode::DEPTH_MODE_PREPASS);
+  VulkanPipelineDescription description;
+  if (!DescribePipeline(kVertexShaderSource, std::string(), primitiveTopology,
+                        vertex_input, true, &description)) {
+    return false;
+  }
+  // Only the nearest depth is written. The fragment shaders of the color
+  // pipelines then run once per pixel.
+  description.color_write_enable = false;
+  description.depth_write_enable = true;
+  description.depth_compare_op = VK_COMPARE_OP_LESS;
+
+  depth_prepass_pipeline_ =
+      device_queue_->GetPipelineRegistry()->Get(description);
+  if (VK_NULL_HANDLE == depth_prepass_pipeline_) {
+    std::cout << "Could not create depth pre-pass pipeline!" << std::endl;
+    return false;
+  }
+  return true;
+}
 
-  const VkPipelineDynamicStateCreateInfo* pDynamicStateCreateInfo = nullptr;
-  if (vertex_binding)
-    pDynamicStateCreateInfo = &dynamic_state_create_info;
-
-  // Tutorial::CreatePipelineLayout(): Creating a Pipeline Layout
-  VkPipelineLayoutCreateInfo layout_create_info = {
-      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // VkStructureType sType
-      nullptr,  // const void                    *pNext
-      0,        // VkPipelineLayoutCreateFlags    flags
-      0,        // uint32_t                       setLayoutCount
-      nullptr,  // const VkDescriptorSetLayout   *pSetLayouts
-      0,        // uint32_t                       pushConstantRangeCount
-      nullptr   // const VkPushConstantRange     *pPushConstantRanges
-  };
+VkPipeline VulkanRenderPass::GetGraphicsPipeline() {
+  if (VK_NULL_HANDLE == graphics_pipeline_ && pipeline_compiler_) {
+    graphics_pipeline_ = device_queue_->GetPipelineRegistry()->GetOrCompile(
+        pipeline_description_, pipeline_hash_, pipeline_compiler_);
+    if (VK_NULL_HANDLE != graphics_pipeline_)
+      pipeline_compiler_ = nullptr;
+  }
+  return graphics_pipeline_;
+}
 
-  if (vkCreatePipelineLayout(device, &layout_create_info, nullptr,
-                             &pipeline_layout_) != VK_SUCCESS) {
-    std::cout << "Could not create pipeline layout!" << std::endl;
+bool VulkanRenderPass::DescribePipeline(
+    const std::string& kVertexShaderSource,
+    const std::string& kFragShaderSource,
+    VkPrimitiveTopology primitiveTopology,
+    const VulkanVertexInput& vertex_input,
+    bool dynamic_viewport,
+    VulkanPipelineDescription* description) {
+  if (!DescribeSubpassPipeline(0, kVertexShaderSource, kFragShaderSource,
+                               primitiveTopology, vertex_input,
+                               description)) {
     return false;
   }
-  // end of creating a Pipeline Layout (only for tutorial3?)
-
-  VkGraphicsPipelineCreateInfo pipeline_create_info = {
-      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,  // VkStructureType sType
-      nullptr,  // const void                                    *pNext
-      0,        // VkPipelineCreateFlags                          flags
-      static_cast<uint32_t>(
-          shader_stage_create_infos.size()),  // uint32_t stageCount
-      &shader_stage_create_infos[0],   // const VkPipelineShaderStageCreateInfo
-      &vertex_input_state_create_info, // VkPipelineVertexInputStateCreateInfo
-      &input_assembly_state_create_info, // VkPipelineInputAssemblyStateCreateInfo
-                                          // *pInputAssemblyState
-      nullptr,                     // const VkPipelineTessellationStateCreateInfo
-      &viewport_state_create_info, // const VkPipelineViewportStateCreateInfo
-      &rasterization_state_create_info, // VkPipelineRasterizationStateCreateInfo
-      &multisample_state_create_info,  // VkPipelineMultisampleStateCreateInfo
-      nullptr,                         // const VkPipelineDepthStencilStateCreateInfo
-      &color_blend_state_create_info,  // VkPipelineColorBlendStateCreateInfo
-                                       // *pColorBlendState
-      pDynamicStateCreateInfo,         //   (tutorial4)       // const
-                                       //   VkPipelineDynamicStateCreateInfo
-                                       //   *pDynamicState
-      pipeline_layout_,                // VkPipelineLayout layout
-      render_pass_,                    // VkRenderPass renderPass
-      0,               // uint32_t subpass
-      VK_NULL_HANDLE,  // VkPipeline basePipelineHandle
-      -1  // int32_t basePipelineIndex
-  };
+  // for tutorial3, tutorial4 sets the viewport dynamically.
+  description->dynamic_viewport = dynamic_viewport;
+  return true;
+}
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
-                                &pipeline_create_info, nullptr,
-                                &graphics_pipeline_) != VK_SUCCESS) {
-    std::cout << "Could not create graphics pipeline!" << std::endl;
+bool VulkanRenderPass::DescribeSubpassPipeline(
+    uint32_t subpass,
+    const std::string& kVertexShaderSource,
+    const std::string& kFragShaderSource,
+    VkPrimitiveTopology primitiveTopology,
+    const VulkanVertexInput& vertex_input,
+    VulkanPipelineDescription* description) {
+  DCHECK_LT(subpass, subpasses_.size());
+  VulkanPipelineRegistry* registry = device_queue_->GetPipelineRegistry();
+  // Tutorial::CreatePipelineLayout(): Creating a Pipeline Layout. Every
+  // pipeline of the demos uses the same empty layout, unless its subpass
+  // reads input attachments.
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  if (VK_NULL_HANDLE != input_set_layouts_[subpass]) {
+    layout = registry->GetPipelineLayout({input_set_layouts_[subpass]}, {});
+  } else {
+    if (VK_NULL_HANDLE == pipeline_layout_)
+      pipeline_layout_ = registry->GetPipelineLayout({}, {});
+    layout = pipeline_layout_;
+  }
+  if (VK_NULL_HANDLE == layout) {
+    std::cout << "Could not create pipeline layout!" << std::endl;
     return false;
   }
 
-  vertex_shader_module.Destroy();
-  fragment_shader_module.Destroy();
-  printf("VulkanRenderPass::%s_end\n", __func__);
+  description->vertex_shader_source = kVertexShaderSource;
+  description->fragment_shader_source = kFragShaderSource;
+  description->topology = primitiveTopology;
+  description->vertex_input = vertex_input;
+  description->dynamic_viewport = true;
+  description->layout = layout;
+  description->render_pass = compatible_render_pass_;
+  description->subpass = subpass;
+  description->samples = SubpassSamples(attachments_, subpasses_[subpass]);
+  description->color_attachment_count =
+      static_cast<uint32_t>(subpasses_[subpass].color_attachments.size());
+  if (subpass != 0)
+    return true;
+  switch (depth_mode_) {
+    case DepthMode::DEPTH_MODE_NONE:
+      break;
+    case DepthMode::DEPTH_MODE_TEST:
+      description->depth_test_enable = true;
+      description->depth_write_enable = true;
+      description->depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+      break;
+    case DepthMode::DEPTH_MODE_PREPASS:
+      // The pre-pass already wrote the nearest depth.
+      description->depth_test_enable = true;
+      description->depth_write_enable = false;
+      description->depth_compare_op = VK_COMPARE_OP_EQUAL;
+      break;
+  }
   return true;
 }
 
 void VulkanRenderPass::Destroy() {
-  VkDevice device = device_queue_->GetVulkanDevice();
-
-  for (VkFramebuffer frame_buffer : frame_buffers_) {
-    vkDestroyFramebuffer(device, frame_buffer, nullptr);
-  }
+  // The framebuffers belong to the framebuffer cache and the pipelines and
+  // pipeline layout to the pipeline registry.
   frame_buffers_.clear();
-
+  for (std::vector<std::unique_ptr<VulkanImage>>& images :
+       attachment_images_) {
+    for (std::unique_ptr<VulkanImage>& image : images) {
+      if (image)
+        image->Destroy();
+    }
+  }
+  attachment_images_.clear();
+  // Frees the input attachment sets. Their layouts belong to the registry.
+  if (VK_NULL_HANDLE != input_set_pool_) {
+    device_queue_->GetDeletionQueue()->Enqueue(input_set_pool_);
+    input_set_pool_ = VK_NULL_HANDLE;
+  }
+  input_set_capacity_ = 0;
+  input_sets_.clear();
+  input_set_views_.clear();
+  input_set_layouts_.clear();
+  graphics_pipeline_ = VK_NULL_HANDLE;
+  depth_prepass_pipeline_ = VK_NULL_HANDLE;
+  pipeline_layout_ = VK_NULL_HANDLE;
+  pipeline_compiler_ = nullptr;
+
+  // The last user of a render pass evicts its framebuffers and pipelines.
   if (VK_NULL_HANDLE != render_pass_) {
-    vkDestroyRenderPass(device, render_pass_, nullptr);
+    device_queue_->GetRenderPassCache()->Release(render_pass_);
     render_pass_ = VK_NULL_HANDLE;
+    compatible_render_pass_ = VK_NULL_HANDLE;
   }
-
-  vkDestroyPipelineLayout(device, pipeline_layout_, nullptr);
   swap_chain_ = nullptr;
-  // attachment_clear_values_.clear();
+  depth_mode_ = DepthMode::DEPTH_MODE_NONE;
+  depth_format_ = VK_FORMAT_UNDEFINED;
+  depth_attachment_index_ = VK_ATTACHMENT_UNUSED;
+  samples_ = VK_SAMPLE_COUNT_1_BIT;
+  attachments_.clear();
+  subpasses_.clear();
+  attachment_usages_.clear();
+  attachment_clear_values_.clear();
   // attachment_clear_indexes_.clear();
 }
 
 void VulkanRenderPass::SetClearValue(uint32_t attachment_index,
-                                     VkClearValue clear_value) {}
+                                     VkClearValue clear_value) {
+  DCHECK_LT(attachment_index, attachment_clear_values_.size());
+  attachment_clear_values_[attachment_index] = clear_value;
+}
 
 }  // namespace gpu
@@ -6,17 +6,22 @@
 #define GPU_VULKAN_VULKAN_RENDER_PASS_H_
 
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "base/macros.h"
 #include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_pipeline.h"
+#include "vulkan_render_pass_cache.h"
 
 namespace gpu {
 
 class CommandBufferRecorderBase;
 class VulkanDeviceQueue;
+class VulkanImage;
 // class VulkanImageView;
+class VulkanPipelineCompiler;
 class VulkanSwapChain;
 
 class VULKAN_EXPORT VulkanRenderPass {
@@ -40,25 +45,139 @@ class VULKAN_EXPORT VulkanRenderPass {
     IMAGE_LAYOUT_TYPE_PRESENT,
   };
 
+  enum class DepthMode {
+    // No depth attachment. Visibility only comes from culling.
+    DEPTH_MODE_NONE,
+
+    // Pipelines test and write depth.
+    DEPTH_MODE_TEST,
+
+    // Depth is laid down first by the pipeline of
+    // CreateDepthPrepassPipeline(), then the other pipelines only pass
+    // fragments with the same depth, so expensive fragment shaders run once
+    // per pixel. The vertex shaders must compute the same positions, e.g.
+    // by declaring gl_Position invariant.
+    DEPTH_MODE_PREPASS,
+  };
+
   explicit VulkanRenderPass(VulkanDeviceQueue* device_queue);
   ~VulkanRenderPass();
 
+  // Without DEPTH_MODE_NONE a depth attachment of the best supported
+  // format, see VulkanImage::FindDepthFormat(), is added as attachment 1.
+  // It is cleared to 1.0 and not stored.
+  //
+  // With more than one sample, clamped to what the device supports, color
+  // and depth are rendered to multisampled attachments which are resolved
+  // into the swap chain image, the last attachment. They are neither loaded
+  // nor stored, so on tile-based GPUs they never leave tile memory.
   bool Initialize(const VulkanSwapChain* swap_chain,
-      std::vector<VkSubpassDependency>& subpass_dependencies);
+      std::vector<VkSubpassDependency>& subpass_dependencies,
+      DepthMode depth_mode = DepthMode::DEPTH_MODE_NONE,
+      VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+  // Uses the render pass of |description| from the device's
+  // VulkanRenderPassCache. The attachment with the PRESENT_SRC_KHR final
+  // layout is the swap chain image. Every other attachment gets an image
+  // per framebuffer; those that are neither loaded nor stored are transient
+  // and use lazily allocated memory where the device has it. |depth_mode|
+  // must match whether subpass 0 has a depth attachment.
+  //
+  // Later subpasses may read attachments written by earlier ones as input
+  // attachments, e.g. a lighting subpass reading a G-buffer. On tile-based
+  // GPUs the G-buffer then stays in tile memory if it isn't stored. The
+  // description's dependencies must order those reads after the writes.
+  bool Initialize(const VulkanSwapChain* swap_chain,
+                  const VulkanRenderPassDescription& description,
+                  DepthMode depth_mode = DepthMode::DEPTH_MODE_NONE);
   void Destroy();
 
   void SetClearValue(uint32_t attachment_index, VkClearValue clear_value);
+  // One per attachment, for VkRenderPassBeginInfo.
+  const std::vector<VkClearValue>& clear_values() const {
+    return attachment_clear_values_;
+  }
   bool CreatePipeline(const std::string& vertexShader,
                       const std::string& fragmentShader,
                       VkPrimitiveTopology primitiveTopology,
                       bool qvertex_binding = false);
+  // Creates a pipeline reading vertices as described by |vertex_input|, e.g.
+  // from VulkanVertexLayout<>::Describe().
+  bool CreatePipeline(const std::string& vertexShader,
+                      const std::string& fragmentShader,
+                      VkPrimitiveTopology primitiveTopology,
+                      const VulkanVertexInput& vertex_input);
+  // Like CreatePipeline(), but the pipeline is built on |compiler|'s threads
+  // and GetGraphicsPipeline() returns VK_NULL_HANDLE until it is ready.
+  bool CreatePipelineAsync(const std::string& vertexShader,
+                           const std::string& fragmentShader,
+                           VkPrimitiveTopology primitiveTopology,
+                           const VulkanVertexInput& vertex_input,
+                           VulkanPipelineCompiler* compiler);
+  // Creates the depth only pipeline of DEPTH_MODE_PREPASS. It runs
+  // |vertexShader| without a fragment shader and writes no color.
+  bool CreateDepthPrepassPipeline(const std::string& vertexShader,
+                                  VkPrimitiveTopology primitiveTopology,
+                                  const VulkanVertexInput& vertex_input);
+  // Sets frame_buffers_[|resource_index|] to the framebuffer of swap chain
+  // image |resource_index|, sized to the swap chain's extent. Framebuffers
+  // come from the device's VulkanFramebufferCache, so calling this every
+  // frame is cheap. With a depth attachment every framebuffer gets its own
+  // depth image, recreated when the extent changes. The input attachment
+  // sets of the framebuffer are rewritten when its images were recreated,
+  // so the images must not be in use then.
   bool CreateFrameBuffer(const VulkanSwapChain* swap_chain,
                          uint32_t resource_index);
 
   VkRenderPass handle() { return render_pass_; }
-  // There is 1 frame buffer for every swap chain image.
+  // There is 1 frame buffer for every swap chain image. They are owned by
+  // the framebuffer cache.
   std::vector<VkFramebuffer> frame_buffers_;
-  VkPipeline GetGraphicsPipeline() { return graphics_pipeline_; }
+  // The pipeline of the last CreatePipeline*() call. Render passes with
+  // several pipelines describe them with DescribePipeline() and look them up
+  // in the device's VulkanPipelineRegistry.
+  VkPipeline GetGraphicsPipeline();
+  VkPipelineLayout GetPipelineLayout() const { return pipeline_layout_; }
+  VkPipeline GetDepthPrepassPipeline() const {
+    return depth_prepass_pipeline_;
+  }
+  DepthMode depth_mode() const { return depth_mode_; }
+  VkFormat depth_format() const { return depth_format_; }
+  // Of subpass 0, which its pipelines are created with.
+  VkSampleCountFlagBits samples() const { return samples_; }
+  uint32_t subpass_count() const {
+    return static_cast<uint32_t>(subpasses_.size());
+  }
+
+  // Binding i is input attachment i of |subpass|, for fragment shaders.
+  // VK_NULL_HANDLE if the subpass reads no input attachments. Owned by the
+  // pipeline registry.
+  VkDescriptorSetLayout GetInputAttachmentSetLayout(uint32_t subpass) const {
+    return input_set_layouts_[subpass];
+  }
+  // The set of |subpass|'s input attachments of framebuffer
+  // |resource_index|, to bind as set 0 of the subpass's pipeline layout.
+  VkDescriptorSet GetInputAttachmentSet(uint32_t subpass,
+                                        uint32_t resource_index) const;
+
+  // Fills |description| for a pipeline of subpass 0 with the render pass's
+  // pipeline layout and the depth state of its DepthMode.
+  bool DescribePipeline(const std::string& vertexShader,
+                        const std::string& fragmentShader,
+                        VkPrimitiveTopology primitiveTopology,
+                        const VulkanVertexInput& vertex_input,
+                        bool dynamic_viewport,
+                        VulkanPipelineDescription* description);
+  // Like DescribePipeline() with a dynamic viewport, for a pipeline of
+  // |subpass|. The sample count and the number of color attachments match
+  // the subpass. Subpasses with input attachments get a pipeline layout with
+  // GetInputAttachmentSetLayout() as set 0. Only subpass 0 gets the depth
+  // state of the DepthMode.
+  bool DescribeSubpassPipeline(uint32_t subpass,
+                               const std::string& vertexShader,
+                               const std::string& fragmentShader,
+                               VkPrimitiveTopology primitiveTopology,
+                               const VulkanVertexInput& vertex_input,
+                               VulkanPipelineDescription* description);
 
   //  bool CreateRenderingResource(uint32_t num_resoures);
   // for Resource, Tutorial4
@@ -73,6 +192,22 @@ class VULKAN_EXPORT VulkanRenderPass {
     std::vector<RenderingResourcesData>   RenderingResources_;
   */
  private:
+  bool CreateGraphicsPipeline(const std::string& vertexShader,
+                              const std::string& fragmentShader,
+                              VkPrimitiveTopology primitiveTopology,
+                              const VulkanVertexInput& vertex_input,
+                              bool dynamic_viewport);
+  // The image of |attachment| of framebuffer |resource_index|, created or
+  // recreated at |extent|.
+  VulkanImage* GetAttachmentImage(uint32_t resource_index,
+                                  uint32_t attachment,
+                                  const VkExtent2D& extent);
+  bool CreateInputAttachmentPool(uint32_t framebuffer_count);
+  // Points the input attachment sets of framebuffer |resource_index| at
+  // |attachments|, allocating them on the first call.
+  bool WriteInputAttachmentSets(uint32_t resource_index,
+                                const std::vector<VkImageView>& attachments);
+
   VulkanDeviceQueue* device_queue_ = nullptr;
   const VulkanSwapChain* swap_chain_ = nullptr;
   //  uint32_t num_sub_passes_ = 0;
@@ -80,6 +215,33 @@ class VULKAN_EXPORT VulkanRenderPass {
   bool executing_ = false;
   //  VkSubpassContents execution_type_ = VK_SUBPASS_CONTENTS_INLINE;
   VkRenderPass render_pass_ = VK_NULL_HANDLE;
+  // The render pass pipelines and framebuffers are created with, see
+  // VulkanRenderPassCache::GetCompatible().
+  VkRenderPass compatible_render_pass_ = VK_NULL_HANDLE;
+
+  DepthMode depth_mode_ = DepthMode::DEPTH_MODE_NONE;
+  VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+  uint32_t depth_attachment_index_ = VK_ATTACHMENT_UNUSED;
+  VkSampleCountFlagBits samples_ = VK_SAMPLE_COUNT_1_BIT;
+
+  std::vector<VkAttachmentDescription> attachments_;
+  // What each attachment is used as in any subpass, for its images.
+  std::vector<VkImageUsageFlags> attachment_usages_;
+  uint32_t swap_image_attachment_ = 0;
+  // Per framebuffer, like frame_buffers_, the images of every attachment
+  // but the swap chain image.
+  std::vector<std::vector<std::unique_ptr<VulkanImage>>> attachment_images_;
+
+  std::vector<VulkanRenderPassDescription::Subpass> subpasses_;
+  // Per subpass, VK_NULL_HANDLE for those without input attachments.
+  std::vector<VkDescriptorSetLayout> input_set_layouts_;
+  // Holds the input attachment sets of |input_set_capacity_| framebuffers.
+  VkDescriptorPool input_set_pool_ = VK_NULL_HANDLE;
+  uint32_t input_set_capacity_ = 0;
+  // Per framebuffer, the input attachment set of every subpass and the
+  // attachment views they point at.
+  std::vector<std::vector<VkDescriptorSet>> input_sets_;
+  std::vector<std::vector<VkImageView>> input_set_views_;
 
   // There is 1 clear color for every attachment which needs a clear.
   std::vector<VkClearValue> attachment_clear_values_;
@@ -88,8 +250,14 @@ class VULKAN_EXPORT VulkanRenderPass {
   // kept in a separate array since it is only used setting clear values.
   std::vector<uint32_t> attachment_clear_indexes_;
 
-  VkPipeline graphics_pipeline_;
-  VkPipelineLayout pipeline_layout_;
+  // Owned by the pipeline registry.
+  VkPipeline graphics_pipeline_ = VK_NULL_HANDLE;
+  VkPipeline depth_prepass_pipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  // Set by CreatePipelineAsync() until the pipeline is ready.
+  VulkanPipelineCompiler* pipeline_compiler_ = nullptr;
+  VulkanPipelineDescription pipeline_description_;
+  size_t pipeline_hash_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(VulkanRenderPass);
 };
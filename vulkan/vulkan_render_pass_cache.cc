@@ -0,0 +1,310 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_render_pass_cache.h"
+
+#include <functional>
+
+#include "base/logging.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_framebuffer_cache.h"
+#include "vulkan_pipeline_registry.h"
+
+namespace gpu {
+
+namespace {
+
+template <typename T>
+size_t HashCombine(size_t seed, const T& value) {
+  return seed * 31 + std::hash<T>()(value);
+}
+
+// With |compatible_only| only what render pass compatibility depends on is
+// compared, which leaves out load and store ops and layouts.
+bool AttachmentsEqual(const VkAttachmentDescription& a,
+                      const VkAttachmentDescription& b,
+                      bool compatible_only) {
+  if (a.flags != b.flags || a.format != b.format || a.samples != b.samples)
+    return false;
+  return compatible_only ||
+         (a.loadOp == b.loadOp && a.storeOp == b.storeOp &&
+          a.stencilLoadOp == b.stencilLoadOp &&
+          a.stencilStoreOp == b.stencilStoreOp &&
+          a.initialLayout == b.initialLayout &&
+          a.finalLayout == b.finalLayout);
+}
+
+bool ReferencesEqual(const VkAttachmentReference& a,
+                     const VkAttachmentReference& b,
+                     bool compatible_only) {
+  return a.attachment == b.attachment &&
+         (compatible_only || a.layout == b.layout);
+}
+
+bool ReferencesEqual(const std::vector<VkAttachmentReference>& a,
+                     const std::vector<VkAttachmentReference>& b,
+                     bool compatible_only) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!ReferencesEqual(a[i], b[i], compatible_only))
+      return false;
+  }
+  return true;
+}
+
+bool SubpassesEqual(const VulkanRenderPassDescription::Subpass& a,
+                    const VulkanRenderPassDescription::Subpass& b,
+                    bool compatible_only) {
+  return ReferencesEqual(a.input_attachments, b.input_attachments,
+                         compatible_only) &&
+         ReferencesEqual(a.color_attachments, b.color_attachments,
+                         compatible_only) &&
+         ReferencesEqual(a.resolve_attachments, b.resolve_attachments,
+                         compatible_only) &&
+         ReferencesEqual(a.depth_stencil_attachment,
+                         b.depth_stencil_attachment, compatible_only);
+}
+
+bool DependenciesEqual(const VkSubpassDependency& a,
+                       const VkSubpassDependency& b) {
+  return a.srcSubpass == b.srcSubpass && a.dstSubpass == b.dstSubpass &&
+         a.srcStageMask == b.srcStageMask &&
+         a.dstStageMask == b.dstStageMask &&
+         a.srcAccessMask == b.srcAccessMask &&
+         a.dstAccessMask == b.dstAccessMask &&
+         a.dependencyFlags == b.dependencyFlags;
+}
+
+bool DescriptionsEqual(const VulkanRenderPassDescription& a,
+                       const VulkanRenderPassDescription& b,
+                       bool compatible_only) {
+  if (a.attachments.size() != b.attachments.size() ||
+      a.subpasses.size() != b.subpasses.size() ||
+      a.dependencies.size() != b.dependencies.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.attachments.size(); ++i) {
+    if (!AttachmentsEqual(a.attachments[i], b.attachments[i],
+                          compatible_only)) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < a.subpasses.size(); ++i) {
+    if (!SubpassesEqual(a.subpasses[i], b.subpasses[i], compatible_only))
+      return false;
+  }
+  for (size_t i = 0; i < a.dependencies.size(); ++i) {
+    if (!DependenciesEqual(a.dependencies[i], b.dependencies[i]))
+      return false;
+  }
+  return true;
+}
+
+size_t HashReferences(size_t hash,
+                      const std::vector<VkAttachmentReference>& references,
+                      bool compatible_only) {
+  hash = HashCombine(hash, references.size());
+  for (const VkAttachmentReference& reference : references) {
+    hash = HashCombine(hash, reference.attachment);
+    if (!compatible_only)
+      hash = HashCombine(hash, static_cast<uint32_t>(reference.layout));
+  }
+  return hash;
+}
+
+size_t HashDescription(const VulkanRenderPassDescription& description,
+                       bool compatible_only) {
+  size_t hash = std::hash<size_t>()(description.attachments.size());
+  for (const VkAttachmentDescription& attachment : description.attachments) {
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.format));
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.samples));
+    if (compatible_only)
+      continue;
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.loadOp));
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.storeOp));
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.initialLayout));
+    hash = HashCombine(hash, static_cast<uint32_t>(attachment.finalLayout));
+  }
+  for (const VulkanRenderPassDescription::Subpass& subpass :
+       description.subpasses) {
+    hash = HashReferences(hash, subpass.input_attachments, compatible_only);
+    hash = HashReferences(hash, subpass.color_attachments, compatible_only);
+    hash = HashReferences(hash, subpass.resolve_attachments, compatible_only);
+    hash = HashCombine(hash, subpass.depth_stencil_attachment.attachment);
+  }
+  for (const VkSubpassDependency& dependency : description.dependencies) {
+    hash = HashCombine(hash, dependency.srcSubpass);
+    hash = HashCombine(hash, dependency.dstSubpass);
+    hash = HashCombine(hash, dependency.srcStageMask);
+    hash = HashCombine(hash, dependency.dstStageMask);
+  }
+  return hash;
+}
+
+}  // namespace
+
+VulkanRenderPassDescription::Subpass::Subpass() {}
+
+VulkanRenderPassDescription::Subpass::Subpass(const Subpass& other) = default;
+
+VulkanRenderPassDescription::Subpass::~Subpass() {}
+
+VulkanRenderPassDescription::VulkanRenderPassDescription() {}
+
+VulkanRenderPassDescription::VulkanRenderPassDescription(
+    const VulkanRenderPassDescription& other) = default;
+
+VulkanRenderPassDescription::~VulkanRenderPassDescription() {}
+
+bool VulkanRenderPassDescription::operator==(
+    const VulkanRenderPassDescription& other) const {
+  return DescriptionsEqual(*this, other, false);
+}
+
+bool VulkanRenderPassDescription::IsCompatibleWith(
+    const VulkanRenderPassDescription& other) const {
+  return DescriptionsEqual(*this, other, true);
+}
+
+VulkanRenderPassCache::Entry::Entry() {}
+
+VulkanRenderPassCache::Entry::Entry(const Entry& other) = default;
+
+VulkanRenderPassCache::Entry::~Entry() {}
+
+VulkanRenderPassCache::VulkanRenderPassCache(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanRenderPassCache::~VulkanRenderPassCache() {
+  DCHECK(entries_.empty());
+}
+
+void VulkanRenderPassCache::Destroy() {
+  for (const Entry& entry : entries_)
+    DestroyEntry(entry);
+  entries_.clear();
+}
+
+VkRenderPass VulkanRenderPassCache::Acquire(
+    const VulkanRenderPassDescription& description) {
+  const size_t hash = HashDescription(description, false);
+  for (Entry& entry : entries_) {
+    if (entry.hash == hash && entry.description == description) {
+      ++hits_;
+      ++entry.ref_count;
+      return entry.handle;
+    }
+  }
+
+  ++misses_;
+  std::vector<VkSubpassDescription> subpasses;
+  for (const VulkanRenderPassDescription::Subpass& subpass :
+       description.subpasses) {
+    DCHECK(subpass.resolve_attachments.empty() ||
+           subpass.resolve_attachments.size() ==
+               subpass.color_attachments.size());
+    VkSubpassDescription subpass_description = {};
+    subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass_description.inputAttachmentCount =
+        static_cast<uint32_t>(subpass.input_attachments.size());
+    subpass_description.pInputAttachments = subpass.input_attachments.data();
+    subpass_description.colorAttachmentCount =
+        static_cast<uint32_t>(subpass.color_attachments.size());
+    subpass_description.pColorAttachments = subpass.color_attachments.data();
+    if (!subpass.resolve_attachments.empty()) {
+      subpass_description.pResolveAttachments =
+          subpass.resolve_attachments.data();
+    }
+    if (subpass.depth_stencil_attachment.attachment != VK_ATTACHMENT_UNUSED) {
+      subpass_description.pDepthStencilAttachment =
+          &subpass.depth_stencil_attachment;
+    }
+    subpasses.push_back(subpass_description);
+  }
+
+  VkRenderPassCreateInfo render_pass_create_info = {};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.attachmentCount =
+      static_cast<uint32_t>(description.attachments.size());
+  render_pass_create_info.pAttachments = description.attachments.data();
+  render_pass_create_info.subpassCount =
+      static_cast<uint32_t>(subpasses.size());
+  render_pass_create_info.pSubpasses = subpasses.data();
+  render_pass_create_info.dependencyCount =
+      static_cast<uint32_t>(description.dependencies.size());
+  render_pass_create_info.pDependencies = description.dependencies.data();
+
+  Entry entry;
+  VkResult result =
+      vkCreateRenderPass(device_queue_->GetVulkanDevice(),
+                         &render_pass_create_info, nullptr, &entry.handle);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateRenderPass() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  entry.description = description;
+  entry.hash = hash;
+  entry.compatibility_hash = HashDescription(description, true);
+  entry.ref_count = 1;
+  entry.compatible = entry.handle;
+
+  // Compatibility is transitive, so it is enough to look at the render
+  // passes that are their own compatible render pass.
+  for (Entry& other : entries_) {
+    if (other.compatible == other.handle &&
+        other.compatibility_hash == entry.compatibility_hash &&
+        other.description.IsCompatibleWith(description)) {
+      entry.compatible = other.handle;
+      ++other.ref_count;
+      break;
+    }
+  }
+  entries_.push_back(entry);
+  return entry.handle;
+}
+
+void VulkanRenderPassCache::Release(VkRenderPass render_pass) {
+  Entry* entry = FindByHandle(render_pass);
+  DCHECK(entry);
+  if (!entry)
+    return;
+  DCHECK_GT(entry->ref_count, 0u);
+  if (--entry->ref_count)
+    return;
+
+  Entry released = *entry;
+  entries_.erase(entries_.begin() + (entry - entries_.data()));
+  DestroyEntry(released);
+  if (released.compatible != released.handle)
+    Release(released.compatible);
+}
+
+VkRenderPass VulkanRenderPassCache::GetCompatible(
+    VkRenderPass render_pass) const {
+  for (const Entry& entry : entries_) {
+    if (entry.handle == render_pass)
+      return entry.compatible;
+  }
+  // Not from the cache.
+  return render_pass;
+}
+
+VulkanRenderPassCache::Entry* VulkanRenderPassCache::FindByHandle(
+    VkRenderPass render_pass) {
+  for (Entry& entry : entries_) {
+    if (entry.handle == render_pass)
+      return &entry;
+  }
+  return nullptr;
+}
+
+void VulkanRenderPassCache::DestroyEntry(const Entry& entry) {
+  device_queue_->GetFramebufferCache()->EvictRenderPass(entry.handle);
+  device_queue_->GetPipelineRegistry()->EvictRenderPass(entry.handle);
+  device_queue_->GetDeletionQueue()->Enqueue(entry.handle);
+}
+
+}  // namespace gpu
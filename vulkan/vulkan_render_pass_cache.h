@@ -0,0 +1,111 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_RENDER_PASS_CACHE_H_
+#define GPU_VULKAN_VULKAN_RENDER_PASS_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// Everything vkCreateRenderPass() needs, as plain data.
+struct VULKAN_EXPORT VulkanRenderPassDescription {
+  struct VULKAN_EXPORT Subpass {
+    Subpass();
+    Subpass(const Subpass& other);
+    ~Subpass();
+
+    std::vector<VkAttachmentReference> input_attachments;
+    std::vector<VkAttachmentReference> color_attachments;
+    // Empty, or one per color attachment.
+    std::vector<VkAttachmentReference> resolve_attachments;
+    VkAttachmentReference depth_stencil_attachment = {
+        VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED};
+  };
+
+  VulkanRenderPassDescription();
+  VulkanRenderPassDescription(const VulkanRenderPassDescription& other);
+  ~VulkanRenderPassDescription();
+
+  std::vector<VkAttachmentDescription> attachments;
+  std::vector<Subpass> subpasses;
+  std::vector<VkSubpassDependency> dependencies;
+
+  bool operator==(const VulkanRenderPassDescription& other) const;
+  // Whether pipelines and framebuffers of one can be used with the other.
+  // Compatible render passes may differ in load and store ops and layouts.
+  bool IsCompatibleWith(const VulkanRenderPassDescription& other) const;
+};
+
+// Hands out one VkRenderPass per distinct VulkanRenderPassDescription, shared
+// by everyone who acquires it and destroyed when the last one releases it.
+//
+// Render passes that are only compatible, e.g. one clears and the other
+// loads, are different VkRenderPasses, but share pipelines and framebuffers:
+// GetCompatible() returns the oldest live render pass compatible with a
+// render pass, and pipelines and framebuffers are created against that one.
+// It stays alive until every render pass compatible with it is released.
+// Released render passes are evicted from the framebuffer cache and the
+// pipeline registry and go through the device's deletion queue.
+// VulkanDeviceQueue owns one, see GetRenderPassCache().
+class VULKAN_EXPORT VulkanRenderPassCache {
+ public:
+  explicit VulkanRenderPassCache(VulkanDeviceQueue* device_queue);
+  ~VulkanRenderPassCache();
+
+  // Hands every render pass to the deletion queue.
+  void Destroy();
+
+  // Returns the render pass of |description|, creating it on the first call,
+  // and adds a reference to it. Returns VK_NULL_HANDLE on failure.
+  VkRenderPass Acquire(const VulkanRenderPassDescription& description);
+  // Drops a reference added by Acquire().
+  void Release(VkRenderPass render_pass);
+
+  // The render pass that pipelines and framebuffers for |render_pass| are
+  // created with.
+  VkRenderPass GetCompatible(VkRenderPass render_pass) const;
+
+  size_t size() const { return entries_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Entry {
+    Entry();
+    Entry(const Entry& other);
+    ~Entry();
+
+    VulkanRenderPassDescription description;
+    size_t hash = 0;
+    size_t compatibility_hash = 0;
+    VkRenderPass handle = VK_NULL_HANDLE;
+    uint32_t ref_count = 0;
+    // Holds a reference while it isn't |handle| itself.
+    VkRenderPass compatible = VK_NULL_HANDLE;
+  };
+
+  Entry* FindByHandle(VkRenderPass render_pass);
+  void DestroyEntry(const Entry& entry);
+
+  VulkanDeviceQueue* device_queue_;
+  // Few enough to search linearly.
+  std::vector<Entry> entries_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanRenderPassCache);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_RENDER_PASS_CACHE_H_
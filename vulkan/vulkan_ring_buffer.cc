@@ -0,0 +1,150 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_ring_buffer.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_timeline.h"
+
+namespace gpu {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+VulkanRingBuffer::VulkanRingBuffer(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanRingBuffer::~VulkanRingBuffer() {
+  DCHECK_EQ(static_cast<VkBuffer>(VK_NULL_HANDLE), handle_);
+}
+
+bool VulkanRingBuffer::Initialize(VkDeviceSize bytes_per_frame,
+                                  uint32_t num_frames,
+                                  VkBufferUsageFlags usage) {
+  DCHECK_GT(num_frames, 0u);
+  VkDevice device = device_queue_->GetVulkanDevice();
+
+  const VkPhysicalDeviceLimits& limits =
+      device_queue_->GetPhysicalDeviceProperties().limits;
+
+  // Vertex attributes are at most 16 bytes wide, so 16 keeps any vertex
+  // format aligned.
+  alignment_ = 16;
+  if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    alignment_ = std::max(alignment_, limits.minUniformBufferOffsetAlignment);
+  if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    alignment_ = std::max(alignment_, limits.minStorageBufferOffsetAlignment);
+
+  // Keep regions on nonCoherentAtomSize boundaries so flushing one frame
+  // never touches a neighbour that the GPU may still be reading. The
+  // allocator starts incoherent allocations on a boundary too.
+  const VkDeviceSize region_alignment =
+      std::max(alignment_, limits.nonCoherentAtomSize);
+  bytes_per_frame_ = AlignUp(bytes_per_frame, region_alignment);
+  num_frames_ = num_frames;
+
+  VkBufferCreateInfo buffer_create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // VkStructureType
+      nullptr,                               // const void *pNext
+      0,                                     // VkBufferCreateFlags
+      bytes_per_frame_ * num_frames_,        // VkDeviceSize
+      usage,                                 // VkBufferUsageFlags
+      VK_SHARING_MODE_EXCLUSIVE,             // VkSharingMode
+      0,                                     // uint32_t queueFamilyIndexCount
+      nullptr  // const uint32_t *pQueueFamilyIndices
+  };
+
+  VkResult result =
+      vkCreateBuffer(device, &buffer_create_info, nullptr, &handle_);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateBuffer() failed: " << result;
+    return false;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device, handle_, &requirements);
+
+  // DIRECT_WRITE prefers coherent memory so per-frame writes need no flush.
+  VulkanMemoryAllocator* allocator = device_queue_->GetMemoryAllocator();
+  if (!allocator->Allocate(requirements, VulkanMemoryUsage::DIRECT_WRITE, true,
+                           &allocation_)) {
+    DLOG(ERROR) << "Could not allocate ring buffer memory.";
+    return false;
+  }
+
+  result = vkBindBufferMemory(device, handle_, allocation_.memory,
+                              allocation_.offset);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkBindBufferMemory() failed: " << result;
+    return false;
+  }
+  return true;
+}
+
+void VulkanRingBuffer::Destroy() {
+  // The last frames may still be reading their regions.
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  if (VK_NULL_HANDLE != handle_) {
+    deletion_queue->Enqueue(handle_);
+    handle_ = VK_NULL_HANDLE;
+  }
+  if (allocation_.IsValid()) {
+    deletion_queue->Enqueue(allocation_);
+    allocation_ = VulkanMemoryAllocation();
+  }
+}
+
+bool VulkanRingBuffer::BeginFrame(uint32_t frame_index,
+                                  VulkanTimeline* timeline,
+                                  uint64_t value) {
+  DCHECK(!in_frame_);
+  DCHECK_LT(frame_index, num_frames_);
+
+  // Usually already reached because VulkanSwapChain::WaitFences() waited for
+  // it, in which case this is just a compare.
+  if (timeline && !timeline->Wait(value))
+    return false;
+
+  frame_index_ = frame_index;
+  frame_begin_ = bytes_per_frame_ * frame_index;
+  frame_used_ = 0;
+  in_frame_ = true;
+  return true;
+}
+
+void* VulkanRingBuffer::Allocate(VkDeviceSize size, VkDeviceSize* offset) {
+  DCHECK(in_frame_);
+  const VkDeviceSize aligned_used = AlignUp(frame_used_, alignment_);
+  if (aligned_used + size > bytes_per_frame_) {
+    DLOG(ERROR) << "Ring buffer frame region is full.";
+    return nullptr;
+  }
+
+  frame_used_ = aligned_used + size;
+  peak_bytes_used_ = std::max(peak_bytes_used_, frame_used_);
+  *offset = frame_begin_ + aligned_used;
+  return static_cast<uint8_t*>(allocation_.mapped_data) + *offset;
+}
+
+bool VulkanRingBuffer::EndFrame() {
+  DCHECK(in_frame_);
+  in_frame_ = false;
+  last_flush_offset_ = frame_begin_;
+  last_flush_size_ = frame_used_;
+  if (!frame_used_)
+    return true;
+  return device_queue_->GetMemoryAllocator()->FlushRange(
+      allocation_, frame_begin_, frame_used_);
+}
+
+}  // namespace gpu
@@ -0,0 +1,95 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_RING_BUFFER_H_
+#define GPU_VULKAN_VULKAN_RING_BUFFER_H_
+
+#include <vulkan/vulkan.h>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_memory_allocator.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanTimeline;
+
+// A single buffer which is mapped once and split into one region per frame
+// in flight, for data rewritten every frame such as transforms and UI quads.
+// Allocations within a frame are a pointer bump; a region is only reused
+// once the timeline of the frame that last wrote it has reached its value.
+//
+// Typical use with VulkanSwapChain:
+//   swap_chain->WaitFences(&resource_index, &image_index);
+//   ring_buffer.BeginFrame(
+//       resource_index, swap_chain->GetFrameTimeline(resource_index),
+//       swap_chain->GetFrameTimelineValue(resource_index));
+//   void* data = ring_buffer.Allocate(size, &offset);
+//   ...
+//   ring_buffer.EndFrame();
+//   swap_chain->SwapBuffer2(resource_index, &image_index);
+class VULKAN_EXPORT VulkanRingBuffer {
+ public:
+  explicit VulkanRingBuffer(VulkanDeviceQueue* device_queue);
+  ~VulkanRingBuffer();
+
+  // |num_frames| is usually VulkanSwapChain::num_images(). |usage| decides
+  // the offset alignment, e.g. minUniformBufferOffsetAlignment for
+  // VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT.
+  bool Initialize(VkDeviceSize bytes_per_frame,
+                  uint32_t num_frames,
+                  VkBufferUsageFlags usage);
+  void Destroy();
+
+  // Starts allocating from |frame_index|'s region once |timeline| reached
+  // |value|. A null |timeline| means the region was never used.
+  bool BeginFrame(uint32_t frame_index,
+                  VulkanTimeline* timeline,
+                  uint64_t value);
+
+  // Returns a host pointer for |size| bytes in the current region and sets
+  // |offset| to its offset within handle(), or nullptr if the region is
+  // full.
+  void* Allocate(VkDeviceSize size, VkDeviceSize* offset);
+
+  // Flushes the bytes written this frame if the memory isn't coherent.
+  bool EndFrame();
+
+  VkBuffer handle() const { return handle_; }
+  const VulkanMemoryAllocation& allocation() const { return allocation_; }
+  VkDeviceSize bytes_per_frame() const { return bytes_per_frame_; }
+  VkDeviceSize alignment() const { return alignment_; }
+
+  // High-water mark of a single frame, to tune |bytes_per_frame|.
+  VkDeviceSize peak_bytes_used() const { return peak_bytes_used_; }
+
+  // Range of handle() the last EndFrame() handed to
+  // VulkanMemoryAllocator::FlushRange(), empty if the frame wrote nothing.
+  VkDeviceSize last_flush_offset() const { return last_flush_offset_; }
+  VkDeviceSize last_flush_size() const { return last_flush_size_; }
+
+ private:
+  VulkanDeviceQueue* device_queue_;
+  VkBuffer handle_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocation allocation_;
+
+  VkDeviceSize bytes_per_frame_ = 0;
+  VkDeviceSize alignment_ = 1;
+  uint32_t num_frames_ = 0;
+
+  uint32_t frame_index_ = 0;
+  VkDeviceSize frame_begin_ = 0;
+  VkDeviceSize frame_used_ = 0;
+  VkDeviceSize peak_bytes_used_ = 0;
+  VkDeviceSize last_flush_offset_ = 0;
+  VkDeviceSize last_flush_size_ = 0;
+  bool in_frame_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanRingBuffer);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_RING_BUFFER_H_
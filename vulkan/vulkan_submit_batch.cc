@@ -0,0 +1,146 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_submit_batch.h"
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+VulkanSubmitBatch::VulkanSubmitBatch(VulkanDeviceQueue* device_queue,
+                                     VkQueue queue)
+    : device_queue_(device_queue), queue_(queue) {}
+
+VulkanSubmitBatch::~VulkanSubmitBatch() {
+  DCHECK(submits_.empty());
+}
+
+void VulkanSubmitBatch::Add(uint32_t num_command_buffers,
+                            const VkCommandBuffer* command_buffers,
+                            uint32_t num_wait_semaphores,
+                            const VkSemaphore* wait_semaphores,
+                            const VkPipelineStageFlags* wait_dst_stage_masks,
+                            uint32_t num_signal_semaphores,
+                            const VkSemaphore* signal_semaphores) {
+  DCHECK(!num_wait_semaphores || wait_dst_stage_masks);
+
+  // Waits would also hold back the commands already in the last submit, and
+  // its signals would be delayed until after the new commands. A submit
+  // that only waits so far can take more waits.
+  if (submits_.empty() || submits_.back().num_signal_semaphores ||
+      (num_wait_semaphores && submits_.back().num_command_buffers)) {
+    Submit submit;
+    submit.first_command_buffer = command_buffers_.size();
+    submit.first_wait_semaphore = wait_semaphores_.size();
+    submit.first_signal_semaphore = signal_semaphores_.size();
+    submits_.push_back(submit);
+  }
+
+  Submit& submit = submits_.back();
+  command_buffers_.insert(command_buffers_.end(), command_buffers,
+                          command_buffers + num_command_buffers);
+  submit.num_command_buffers += num_command_buffers;
+  wait_semaphores_.insert(wait_semaphores_.end(), wait_semaphores,
+                          wait_semaphores + num_wait_semaphores);
+  wait_values_.resize(wait_semaphores_.size());
+  wait_dst_stage_masks_.insert(wait_dst_stage_masks_.end(),
+                               wait_dst_stage_masks,
+                               wait_dst_stage_masks + num_wait_semaphores);
+  submit.num_wait_semaphores += num_wait_semaphores;
+  signal_semaphores_.insert(signal_semaphores_.end(), signal_semaphores,
+                            signal_semaphores + num_signal_semaphores);
+  signal_values_.resize(signal_semaphores_.size());
+  submit.num_signal_semaphores += num_signal_semaphores;
+}
+
+void VulkanSubmitBatch::AddTimelineWait(
+    VkSemaphore semaphore,
+    uint64_t value,
+    VkPipelineStageFlags wait_dst_stage_mask) {
+  Add(0, nullptr, 1, &semaphore, &wait_dst_stage_mask);
+  wait_values_.back() = value;
+  has_timeline_values_ = true;
+}
+
+void VulkanSubmitBatch::AddTimelineSignal(VkSemaphore semaphore,
+                                          uint64_t value) {
+  Add(0, nullptr, 0, nullptr, nullptr, 1, &semaphore);
+  signal_values_.back() = value;
+  has_timeline_values_ = true;
+}
+
+bool VulkanSubmitBatch::Flush(VkFence fence) {
+  if (submits_.empty() && VK_NULL_HANDLE == fence)
+    return true;
+
+  submit_infos_.resize(submits_.size());
+#if defined(VK_KHR_timeline_semaphore)
+  if (has_timeline_values_)
+    timeline_submit_infos_.resize(submits_.size());
+#else
+  DCHECK(!has_timeline_values_);
+#endif
+  for (size_t i = 0; i < submits_.size(); ++i) {
+    const Submit& submit = submits_[i];
+    VkSubmitInfo& submit_info = submit_infos_[i];
+    submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount =
+        static_cast<uint32_t>(submit.num_wait_semaphores);
+    submit_info.pWaitSemaphores =
+        wait_semaphores_.data() + submit.first_wait_semaphore;
+    submit_info.pWaitDstStageMask =
+        wait_dst_stage_masks_.data() + submit.first_wait_semaphore;
+    submit_info.commandBufferCount =
+        static_cast<uint32_t>(submit.num_command_buffers);
+    submit_info.pCommandBuffers =
+        command_buffers_.data() + submit.first_command_buffer;
+    submit_info.signalSemaphoreCount =
+        static_cast<uint32_t>(submit.num_signal_semaphores);
+    submit_info.pSignalSemaphores =
+        signal_semaphores_.data() + submit.first_signal_semaphore;
+
+#if defined(VK_KHR_timeline_semaphore)
+    if (has_timeline_values_) {
+      VkTimelineSemaphoreSubmitInfoKHR& timeline_info =
+          timeline_submit_infos_[i];
+      timeline_info = {};
+      timeline_info.sType =
+          VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+      timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+      timeline_info.pWaitSemaphoreValues =
+          wait_values_.data() + submit.first_wait_semaphore;
+      timeline_info.signalSemaphoreValueCount =
+          submit_info.signalSemaphoreCount;
+      timeline_info.pSignalSemaphoreValues =
+          signal_values_.data() + submit.first_signal_semaphore;
+      submit_info.pNext = &timeline_info;
+    }
+#endif
+  }
+
+  VkResult result = device_queue_->QueueSubmit(
+      queue_, static_cast<uint32_t>(submit_infos_.size()),
+      submit_infos_.data(), fence);
+  Clear();
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkQueueSubmit() failed: " << result;
+    return false;
+  }
+  return true;
+}
+
+void VulkanSubmitBatch::Clear() {
+  submits_.clear();
+  command_buffers_.clear();
+  wait_semaphores_.clear();
+  wait_dst_stage_masks_.clear();
+  signal_semaphores_.clear();
+  wait_values_.clear();
+  signal_values_.clear();
+  has_timeline_values_ = false;
+}
+
+}  // namespace gpu
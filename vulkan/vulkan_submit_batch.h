@@ -0,0 +1,97 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_SUBMIT_BATCH_H_
+#define GPU_VULKAN_VULKAN_SUBMIT_BATCH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+
+// Gathers the submissions several producers make to one queue during a
+// frame and sends them with a single vkQueueSubmit(), which costs tens of
+// microseconds on some drivers regardless of how much it submits.
+//
+// Submissions are kept in the order they were added. Consecutive ones share
+// a VkSubmitInfo unless that would change when a semaphore is waited on or
+// signaled, i.e. unless the earlier one signals, or the later one waits and
+// the earlier one has command buffers. So consecutive waits share one, and
+// the batch needs the fewest VkSubmitInfos that keep the semantics.
+class VULKAN_EXPORT VulkanSubmitBatch {
+ public:
+  VulkanSubmitBatch(VulkanDeviceQueue* device_queue, VkQueue queue);
+  ~VulkanSubmitBatch();
+
+  // Queues |command_buffers| for the next Flush(). Each wait semaphore
+  // blocks the matching stage of |wait_dst_stage_masks|.
+  void Add(uint32_t num_command_buffers,
+           const VkCommandBuffer* command_buffers,
+           uint32_t num_wait_semaphores = 0,
+           const VkSemaphore* wait_semaphores = nullptr,
+           const VkPipelineStageFlags* wait_dst_stage_masks = nullptr,
+           uint32_t num_signal_semaphores = 0,
+           const VkSemaphore* signal_semaphores = nullptr);
+  void Add(VkCommandBuffer command_buffer) { Add(1, &command_buffer); }
+
+  // Makes the next submission wait until the timeline |semaphore| reaches
+  // |value|, or signals |value| on it after everything added so far.
+  void AddTimelineWait(VkSemaphore semaphore,
+                       uint64_t value,
+                       VkPipelineStageFlags wait_dst_stage_mask);
+  void AddTimelineSignal(VkSemaphore semaphore, uint64_t value);
+
+  // Submits everything added since the last Flush() with one
+  // vkQueueSubmit(). |fence| signals when all of it has completed. Without
+  // pending submissions only a non-null |fence| is submitted.
+  bool Flush(VkFence fence = VK_NULL_HANDLE);
+
+  bool empty() const { return submits_.empty(); }
+  size_t num_pending_submit_infos() const { return submits_.size(); }
+  VkQueue queue() const { return queue_; }
+
+ private:
+  // Ranges into the arrays below making up one VkSubmitInfo.
+  struct Submit {
+    size_t first_command_buffer = 0;
+    size_t num_command_buffers = 0;
+    size_t first_wait_semaphore = 0;
+    size_t num_wait_semaphores = 0;
+    size_t first_signal_semaphore = 0;
+    size_t num_signal_semaphores = 0;
+  };
+
+  void Clear();
+
+  VulkanDeviceQueue* device_queue_;
+  VkQueue queue_;
+
+  std::vector<Submit> submits_;
+  std::vector<VkCommandBuffer> command_buffers_;
+  std::vector<VkSemaphore> wait_semaphores_;
+  std::vector<VkPipelineStageFlags> wait_dst_stage_masks_;
+  std::vector<VkSemaphore> signal_semaphores_;
+  std::vector<VkSubmitInfo> submit_infos_;
+
+  // Timeline semaphore values, parallel to the semaphore arrays. Binary
+  // semaphores get 0, which the driver ignores.
+  std::vector<uint64_t> wait_values_;
+  std::vector<uint64_t> signal_values_;
+  bool has_timeline_values_ = false;
+#if defined(VK_KHR_timeline_semaphore)
+  std::vector<VkTimelineSemaphoreSubmitInfoKHR> timeline_submit_infos_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanSubmitBatch);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_SUBMIT_BATCH_H_
@@ -9,7 +9,11 @@
 #include "vulkan_image_view.h"
 #include "vulkan_implementation.h"
 #include "vulkan_command_pool.h"
+#include "vulkan_deletion_queue.h"
 #include "vulkan_device_queue.h"
+#include "vulkan_submit_batch.h"
+#include "vulkan_sync_pool.h"
+#include "vulkan_timeline.h"
 
 namespace gpu {
 
@@ -55,6 +59,7 @@ gfx::SwapResult VulkanSwapChain::SwapBuffers() {
   switch (result) {
     case VK_SUCCESS:
     case VK_SUBOPTIMAL_KHR:
+      current_image_data->render_semaphore_signaled = true;
       break;
     case VK_ERROR_OUT_OF_DATE_KHR:
       if (device_queue_->OnWindowSizeChanged())
@@ -76,6 +81,7 @@ gfx::SwapResult VulkanSwapChain::SwapBuffers() {
       VK_SUCCESS) {
     return gfx::SwapResult::SWAP_FAILED;
   }
+  current_image_data->render_semaphore_signaled = false;
 
   VkPresentInfoKHR present_info = {
       VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,  // VkStructureType        sType
@@ -103,6 +109,7 @@ gfx::SwapResult VulkanSwapChain::SwapBuffers() {
       return gfx::SwapResult::SWAP_FAILED;
   }
 
+  device_queue_->EndFrame();
   return gfx::SwapResult::SWAP_ACK;
 }
 
@@ -115,17 +122,10 @@ bool VulkanSwapChain::InitializeSwapChain(
 
   device_queue_->CanRender(false);
 
-  if (device != VK_NULL_HANDLE) {
-    vkDeviceWaitIdle(device);
-  }
-
   // FIXME: Don't need to clear images.
-  for (size_t i = 0; i < images_.size(); ++i) {
-    std::unique_ptr<ImageData>& image_data = images_[i];
-    if (!image_data->image_view.get()) {
-      vkDestroyImageView(device, image_data->image_view->handle(), nullptr);
-      //  images_[i].image_view = VK_NULL_HANDLE;
-    }
+  for (const std::unique_ptr<ImageData>& image_data : images_) {
+    if (image_data->image_view)
+      image_data->image_view->Destroy();
   }
   images_.clear();
 
@@ -174,6 +174,18 @@ bool VulkanSwapChain::InitializeSwapChain(
     return true;
   }
 
+  // With separate graphics and present queue families the images are shared
+  // by both, so frames need no ownership transfer before presenting.
+  const uint32_t queue_family_indices[] = {
+      device_queue_->GetGraphicsQueueFamilyIndex(),
+      device_queue_->GetPresentQueueFamilyIndex()};
+  VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+  uint32_t queue_family_index_count = 0;
+  if (queue_family_indices[0] != queue_family_indices[1]) {
+    sharing_mode = VK_SHARING_MODE_CONCURRENT;
+    queue_family_index_count = 2;
+  }
+
   VkSwapchainCreateInfoKHR swap_chain_create_info = {
       VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,  // VkStructureType sType
       nullptr,                   // const void                    *pNext
@@ -185,9 +197,9 @@ bool VulkanSwapChain::InitializeSwapChain(
       desired_extent,             // VkExtent2D                     imageExtent
       1,              // uint32_t                       imageArrayLayers
       desired_usage,  // VkImageUsageFlags              imageUsage
-      VK_SHARING_MODE_EXCLUSIVE,  // VkSharingMode imageSharingMode
-      0,        // uint32_t                       queueFamilyIndexCount
-      nullptr,  // const uint32_t                *pQueueFamilyIndices
+      sharing_mode,              // VkSharingMode imageSharingMode
+      queue_family_index_count,  // uint32_t queueFamilyIndexCount
+      queue_family_indices,      // const uint32_t *pQueueFamilyIndices
       desired_transform,  // VkSurfaceTransformFlagBitsKHR  preTransform
       VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,  // VkCompositeAlphaFlagBitsKHR
                                           // compositeAlpha
@@ -202,7 +214,11 @@ bool VulkanSwapChain::InitializeSwapChain(
     return false;
   }
   if (old_swap_chain != VK_NULL_HANDLE) {
-    vkDestroySwapchainKHR(device, old_swap_chain, nullptr);
+    // Frames in flight may still render into or present its images.
+    device_queue_->GetDeletionQueue()->EnqueueTask(
+        [old_swap_chain](VkDevice device) {
+          vkDestroySwapchainKHR(device, old_swap_chain, nullptr);
+        });
   }
 
   format_ = desired_format.format;
@@ -394,6 +410,9 @@ VkPresentModeKHR VulkanSwapChain::GetSwapChainPresentMode(
 
 void VulkanSwapChain::DestroySwapChain() {
   VkDevice device = device_queue_->GetVulkanDevice();
+  // Old swap chains retired by DestroySwapImages() have to go before the
+  // surface does.
+  device_queue_->GetDeletionQueue()->Collect();
 
   if (swap_chain_ != VK_NULL_HANDLE) {
     vkDestroySwapchainKHR(device, swap_chain_, nullptr);
@@ -405,95 +424,50 @@ bool VulkanSwapChain::InitializeSwapImages(
     const VkSurfaceCapabilitiesKHR& surface_caps,
     const std::vector<VkSurfaceFormatKHR> surface_formats,
     VkCommandPoolCreateFlags command_pool_create_flags) {
-  VkDevice device = device_queue_->GetVulkanDevice();
-
   command_pool_ = device_queue_->CreateCommandPool(this,
       command_pool_create_flags);
   if (!command_pool_)
     return false;
 
-  VkSemaphoreCreateInfo semaphore_create_info = {
-      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,  // VkStructureType sType
-      nullptr,  // const void*              pNext
-      0         // VkSemaphoreCreateFlags   flags
-  };
-
-  VkResult result = VK_SUCCESS;
-
+  // Recreating the swap chain reuses the semaphores of the old one.
+  VulkanSemaphorePool* semaphore_pool = device_queue_->GetSemaphorePool();
   for (uint32_t i = 0; i < image_count_; ++i) {
     std::unique_ptr<ImageData>& image_data = images_[i];
 
     // Setup semaphores.
-    result = vkCreateSemaphore(device, &semaphore_create_info, nullptr,
-                               &image_data->render_semaphore);
-    if (VK_SUCCESS != result) {
-      DLOG(ERROR) << "vkCreateSemaphore(render) failed: " << result;
-      return false;
-    }
-
-    result = vkCreateSemaphore(device, &semaphore_create_info, nullptr,
-                               &image_data->present_semaphore);
-    if (VK_SUCCESS != result) {
-      DLOG(ERROR) << "vkCreateSemaphore(present) failed: " << result;
+    image_data->render_semaphore = semaphore_pool->Acquire();
+    image_data->present_semaphore = semaphore_pool->Acquire();
+    if (VK_NULL_HANDLE == image_data->render_semaphore ||
+        VK_NULL_HANDLE == image_data->present_semaphore) {
       return false;
     }
 
     // Initialize the command buffer for this buffer data.
     image_data->command_buffer = command_pool_->CreatePrimaryCommandBuffer();
-
-    // FIXME: This should be done in VulkanCommandBuffer::Initialize().
-    VkFenceCreateInfo fence_create_info = {
-        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,  // VkStructureType
-        nullptr,                      // const void *pNext
-        VK_FENCE_CREATE_SIGNALED_BIT  // VkFenceCreateFlags
-    };
-    if (vkCreateFence(device, &fence_create_info, nullptr,
-                      &image_data->Fence) != VK_SUCCESS) {
-      std::cout << "Could not create a fence!" << std::endl;
-      return false;
-    }
   }  // end of for
   return true;
 }
 
-bool VulkanSwapChain::CreateFences() {
-  VkDevice device = device_queue_->GetVulkanDevice();
-  VkFenceCreateInfo fence_create_info = {
-      VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,  // VkStructureType sType
-      nullptr,                      // const void                    *pNext
-      VK_FENCE_CREATE_SIGNALED_BIT  // VkFenceCreateFlags             flags
-  };
-
-  for (size_t i = 0; i < image_count_; ++i) {
-    std::unique_ptr<ImageData>& image_data = images_[i];
-    if (vkCreateFence(device, &fence_create_info, nullptr,
-                      &image_data->Fence) != VK_SUCCESS) {
-      std::cout << "Could not create a fence!" << std::endl;
-      return false;
-    }
-  }
-  return true;
-}
-
 // For tutorial4
 bool VulkanSwapChain::WaitFences(uint32_t* resource_index,
                                  uint32_t* image_index) {
+  // Advance first so we wait for the last submission that used the slot we
+  // are about to record into.
+  *resource_index = (*resource_index + 1) % image_count_;
   std::unique_ptr<ImageData>& image_data = images_[*resource_index];
   VkDevice device = device_queue_->GetVulkanDevice();
-  *resource_index = (*resource_index + 1) % image_count_;
-  if (vkWaitForFences(device, 1, &image_data->Fence, VK_FALSE, 1000000000) !=
-      VK_SUCCESS) {
+  if (image_data->timeline &&
+      !image_data->timeline->Wait(image_data->timeline_value, 1000000000)) {
     std::cout << "Waiting for fence takes too long!" << std::endl;
     return false;
   }
-  vkResetFences(device, 1, &image_data->Fence);
   VkResult result = vkAcquireNextImageKHR(device, swap_chain_, UINT64_MAX,
                                           image_data->render_semaphore,
                                           VK_NULL_HANDLE, image_index);
   switch (result) {
     case VK_SUCCESS:
-      break;
     case VK_SUBOPTIMAL_KHR:
+      image_data->render_semaphore_signaled = true;
       break;
     // case VK_ERROR_OUT_OF_DATE_KHR:
     //   return OnWindowSizeChanged();
@@ -509,11 +483,52 @@ bool VulkanSwapChain::WaitFences(uint32_t* resource_index,
 bool VulkanSwapChain::SwapBuffer2(uint32_t resource_index,
                                   uint32_t* image_index) {
   std::unique_ptr<ImageData>& image_data = images_[resource_index];
-  VkQueue queue = device_queue_->GetPresentQueue();
 
-  image_data->command_buffer->Submit(1, &image_data->present_semaphore,
-      1, &image_data->render_semaphore);
-  
+  // Wait for the image to be available and signal rendering finished for
+  // the presentation engine.
+  if (!image_data->command_buffer->Submit(1, &image_data->render_semaphore, 1,
+                                          &image_data->present_semaphore)) {
+    std::cout << "Could not submit command buffer!" << std::endl;
+    return false;
+  }
+  image_data->render_semaphore_signaled = false;
+
+  // The submission signaled the queue's timeline itself.
+  image_data->timeline = image_data->command_buffer->timeline();
+  image_data->timeline_value = image_data->command_buffer->timeline_value();
+
+  return Present(resource_index, image_index);
+}
+
+bool VulkanSwapChain::SwapBuffer2(uint32_t resource_index,
+                                  uint32_t* image_index,
+                                  VkCommandBuffer command_buffer) {
+  std::unique_ptr<ImageData>& image_data = images_[resource_index];
+
+  VkPipelineStageFlags wait_dst_stage_mask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+  // Goes out together with whatever else was batched for this frame. The
+  // timeline value signaled with it guards all of it directly.
+  VulkanSubmitBatch* submit_batch = device_queue_->GetSubmitBatch();
+  submit_batch->Add(1, &command_buffer, 1, &image_data->render_semaphore,
+                    &wait_dst_stage_mask, 1, &image_data->present_semaphore);
+  VulkanTimeline* timeline = device_queue_->GetTimeline(submit_batch->queue());
+  uint64_t timeline_value = timeline->Flush(submit_batch);
+  if (!timeline_value) {
+    std::cout << "Could not submit command buffer!" << std::endl;
+    return false;
+  }
+  image_data->render_semaphore_signaled = false;
+  image_data->timeline = timeline;
+  image_data->timeline_value = timeline_value;
+
+  return Present(resource_index, image_index);
+}
+
+bool VulkanSwapChain::Present(uint32_t resource_index, uint32_t* image_index) {
+  std::unique_ptr<ImageData>& image_data = images_[resource_index];
+  VkQueue queue = device_queue_->GetPresentQueue();
 
   VkPresentInfoKHR present_info = {
       VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,  // VkStructureType              sType
@@ -539,20 +554,48 @@ bool VulkanSwapChain::SwapBuffer2(uint32_t resource_index,
       std::cout << "Problem occurred during image presentation!" << std::endl;
       return false;
   }
+  device_queue_->EndFrame();
   return true;
 }
 
 void VulkanSwapChain::DestroySwapImages() {
-  VkDevice device = device_queue_->GetVulkanDevice();
+  // The command buffers can only be freed once their submissions retired.
+  // SwapBuffers() doesn't track its frames, so wait for the queue of the
+  // pool rather than per frame. Other queues keep running.
+  VulkanTimeline* timeline = device_queue_->GetTimeline(command_pool_->queue());
+  if (uint64_t value = timeline->Signal())
+    timeline->Wait(value);
+
+  // Presents have no completion signal, so their semaphores come back once
+  // the graphics work after them has retired.
+  VulkanSemaphorePool* semaphore_pool = device_queue_->GetSemaphorePool();
+  VulkanDeletionQueue* deletion_queue = device_queue_->GetDeletionQueue();
+  VulkanTimeline* graphics_timeline =
+      device_queue_->GetTimeline(device_queue_->GetGraphicsQueue());
   for (const std::unique_ptr<ImageData>& image_data : images_) {
     // Destroy Image View.
     if (image_data->image_view) {
       image_data->image_view->Destroy();
       image_data->image_view.reset();
     }
-    vkDestroySemaphore(device, image_data->render_semaphore, nullptr);
-    vkDestroySemaphore(device, image_data->present_semaphore, nullptr);
+    if (image_data->command_buffer) {
+      image_data->command_buffer->Destroy();
+      image_data->command_buffer.reset();
+    }
+    // A semaphore whose acquire was never waited on still has its signal
+    // pending, so it can't be handed out again.
+    if (VK_NULL_HANDLE != image_data->render_semaphore) {
+      if (image_data->render_semaphore_signaled)
+        deletion_queue->Enqueue(image_data->render_semaphore);
+      else
+        semaphore_pool->Release(image_data->render_semaphore);
+    }
+    if (VK_NULL_HANDLE != image_data->present_semaphore) {
+      semaphore_pool->Release(image_data->present_semaphore, graphics_timeline,
+                              graphics_timeline->last_submitted_value() + 1);
+    }
     image_data->render_semaphore = VK_NULL_HANDLE;
+    image_data->render_semaphore_signaled = false;
     image_data->present_semaphore = VK_NULL_HANDLE;
   }
   command_pool_->Destroy();
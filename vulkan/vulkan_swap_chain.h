@@ -20,6 +20,7 @@ class VulkanCommandBuffer;
 class VulkanCommandPool;
 class VulkanDeviceQueue;
 class VulkanImageView;
+class VulkanTimeline;
 
 class VulkanSwapChain {
  public:
@@ -64,7 +65,15 @@ class VulkanSwapChain {
   VkSemaphore* GetFinishedRenderingSemaphore(uint32_t index) {
     return &images_[index]->present_semaphore;
   }
-  VkFence* GetFence(uint32_t index) { return &images_[index]->Fence; }
+
+  // The last submission of frame slot |index| is done once its timeline
+  // reaches the value. The timeline is null before the slot's first frame.
+  VulkanTimeline* GetFrameTimeline(uint32_t index) const {
+    return images_[index]->timeline;
+  }
+  uint64_t GetFrameTimelineValue(uint32_t index) const {
+    return images_[index]->timeline_value;
+  }
 
   VkSwapchainKHR handle() const { return swap_chain_; }
   VkFormat format() const { return format_; }
@@ -72,15 +81,23 @@ class VulkanSwapChain {
 
   VkImage GetImage(uint32_t index) { return images_[index]->image; }
 
-  bool CreateFences();
+  // Advances |resource_index| to the next frame slot, waits for the slot's
+  // last submission and acquires the next image.
   bool WaitFences(uint32_t* resource_index, uint32_t* image_index);
   bool SwapBuffer2(uint32_t resource_index, uint32_t* image_index);
+  // Submits |command_buffer|, e.g. one from a VulkanFrameCommandAllocator,
+  // to the graphics queue instead of the slot's own command buffer, and
+  // presents. The slot's timeline value is reached when it has executed.
+  bool SwapBuffer2(uint32_t resource_index,
+                   uint32_t* image_index,
+                   VkCommandBuffer command_buffer);
 
  private:
   bool InitializeSwapChain(VkSurfaceKHR surface,
                            const VkSurfaceCapabilitiesKHR& surface_caps,
                            const std::vector<VkSurfaceFormatKHR>);
   void DestroySwapChain();
+  bool Present(uint32_t resource_index, uint32_t* image_index);
 
   bool InitializeSwapImages(const VkSurfaceCapabilitiesKHR& surface_caps,
                             const std::vector<VkSurfaceFormatKHR>,
@@ -117,10 +134,14 @@ class VulkanSwapChain {
 
     // Image Available
     VkSemaphore render_semaphore = VK_NULL_HANDLE;
+    // Set while an acquire has signaled |render_semaphore| and no submission
+    // has waited on it yet.
+    bool render_semaphore_signaled = false;
     // Rendering Finished
     VkSemaphore present_semaphore = VK_NULL_HANDLE;
-    // For Tutorial4. FIXME: remove it.
-    VkFence Fence;
+    // Reached by |timeline| when the slot's last submission is done.
+    VulkanTimeline* timeline = nullptr;
+    uint64_t timeline_value = 0;
   };
 
   std::vector<std::unique_ptr<ImageData>> images_;
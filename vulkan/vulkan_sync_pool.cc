@@ -0,0 +1,136 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_sync_pool.h"
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_timeline.h"
+
+namespace gpu {
+
+VulkanFencePool::VulkanFencePool(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanFencePool::~VulkanFencePool() {
+  DCHECK(free_.empty());
+  DCHECK(released_.empty());
+}
+
+void VulkanFencePool::Destroy() {
+  VkDevice device = device_queue_->GetVulkanDevice();
+  for (VkFence fence : free_)
+    vkDestroyFence(device, fence, nullptr);
+  free_.clear();
+  for (VkFence fence : released_)
+    vkDestroyFence(device, fence, nullptr);
+  released_.clear();
+}
+
+VkFence VulkanFencePool::Acquire() {
+  VkDevice device = device_queue_->GetVulkanDevice();
+  if (free_.empty() && !released_.empty()) {
+    VkResult result = vkResetFences(
+        device, static_cast<uint32_t>(released_.size()), released_.data());
+    if (VK_SUCCESS != result) {
+      DLOG(ERROR) << "vkResetFences() failed: " << result;
+    } else {
+      free_.swap(released_);
+    }
+  }
+
+  if (!free_.empty()) {
+    VkFence fence = free_.back();
+    free_.pop_back();
+    ++hits_;
+    return fence;
+  }
+
+  ++misses_;
+  VkFenceCreateInfo fence_create_info = {};
+  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence = VK_NULL_HANDLE;
+  VkResult result =
+      vkCreateFence(device, &fence_create_info, nullptr, &fence);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateFence() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  return fence;
+}
+
+void VulkanFencePool::Release(VkFence fence) {
+  DCHECK_NE(static_cast<VkFence>(VK_NULL_HANDLE), fence);
+  released_.push_back(fence);
+}
+
+VulkanSemaphorePool::VulkanSemaphorePool(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanSemaphorePool::~VulkanSemaphorePool() {
+  DCHECK(free_.empty());
+  DCHECK(pending_.empty());
+}
+
+void VulkanSemaphorePool::Destroy() {
+  VkDevice device = device_queue_->GetVulkanDevice();
+  for (VkSemaphore semaphore : free_)
+    vkDestroySemaphore(device, semaphore, nullptr);
+  free_.clear();
+  for (const PendingSemaphore& pending : pending_)
+    vkDestroySemaphore(device, pending.semaphore, nullptr);
+  pending_.clear();
+}
+
+VkSemaphore VulkanSemaphorePool::Acquire() {
+  if (free_.empty())
+    RecyclePending();
+
+  if (!free_.empty()) {
+    VkSemaphore semaphore = free_.back();
+    free_.pop_back();
+    ++hits_;
+    return semaphore;
+  }
+
+  ++misses_;
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  VkResult result = vkCreateSemaphore(device_queue_->GetVulkanDevice(),
+                                      &semaphore_create_info, nullptr,
+                                      &semaphore);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateSemaphore() failed: " << result;
+    return VK_NULL_HANDLE;
+  }
+  return semaphore;
+}
+
+void VulkanSemaphorePool::Release(VkSemaphore semaphore) {
+  DCHECK_NE(static_cast<VkSemaphore>(VK_NULL_HANDLE), semaphore);
+  free_.push_back(semaphore);
+}
+
+void VulkanSemaphorePool::Release(VkSemaphore semaphore,
+                                  VulkanTimeline* timeline,
+                                  uint64_t value) {
+  DCHECK_NE(static_cast<VkSemaphore>(VK_NULL_HANDLE), semaphore);
+  DCHECK(timeline);
+  pending_.push_back({semaphore, timeline, value});
+}
+
+void VulkanSemaphorePool::RecyclePending() {
+  // Semaphores waited on by different queues complete out of order.
+  size_t kept = 0;
+  for (const PendingSemaphore& pending : pending_) {
+    if (pending.timeline->IsComplete(pending.value))
+      free_.push_back(pending.semaphore);
+    else
+      pending_[kept++] = pending;
+  }
+  pending_.resize(kept);
+}
+
+}  // namespace gpu
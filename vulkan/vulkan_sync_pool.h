@@ -0,0 +1,107 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_SYNC_POOL_H_
+#define GPU_VULKAN_VULKAN_SYNC_POOL_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanTimeline;
+
+// Recycles the fences of a device, so that submitting, recreating the swap
+// chain or creating command buffers doesn't create and destroy them every
+// time. VulkanDeviceQueue owns one, see GetFencePool().
+class VULKAN_EXPORT VulkanFencePool {
+ public:
+  explicit VulkanFencePool(VulkanDeviceQueue* device_queue);
+  ~VulkanFencePool();
+
+  // Destroys every fence in the pool. Fences still handed out aren't
+  // tracked and must have been released.
+  void Destroy();
+
+  // Returns an unsignaled fence, or VK_NULL_HANDLE on failure.
+  VkFence Acquire();
+  // Takes |fence| back. It must not be pending on a queue any more; it is
+  // reset, together with the other released fences, before it is handed out
+  // again.
+  void Release(VkFence fence);
+
+  size_t num_free() const { return free_.size() + released_.size(); }
+  // Acquire() calls served by a recycled fence and by a new one.
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  VulkanDeviceQueue* device_queue_;
+
+  std::vector<VkFence> free_;
+  // Possibly signaled; reset with one vkResetFences() once |free_| is empty.
+  std::vector<VkFence> released_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanFencePool);
+};
+
+// Recycles the binary semaphores of a device. A binary semaphore can only be
+// reused once the wait that unsignaled it has executed, so besides releasing
+// semaphores that are idle, callers can hand one back together with the
+// timeline value of the submission that waits on it.
+class VULKAN_EXPORT VulkanSemaphorePool {
+ public:
+  explicit VulkanSemaphorePool(VulkanDeviceQueue* device_queue);
+  ~VulkanSemaphorePool();
+
+  // Destroys every semaphore in the pool, including those released with a
+  // timeline value, so the device must be idle.
+  void Destroy();
+
+  // Returns an unsignaled binary semaphore, or VK_NULL_HANDLE on failure.
+  VkSemaphore Acquire();
+  // Takes back |semaphore|, which has no pending signal or wait.
+  void Release(VkSemaphore semaphore);
+  // Takes back |semaphore| once |timeline| has reached |value|.
+  void Release(VkSemaphore semaphore, VulkanTimeline* timeline,
+               uint64_t value);
+
+  size_t num_free() const { return free_.size(); }
+  size_t num_pending() const { return pending_.size(); }
+  // Acquire() calls served by a recycled semaphore and by a new one.
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct PendingSemaphore {
+    VkSemaphore semaphore;
+    VulkanTimeline* timeline;
+    uint64_t value;
+  };
+
+  // Moves the pending semaphores whose wait has completed to |free_|.
+  void RecyclePending();
+
+  VulkanDeviceQueue* device_queue_;
+
+  std::vector<VkSemaphore> free_;
+  std::vector<PendingSemaphore> pending_;
+
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanSemaphorePool);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_SYNC_POOL_H_
@@ -0,0 +1,196 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_timeline.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_submit_batch.h"
+#include "vulkan_sync_pool.h"
+
+namespace gpu {
+
+VulkanTimeline::VulkanTimeline(VulkanDeviceQueue* device_queue,
+                               VkQueue queue,
+                               bool use_timeline_semaphore)
+    : device_queue_(device_queue),
+      queue_(queue),
+      uses_timeline_semaphore_(use_timeline_semaphore &&
+                               device_queue->SupportsTimelineSemaphores()) {}
+
+VulkanTimeline::~VulkanTimeline() {
+  DCHECK_EQ(static_cast<VkSemaphore>(VK_NULL_HANDLE), semaphore_);
+  DCHECK(pending_fences_.empty());
+}
+
+bool VulkanTimeline::Initialize() {
+  signal_batch_.reset(new VulkanSubmitBatch(device_queue_, queue_));
+  if (!uses_timeline_semaphore_)
+    return true;
+
+#if defined(VK_KHR_timeline_semaphore)
+  VkDevice device = device_queue_->GetVulkanDevice();
+  vkGetSemaphoreCounterValueKHR_ =
+      reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+          vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+  vkWaitSemaphoresKHR_ = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+      vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+  if (!vkGetSemaphoreCounterValueKHR_ || !vkWaitSemaphoresKHR_) {
+    DLOG(ERROR) << "VK_KHR_timeline_semaphore entry points are missing";
+    uses_timeline_semaphore_ = false;
+    return true;
+  }
+
+  VkSemaphoreTypeCreateInfoKHR semaphore_type_create_info = {};
+  semaphore_type_create_info.sType =
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+  semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+  semaphore_type_create_info.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_create_info.pNext = &semaphore_type_create_info;
+
+  VkResult result =
+      vkCreateSemaphore(device, &semaphore_create_info, nullptr, &semaphore_);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateSemaphore(timeline) failed: " << result;
+    return false;
+  }
+  return true;
+#else
+  NOTREACHED();
+  return false;
+#endif
+}
+
+void VulkanTimeline::Destroy() {
+  Wait(last_submitted_value_);
+
+  VkDevice device = device_queue_->GetVulkanDevice();
+  if (VK_NULL_HANDLE != semaphore_) {
+    vkDestroySemaphore(device, semaphore_, nullptr);
+    semaphore_ = VK_NULL_HANDLE;
+  }
+  // Every fence has signaled after the wait above.
+  for (const PendingFence& pending : pending_fences_)
+    device_queue_->GetFencePool()->Release(pending.fence);
+  pending_fences_.clear();
+  if (signal_batch_) {
+    signal_batch_->Flush();
+    signal_batch_.reset();
+  }
+}
+
+uint64_t VulkanTimeline::Flush(VulkanSubmitBatch* batch) {
+  DCHECK_EQ(queue_, batch->queue());
+  const uint64_t value = last_submitted_value_ + 1;
+
+  if (uses_timeline_semaphore_) {
+    batch->AddTimelineSignal(semaphore_, value);
+    if (!batch->Flush())
+      return 0;
+  } else {
+    VulkanFencePool* fence_pool = device_queue_->GetFencePool();
+    VkFence fence = fence_pool->Acquire();
+    if (VK_NULL_HANDLE == fence)
+      return 0;
+    if (!batch->Flush(fence)) {
+      fence_pool->Release(fence);
+      return 0;
+    }
+    pending_fences_.push_back({value, fence});
+  }
+
+  last_submitted_value_ = value;
+  return value;
+}
+
+uint64_t VulkanTimeline::Signal() {
+  return Flush(signal_batch_.get());
+}
+
+bool VulkanTimeline::AddWait(VulkanSubmitBatch* batch,
+                             uint64_t value,
+                             VkPipelineStageFlags wait_stages) {
+  if (!uses_timeline_semaphore_)
+    return Wait(value);
+  batch->AddTimelineWait(semaphore_, value, wait_stages);
+  return true;
+}
+
+uint64_t VulkanTimeline::GetCompletedValue() {
+  if (completed_value_ == last_submitted_value_)
+    return completed_value_;
+
+  VkDevice device = device_queue_->GetVulkanDevice();
+#if defined(VK_KHR_timeline_semaphore)
+  if (uses_timeline_semaphore_) {
+    uint64_t value = 0;
+    VkResult result =
+        vkGetSemaphoreCounterValueKHR_(device, semaphore_, &value);
+    if (VK_SUCCESS != result) {
+      DLOG(ERROR) << "vkGetSemaphoreCounterValueKHR() failed: " << result;
+      return completed_value_;
+    }
+    completed_value_ = value;
+    return completed_value_;
+  }
+#endif
+
+  // Fences signal in submission order, so stop at the first pending one.
+  while (!pending_fences_.empty()) {
+    const PendingFence& pending = pending_fences_.front();
+    if (VK_SUCCESS != vkGetFenceStatus(device, pending.fence))
+      break;
+    completed_value_ = pending.value;
+    device_queue_->GetFencePool()->Release(pending.fence);
+    pending_fences_.pop_front();
+  }
+  return completed_value_;
+}
+
+bool VulkanTimeline::Wait(uint64_t value, uint64_t timeout) {
+  DCHECK_LE(value, last_submitted_value_);
+  if (IsComplete(value))
+    return true;
+
+  VkDevice device = device_queue_->GetVulkanDevice();
+  VkResult result = VK_SUCCESS;
+#if defined(VK_KHR_timeline_semaphore)
+  if (uses_timeline_semaphore_) {
+    VkSemaphoreWaitInfoKHR wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &semaphore_;
+    wait_info.pValues = &value;
+    result = vkWaitSemaphoresKHR_(device, &wait_info, timeout);
+    if (VK_SUCCESS != result) {
+      if (VK_TIMEOUT != result)
+        DLOG(ERROR) << "vkWaitSemaphoresKHR() failed: " << result;
+      return false;
+    }
+    completed_value_ = std::max(completed_value_, value);
+    return true;
+  }
+#endif
+
+  // The first fence at or past |value| covers it.
+  for (const PendingFence& pending : pending_fences_) {
+    if (pending.value < value)
+      continue;
+    result = vkWaitForFences(device, 1, &pending.fence, VK_TRUE, timeout);
+    break;
+  }
+  if (VK_SUCCESS != result) {
+    if (VK_TIMEOUT != result)
+      DLOG(ERROR) << "vkWaitForFences() failed: " << result;
+    return false;
+  }
+  return IsComplete(value);
+}
+
+}  // namespace gpu
@@ -0,0 +1,96 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_TIMELINE_H_
+#define GPU_VULKAN_VULKAN_TIMELINE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+class VulkanDeviceQueue;
+class VulkanSubmitBatch;
+
+// A monotonically increasing counter for one queue. Every flush through the
+// timeline signals the next value once the queue has finished everything
+// submitted so far, so "wait for frame N" is a single value compare instead
+// of a fence per frame to reset and track.
+//
+// With VK_KHR_timeline_semaphore the counter is a timeline semaphore, which
+// other queues can wait on directly. On devices without it a fence from the
+// device's VulkanFencePool is submitted per value instead; waiting for a
+// value from another queue then has to block on the CPU.
+class VULKAN_EXPORT VulkanTimeline {
+ public:
+  // |use_timeline_semaphore| is ignored when the device doesn't support
+  // timeline semaphores.
+  VulkanTimeline(VulkanDeviceQueue* device_queue,
+                 VkQueue queue,
+                 bool use_timeline_semaphore = true);
+  ~VulkanTimeline();
+
+  bool Initialize();
+  // Waits for everything signaled through the timeline.
+  void Destroy();
+
+  // Submits |batch|, which must be for this timeline's queue, and signals
+  // the returned value after it. Returns 0 on failure.
+  uint64_t Flush(VulkanSubmitBatch* batch);
+  // Signals the next value after everything submitted to the queue so far.
+  uint64_t Signal();
+
+  // Makes the next submission of |batch| wait for |value| at |wait_stages|.
+  // Without timeline semaphores this blocks until |value| is reached.
+  bool AddWait(VulkanSubmitBatch* batch,
+               uint64_t value,
+               VkPipelineStageFlags wait_stages);
+
+  // Highest value the queue has reached, without blocking.
+  uint64_t GetCompletedValue();
+  bool IsComplete(uint64_t value) { return GetCompletedValue() >= value; }
+  // Blocks until |value| is reached. Returns false on timeout or error.
+  bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+  uint64_t last_submitted_value() const { return last_submitted_value_; }
+  bool uses_timeline_semaphore() const { return uses_timeline_semaphore_; }
+  VkQueue queue() const { return queue_; }
+  // The timeline semaphore, or VK_NULL_HANDLE when fences are used.
+  VkSemaphore semaphore() const { return semaphore_; }
+
+ private:
+  // Fallback for devices without timeline semaphores.
+  struct PendingFence {
+    uint64_t value;
+    VkFence fence;
+  };
+
+  VulkanDeviceQueue* device_queue_;
+  const VkQueue queue_;
+  bool uses_timeline_semaphore_;
+  VkSemaphore semaphore_ = VK_NULL_HANDLE;
+  std::unique_ptr<VulkanSubmitBatch> signal_batch_;
+
+  uint64_t last_submitted_value_ = 0;
+  uint64_t completed_value_ = 0;
+
+  // Oldest first.
+  std::deque<PendingFence> pending_fences_;
+
+#if defined(VK_KHR_timeline_semaphore)
+  PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR_ = nullptr;
+  PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR_ = nullptr;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanTimeline);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_TIMELINE_H_
@@ -0,0 +1,190 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_upload_batch.h"
+
+#include <cstring>
+
+#include "base/logging.h"
+#include "vulkan_command_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device_queue.h"
+
+namespace gpu {
+
+bool CreateStagingBuffer(VulkanDeviceQueue* device_queue,
+                         const void* data,
+                         VkDeviceSize size,
+                         VulkanStagingBuffer* staging) {
+  VkDevice device = device_queue->GetVulkanDevice();
+
+  VkBufferCreateInfo buffer_create_info = {
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // VkStructureType
+      nullptr,                               // const void *pNext
+      0,                                     // VkBufferCreateFlags
+      size,                                  // VkDeviceSize
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,      // VkBufferUsageFlags
+      VK_SHARING_MODE_EXCLUSIVE,             // VkSharingMode
+      0,                                     // uint32_t queueFamilyIndexCount
+      nullptr  // const uint32_t *pQueueFamilyIndices
+  };
+
+  VkResult result =
+      vkCreateBuffer(device, &buffer_create_info, nullptr, &staging->buffer);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkCreateBuffer(staging) failed: " << result;
+    return false;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device, staging->buffer, &requirements);
+
+  VulkanMemoryAllocator* allocator = device_queue->GetMemoryAllocator();
+  if (!allocator->Allocate(requirements, VulkanMemoryUsage::UPLOAD, true,
+                           &staging->allocation)) {
+    DLOG(ERROR) << "Could not allocate staging memory.";
+    vkDestroyBuffer(device, staging->buffer, nullptr);
+    return false;
+  }
+
+  result = vkBindBufferMemory(device, staging->buffer,
+                              staging->allocation.memory,
+                              staging->allocation.offset);
+  if (VK_SUCCESS != result) {
+    DLOG(ERROR) << "vkBindBufferMemory(staging) failed: " << result;
+    vkDestroyBuffer(device, staging->buffer, nullptr);
+    allocator->Free(&staging->allocation);
+    return false;
+  }
+
+  memcpy(staging->allocation.mapped_data, data, size);
+  allocator->Flush(staging->allocation);
+  return true;
+}
+
+void ReleaseStagingBuffers(VulkanDeviceQueue* device_queue,
+                           std::vector<VulkanStagingBuffer>* staging_buffers) {
+  VulkanDeletionQueue* deletion_queue = device_queue->GetDeletionQueue();
+  for (const VulkanStagingBuffer& staging : *staging_buffers) {
+    deletion_queue->Enqueue(staging.buffer);
+    deletion_queue->Enqueue(staging.allocation);
+  }
+  staging_buffers->clear();
+}
+
+VulkanUploadBatch::VulkanUploadBatch(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanUploadBatch::~VulkanUploadBatch() {
+  DCHECK(!command_pool_);
+  DCHECK(pending_staging_.empty());
+  DCHECK(submitted_staging_.empty());
+}
+
+bool VulkanUploadBatch::Initialize() {
+  // Command buffers from this pool are recorded once and reset after their
+  // fence signals.
+  command_pool_ = device_queue_->CreateCommandPool(
+      nullptr, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                   VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+  if (!command_pool_)
+    return false;
+
+  command_buffer_ = command_pool_->CreatePrimaryCommandBuffer();
+  return !!command_buffer_;
+}
+
+void VulkanUploadBatch::Destroy() {
+  if (recorder_)
+    Submit();
+  Wait();
+
+  if (command_buffer_) {
+    command_buffer_->Destroy();
+    command_buffer_.reset();
+  }
+  if (command_pool_) {
+    command_pool_->Destroy();
+    command_pool_.reset();
+  }
+}
+
+bool VulkanUploadBatch::Upload(VkBuffer dst_buffer,
+                               VkDeviceSize dst_offset,
+                               const void* data,
+                               VkDeviceSize size) {
+  DCHECK(command_buffer_);
+
+  VulkanStagingBuffer staging;
+  if (!CreateStagingBuffer(device_queue_, data, size, &staging))
+    return false;
+
+  if (!recorder_) {
+    // The command buffer is about to be reset, which waits for the previous
+    // submission anyway, so reclaim its staging memory first.
+    Wait();
+    recorder_.reset(new ScopedSingleUseCommandBufferRecorder(*command_buffer_));
+  }
+
+  VkBufferCopy region = {
+      0,           // VkDeviceSize srcOffset
+      dst_offset,  // VkDeviceSize dstOffset
+      size         // VkDeviceSize size
+  };
+  vkCmdCopyBuffer(recorder_->handle(), staging.buffer, dst_buffer, 1, &region);
+
+  pending_staging_.push_back(staging);
+  return true;
+}
+
+bool VulkanUploadBatch::Submit() {
+  if (!recorder_)
+    return true;
+
+  // One global barrier covers every copy in the batch.
+  VkMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,  // VkStructureType sType
+      nullptr,                           // const void     *pNext
+      VK_ACCESS_TRANSFER_WRITE_BIT,      // VkAccessFlags   srcAccessMask
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+          VK_ACCESS_UNIFORM_READ_BIT  // VkAccessFlags   dstAccessMask
+  };
+  vkCmdPipelineBarrier(recorder_->handle(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  // Ends the command buffer.
+  recorder_.reset();
+
+  DCHECK(submitted_staging_.empty());
+  submitted_staging_.swap(pending_staging_);
+
+  if (!command_buffer_->Submit(0, nullptr, 0, nullptr)) {
+    // Nothing references the staging buffers if the submit failed.
+    ReleaseStagingBuffers(device_queue_, &submitted_staging_);
+    return false;
+  }
+  return true;
+}
+
+void VulkanUploadBatch::Wait() {
+  if (submitted_staging_.empty())
+    return;
+  command_buffer_->Wait(UINT64_MAX);
+  ReleaseStagingBuffers(device_queue_, &submitted_staging_);
+}
+
+bool VulkanUploadBatch::IsIdle() {
+  if (submitted_staging_.empty())
+    return true;
+  if (!command_buffer_->SubmissionFinished())
+    return false;
+  ReleaseStagingBuffers(device_queue_, &submitted_staging_);
+  return true;
+}
+
+}  // namespace gpu
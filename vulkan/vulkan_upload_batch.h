@@ -0,0 +1,94 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_UPLOAD_BATCH_H_
+#define GPU_VULKAN_VULKAN_UPLOAD_BATCH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_memory_allocator.h"
+
+namespace gpu {
+
+class ScopedSingleUseCommandBufferRecorder;
+class VulkanCommandBuffer;
+class VulkanCommandPool;
+class VulkanDeviceQueue;
+
+// Host visible buffer holding the source of one copy.
+struct VulkanStagingBuffer {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VulkanMemoryAllocation allocation;
+};
+
+// Creates a staging buffer holding a copy of |size| bytes of |data|.
+VULKAN_EXPORT bool CreateStagingBuffer(VulkanDeviceQueue* device_queue,
+                                       const void* data,
+                                       VkDeviceSize size,
+                                       VulkanStagingBuffer* staging);
+
+// Hands |staging_buffers| to the device's deletion queue and clears the
+// vector. They are destroyed once the graphics queue's work submitted so far
+// has retired, so work on other queues must no longer read them.
+VULKAN_EXPORT void ReleaseStagingBuffers(
+    VulkanDeviceQueue* device_queue,
+    std::vector<VulkanStagingBuffer>* staging_buffers);
+
+// Collects copies into device local buffers. Each Upload() writes the data
+// into a transient host visible staging buffer and records a
+// vkCmdCopyBuffer() into a one-shot command buffer; Submit() sends all of
+// them with a single vkQueueSubmit() tracked by the command buffer's fence.
+// Staging memory is released once that fence is known to be signaled.
+class VULKAN_EXPORT VulkanUploadBatch {
+ public:
+  explicit VulkanUploadBatch(VulkanDeviceQueue* device_queue);
+  ~VulkanUploadBatch();
+
+  bool Initialize();
+  void Destroy();
+
+  // Schedules a copy of |size| bytes from |data| into |dst_buffer| at
+  // |dst_offset|. |data| may be released as soon as this returns.
+  bool Upload(VkBuffer dst_buffer,
+              VkDeviceSize dst_offset,
+              const void* data,
+              VkDeviceSize size);
+
+  // Submits every copy scheduled since the last Submit(). The copies are
+  // made visible to vertex, index and uniform reads of later submissions.
+  bool Submit();
+
+  // Blocks until the last Submit() has completed and frees its staging
+  // buffers.
+  void Wait();
+
+  // Returns true when no submitted copy is pending on the GPU, releasing the
+  // staging buffers of a finished submission without blocking.
+  bool IsIdle();
+
+  size_t num_pending_uploads() const { return pending_staging_.size(); }
+
+ private:
+  VulkanDeviceQueue* device_queue_;
+  std::unique_ptr<VulkanCommandPool> command_pool_;
+  std::unique_ptr<VulkanCommandBuffer> command_buffer_;
+
+  // Alive while copies are being recorded, ended by Submit().
+  std::unique_ptr<ScopedSingleUseCommandBufferRecorder> recorder_;
+
+  // Staging buffers referenced by the recording and by the last submission.
+  std::vector<VulkanStagingBuffer> pending_staging_;
+  std::vector<VulkanStagingBuffer> submitted_staging_;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanUploadBatch);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_UPLOAD_BATCH_H_
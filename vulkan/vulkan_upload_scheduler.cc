@@ -0,0 +1,295 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_upload_scheduler.h"
+
+#include "base/logging.h"
+#include "vulkan_command_buffer.h"
+#include "vulkan_command_pool.h"
+#include "vulkan_device_queue.h"
+#include "vulkan_sync_pool.h"
+
+namespace gpu {
+
+VulkanUploadScheduler::Batch::Batch() {}
+
+VulkanUploadScheduler::Batch::~Batch() {
+  DCHECK(!transfer_command_buffer);
+  DCHECK(!acquire_command_buffer);
+  DCHECK_EQ(static_cast<VkSemaphore>(VK_NULL_HANDLE), semaphore);
+}
+
+VulkanUploadScheduler::VulkanUploadScheduler(VulkanDeviceQueue* device_queue)
+    : device_queue_(device_queue) {}
+
+VulkanUploadScheduler::~VulkanUploadScheduler() {
+  DCHECK(!transfer_command_pool_);
+  DCHECK(!graphics_command_pool_);
+  DCHECK(batches_in_flight_.empty());
+}
+
+bool VulkanUploadScheduler::Initialize() {
+  const VkCommandPoolCreateFlags kFlags =
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  transfer_command_pool_ = device_queue_->CreateCommandPool(
+      nullptr, kFlags, device_queue_->GetTransferQueueFamilyIndex());
+  if (!transfer_command_pool_)
+    return false;
+
+  graphics_command_pool_ = device_queue_->CreateCommandPool(
+      nullptr, kFlags, device_queue_->GetGraphicsQueueFamilyIndex());
+  return !!graphics_command_pool_;
+}
+
+void VulkanUploadScheduler::Destroy() {
+  if (transfer_command_pool_ && graphics_command_pool_)
+    Finish();
+
+  for (std::unique_ptr<Batch>& batch : free_batches_)
+    DestroyBatch(batch.get());
+  free_batches_.clear();
+
+  if (graphics_command_pool_) {
+    graphics_command_pool_->Destroy();
+    graphics_command_pool_.reset();
+  }
+  if (transfer_command_pool_) {
+    transfer_command_pool_->Destroy();
+    transfer_command_pool_.reset();
+  }
+}
+
+bool VulkanUploadScheduler::Upload(VkBuffer dst_buffer,
+                                   VkDeviceSize dst_offset,
+                                   const void* data,
+                                   VkDeviceSize size,
+                                   VkPipelineStageFlags dst_stage_mask,
+                                   VkAccessFlags dst_access_mask) {
+  DCHECK(transfer_command_pool_);
+  DCHECK(dst_stage_mask);
+
+  VulkanStagingBuffer staging;
+  if (!CreateStagingBuffer(device_queue_, data, size, &staging))
+    return false;
+
+  if (!recording_batch_) {
+    RetireCompletedBatches();
+    if (free_batches_.empty()) {
+      recording_batch_ = CreateBatch();
+      if (!recording_batch_) {
+        std::vector<VulkanStagingBuffer> unused(1, staging);
+        ReleaseStagingBuffers(device_queue_, &unused);
+        return false;
+      }
+    } else {
+      recording_batch_ = std::move(free_batches_.back());
+      free_batches_.pop_back();
+    }
+    recorder_.reset(new ScopedSingleUseCommandBufferRecorder(
+        *recording_batch_->transfer_command_buffer));
+  }
+
+  VkBufferCopy region = {
+      0,           // VkDeviceSize srcOffset
+      dst_offset,  // VkDeviceSize dstOffset
+      size         // VkDeviceSize size
+  };
+  vkCmdCopyBuffer(recorder_->handle(), staging.buffer, dst_buffer, 1, &region);
+
+  const uint32_t src_family = device_queue_->GetTransferQueueFamilyIndex();
+  const uint32_t dst_family = device_queue_->GetGraphicsQueueFamilyIndex();
+  const bool transfer_ownership = src_family != dst_family;
+  VkBufferMemoryBarrier barrier = {
+      VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,  // VkStructureType sType
+      nullptr,                                  // const void *pNext
+      VK_ACCESS_TRANSFER_WRITE_BIT,  // VkAccessFlags srcAccessMask
+      dst_access_mask,               // VkAccessFlags dstAccessMask
+      transfer_ownership ? src_family
+                         : VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+      transfer_ownership ? dst_family
+                         : VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+      dst_buffer,  // VkBuffer buffer
+      dst_offset,  // VkDeviceSize offset
+      size         // VkDeviceSize size
+  };
+  recording_batch_->barriers.push_back(barrier);
+  recording_batch_->dst_stage_mask |= dst_stage_mask;
+  recording_batch_->staging_buffers.push_back(staging);
+  return true;
+}
+
+VulkanUploadScheduler::Ticket VulkanUploadScheduler::Flush() {
+  if (!recording_batch_)
+    return last_flushed_ticket_;
+
+  std::unique_ptr<Batch> batch = std::move(recording_batch_);
+
+  // The release half of the ownership transfers. Its destination access is
+  // ignored, the acquire barrier makes the writes visible on the graphics
+  // queue.
+  if (device_queue_->HasDedicatedTransferQueue()) {
+    std::vector<VkBufferMemoryBarrier> release_barriers = batch->barriers;
+    for (VkBufferMemoryBarrier& barrier : release_barriers)
+      barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(recorder_->handle(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(release_barriers.size()),
+                         release_barriers.data(), 0, nullptr);
+  }
+
+  // Ends the command buffer.
+  recorder_.reset();
+
+  if (!batch->transfer_command_buffer->Submit(0, nullptr, 1,
+                                              &batch->semaphore)) {
+    // Nothing references the staging buffers if the submit failed.
+    ReleaseStagingBuffers(device_queue_, &batch->staging_buffers);
+    batch->barriers.clear();
+    batch->dst_stage_mask = 0;
+    free_batches_.push_back(std::move(batch));
+    return 0;
+  }
+
+  batch->ticket = ++last_flushed_ticket_;
+  batch->acquired = false;
+  batches_in_flight_.push_back(std::move(batch));
+  return last_flushed_ticket_;
+}
+
+bool VulkanUploadScheduler::IsTransferComplete(Ticket ticket) {
+  if (ticket > last_flushed_ticket_)
+    return false;
+  for (const std::unique_ptr<Batch>& batch : batches_in_flight_) {
+    if (batch->ticket > ticket)
+      break;
+    if (!batch->transfer_command_buffer->SubmissionFinished())
+      return false;
+  }
+  return true;
+}
+
+bool VulkanUploadScheduler::Acquire(Ticket ticket) {
+  DCHECK_LE(ticket, last_flushed_ticket_);
+  for (std::unique_ptr<Batch>& batch : batches_in_flight_) {
+    if (batch->ticket > ticket)
+      break;
+    if (batch->acquired)
+      continue;
+
+    {
+      ScopedSingleUseCommandBufferRecorder recorder(
+          *batch->acquire_command_buffer);
+      // The barriers chain to the semaphore wait through |dst_stage_mask|,
+      // and the wait already made the copies available. Without an
+      // ownership transfer they merely repeat the wait.
+      std::vector<VkBufferMemoryBarrier> acquire_barriers = batch->barriers;
+      for (VkBufferMemoryBarrier& barrier : acquire_barriers)
+        barrier.srcAccessMask = 0;
+      vkCmdPipelineBarrier(recorder.handle(), batch->dst_stage_mask,
+                           batch->dst_stage_mask, 0, 0, nullptr,
+                           static_cast<uint32_t>(acquire_barriers.size()),
+                           acquire_barriers.data(), 0, nullptr);
+    }
+
+    if (!batch->acquire_command_buffer->Submit(1, &batch->semaphore, 0,
+                                               nullptr,
+                                               &batch->dst_stage_mask)) {
+      return false;
+    }
+    batch->acquired = true;
+  }
+
+  RetireCompletedBatches();
+  return true;
+}
+
+void VulkanUploadScheduler::Finish() {
+  Flush();
+  Acquire(last_flushed_ticket_);
+  for (std::unique_ptr<Batch>& batch : batches_in_flight_) {
+    batch->transfer_command_buffer->Wait(UINT64_MAX);
+    if (batch->acquired)
+      batch->acquire_command_buffer->Wait(UINT64_MAX);
+  }
+
+  while (!batches_in_flight_.empty()) {
+    std::unique_ptr<Batch>& batch = batches_in_flight_.front();
+    if (batch->acquired &&
+        batch->acquire_command_buffer->SubmissionFinished()) {
+      RetireCompletedBatches();
+      continue;
+    }
+    // Acquire() failed and the semaphore was left signaled, so neither the
+    // batch nor the semaphore can be reused.
+    ReleaseStagingBuffers(device_queue_, &batch->staging_buffers);
+    vkDestroySemaphore(device_queue_->GetVulkanDevice(), batch->semaphore,
+                       nullptr);
+    batch->semaphore = VK_NULL_HANDLE;
+    DestroyBatch(batch.get());
+    batches_in_flight_.pop_front();
+  }
+}
+
+bool VulkanUploadScheduler::HasDedicatedTransferQueue() const {
+  return device_queue_->HasDedicatedTransferQueue();
+}
+
+size_t VulkanUploadScheduler::num_pending_uploads() const {
+  return recording_batch_ ? recording_batch_->staging_buffers.size() : 0;
+}
+
+std::unique_ptr<VulkanUploadScheduler::Batch>
+VulkanUploadScheduler::CreateBatch() {
+  std::unique_ptr<Batch> batch(new Batch);
+  batch->transfer_command_buffer =
+      transfer_command_pool_->CreatePrimaryCommandBuffer();
+  batch->acquire_command_buffer =
+      graphics_command_pool_->CreatePrimaryCommandBuffer();
+
+  batch->semaphore = device_queue_->GetSemaphorePool()->Acquire();
+
+  if (!batch->transfer_command_buffer || !batch->acquire_command_buffer ||
+      VK_NULL_HANDLE == batch->semaphore) {
+    DestroyBatch(batch.get());
+    return nullptr;
+  }
+  return batch;
+}
+
+void VulkanUploadScheduler::DestroyBatch(Batch* batch) {
+  DCHECK(batch->staging_buffers.empty());
+  if (batch->transfer_command_buffer) {
+    batch->transfer_command_buffer->Destroy();
+    batch->transfer_command_buffer.reset();
+  }
+  if (batch->acquire_command_buffer) {
+    batch->acquire_command_buffer->Destroy();
+    batch->acquire_command_buffer.reset();
+  }
+  if (VK_NULL_HANDLE != batch->semaphore) {
+    device_queue_->GetSemaphorePool()->Release(batch->semaphore);
+    batch->semaphore = VK_NULL_HANDLE;
+  }
+}
+
+void VulkanUploadScheduler::RetireCompletedBatches() {
+  // The acquire submission waited for the transfer one, so once it is done
+  // neither reads the staging buffers or the semaphore any more.
+  while (!batches_in_flight_.empty()) {
+    std::unique_ptr<Batch>& batch = batches_in_flight_.front();
+    if (!batch->acquired ||
+        !batch->acquire_command_buffer->SubmissionFinished()) {
+      break;
+    }
+    ReleaseStagingBuffers(device_queue_, &batch->staging_buffers);
+    batch->barriers.clear();
+    batch->dst_stage_mask = 0;
+    batch->ticket = 0;
+    free_batches_.push_back(std::move(batch));
+    batches_in_flight_.pop_front();
+  }
+}
+
+}  // namespace gpu
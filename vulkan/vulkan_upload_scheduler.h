@@ -0,0 +1,127 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_UPLOAD_SCHEDULER_H_
+#define GPU_VULKAN_VULKAN_UPLOAD_SCHEDULER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "gpu/vulkan/vulkan_export.h"
+#include "vulkan_upload_batch.h"
+
+namespace gpu {
+
+class ScopedSingleUseCommandBufferRecorder;
+class VulkanCommandBuffer;
+class VulkanCommandPool;
+class VulkanDeviceQueue;
+
+// Streams buffer uploads through the device's transfer queue so that large
+// copies run on the copy engine while the graphics queue keeps rendering.
+//
+// Flush() submits the copies of a batch to the transfer queue, releasing
+// each destination buffer to the graphics queue family, and signals a
+// semaphore. Acquire() submits the matching acquire barriers to the graphics
+// queue, waiting on that semaphore, after which later graphics submissions
+// may read the buffers. Polling IsTransferComplete() before Acquire() keeps
+// the graphics queue from ever stalling on an upload. Without a dedicated
+// transfer family both sides run on the graphics queue and the ownership
+// transfers are skipped.
+//
+// Destination buffers must be created with VK_SHARING_MODE_EXCLUSIVE and
+// must not be used by the graphics queue between Upload() and Acquire().
+class VULKAN_EXPORT VulkanUploadScheduler {
+ public:
+  // Identifies the copies submitted by one Flush(). Tickets increase
+  // monotonically, starting at 1.
+  using Ticket = uint64_t;
+
+  explicit VulkanUploadScheduler(VulkanDeviceQueue* device_queue);
+  ~VulkanUploadScheduler();
+
+  bool Initialize();
+  void Destroy();
+
+  // Schedules a copy of |size| bytes from |data| into |dst_buffer| at
+  // |dst_offset|. |dst_stage_mask| and |dst_access_mask| describe the first
+  // reads of the graphics queue, e.g. VK_PIPELINE_STAGE_VERTEX_INPUT_BIT and
+  // VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT. |data| may be released as soon as
+  // this returns.
+  bool Upload(VkBuffer dst_buffer,
+              VkDeviceSize dst_offset,
+              const void* data,
+              VkDeviceSize size,
+              VkPipelineStageFlags dst_stage_mask,
+              VkAccessFlags dst_access_mask);
+
+  // Submits every copy scheduled since the last Flush() to the transfer
+  // queue and returns its ticket, or 0 on failure. Returns the last ticket
+  // if nothing was scheduled.
+  Ticket Flush();
+
+  // Whether the copies of |ticket| and all earlier ones have finished on the
+  // transfer queue. Does not block.
+  bool IsTransferComplete(Ticket ticket);
+
+  // Hands the buffers of |ticket| and all earlier tickets over to the
+  // graphics queue. Graphics work submitted after this returns may read
+  // them; it waits on the GPU for copies that are still running.
+  bool Acquire(Ticket ticket);
+
+  // Flushes and acquires everything scheduled, then blocks until the GPU is
+  // done with it and releases all staging memory.
+  void Finish();
+
+  bool HasDedicatedTransferQueue() const;
+  size_t num_pending_uploads() const;
+  size_t num_batches_in_flight() const { return batches_in_flight_.size(); }
+
+ private:
+  struct Batch {
+    Batch();
+    ~Batch();
+
+    Ticket ticket = 0;
+    std::unique_ptr<VulkanCommandBuffer> transfer_command_buffer;
+    std::unique_ptr<VulkanCommandBuffer> acquire_command_buffer;
+    // Signaled by the transfer submission, waited on by the acquire one.
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    std::vector<VulkanStagingBuffer> staging_buffers;
+    // Ownership transfers, recorded as release barriers on the transfer
+    // queue and as acquire barriers on the graphics queue.
+    std::vector<VkBufferMemoryBarrier> barriers;
+    VkPipelineStageFlags dst_stage_mask = 0;
+    bool acquired = false;
+  };
+
+  std::unique_ptr<Batch> CreateBatch();
+  void DestroyBatch(Batch* batch);
+  // Recycles the batches whose acquire submission finished.
+  void RetireCompletedBatches();
+
+  VulkanDeviceQueue* device_queue_;
+  std::unique_ptr<VulkanCommandPool> transfer_command_pool_;
+  std::unique_ptr<VulkanCommandPool> graphics_command_pool_;
+
+  // Batch being recorded, its recorder ended by Flush().
+  std::unique_ptr<Batch> recording_batch_;
+  std::unique_ptr<ScopedSingleUseCommandBufferRecorder> recorder_;
+
+  // Flushed batches in ticket order and retired ones kept for reuse.
+  std::deque<std::unique_ptr<Batch>> batches_in_flight_;
+  std::vector<std::unique_ptr<Batch>> free_batches_;
+
+  Ticket last_flushed_ticket_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(VulkanUploadScheduler);
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_UPLOAD_SCHEDULER_H_
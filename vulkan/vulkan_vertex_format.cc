@@ -0,0 +1,128 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vulkan_vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gpu {
+
+namespace {
+
+uint8_t ToUNorm8(float value) {
+  return static_cast<uint8_t>(
+      std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+int8_t ToSNorm8(float value) {
+  return static_cast<int8_t>(
+      std::lround(std::min(std::max(value, -1.0f), 1.0f) * 127.0f));
+}
+
+uint16_t ToUNorm16(float value) {
+  return static_cast<uint16_t>(
+      std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+}
+
+}  // namespace
+
+VulkanVertexInput::VulkanVertexInput() {}
+
+VulkanVertexInput::VulkanVertexInput(const VulkanVertexInput& other) = default;
+
+VulkanVertexInput::~VulkanVertexInput() {}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000;
+  const uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  // Infinity and NaN, keeping NaNs quiet.
+  if (exponent == 0xff)
+    return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+  const int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+  if (half_exponent >= 0x1f)
+    return static_cast<uint16_t>(sign | 0x7c00);
+
+  if (half_exponent <= 0) {
+    // Too small even for a denormal half.
+    if (half_exponent < -10)
+      return static_cast<uint16_t>(sign);
+
+    // Denormal half: shift the mantissa including its implicit bit and
+    // round to nearest even.
+    mantissa |= 0x800000;
+    const uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+    uint32_t half_mantissa = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+      half_mantissa++;
+    return static_cast<uint16_t>(sign | half_mantissa);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) |
+                  (mantissa >> 13);
+  // Round to nearest even. A carry out of the mantissa correctly bumps the
+  // exponent, up to infinity.
+  const uint32_t remainder = mantissa & 0x1fff;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    half++;
+  return static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent) {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa) {
+    // Normalize the denormal.
+    exponent = 127 - 15 + 1;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  } else {
+    bits = sign;
+  }
+
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+Half2 PackHalf2(float x, float y) {
+  return {FloatToHalf(x), FloatToHalf(y)};
+}
+
+Half4 PackHalf4(float x, float y, float z, float w) {
+  return {FloatToHalf(x), FloatToHalf(y), FloatToHalf(z), FloatToHalf(w)};
+}
+
+UNorm8x4 PackUNorm8x4(float x, float y, float z, float w) {
+  return {ToUNorm8(x), ToUNorm8(y), ToUNorm8(z), ToUNorm8(w)};
+}
+
+SNorm8x4 PackSNorm8x4(float x, float y, float z, float w) {
+  return {ToSNorm8(x), ToSNorm8(y), ToSNorm8(z), ToSNorm8(w)};
+}
+
+UNorm16x2 PackUNorm16x2(float x, float y) {
+  return {ToUNorm16(x), ToUNorm16(y)};
+}
+
+}  // namespace gpu
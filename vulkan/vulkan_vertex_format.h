@@ -0,0 +1,221 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GPU_VULKAN_VULKAN_VERTEX_FORMAT_H_
+#define GPU_VULKAN_VULKAN_VERTEX_FORMAT_H_
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "gpu/vulkan/vulkan_export.h"
+
+namespace gpu {
+
+// Attribute storage types. Each maps to the VkFormat the vertex shader reads
+// it as through VulkanVertexFormatTraits, so a vertex struct built from them
+// fully describes its own vertex input state.
+struct Float2 {
+  float x, y;
+};
+struct Float3 {
+  float x, y, z;
+};
+struct Float4 {
+  float x, y, z, w;
+};
+
+// IEEE half floats, e.g. positions of meshes with a small extent.
+struct Half2 {
+  uint16_t x, y;
+};
+struct Half4 {
+  uint16_t x, y, z, w;
+};
+
+// [0, 1] mapped to [0, 255], e.g. colors.
+struct UNorm8x4 {
+  uint8_t x, y, z, w;
+};
+
+// [-1, 1] mapped to [-127, 127], e.g. normals and tangents.
+struct SNorm8x4 {
+  int8_t x, y, z, w;
+};
+
+// [0, 1] mapped to [0, 65535], e.g. texture coordinates.
+struct UNorm16x2 {
+  uint16_t x, y;
+};
+
+template <typename T>
+struct VulkanVertexFormatTraits;
+
+#define GPU_VULKAN_VERTEX_FORMAT(type, format)          \
+  template <>                                           \
+  struct VulkanVertexFormatTraits<type> {               \
+    static constexpr VkFormat kFormat = format;         \
+  };
+
+GPU_VULKAN_VERTEX_FORMAT(float, VK_FORMAT_R32_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(Float2, VK_FORMAT_R32G32_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(Float3, VK_FORMAT_R32G32B32_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(Float4, VK_FORMAT_R32G32B32A32_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(Half2, VK_FORMAT_R16G16_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(Half4, VK_FORMAT_R16G16B16A16_SFLOAT)
+GPU_VULKAN_VERTEX_FORMAT(UNorm8x4, VK_FORMAT_R8G8B8A8_UNORM)
+GPU_VULKAN_VERTEX_FORMAT(SNorm8x4, VK_FORMAT_R8G8B8A8_SNORM)
+GPU_VULKAN_VERTEX_FORMAT(UNorm16x2, VK_FORMAT_R16G16_UNORM)
+
+#undef GPU_VULKAN_VERTEX_FORMAT
+
+// Size in bytes of the formats above, 0 for anything else.
+constexpr uint32_t VertexFormatSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+      return 4;
+    case VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+      return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+// Conversions into the packed types. These round to nearest and clamp.
+VULKAN_EXPORT uint16_t FloatToHalf(float value);
+VULKAN_EXPORT float HalfToFloat(uint16_t value);
+VULKAN_EXPORT Half2 PackHalf2(float x, float y);
+VULKAN_EXPORT Half4 PackHalf4(float x, float y, float z, float w);
+VULKAN_EXPORT UNorm8x4 PackUNorm8x4(float x, float y, float z, float w);
+VULKAN_EXPORT SNorm8x4 PackSNorm8x4(float x, float y, float z, float w);
+VULKAN_EXPORT UNorm16x2 PackUNorm16x2(float x, float y);
+
+// One attribute at |Offset| within the vertex, read as |Format|.
+template <VkFormat Format, uint32_t Offset>
+struct VulkanVertexAttribute {
+  static constexpr VkFormat kFormat = Format;
+  static constexpr uint32_t kOffset = Offset;
+  static constexpr uint32_t kSize = VertexFormatSize(Format);
+  static_assert(kSize > 0, "Unknown vertex attribute format");
+
+  static constexpr VkVertexInputAttributeDescription Describe(
+      uint32_t location,
+      uint32_t binding) {
+    return {location, binding, Format, Offset};
+  }
+};
+
+// Describes |member| of |vertex| with the format implied by its type.
+#define GPU_VERTEX_ATTRIBUTE(vertex, member)                                \
+  ::gpu::VulkanVertexAttribute<                                             \
+      ::gpu::VulkanVertexFormatTraits<decltype(vertex::member)>::kFormat,   \
+      offsetof(vertex, member)>
+
+// Describes |member| of |vertex| read with an explicit |format|, for members
+// whose type doesn't imply it (e.g. the first of four floats).
+#define GPU_VERTEX_ATTRIBUTE_FORMAT(vertex, member, format) \
+  ::gpu::VulkanVertexAttribute<format, offsetof(vertex, member)>
+
+// Vertex input state handed to VulkanRenderPass::CreatePipeline().
+struct VULKAN_EXPORT VulkanVertexInput {
+  VulkanVertexInput();
+  VulkanVertexInput(const VulkanVertexInput& other);
+  ~VulkanVertexInput();
+
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+namespace internal {
+
+constexpr bool AllOf(std::initializer_list<bool> values) {
+  for (bool value : values) {
+    if (!value)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace internal
+
+// Compile-time vertex layout. Attributes are assigned consecutive shader
+// locations in the order they are listed:
+//
+//   struct MeshVertex {  // 16 bytes instead of 48 with floats.
+//     Half4 position;
+//     SNorm8x4 normal;
+//     UNorm8x4 color;
+//   };
+//   using MeshVertexLayout =
+//       VulkanVertexLayout<MeshVertex,
+//                          GPU_VERTEX_ATTRIBUTE(MeshVertex, position),
+//                          GPU_VERTEX_ATTRIBUTE(MeshVertex, normal),
+//                          GPU_VERTEX_ATTRIBUTE(MeshVertex, color)>;
+//
+//   constexpr auto kAttributes = MeshVertexLayout::Attributes();
+//   render_pass.CreatePipeline(vs, fs, topology,
+//                              MeshVertexLayout::Describe());
+template <typename Vertex, typename... VertexAttributes>
+class VulkanVertexLayout {
+ public:
+  static constexpr uint32_t kStride = sizeof(Vertex);
+  static constexpr uint32_t kAttributeCount = sizeof...(VertexAttributes);
+
+  using AttributeArray =
+      std::array<VkVertexInputAttributeDescription, kAttributeCount>;
+
+  static constexpr VkVertexInputBindingDescription Binding(
+      uint32_t binding = 0,
+      VkVertexInputRate input_rate = VK_VERTEX_INPUT_RATE_VERTEX) {
+    return {binding, kStride, input_rate};
+  }
+
+  static constexpr AttributeArray Attributes(uint32_t binding = 0,
+                                             uint32_t first_location = 0) {
+    return MakeAttributes(binding, first_location,
+                          std::make_index_sequence<kAttributeCount>());
+  }
+
+  static VulkanVertexInput Describe(uint32_t binding = 0) {
+    VulkanVertexInput vertex_input;
+    vertex_input.bindings.push_back(Binding(binding));
+    AttributeArray attributes = Attributes(binding);
+    vertex_input.attributes.assign(attributes.begin(), attributes.end());
+    return vertex_input;
+  }
+
+ private:
+  static_assert(kAttributeCount > 0, "A vertex needs at least one attribute");
+  static_assert(internal::AllOf({(VertexAttributes::kOffset +
+                                      VertexAttributes::kSize <=
+                                  sizeof(Vertex))...}),
+                "Vertex attribute extends past the end of the vertex");
+
+  template <size_t... Locations>
+  static constexpr AttributeArray MakeAttributes(
+      uint32_t binding,
+      uint32_t first_location,
+      std::index_sequence<Locations...>) {
+    return {{VertexAttributes::Describe(
+        first_location + static_cast<uint32_t>(Locations), binding)...}};
+  }
+};
+
+}  // namespace gpu
+
+#endif  // GPU_VULKAN_VULKAN_VERTEX_FORMAT_H_